@@ -2040,6 +2040,58 @@ static void test_delete_value(void)
        "expect ERROR_FILE_NOT_FOUND, got %i\n", res);
 }
 
+static void test_flush_key_tree(void)
+{
+    HKEY hkey, subkey;
+    char name[16], buffer[16];
+    DWORD i, type, size, count, data;
+    LONG res;
+
+    res = RegCreateKeyA( hkey_main, "Tree", &hkey );
+    ok(res == ERROR_SUCCESS, "expect ERROR_SUCCESS, got %i\n", res);
+    for (i = 0; i < 20; i++)
+    {
+        sprintf( name, "key%u", i );
+        res = RegCreateKeyA( hkey, name, &subkey );
+        ok(res == ERROR_SUCCESS, "expect ERROR_SUCCESS, got %i\n", res);
+        res = RegSetValueExA( subkey, "dword", 0, REG_DWORD, (const BYTE *)&i, sizeof(i) );
+        ok(res == ERROR_SUCCESS, "expect ERROR_SUCCESS, got %i\n", res);
+        res = RegSetValueExA( subkey, NULL, 0, REG_SZ, (const BYTE *)name, strlen(name) + 1 );
+        ok(res == ERROR_SUCCESS, "expect ERROR_SUCCESS, got %i\n", res);
+        RegCloseKey( subkey );
+    }
+    RegCloseKey( hkey );
+
+    res = RegFlushKey( HKEY_CURRENT_USER );
+    ok(res == ERROR_SUCCESS, "expect ERROR_SUCCESS, got %i\n", res);
+
+    /* the tree must be unchanged after being saved */
+    res = RegOpenKeyA( hkey_main, "Tree", &hkey );
+    ok(res == ERROR_SUCCESS, "expect ERROR_SUCCESS, got %i\n", res);
+    res = RegQueryInfoKeyA( hkey, NULL, NULL, NULL, &count, NULL, NULL, NULL, NULL, NULL, NULL, NULL );
+    ok(res == ERROR_SUCCESS, "expect ERROR_SUCCESS, got %i\n", res);
+    ok(count == 20, "expected 20 subkeys, got %u\n", count);
+    for (i = 0; i < 20; i++)
+    {
+        sprintf( name, "key%u", i );
+        res = RegOpenKeyA( hkey, name, &subkey );
+        ok(res == ERROR_SUCCESS, "expect ERROR_SUCCESS for %s, got %i\n", name, res);
+        if (res) continue;
+        size = sizeof(data);
+        data = ~0u;
+        res = RegQueryValueExA( subkey, "dword", NULL, &type, (BYTE *)&data, &size );
+        ok(res == ERROR_SUCCESS, "expect ERROR_SUCCESS, got %i\n", res);
+        ok(type == REG_DWORD && data == i, "wrong value %u type %u for %s\n", data, type, name);
+        size = sizeof(buffer);
+        res = RegQueryValueExA( subkey, NULL, NULL, &type, (BYTE *)buffer, &size );
+        ok(res == ERROR_SUCCESS, "expect ERROR_SUCCESS, got %i\n", res);
+        ok(type == REG_SZ && !strcmp( buffer, name ), "wrong default value %s for %s\n", buffer, name);
+        RegCloseKey( subkey );
+    }
+    delete_key( hkey );
+    RegCloseKey( hkey );
+}
+
 START_TEST(registry)
 {
     /* Load pointers for functions that are not available in all Windows versions */
@@ -2077,6 +2129,7 @@ START_TEST(registry)
     test_rw_order();
     test_deleted_key();
     test_delete_value();
+    test_flush_key_tree();
 
     /* cleanup */
     delete_key( hkey_main );
@@ -784,6 +784,154 @@ static void test_readdirectorychanges_filedir(void)
     ok( r == TRUE, "failed to remove directory\n");
 }
 
+#define MANY_CHANGES 1000
+#define SMALL_CHANGES 40
+
+static void test_readdirectorychanges_many(void)
+{
+    static const WCHAR newW[] = {'s','u','b','\\','s','u','b','s','u','b','\\','n','e','w',0};
+    char path[MAX_PATH], sub[MAX_PATH + 4], subsub[MAX_PATH + 11], name[MAX_PATH + 32];
+    DWORD buffer[0x4000], small[0x100], start, r, count, calls;
+    PFILE_NOTIFY_INFORMATION pfni;
+    OVERLAPPED ov;
+    HANDLE hdir, file;
+    int i;
+
+    if (!pReadDirectoryChangesW)
+    {
+        win_skip("ReadDirectoryChangesW is not available\n");
+        return;
+    }
+
+    GetTempPathA( MAX_PATH, path );
+    lstrcatA( path, "WineChangeTest" );
+    sprintf( sub, "%s\\sub", path );
+    sprintf( subsub, "%s\\subsub", sub );
+
+    /* the subdirectories exist before the watch is set */
+    r = CreateDirectoryA( path, NULL );
+    ok( r == TRUE, "failed to create directory\n");
+    r = CreateDirectoryA( sub, NULL );
+    ok( r == TRUE, "failed to create directory\n");
+    r = CreateDirectoryA( subsub, NULL );
+    ok( r == TRUE, "failed to create directory\n");
+
+    hdir = CreateFileA( path, GENERIC_READ|SYNCHRONIZE|FILE_LIST_DIRECTORY,
+                        FILE_SHARE_READ|FILE_SHARE_WRITE|FILE_SHARE_DELETE, NULL,
+                        OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, NULL );
+    ok( hdir != INVALID_HANDLE_VALUE, "failed to open directory\n");
+
+    memset( &ov, 0, sizeof(ov) );
+    ov.hEvent = CreateEvent( NULL, 1, 0, NULL );
+
+    r = pReadDirectoryChangesW( hdir, buffer, sizeof(buffer), TRUE, FILE_NOTIFY_CHANGE_FILE_NAME,
+                                NULL, &ov, NULL );
+    ok( r == TRUE, "should return true\n" );
+
+    sprintf( name, "%s\\new", subsub );
+    file = CreateFileA( name, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, NULL );
+    ok( file != INVALID_HANDLE_VALUE, "failed to create file\n" );
+    CloseHandle( file );
+
+    r = WaitForSingleObject( ov.hEvent, 1000 );
+    ok( r == WAIT_OBJECT_0, "event should be ready\n" );
+    ok( ov.Internal == STATUS_SUCCESS, "ov.Internal wrong %lx\n", ov.Internal );
+
+    pfni = (PFILE_NOTIFY_INFORMATION)buffer;
+    ok( pfni->Action == FILE_ACTION_ADDED, "action wrong %u\n", pfni->Action );
+    ok( pfni->FileNameLength == lstrlenW(newW) * sizeof(WCHAR) &&
+        !memcmp( pfni->FileName, newW, pfni->FileNameLength ), "name wrong %s\n",
+        wine_dbgstr_wn( pfni->FileName, pfni->FileNameLength / sizeof(WCHAR) ));
+
+    /* the changes made between two calls are returned together */
+    start = GetTickCount();
+    for (i = 0; i < MANY_CHANGES; i++)
+    {
+        sprintf( name, "%s\\file%d", sub, i );
+        file = CreateFileA( name, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, NULL );
+        ok( file != INVALID_HANDLE_VALUE, "failed to create file %d\n", i );
+        CloseHandle( file );
+    }
+
+    count = calls = 0;
+    while (count < MANY_CHANGES)
+    {
+        ResetEvent( ov.hEvent );
+        r = pReadDirectoryChangesW( hdir, buffer, sizeof(buffer), TRUE, FILE_NOTIFY_CHANGE_FILE_NAME,
+                                    NULL, &ov, NULL );
+        ok( r == TRUE, "should return true\n" );
+        if (!r || WaitForSingleObject( ov.hEvent, 1000 )) break;
+        calls++;
+        ok( ov.Internal == STATUS_SUCCESS, "ov.Internal wrong %lx\n", ov.Internal );
+        if (ov.Internal != STATUS_SUCCESS) break;
+
+        pfni = (PFILE_NOTIFY_INFORMATION)buffer;
+        for (;;)
+        {
+            if (pfni->Action == FILE_ACTION_ADDED) count++;
+            if (!pfni->NextEntryOffset) break;
+            pfni = (PFILE_NOTIFY_INFORMATION)((char *)pfni + pfni->NextEntryOffset);
+        }
+    }
+    ok( count == MANY_CHANGES, "got %u changes\n", count );
+    r = GetTickCount() - start;
+    trace( "%u changes returned by %u calls in %u ms (%u changes/s)\n",
+           count, calls, r, count * 1000 / max( r, 1 ));
+
+    /* the changes are split across calls when they don't all fit in a small buffer */
+    for (i = 0; i < SMALL_CHANGES; i++)
+    {
+        sprintf( name, "%s\\small%05d", sub, i );
+        file = CreateFileA( name, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, 0, NULL );
+        ok( file != INVALID_HANDLE_VALUE, "failed to create file %d\n", i );
+        CloseHandle( file );
+    }
+
+    count = calls = 0;
+    while (count < SMALL_CHANGES)
+    {
+        ResetEvent( ov.hEvent );
+        r = pReadDirectoryChangesW( hdir, small, sizeof(small), TRUE, FILE_NOTIFY_CHANGE_FILE_NAME,
+                                    NULL, &ov, NULL );
+        ok( r == TRUE, "should return true\n" );
+        if (!r || WaitForSingleObject( ov.hEvent, 1000 )) break;
+        calls++;
+        ok( ov.Internal == STATUS_SUCCESS, "ov.Internal wrong %lx\n", ov.Internal );
+        if (ov.Internal != STATUS_SUCCESS) break;
+        ok( ov.InternalHigh && ov.InternalHigh <= sizeof(small), "wrong size %lu\n", ov.InternalHigh );
+
+        pfni = (PFILE_NOTIFY_INFORMATION)small;
+        for (;;)
+        {
+            if (pfni->Action == FILE_ACTION_ADDED) count++;
+            if (!pfni->NextEntryOffset) break;
+            pfni = (PFILE_NOTIFY_INFORMATION)((char *)pfni + pfni->NextEntryOffset);
+        }
+    }
+    ok( count == SMALL_CHANGES, "got %u changes\n", count );
+    ok( calls > 1, "changes returned by %u calls\n", calls );
+
+    CloseHandle( ov.hEvent );
+    CloseHandle( hdir );
+
+    for (i = 0; i < MANY_CHANGES; i++)
+    {
+        sprintf( name, "%s\\file%d", sub, i );
+        DeleteFileA( name );
+    }
+    for (i = 0; i < SMALL_CHANGES; i++)
+    {
+        sprintf( name, "%s\\small%05d", sub, i );
+        DeleteFileA( name );
+    }
+    sprintf( name, "%s\\new", subsub );
+    DeleteFileA( name );
+    RemoveDirectoryA( subsub );
+    RemoveDirectoryA( sub );
+    r = RemoveDirectoryA( path );
+    ok( r == TRUE, "failed to remove directory\n");
+}
+
 static void test_ffcn_directory_overlap(void)
 {
     HANDLE parent_watch, child_watch, parent_thread, child_thread;
@@ -884,5 +1032,6 @@ START_TEST(change)
     test_readdirectorychanges();
     test_readdirectorychanges_null();
     test_readdirectorychanges_filedir();
+    test_readdirectorychanges_many();
     test_ffcn_directory_overlap();
 }
@@ -1691,6 +1691,85 @@ static void test_LockFile(void)
     DeleteFileA( filename );
 }
 
+#define MANY_LOCKS 5000
+
+static void test_LockFile_many(void)
+{
+    HANDLE handle, handle2;
+    OVERLAPPED overlapped;
+    DWORD start;
+    int i, count;
+
+    handle = CreateFileA( filename, GENERIC_READ | GENERIC_WRITE,
+                          FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                          CREATE_ALWAYS, 0, 0 );
+    if (handle == INVALID_HANDLE_VALUE)
+    {
+        ok(0,"couldn't create file \"%s\" (err=%d)\n",filename,GetLastError());
+        return;
+    }
+
+    /* one byte exclusive locks on the even offsets */
+    start = GetTickCount();
+    for (i = count = 0; i < MANY_LOCKS; i++) count += LockFile( handle, 2 * i, 0, 1, 0 );
+    ok( count == MANY_LOCKS, "only %u locks succeeded\n", count );
+    trace( "setting %u locks took %u ms\n", MANY_LOCKS, GetTickCount() - start );
+
+    /* the odd offsets are still free, but anything overlapping an even one conflicts */
+    start = GetTickCount();
+    for (i = count = 0; i < MANY_LOCKS; i++)
+    {
+        if (!LockFile( handle, 2 * i + 1, 0, 1, 0 )) continue;
+        count++;
+        ok( !LockFile( handle, 2 * i, 0, 2, 0 ), "LockFile %u,2 succeeded\n", 2 * i );
+        ok( UnlockFile( handle, 2 * i + 1, 0, 1, 0 ), "UnlockFile %u,1 failed\n", 2 * i + 1 );
+    }
+    ok( count == MANY_LOCKS, "only %u locks succeeded\n", count );
+    trace( "checking %u locks took %u ms\n", MANY_LOCKS, GetTickCount() - start );
+
+    ok( !LockFile( handle, 0, 0, 2 * MANY_LOCKS, 0 ), "LockFile covering all the locks succeeded\n" );
+    ok( LockFile( handle, 2 * MANY_LOCKS, 0, 10, 0 ), "LockFile after the locks failed\n" );
+    ok( UnlockFile( handle, 2 * MANY_LOCKS, 0, 10, 0 ), "UnlockFile after the locks failed\n" );
+
+    /* release every other lock, the holes must be usable again */
+    start = GetTickCount();
+    for (i = count = 0; i < MANY_LOCKS; i += 2) count += UnlockFile( handle, 2 * i, 0, 1, 0 );
+    ok( count == MANY_LOCKS / 2, "only %u unlocks succeeded\n", count );
+    trace( "removing %u locks took %u ms\n", MANY_LOCKS / 2, GetTickCount() - start );
+    ok( !UnlockFile( handle, 0, 0, 1, 0 ), "UnlockFile 0,1 again succeeded\n" );
+    ok( LockFile( handle, 3, 0, 3, 0 ), "LockFile 3,3 failed\n" );
+    ok( !LockFile( handle, 5, 0, 2, 0 ), "LockFile 5,2 succeeded\n" );
+    ok( UnlockFile( handle, 3, 0, 3, 0 ), "UnlockFile 3,3 failed\n" );
+
+    /* shared locks overlapping each other */
+    memset( &overlapped, 0, sizeof(overlapped) );
+    for (i = count = 0; i < MANY_LOCKS; i++)
+    {
+        S(U(overlapped)).Offset = 4 * MANY_LOCKS + i;
+        count += LockFileEx( handle, LOCKFILE_FAIL_IMMEDIATELY, 0, 100, 0, &overlapped );
+    }
+    if (count)  /* not supported on win9x */
+    {
+        ok( count == MANY_LOCKS, "only %u shared locks succeeded\n", count );
+        S(U(overlapped)).Offset = 5 * MANY_LOCKS;
+        ok( !LockFileEx( handle, LOCKFILE_EXCLUSIVE_LOCK|LOCKFILE_FAIL_IMMEDIATELY, 0, 1, 0, &overlapped ),
+            "exclusive LockFileEx inside the shared locks succeeded\n" );
+    }
+
+    /* closing the handle releases all the remaining locks */
+    start = GetTickCount();
+    CloseHandle( handle );
+    trace( "closing a file with %u locks took %u ms\n", MANY_LOCKS + count, GetTickCount() - start );
+
+    handle2 = CreateFileA( filename, GENERIC_READ | GENERIC_WRITE,
+                           FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, 0, 0 );
+    ok( handle2 != INVALID_HANDLE_VALUE, "couldn't reopen file (err=%d)\n", GetLastError() );
+    ok( LockFile( handle2, 0, 0, 6 * MANY_LOCKS, 0 ), "LockFile over the released locks failed\n" );
+    ok( UnlockFile( handle2, 0, 0, 6 * MANY_LOCKS, 0 ), "UnlockFile failed\n" );
+    CloseHandle( handle2 );
+    DeleteFileA( filename );
+}
+
 static BOOL create_fake_dll( LPCSTR filename )
 {
     IMAGE_DOS_HEADER *dos;
@@ -2185,6 +2264,104 @@ static void test_FindNextFileA(void)
     ok ( err == ERROR_NO_MORE_FILES, "GetLastError should return ERROR_NO_MORE_FILES\n");
 }
 
+#define MANY_FILES 3000
+
+/* enumerate a directory, checking that every file is returned exactly once */
+static void check_find_many( HANDLE handle, WIN32_FIND_DATAA *data, BYTE *seen, const char *desc )
+{
+    int found = 0, dups = 0, index;
+
+    memset( seen, 0, MANY_FILES );
+    do
+    {
+        if (sscanf( data->cFileName, "file%d.txt", &index ) != 1) continue;
+        if (index < 0 || index >= MANY_FILES) continue;
+        if (seen[index]++) dups++;
+        else found++;
+    } while (FindNextFileA( handle, data ));
+    ok( GetLastError() == ERROR_NO_MORE_FILES, "%s: wrong error %u\n", desc, GetLastError() );
+    ok( found == MANY_FILES, "%s: found %u files\n", desc, found );
+    ok( !dups, "%s: %u files returned twice\n", desc, dups );
+}
+
+static void test_FindNextFile_many(void)
+{
+    char temp_path[MAX_PATH], dir[MAX_PATH + 12], name[MAX_PATH + 32];
+    WIN32_FIND_DATAA data, data2;
+    BYTE *seen, *seen2;
+    HANDLE handle, handle2;
+    DWORD start;
+    int i, j, count, count2;
+    BOOL ret, ret2;
+
+    GetTempPathA( MAX_PATH, temp_path );
+    sprintf( dir, "%sWineFindTest", temp_path );
+    ret = CreateDirectoryA( dir, NULL );
+    ok( ret, "CreateDirectory failed, gle=%d\n", GetLastError() );
+    for (i = 0; i < MANY_FILES; i++)
+    {
+        sprintf( name, "%s\\file%d.txt", dir, i );
+        _lclose( _lcreat( name, 0 ));
+    }
+    seen = HeapAlloc( GetProcessHeap(), 0, MANY_FILES );
+    seen2 = HeapAlloc( GetProcessHeap(), 0, MANY_FILES );
+
+    sprintf( name, "%s\\*", dir );
+    start = GetTickCount();
+    handle = FindFirstFileA( name, &data );
+    ok( handle != INVALID_HANDLE_VALUE, "FindFirstFile failed, gle=%d\n", GetLastError() );
+    check_find_many( handle, &data, seen, "single" );
+    FindClose( handle );
+    trace( "enumerating %u files took %u ms\n", MANY_FILES, GetTickCount() - start );
+
+    /* two searches interleaved in the same directory */
+    handle = FindFirstFileA( name, &data );
+    ok( handle != INVALID_HANDLE_VALUE, "FindFirstFile failed, gle=%d\n", GetLastError() );
+    handle2 = FindFirstFileA( name, &data2 );
+    ok( handle2 != INVALID_HANDLE_VALUE, "FindFirstFile failed, gle=%d\n", GetLastError() );
+    memset( seen, 0, MANY_FILES );
+    memset( seen2, 0, MANY_FILES );
+    count = count2 = 0;
+    ret = ret2 = TRUE;
+    while (ret || ret2)
+    {
+        if (ret)
+        {
+            if (sscanf( data.cFileName, "file%d.txt", &i ) == 1 && i < MANY_FILES && !seen[i]++) count++;
+            ret = FindNextFileA( handle, &data );
+        }
+        /* the second search moves twice as fast */
+        for (j = 0; j < 2 && ret2; j++)
+        {
+            if (sscanf( data2.cFileName, "file%d.txt", &i ) == 1 && i < MANY_FILES && !seen2[i]++) count2++;
+            ret2 = FindNextFileA( handle2, &data2 );
+        }
+    }
+    ok( count == MANY_FILES, "first search found %u files\n", count );
+    ok( count2 == MANY_FILES, "second search found %u files\n", count2 );
+    FindClose( handle );
+    FindClose( handle2 );
+
+    /* search with a mask, to exercise the short names */
+    sprintf( name, "%s\\file1?.txt", dir );
+    handle = FindFirstFileA( name, &data );
+    ok( handle != INVALID_HANDLE_VALUE, "FindFirstFile failed, gle=%d\n", GetLastError() );
+    count = 0;
+    do count++; while (FindNextFileA( handle, &data ));
+    ok( count == 10, "found %u files\n", count );
+    FindClose( handle );
+
+    for (i = 0; i < MANY_FILES; i++)
+    {
+        sprintf( name, "%s\\file%d.txt", dir, i );
+        DeleteFileA( name );
+    }
+    ret = RemoveDirectoryA( dir );
+    ok( ret, "RemoveDirectory failed, gle=%d\n", GetLastError() );
+    HeapFree( GetProcessHeap(), 0, seen );
+    HeapFree( GetProcessHeap(), 0, seen2 );
+}
+
 static void test_FindFirstFileExA(FINDEX_SEARCH_OPS search_ops)
 {
     WIN32_FIND_DATAA search_results;
@@ -2814,6 +2991,86 @@ static void test_RemoveDirectory(void)
     }
 }
 
+static HANDLE open_existing( const char *name )
+{
+    return CreateFileA( name, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL,
+                        OPEN_EXISTING, 0, 0 );
+}
+
+static void test_case_insensitive_open(void)
+{
+    char temp_path[MAX_PATH], dir[MAX_PATH + 16], name[MAX_PATH + 32], name2[MAX_PATH + 32];
+    DWORD start;
+    HANDLE file;
+    BOOL ret;
+    int i;
+
+    GetTempPathA( MAX_PATH, temp_path );
+    sprintf( dir, "%sWineCaseTest", temp_path );
+    ret = CreateDirectoryA( dir, NULL );
+    ok( ret, "CreateDirectory failed, gle=%d\n", GetLastError() );
+
+    for (i = 0; i < 200; i++)
+    {
+        sprintf( name, "%s\\MixedCase%03u.Txt", dir, i );
+        file = CreateFileA( name, GENERIC_WRITE, 0, NULL, CREATE_NEW, 0, 0 );
+        ok( file != INVALID_HANDLE_VALUE, "CreateFile %s failed, gle=%d\n", name, GetLastError() );
+        CloseHandle( file );
+    }
+
+    start = GetTickCount();
+    for (i = 0; i < 2000; i++)
+    {
+        sprintf( name, "%s\\MIXEDCASE%03u.TXT", dir, i % 200 );
+        file = open_existing( name );
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            ok( 0, "CreateFile %s failed, gle=%d\n", name, GetLastError() );
+            break;
+        }
+        CloseHandle( file );
+    }
+    trace( "2000 case-mismatched opens took %u ms\n", GetTickCount() - start );
+
+    /* a new file must be found right away */
+    sprintf( name, "%s\\NewFile.Txt", dir );
+    file = CreateFileA( name, GENERIC_WRITE, 0, NULL, CREATE_NEW, 0, 0 );
+    ok( file != INVALID_HANDLE_VALUE, "CreateFile %s failed, gle=%d\n", name, GetLastError() );
+    CloseHandle( file );
+    sprintf( name, "%s\\NEWFILE.TXT", dir );
+    file = open_existing( name );
+    ok( file != INVALID_HANDLE_VALUE, "CreateFile %s failed, gle=%d\n", name, GetLastError() );
+    CloseHandle( file );
+
+    /* renamed and deleted files must not be found anymore */
+    sprintf( name2, "%s\\Renamed.Txt", dir );
+    ret = MoveFileA( name, name2 );
+    ok( ret, "MoveFile failed, gle=%d\n", GetLastError() );
+    SetLastError( 0xdeadbeef );
+    file = open_existing( name );
+    ok( file == INVALID_HANDLE_VALUE, "CreateFile %s succeeded\n", name );
+    ok( GetLastError() == ERROR_FILE_NOT_FOUND, "wrong error %d\n", GetLastError() );
+    sprintf( name, "%s\\RENAMED.TXT", dir );
+    file = open_existing( name );
+    ok( file != INVALID_HANDLE_VALUE, "CreateFile %s failed, gle=%d\n", name, GetLastError() );
+    CloseHandle( file );
+    ret = DeleteFileA( name );
+    ok( ret, "DeleteFile failed, gle=%d\n", GetLastError() );
+    SetLastError( 0xdeadbeef );
+    file = open_existing( name );
+    ok( file == INVALID_HANDLE_VALUE, "CreateFile %s succeeded\n", name );
+    ok( GetLastError() == ERROR_FILE_NOT_FOUND, "wrong error %d\n", GetLastError() );
+
+    for (i = 0; i < 200; i++)
+    {
+        sprintf( name, "%s\\mixedcase%03u.txt", dir, i );
+        ret = DeleteFileA( name );
+        ok( ret, "DeleteFile %s failed, gle=%d\n", name, GetLastError() );
+    }
+    ret = RemoveDirectoryA( dir );
+    ok( ret, "RemoveDirectory failed, gle=%d\n", GetLastError() );
+}
+
 static BOOL check_file_time( const FILETIME *ft1, const FILETIME *ft2, UINT tolerance )
 {
     ULONGLONG t1 = ((ULONGLONG)ft1->dwHighDateTime << 32) | ft1->dwLowDateTime;
@@ -3140,10 +3397,12 @@ START_TEST(file)
     test_MoveFileW();
     test_FindFirstFileA();
     test_FindNextFileA();
+    test_FindNextFile_many();
     test_FindFirstFileExA(0);
     /* FindExLimitToDirectories is ignored if the file system doesn't support directory filtering */
     test_FindFirstFileExA(FindExSearchLimitToDirectories);
     test_LockFile();
+    test_LockFile_many();
     test_file_sharing();
     test_offset_in_overlapped_structure();
     test_MapFile();
@@ -3153,6 +3412,7 @@ START_TEST(file)
     test_OpenFile();
     test_overlapped();
     test_RemoveDirectory();
+    test_case_insensitive_open();
     test_ReplaceFileA();
     test_ReplaceFileW();
 }
@@ -38,6 +38,7 @@
 #define HEAP_VALIDATE_PARAMS  0x40000000
 
 static BOOL (WINAPI *pHeapQueryInformation)(HANDLE, HEAP_INFORMATION_CLASS, PVOID, SIZE_T, PSIZE_T);
+static BOOL (WINAPI *pHeapSetInformation)(HANDLE, HEAP_INFORMATION_CLASS, PVOID, SIZE_T);
 static ULONG (WINAPI *pRtlGetNtGlobalFlags)(void);
 
 struct heap_layout
@@ -505,6 +506,186 @@ static void test_HeapQueryInformation(void)
     ok(info == 0 || info == 1 || info == 2, "expected 0, 1 or 2, got %u\n", info);
 }
 
+static void test_HeapSetInformation(void)
+{
+    BYTE *p, *p2, *blocks[100];
+    HANDLE heap;
+    ULONG info;
+    SIZE_T size;
+    BOOL ret;
+    int i;
+
+    pHeapSetInformation = (void *)GetProcAddress(GetModuleHandle("kernel32.dll"), "HeapSetInformation");
+    if (!pHeapSetInformation || !pHeapQueryInformation)
+    {
+        win_skip("HeapSetInformation is not available\n");
+        return;
+    }
+
+    heap = HeapCreate(0, 0, 0);
+    ok(heap != NULL, "HeapCreate failed\n");
+
+    info = 2;
+    SetLastError(0xdeadbeef);
+    ret = pHeapSetInformation(heap, HeapCompatibilityInformation, &info, sizeof(info) - 1);
+    ok(!ret, "HeapSetInformation should fail\n");
+    ok(GetLastError() == ERROR_INSUFFICIENT_BUFFER,
+       "expected ERROR_INSUFFICIENT_BUFFER got %u\n", GetLastError());
+
+    info = 3;
+    SetLastError(0xdeadbeef);
+    ret = pHeapSetInformation(heap, HeapCompatibilityInformation, &info, sizeof(info));
+    ok(!ret, "HeapSetInformation should fail\n");
+    ok(GetLastError() == ERROR_INVALID_PARAMETER,
+       "expected ERROR_INVALID_PARAMETER got %u\n", GetLastError());
+
+    info = 2;
+    ret = pHeapSetInformation(heap, HeapCompatibilityInformation, &info, sizeof(info));
+    ok(ret, "HeapSetInformation error %u\n", GetLastError());
+
+    info = 0xdeadbeef;
+    ret = pHeapQueryInformation(heap, HeapCompatibilityInformation, &info, sizeof(info), NULL);
+    ok(ret, "HeapQueryInformation error %u\n", GetLastError());
+    ok(info == 2, "expected 2, got %u\n", info);
+
+    /* the LFH can't be turned off again */
+    info = 0;
+    ret = pHeapSetInformation(heap, HeapCompatibilityInformation, &info, sizeof(info));
+    ok(!ret, "HeapSetInformation should fail\n");
+
+    for (i = 0; i < sizeof(blocks) / sizeof(blocks[0]); i++)
+    {
+        blocks[i] = HeapAlloc(heap, HEAP_ZERO_MEMORY, i * 7 + 1);
+        ok(blocks[i] != NULL, "HeapAlloc failed\n");
+        ok(!((ULONG_PTR)blocks[i] % (2 * sizeof(void *))), "block %p is not aligned\n", blocks[i]);
+        ok(blocks[i][i * 7] == 0, "block %u not zeroed\n", i);
+        size = HeapSize(heap, 0, blocks[i]);
+        ok(size == i * 7 + 1, "wrong size %lu for block %u\n", size, i);
+        memset(blocks[i], i, i * 7 + 1);
+    }
+    for (i = 0; i < sizeof(blocks) / sizeof(blocks[0]); i++)
+    {
+        ok(blocks[i][0] == i && blocks[i][i * 7] == i, "block %u got overwritten\n", i);
+        ret = HeapValidate(heap, 0, blocks[i]);
+        ok(ret, "HeapValidate failed for block %u\n", i);
+        ret = HeapFree(heap, 0, blocks[i]);
+        ok(ret, "HeapFree failed for block %u\n", i);
+    }
+
+    p = HeapAlloc(heap, 0, 20);
+    ok(p != NULL, "HeapAlloc failed\n");
+    memset(p, 0xcc, 20);
+    p2 = HeapReAlloc(heap, HEAP_ZERO_MEMORY, p, 24);
+    ok(p2 != NULL, "HeapReAlloc failed\n");
+    ok(p2[19] == 0xcc, "wrong data %x\n", p2[19]);
+    ok(p2[20] == 0 && p2[23] == 0, "grown part not zeroed\n");
+    size = HeapSize(heap, 0, p2);
+    ok(size == 24, "wrong size %lu\n", size);
+    p = HeapReAlloc(heap, 0, p2, 3000);
+    ok(p != NULL, "HeapReAlloc failed\n");
+    ok(p[0] == 0xcc && p[19] == 0xcc, "data not copied\n");
+    size = HeapSize(heap, 0, p);
+    ok(size == 3000, "wrong size %lu\n", size);
+    ret = HeapFree(heap, 0, p);
+    ok(ret, "HeapFree failed\n");
+
+    /* pointers that don't belong to the heap are rejected without being dereferenced */
+    p = VirtualAlloc(NULL, 0x20000, MEM_RESERVE, PAGE_NOACCESS);
+    ok(p != NULL, "VirtualAlloc failed %u\n", GetLastError());
+    p2 = VirtualAlloc(p + 0x10000, 0x10000, MEM_COMMIT, PAGE_READWRITE);
+    ok(p2 == p + 0x10000, "VirtualAlloc failed %u\n", GetLastError());
+    ret = HeapValidate(heap, 0, p2);
+    ok(!ret, "HeapValidate succeeded for a foreign pointer\n");
+    ret = HeapValidate(GetProcessHeap(), 0, p2);
+    ok(!ret, "HeapValidate succeeded for a foreign pointer\n");
+    size = HeapSize(heap, 0, p2);
+    ok(size == ~(SIZE_T)0, "HeapSize returned %lu for a foreign pointer\n", size);
+    VirtualFree(p, 0, MEM_RELEASE);
+
+    p = HeapAlloc(GetProcessHeap(), 0, 20);
+    ok(p != NULL, "HeapAlloc failed\n");
+    ret = HeapValidate(heap, 0, p);
+    ok(!ret, "HeapValidate succeeded for a block of another heap\n");
+    HeapFree(GetProcessHeap(), 0, p);
+
+    ret = HeapDestroy(heap);
+    ok(ret, "HeapDestroy failed\n");
+
+    /* a heap without serialization doesn't support the LFH */
+    heap = HeapCreate(HEAP_NO_SERIALIZE, 0, 0);
+    ok(heap != NULL, "HeapCreate failed\n");
+    info = 2;
+    ret = pHeapSetInformation(heap, HeapCompatibilityInformation, &info, sizeof(info));
+    ok(!ret, "HeapSetInformation should fail\n");
+    HeapDestroy(heap);
+}
+
+#define HEAP_BENCH_THREADS 4
+#define HEAP_BENCH_LOOPS   200000
+
+/* returns the number of failed operations */
+static DWORD WINAPI heap_bench_thread( void *arg )
+{
+    HANDLE heap = arg;
+    BYTE *ptrs[16];
+    DWORD errors = 0;
+    SIZE_T size;
+    int i, j;
+
+    for (i = 0; i < HEAP_BENCH_LOOPS / 16; i++)
+    {
+        for (j = 0; j < 16; j++)
+        {
+            size = 16 + (i + j) % 200;
+            if (!(ptrs[j] = HeapAlloc( heap, 0, size ))) errors++;
+            else ptrs[j][0] = ptrs[j][size - 1] = j;
+        }
+        for (j = 0; j < 16; j++)
+        {
+            if (!ptrs[j]) continue;
+            size = 16 + (i + j) % 200;
+            if (HeapSize( heap, 0, ptrs[j] ) != size) errors++;
+            if (ptrs[j][0] != j || ptrs[j][size - 1] != j) errors++;
+            if (!HeapFree( heap, 0, ptrs[j] )) errors++;
+        }
+    }
+    return errors;
+}
+
+/* small allocations from several threads, mostly to spot contention in the heap lock */
+static void test_heap_threads(void)
+{
+    HANDLE threads[HEAP_BENCH_THREADS];
+    DWORD start, count, res, errors;
+    ULONG info;
+    int i;
+
+    info = 0;
+    if (pHeapQueryInformation)
+        pHeapQueryInformation( GetProcessHeap(), HeapCompatibilityInformation, &info, sizeof(info), NULL );
+
+    for (count = 1; count <= HEAP_BENCH_THREADS; count *= 2)
+    {
+        start = GetTickCount();
+        for (i = 0; i < count; i++)
+        {
+            threads[i] = CreateThread( NULL, 0, heap_bench_thread, GetProcessHeap(), 0, NULL );
+            ok( threads[i] != NULL, "CreateThread failed %u\n", GetLastError() );
+        }
+        res = WaitForMultipleObjects( count, threads, TRUE, INFINITE );
+        ok( res == WAIT_OBJECT_0, "WaitForMultipleObjects returned %u\n", res );
+        for (i = 0; i < count; i++)
+        {
+            errors = ~0u;
+            ok( GetExitCodeThread( threads[i], &errors ), "GetExitCodeThread failed %u\n", GetLastError() );
+            ok( !errors, "thread %u: %u heap operations failed\n", i, errors );
+            CloseHandle( threads[i] );
+        }
+        trace( "heap mode %u: %u threads doing %u allocations each took %u ms\n",
+               info, count, HEAP_BENCH_LOOPS, GetTickCount() - start );
+    }
+}
+
 static void test_heap_checks( DWORD flags )
 {
     BYTE old, *p, *p2;
@@ -817,6 +998,8 @@ START_TEST(heap)
     test_sized_HeapReAlloc((1 << 20), (2 << 20));
     test_sized_HeapReAlloc((1 << 20), 1);
     test_HeapQueryInformation();
+    test_HeapSetInformation();
+    test_heap_threads();
 
     if (pRtlGetNtGlobalFlags)
     {
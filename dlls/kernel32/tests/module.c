@@ -216,6 +216,46 @@ static void testGetProcAddress_Wrong(void)
         "Expected ERROR_MOD_NOT_FOUND or ERROR_INVALID_HANDLE(win9x), got %d\n", GetLastError());
 }
 
+static void testGetProcAddress_exports(const char *dll)
+{
+    HMODULE module = GetModuleHandleA(dll);
+    const IMAGE_DOS_HEADER *dos = (const IMAGE_DOS_HEADER *)module;
+    const IMAGE_NT_HEADERS *nt;
+    const IMAGE_EXPORT_DIRECTORY *exports;
+    const DWORD *names;
+    const WORD *ordinals;
+    FARPROC by_name, by_ordinal;
+    DWORD i, start, failures = 0;
+
+    ok( module != NULL, "%s not loaded\n", dll );
+    if (!module) return;
+
+    nt = (const IMAGE_NT_HEADERS *)((const char *)module + dos->e_lfanew);
+    exports = (const IMAGE_EXPORT_DIRECTORY *)((const char *)module +
+              nt->OptionalHeader.DataDirectory[IMAGE_DIRECTORY_ENTRY_EXPORT].VirtualAddress);
+    names = (const DWORD *)((const char *)module + exports->AddressOfNames);
+    ordinals = (const WORD *)((const char *)module + exports->AddressOfNameOrdinals);
+
+    start = GetTickCount();
+    for (i = 0; i < exports->NumberOfNames; i++)
+    {
+        const char *name = (const char *)module + names[i];
+
+        by_name = GetProcAddress( module, name );
+        by_ordinal = GetProcAddress( module, (LPCSTR)(ULONG_PTR)(ordinals[i] + exports->Base) );
+        if (by_name != by_ordinal && failures++ < 10)
+            ok( 0, "%s.%s: got %p by name, %p by ordinal\n", dll, name, by_name, by_ordinal );
+    }
+    ok( !failures, "%s: %u mismatches\n", dll, failures );
+    trace( "%s: looked up %u names in %u ms\n", dll, exports->NumberOfNames, GetTickCount() - start );
+
+    /* names that sort around the existing ones must not be found */
+    SetLastError(0xdeadbeef);
+    ok( !GetProcAddress( module, "" ), "empty name found\n" );
+    ok( !GetProcAddress( module, "zzzz_not_exported" ), "bogus name found\n" );
+    ok( !GetProcAddress( module, "CreateFileAA" ), "bogus name found\n" );
+}
+
 static void testLoadLibraryEx(void)
 {
     CHAR path[MAX_PATH];
@@ -401,5 +441,7 @@ START_TEST(module)
     testNestedLoadLibraryA();
     testLoadLibraryA_Wrong();
     testGetProcAddress_Wrong();
+    testGetProcAddress_exports("kernel32.dll");
+    testGetProcAddress_exports("ntdll.dll");
     testLoadLibraryEx();
 }
@@ -22,6 +22,7 @@
 #include <stdarg.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <windef.h>
 #include <winbase.h>
 
@@ -35,6 +36,24 @@ static HANDLE (WINAPI *pCreateWaitableTimerA)(SECURITY_ATTRIBUTES*,BOOL,LPCSTR);
 static BOOL   (WINAPI *pDeleteTimerQueueEx)(HANDLE, HANDLE);
 static BOOL   (WINAPI *pDeleteTimerQueueTimer)(HANDLE, HANDLE, HANDLE);
 static HANDLE (WINAPI *pOpenWaitableTimerA)(DWORD,BOOL,LPCSTR);
+static BOOL   (WINAPI *pSetWaitableTimer)(HANDLE,const LARGE_INTEGER*,LONG,PTIMERAPCROUTINE,LPVOID,BOOL);
+static BOOL   (WINAPI *pCancelWaitableTimer)(HANDLE);
+static VOID   (WINAPI *pInitializeSRWLock)(PSRWLOCK);
+static VOID   (WINAPI *pAcquireSRWLockExclusive)(PSRWLOCK);
+static VOID   (WINAPI *pAcquireSRWLockShared)(PSRWLOCK);
+static VOID   (WINAPI *pReleaseSRWLockExclusive)(PSRWLOCK);
+static VOID   (WINAPI *pReleaseSRWLockShared)(PSRWLOCK);
+static BOOLEAN (WINAPI *pTryAcquireSRWLockExclusive)(PSRWLOCK);
+static BOOLEAN (WINAPI *pTryAcquireSRWLockShared)(PSRWLOCK);
+static VOID   (WINAPI *pInitializeConditionVariable)(PCONDITION_VARIABLE);
+static BOOL   (WINAPI *pSleepConditionVariableCS)(PCONDITION_VARIABLE,PCRITICAL_SECTION,DWORD);
+static BOOL   (WINAPI *pSleepConditionVariableSRW)(PCONDITION_VARIABLE,PSRWLOCK,DWORD,ULONG);
+static VOID   (WINAPI *pWakeAllConditionVariable)(PCONDITION_VARIABLE);
+static VOID   (WINAPI *pWakeConditionVariable)(PCONDITION_VARIABLE);
+static VOID   (WINAPI *pInitOnceInitialize)(PINIT_ONCE);
+static BOOL   (WINAPI *pInitOnceExecuteOnce)(PINIT_ONCE,PINIT_ONCE_FN,PVOID,LPVOID*);
+static BOOL   (WINAPI *pInitOnceBeginInitialize)(PINIT_ONCE,DWORD,BOOL*,LPVOID*);
+static BOOL   (WINAPI *pInitOnceComplete)(PINIT_ONCE,DWORD,LPVOID);
 
 static void test_signalandwait(void)
 {
@@ -431,6 +450,60 @@ static void test_waitable_timer(void)
     CloseHandle( handle );
 }
 
+static void test_many_waitable_timers(void)
+{
+    static const int count = 1000, rounds = 100;
+    HANDLE *timers, quick;
+    LARGE_INTEGER due;
+    DWORD start, ret, error = 0;
+    int i, j, failures = 0;
+
+    if (!pCreateWaitableTimerA || !pSetWaitableTimer || !pCancelWaitableTimer)
+    {
+        win_skip("{Create,Set,Cancel}WaitableTimer() is not available\n");
+        return;
+    }
+
+    timers = HeapAlloc( GetProcessHeap(), 0, count * sizeof(*timers) );
+    for (i = 0; i < count; i++)
+    {
+        timers[i] = pCreateWaitableTimerA( NULL, TRUE, NULL );
+        ok( timers[i] != NULL, "CreateWaitableTimer failed with error %u\n", GetLastError() );
+    }
+
+    /* arm and cancel the timers with scattered due times, 100k times in total */
+    start = GetTickCount();
+    for (j = 0; j < rounds; j++)
+    {
+        for (i = 0; i < count; i++)
+        {
+            due.QuadPart = -(LONGLONG)(3600 + (i * 7919 + j * 104729) % 86400) * 10000000;
+            if (!pSetWaitableTimer( timers[i], &due, 0, NULL, NULL, FALSE ))
+            {
+                error = GetLastError();
+                failures++;
+            }
+        }
+        for (i = 0; i < count; i += 2) pCancelWaitableTimer( timers[i] );
+    }
+    trace( "%d timer set/cancel cycles took %u ms\n", count * rounds, GetTickCount() - start );
+    ok( !failures, "SetWaitableTimer failed %d times, last error %u\n", failures, error );
+
+    /* a short timer must still fire while all the long ones are pending */
+    quick = pCreateWaitableTimerA( NULL, TRUE, NULL );
+    due.QuadPart = -100 * 10000;
+    ok( pSetWaitableTimer( quick, &due, 0, NULL, NULL, FALSE ),
+        "SetWaitableTimer failed with error %u\n", GetLastError() );
+    ret = WaitForSingleObject( quick, 5000 );
+    ok( ret == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", ret );
+    ret = WaitForSingleObject( timers[1], 0 );
+    ok( ret == WAIT_TIMEOUT, "WaitForSingleObject returned %u\n", ret );
+    CloseHandle( quick );
+
+    for (i = 0; i < count; i++) CloseHandle( timers[i] );
+    HeapFree( GetProcessHeap(), 0, timers );
+}
+
 static HANDLE sem = 0;
 
 static void CALLBACK iocp_callback(DWORD dwErrorCode, DWORD dwNumberOfBytesTransferred, LPOVERLAPPED lpOverlapped)
@@ -1027,9 +1100,465 @@ static void test_WaitForSingleObject(void)
     CloseHandle(nonsignaled);
 }
 
+static SRWLOCK srwlock;
+static LONG srwlock_owners, srwlock_errors;
+
+static DWORD WINAPI srwlock_thread(LPVOID arg)
+{
+    int i;
+
+    for (i = 0; i < 10000; i++)
+    {
+        if (i % 4)
+        {
+            pAcquireSRWLockShared(&srwlock);
+            if (srwlock_owners < 0) InterlockedIncrement(&srwlock_errors);
+            pReleaseSRWLockShared(&srwlock);
+        }
+        else
+        {
+            pAcquireSRWLockExclusive(&srwlock);
+            if (InterlockedDecrement(&srwlock_owners) != -1) InterlockedIncrement(&srwlock_errors);
+            if (!(i % 16)) Sleep(0);
+            InterlockedIncrement(&srwlock_owners);
+            pReleaseSRWLockExclusive(&srwlock);
+        }
+    }
+    return 0;
+}
+
+static void test_srwlock(void)
+{
+    HANDLE threads[4];
+    DWORD start;
+    BOOLEAN ret;
+    int i;
+
+    if (!pInitializeSRWLock)
+    {
+        win_skip("SRW locks are not supported\n");
+        return;
+    }
+
+    pInitializeSRWLock(&srwlock);
+
+    pAcquireSRWLockShared(&srwlock);
+    ret = pTryAcquireSRWLockShared ? pTryAcquireSRWLockShared(&srwlock) : TRUE;
+    ok(ret, "TryAcquireSRWLockShared failed with a shared owner\n");
+    if (pTryAcquireSRWLockExclusive)
+    {
+        ret = pTryAcquireSRWLockExclusive(&srwlock);
+        ok(!ret, "TryAcquireSRWLockExclusive succeeded with a shared owner\n");
+    }
+    if (pTryAcquireSRWLockShared) pReleaseSRWLockShared(&srwlock);
+    pReleaseSRWLockShared(&srwlock);
+
+    pAcquireSRWLockExclusive(&srwlock);
+    if (pTryAcquireSRWLockShared)
+    {
+        ret = pTryAcquireSRWLockShared(&srwlock);
+        ok(!ret, "TryAcquireSRWLockShared succeeded with an exclusive owner\n");
+        ret = pTryAcquireSRWLockExclusive(&srwlock);
+        ok(!ret, "TryAcquireSRWLockExclusive succeeded with an exclusive owner\n");
+    }
+    pReleaseSRWLockExclusive(&srwlock);
+
+    /* contended case, also gives a rough idea of the lock throughput */
+    start = GetTickCount();
+    for (i = 0; i < sizeof(threads)/sizeof(threads[0]); i++)
+        threads[i] = CreateThread(NULL, 0, srwlock_thread, NULL, 0, NULL);
+    WaitForMultipleObjects(sizeof(threads)/sizeof(threads[0]), threads, TRUE, INFINITE);
+    for (i = 0; i < sizeof(threads)/sizeof(threads[0]); i++) CloseHandle(threads[i]);
+    trace("%u threads, 10000 acquisitions each: %u ms\n",
+          (UINT)(sizeof(threads)/sizeof(threads[0])), GetTickCount() - start);
+
+    ok(!srwlock_errors, "got %d lock errors\n", srwlock_errors);
+    ok(!srwlock_owners, "got %d owners at the end\n", srwlock_owners);
+}
+
+static CONDITION_VARIABLE condvar;
+static CRITICAL_SECTION condvar_crit;
+static SRWLOCK condvar_srwlock;
+static LONG condvar_queue, condvar_consumed;
+
+#define CONDVAR_ITEMS 5000
+
+static DWORD WINAPI condvar_consumer(LPVOID arg)
+{
+    for (;;)
+    {
+        EnterCriticalSection(&condvar_crit);
+        while (!condvar_queue && condvar_consumed < CONDVAR_ITEMS)
+            pSleepConditionVariableCS(&condvar, &condvar_crit, INFINITE);
+        if (condvar_consumed >= CONDVAR_ITEMS)
+        {
+            LeaveCriticalSection(&condvar_crit);
+            pWakeAllConditionVariable(&condvar);
+            return 0;
+        }
+        condvar_queue--;
+        condvar_consumed++;
+        LeaveCriticalSection(&condvar_crit);
+    }
+}
+
+static void test_condvars(void)
+{
+    HANDLE threads[3];
+    DWORD start;
+    BOOL ret;
+    int i;
+
+    if (!pInitializeConditionVariable)
+    {
+        win_skip("condition variables are not supported\n");
+        return;
+    }
+
+    pInitializeConditionVariable(&condvar);
+    InitializeCriticalSection(&condvar_crit);
+
+    /* nobody wakes us up */
+    EnterCriticalSection(&condvar_crit);
+    SetLastError(0xdeadbeef);
+    start = GetTickCount();
+    ret = pSleepConditionVariableCS(&condvar, &condvar_crit, 50);
+    ok(!ret, "SleepConditionVariableCS succeeded\n");
+    ok(GetLastError() == ERROR_TIMEOUT, "got error %u\n", GetLastError());
+    ok(GetTickCount() - start >= 40, "returned too early\n");
+    ok(condvar_crit.OwningThread == ULongToHandle(GetCurrentThreadId()), "critical section not reacquired\n");
+    LeaveCriticalSection(&condvar_crit);
+
+    pInitializeSRWLock(&condvar_srwlock);
+    pAcquireSRWLockShared(&condvar_srwlock);
+    SetLastError(0xdeadbeef);
+    ret = pSleepConditionVariableSRW(&condvar, &condvar_srwlock, 0, CONDITION_VARIABLE_LOCKMODE_SHARED);
+    ok(!ret, "SleepConditionVariableSRW succeeded\n");
+    ok(GetLastError() == ERROR_TIMEOUT, "got error %u\n", GetLastError());
+    pReleaseSRWLockShared(&condvar_srwlock);
+
+    /* waking without waiters does nothing */
+    pWakeConditionVariable(&condvar);
+    pWakeAllConditionVariable(&condvar);
+
+    for (i = 0; i < sizeof(threads)/sizeof(threads[0]); i++)
+        threads[i] = CreateThread(NULL, 0, condvar_consumer, NULL, 0, NULL);
+    for (i = 0; i < CONDVAR_ITEMS; i++)
+    {
+        EnterCriticalSection(&condvar_crit);
+        condvar_queue++;
+        LeaveCriticalSection(&condvar_crit);
+        pWakeConditionVariable(&condvar);
+    }
+    ret = WaitForMultipleObjects(sizeof(threads)/sizeof(threads[0]), threads, TRUE, 10000);
+    ok(ret == WAIT_OBJECT_0, "consumers didn't finish: %u\n", ret);
+    for (i = 0; i < sizeof(threads)/sizeof(threads[0]); i++) CloseHandle(threads[i]);
+
+    ok(condvar_consumed == CONDVAR_ITEMS, "consumed %d items\n", condvar_consumed);
+    ok(!condvar_queue, "%d items left\n", condvar_queue);
+    DeleteCriticalSection(&condvar_crit);
+}
+
+static LONG initonce_calls;
+static BOOL initonce_result = TRUE;
+
+static BOOL CALLBACK initonce_callback(INIT_ONCE *once, void *param, void **context)
+{
+    BOOL *result = param;
+
+    InterlockedIncrement(&initonce_calls);
+    ok(result == &initonce_result, "wrong param %p\n", param);
+    *context = (void *)0x1230;
+    return *result;
+}
+
+static BOOL CALLBACK initonce_fail_callback(INIT_ONCE *once, void *param, void **context)
+{
+    InterlockedIncrement(&initonce_calls);
+    return FALSE;
+}
+
+static void test_initonce(void)
+{
+    INIT_ONCE once;
+    void *context;
+    BOOL ret, pending;
+
+    if (!pInitOnceInitialize || !pInitOnceExecuteOnce)
+    {
+        win_skip("one-time initialization is not supported\n");
+        return;
+    }
+
+    pInitOnceInitialize(&once);
+    ok(once.Ptr == NULL, "got %p\n", once.Ptr);
+
+    context = NULL;
+    ret = pInitOnceExecuteOnce(&once, initonce_callback, &initonce_result, &context);
+    ok(ret, "InitOnceExecuteOnce failed\n");
+    ok(initonce_calls == 1, "got %d calls\n", initonce_calls);
+    ok(context == (void *)0x1230, "got context %p\n", context);
+
+    context = NULL;
+    ret = pInitOnceExecuteOnce(&once, initonce_callback, &initonce_result, &context);
+    ok(ret, "InitOnceExecuteOnce failed\n");
+    ok(initonce_calls == 1, "got %d calls\n", initonce_calls);
+    ok(context == (void *)0x1230, "got context %p\n", context);
+
+    /* a failed initialization can be retried */
+    pInitOnceInitialize(&once);
+    initonce_calls = 0;
+    ret = pInitOnceExecuteOnce(&once, initonce_fail_callback, NULL, &context);
+    ok(!ret, "InitOnceExecuteOnce succeeded\n");
+    ret = pInitOnceExecuteOnce(&once, initonce_fail_callback, NULL, &context);
+    ok(!ret, "InitOnceExecuteOnce succeeded\n");
+    ok(initonce_calls == 2, "got %d calls\n", initonce_calls);
+
+    /* explicit begin/complete */
+    pInitOnceInitialize(&once);
+    ret = pInitOnceBeginInitialize(&once, INIT_ONCE_CHECK_ONLY, &pending, &context);
+    ok(!ret, "InitOnceBeginInitialize succeeded\n");
+    ok(GetLastError() == ERROR_GEN_FAILURE, "got error %u\n", GetLastError());
+
+    pending = FALSE;
+    ret = pInitOnceBeginInitialize(&once, 0, &pending, &context);
+    ok(ret, "InitOnceBeginInitialize failed\n");
+    ok(pending, "expected pending\n");
+
+    SetLastError(0xdeadbeef);
+    ret = pInitOnceComplete(&once, 0, (void *)0x1231);
+    ok(!ret, "InitOnceComplete succeeded with a misaligned context\n");
+    ok(GetLastError() == ERROR_INVALID_PARAMETER, "got error %u\n", GetLastError());
+
+    ret = pInitOnceComplete(&once, 0, (void *)0x1230);
+    ok(ret, "InitOnceComplete failed\n");
+
+    context = NULL;
+    pending = TRUE;
+    ret = pInitOnceBeginInitialize(&once, INIT_ONCE_CHECK_ONLY, &pending, &context);
+    ok(ret, "InitOnceBeginInitialize failed\n");
+    ok(!pending, "expected not pending\n");
+    ok(context == (void *)0x1230, "got context %p\n", context);
+
+    SetLastError(0xdeadbeef);
+    ret = pInitOnceComplete(&once, 0, (void *)0x1230);
+    ok(!ret, "InitOnceComplete succeeded twice\n");
+    ok(GetLastError() == ERROR_GEN_FAILURE, "got error %u\n", GetLastError());
+}
+
+static DWORD WINAPI sync_shm_wait_thread(void *arg)
+{
+    HANDLE *handles = arg;
+
+    SetEvent(handles[1]);
+    return WaitForSingleObject(handles[0], 5000);
+}
+
+static DWORD WINAPI sync_shm_mutex_thread(void *arg)
+{
+    /* exit while owning the mutex */
+    return WaitForSingleObject(arg, 0);
+}
+
+/* run with WINESYNCSHM set, so that the objects use the shared memory fast path under Wine */
+static void test_sync_shm_child(void)
+{
+    HANDLE event, event2, sem, mutex, thread, handles[2], mapping, ready, closed, dup;
+    DWORD *shared, ret;
+    LONG prev;
+
+    /* manual reset event */
+    event = CreateEventA(NULL, TRUE, FALSE, NULL);
+    ok(event != NULL, "CreateEvent failed with error %u\n", GetLastError());
+    ret = WaitForSingleObject(event, 0);
+    ok(ret == WAIT_TIMEOUT, "got %u\n", ret);
+    ret = SetEvent(event);
+    ok(ret, "SetEvent failed with error %u\n", GetLastError());
+    ret = WaitForSingleObject(event, 0);
+    ok(ret == WAIT_OBJECT_0, "got %u\n", ret);
+    ret = WaitForSingleObject(event, 0);
+    ok(ret == WAIT_OBJECT_0, "manual reset event was reset, got %u\n", ret);
+    ret = ResetEvent(event);
+    ok(ret, "ResetEvent failed with error %u\n", GetLastError());
+    ret = WaitForSingleObject(event, 0);
+    ok(ret == WAIT_TIMEOUT, "got %u\n", ret);
+    SetEvent(event);
+    ret = PulseEvent(event);
+    ok(ret, "PulseEvent failed with error %u\n", GetLastError());
+    ret = WaitForSingleObject(event, 0);
+    ok(ret == WAIT_TIMEOUT, "pulsed event is signaled, got %u\n", ret);
+
+    /* auto reset event */
+    event2 = CreateEventA(NULL, FALSE, TRUE, NULL);
+    ok(event2 != NULL, "CreateEvent failed with error %u\n", GetLastError());
+    ret = WaitForSingleObject(event2, 0);
+    ok(ret == WAIT_OBJECT_0, "got %u\n", ret);
+    ret = WaitForSingleObject(event2, 0);
+    ok(ret == WAIT_TIMEOUT, "auto reset event wasn't reset, got %u\n", ret);
+    SetEvent(event2);
+    SetEvent(event2);
+    ret = WaitForSingleObject(event2, 0);
+    ok(ret == WAIT_OBJECT_0, "got %u\n", ret);
+    ret = WaitForSingleObject(event2, 0);
+    ok(ret == WAIT_TIMEOUT, "got %u\n", ret);
+
+    /* pulse with a thread waiting on the event */
+    handles[0] = event;
+    handles[1] = event2;
+    thread = CreateThread(NULL, 0, sync_shm_wait_thread, handles, 0, NULL);
+    ok(thread != NULL, "CreateThread failed with error %u\n", GetLastError());
+    ret = WaitForSingleObject(event2, 1000);
+    ok(ret == WAIT_OBJECT_0, "got %u\n", ret);
+    Sleep(100);  /* give the thread time to block */
+    ret = PulseEvent(event);
+    ok(ret, "PulseEvent failed with error %u\n", GetLastError());
+    ret = WaitForSingleObject(thread, 1000);
+    ok(ret == WAIT_OBJECT_0, "got %u\n", ret);
+    GetExitCodeThread(thread, &ret);
+    ok(ret == WAIT_OBJECT_0, "waiter not woken by the pulse, got %u\n", ret);
+    CloseHandle(thread);
+    ret = WaitForSingleObject(event, 0);
+    ok(ret == WAIT_TIMEOUT, "pulsed event is signaled, got %u\n", ret);
+    CloseHandle(event2);
+
+    /* semaphore */
+    sem = CreateSemaphoreA(NULL, 1, 2, NULL);
+    ok(sem != NULL, "CreateSemaphore failed with error %u\n", GetLastError());
+    ret = WaitForSingleObject(sem, 0);
+    ok(ret == WAIT_OBJECT_0, "got %u\n", ret);
+    ret = WaitForSingleObject(sem, 0);
+    ok(ret == WAIT_TIMEOUT, "got %u\n", ret);
+    prev = 0xdeadbeef;
+    ret = ReleaseSemaphore(sem, 2, &prev);
+    ok(ret, "ReleaseSemaphore failed with error %u\n", GetLastError());
+    ok(prev == 0, "got previous count %d\n", prev);
+    SetLastError(0xdeadbeef);
+    ret = ReleaseSemaphore(sem, 1, &prev);
+    ok(!ret, "ReleaseSemaphore succeeded past the maximum\n");
+    ok(GetLastError() == ERROR_TOO_MANY_POSTS, "wrong error %u\n", GetLastError());
+    ret = WaitForSingleObject(sem, 0);
+    ok(ret == WAIT_OBJECT_0, "got %u\n", ret);
+    ret = WaitForSingleObject(sem, 0);
+    ok(ret == WAIT_OBJECT_0, "got %u\n", ret);
+    ret = WaitForSingleObject(sem, 0);
+    ok(ret == WAIT_TIMEOUT, "got %u\n", ret);
+    CloseHandle(sem);
+
+    /* mutexes keep working alongside */
+    mutex = CreateMutexA(NULL, TRUE, NULL);
+    ok(mutex != NULL, "CreateMutex failed with error %u\n", GetLastError());
+    ret = WaitForSingleObject(mutex, 0);
+    ok(ret == WAIT_OBJECT_0, "got %u\n", ret);
+    ret = ReleaseMutex(mutex);
+    ok(ret, "ReleaseMutex failed with error %u\n", GetLastError());
+    ret = ReleaseMutex(mutex);
+    ok(ret, "ReleaseMutex failed with error %u\n", GetLastError());
+    SetLastError(0xdeadbeef);
+    ret = ReleaseMutex(mutex);
+    ok(!ret, "ReleaseMutex succeeded\n");
+    ok(GetLastError() == ERROR_NOT_OWNER, "wrong error %u\n", GetLastError());
+    thread = CreateThread(NULL, 0, sync_shm_mutex_thread, mutex, 0, NULL);
+    ok(thread != NULL, "CreateThread failed with error %u\n", GetLastError());
+    WaitForSingleObject(thread, 1000);
+    GetExitCodeThread(thread, &ret);
+    ok(ret == WAIT_OBJECT_0, "got %u\n", ret);
+    CloseHandle(thread);
+    ret = WaitForSingleObject(mutex, 0);
+    ok(ret == WAIT_ABANDONED, "got %u\n", ret);
+    ReleaseMutex(mutex);
+    CloseHandle(mutex);
+
+    /* the parent closes the handle behind our back, the value must not be used anymore */
+    mapping = OpenFileMappingA(FILE_MAP_ALL_ACCESS, FALSE, "winetest_sync_shm");
+    ok(mapping != NULL, "OpenFileMapping failed with error %u\n", GetLastError());
+    ready = OpenEventA(EVENT_ALL_ACCESS, FALSE, "winetest_sync_shm_ready");
+    closed = OpenEventA(EVENT_ALL_ACCESS, FALSE, "winetest_sync_shm_closed");
+    if (!mapping || !ready || !closed) return;
+    shared = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(*shared));
+
+    ResetEvent(event);
+    DuplicateHandle(GetCurrentProcess(), event, GetCurrentProcess(), &dup, 0, FALSE, DUPLICATE_SAME_ACCESS);
+    *shared = HandleToULong(event);
+    SetEvent(ready);
+    ret = WaitForSingleObject(closed, 5000);
+    ok(ret == WAIT_OBJECT_0, "got %u\n", ret);
+
+    /* likely reuses the handle value */
+    mutex = CreateMutexA(NULL, FALSE, NULL);
+    SetLastError(0xdeadbeef);
+    ret = SetEvent(event);
+    ok(!ret, "SetEvent succeeded on a closed handle\n");
+    ok(GetLastError() == ERROR_INVALID_HANDLE, "wrong error %u\n", GetLastError());
+    ret = WaitForSingleObject(dup, 0);
+    ok(ret == WAIT_TIMEOUT, "event set through a closed handle, got %u\n", ret);
+
+    CloseHandle(mutex);
+    CloseHandle(dup);
+    UnmapViewOfFile(shared);
+    CloseHandle(mapping);
+    CloseHandle(ready);
+    CloseHandle(closed);
+}
+
+static void test_sync_shm(const char *argv0)
+{
+    PROCESS_INFORMATION info;
+    STARTUPINFOA startup;
+    HANDLE mapping, ready, closed, handle;
+    char buffer[MAX_PATH + 16];
+    DWORD *shared, ret;
+
+    mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(*shared),
+                                 "winetest_sync_shm");
+    ok(mapping != NULL, "CreateFileMapping failed with error %u\n", GetLastError());
+    shared = MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(*shared));
+    ready = CreateEventA(NULL, FALSE, FALSE, "winetest_sync_shm_ready");
+    closed = CreateEventA(NULL, FALSE, FALSE, "winetest_sync_shm_closed");
+
+    memset(&startup, 0, sizeof(startup));
+    startup.cb = sizeof(startup);
+    SetEnvironmentVariableA("WINESYNCSHM", "1");
+    sprintf(buffer, "%s sync sync_shm", argv0);
+    ret = CreateProcessA(NULL, buffer, NULL, NULL, FALSE, 0, NULL, NULL, &startup, &info);
+    ok(ret, "failed to create child process error %u\n", GetLastError());
+    SetEnvironmentVariableA("WINESYNCSHM", NULL);
+
+    if (ret)
+    {
+        ret = WaitForSingleObject(ready, 10000);
+        ok(ret == WAIT_OBJECT_0, "got %u\n", ret);
+        if (ret == WAIT_OBJECT_0)
+        {
+            ret = DuplicateHandle(info.hProcess, ULongToHandle(*shared), GetCurrentProcess(), &handle,
+                                  0, FALSE, DUPLICATE_SAME_ACCESS | DUPLICATE_CLOSE_SOURCE);
+            ok(ret, "DuplicateHandle failed with error %u\n", GetLastError());
+            if (ret) CloseHandle(handle);
+        }
+        SetEvent(closed);
+        winetest_wait_child_process(info.hProcess);
+        CloseHandle(info.hThread);
+        CloseHandle(info.hProcess);
+    }
+
+    UnmapViewOfFile(shared);
+    CloseHandle(mapping);
+    CloseHandle(ready);
+    CloseHandle(closed);
+}
+
 START_TEST(sync)
 {
     HMODULE hdll = GetModuleHandle("kernel32");
+    char **argv;
+    int argc;
+
+    argc = winetest_get_mainargs( &argv );
+    if (argc >= 3 && !strcmp(argv[2], "sync_shm"))
+    {
+        test_sync_shm_child();
+        return;
+    }
+
     pChangeTimerQueueTimer = (void*)GetProcAddress(hdll, "ChangeTimerQueueTimer");
     pCreateTimerQueue = (void*)GetProcAddress(hdll, "CreateTimerQueue");
     pCreateTimerQueueTimer = (void*)GetProcAddress(hdll, "CreateTimerQueueTimer");
@@ -1037,6 +1566,24 @@ START_TEST(sync)
     pDeleteTimerQueueEx = (void*)GetProcAddress(hdll, "DeleteTimerQueueEx");
     pDeleteTimerQueueTimer = (void*)GetProcAddress(hdll, "DeleteTimerQueueTimer");
     pOpenWaitableTimerA = (void*)GetProcAddress(hdll, "OpenWaitableTimerA");
+    pSetWaitableTimer = (void*)GetProcAddress(hdll, "SetWaitableTimer");
+    pCancelWaitableTimer = (void*)GetProcAddress(hdll, "CancelWaitableTimer");
+    pInitializeSRWLock = (void*)GetProcAddress(hdll, "InitializeSRWLock");
+    pAcquireSRWLockExclusive = (void*)GetProcAddress(hdll, "AcquireSRWLockExclusive");
+    pAcquireSRWLockShared = (void*)GetProcAddress(hdll, "AcquireSRWLockShared");
+    pReleaseSRWLockExclusive = (void*)GetProcAddress(hdll, "ReleaseSRWLockExclusive");
+    pReleaseSRWLockShared = (void*)GetProcAddress(hdll, "ReleaseSRWLockShared");
+    pTryAcquireSRWLockExclusive = (void*)GetProcAddress(hdll, "TryAcquireSRWLockExclusive");
+    pTryAcquireSRWLockShared = (void*)GetProcAddress(hdll, "TryAcquireSRWLockShared");
+    pInitializeConditionVariable = (void*)GetProcAddress(hdll, "InitializeConditionVariable");
+    pSleepConditionVariableCS = (void*)GetProcAddress(hdll, "SleepConditionVariableCS");
+    pSleepConditionVariableSRW = (void*)GetProcAddress(hdll, "SleepConditionVariableSRW");
+    pWakeAllConditionVariable = (void*)GetProcAddress(hdll, "WakeAllConditionVariable");
+    pWakeConditionVariable = (void*)GetProcAddress(hdll, "WakeConditionVariable");
+    pInitOnceInitialize = (void*)GetProcAddress(hdll, "InitOnceInitialize");
+    pInitOnceExecuteOnce = (void*)GetProcAddress(hdll, "InitOnceExecuteOnce");
+    pInitOnceBeginInitialize = (void*)GetProcAddress(hdll, "InitOnceBeginInitialize");
+    pInitOnceComplete = (void*)GetProcAddress(hdll, "InitOnceComplete");
 
     test_signalandwait();
     test_mutex();
@@ -1044,7 +1591,12 @@ START_TEST(sync)
     test_event();
     test_semaphore();
     test_waitable_timer();
+    test_many_waitable_timers();
     test_iocp_callback();
     test_timer_queue();
     test_WaitForSingleObject();
+    test_srwlock();
+    test_condvars();
+    test_initonce();
+    test_sync_shm(argv[0]);
 }
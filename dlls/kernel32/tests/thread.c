@@ -30,6 +30,7 @@
 #include <winbase.h>
 #include <winnt.h>
 #include <winerror.h>
+#include <tlhelp32.h>
 
 /* Specify the number of simultaneous threads to test */
 #define NUM_THREADS 4
@@ -61,6 +62,7 @@ static DWORD (WINAPI *pSetThreadIdealProcessor)(HANDLE,DWORD);
 static BOOL (WINAPI *pSetThreadPriorityBoost)(HANDLE,BOOL);
 static BOOL (WINAPI *pRegisterWaitForSingleObject)(PHANDLE,HANDLE,WAITORTIMERCALLBACK,PVOID,ULONG,ULONG);
 static BOOL (WINAPI *pUnregisterWait)(HANDLE);
+static BOOL (WINAPI *pUnregisterWaitEx)(HANDLE,HANDLE);
 static BOOL (WINAPI *pIsWow64Process)(HANDLE,PBOOL);
 static BOOL (WINAPI *pSetThreadErrorMode)(DWORD,PDWORD);
 static DWORD (WINAPI *pGetThreadErrorMode)(void);
@@ -1057,6 +1059,151 @@ static void test_RegisterWaitForSingleObject(void)
 
     ret = pUnregisterWait(wait_handle);
     ok(ret, "UnregisterWait failed with error %d\n", GetLastError());
+
+    /* test that the wait is restarted after the callback */
+
+    CloseHandle(handle);
+    handle = CreateEvent(NULL, FALSE, FALSE, NULL);
+
+    ret = pRegisterWaitForSingleObject(&wait_handle, handle, signaled_function, complete_event, INFINITE, WT_EXECUTEDEFAULT);
+    ok(ret, "RegisterWaitForSingleObject failed with error %d\n", GetLastError());
+
+    SetEvent(handle);
+    ok(WaitForSingleObject(complete_event, 1000) == WAIT_OBJECT_0, "callback wasn't called\n");
+    SetEvent(handle);
+    ok(WaitForSingleObject(complete_event, 1000) == WAIT_OBJECT_0, "callback wasn't called again\n");
+
+    if (pUnregisterWaitEx)
+    {
+        ret = pUnregisterWaitEx(wait_handle, INVALID_HANDLE_VALUE);
+        ok(ret, "UnregisterWaitEx failed with error %d\n", GetLastError());
+    }
+    else
+    {
+        Sleep(100);
+        ret = pUnregisterWait(wait_handle);
+        ok(ret, "UnregisterWait failed with error %d\n", GetLastError());
+    }
+
+    /* no callback after the wait has been unregistered */
+    SetEvent(handle);
+    ok(WaitForSingleObject(complete_event, 100) == WAIT_TIMEOUT, "callback was called\n");
+
+    /* test a callback executed in the wait thread */
+
+    ResetEvent(handle);
+    ret = pRegisterWaitForSingleObject(&wait_handle, handle, signaled_function, complete_event, INFINITE,
+                                       WT_EXECUTEINWAITTHREAD | WT_EXECUTEONLYONCE);
+    ok(ret, "RegisterWaitForSingleObject failed with error %d\n", GetLastError());
+
+    SetEvent(handle);
+    ok(WaitForSingleObject(complete_event, 1000) == WAIT_OBJECT_0, "callback wasn't called\n");
+    /* give wait thread chance to complete */
+    Sleep(100);
+
+    ret = pUnregisterWait(wait_handle);
+    ok(ret, "UnregisterWait failed with error %d\n", GetLastError());
+
+    CloseHandle(handle);
+    CloseHandle(complete_event);
+}
+
+#define NUM_MANY_WAITS 10000
+
+static LONG many_waits_count;
+static HANDLE many_waits_done;
+
+static void CALLBACK many_waits_function(PVOID p, BOOLEAN TimerOrWaitFired)
+{
+    ok(!TimerOrWaitFired, "wait shouldn't have timed out\n");
+    if (InterlockedIncrement(&many_waits_count) == NUM_MANY_WAITS) SetEvent(many_waits_done);
+}
+
+static DWORD count_process_threads(void)
+{
+    THREADENTRY32 te;
+    HANDLE snapshot;
+    DWORD count = 0, pid = GetCurrentProcessId();
+
+    snapshot = CreateToolhelp32Snapshot(TH32CS_SNAPTHREAD, 0);
+    if (snapshot == INVALID_HANDLE_VALUE) return 0;
+
+    te.dwSize = sizeof(te);
+    if (Thread32First(snapshot, &te))
+    {
+        do
+        {
+            if (te.th32OwnerProcessID == pid) count++;
+        } while (Thread32Next(snapshot, &te));
+    }
+    CloseHandle(snapshot);
+    return count;
+}
+
+static void test_RegisterWaitForSingleObject_many(void)
+{
+    HANDLE *events, *wait_handles;
+    DWORD threads_before, threads_after, result, i;
+    BOOL ret;
+
+    if (!pRegisterWaitForSingleObject || !pUnregisterWaitEx)
+    {
+        win_skip("RegisterWaitForSingleObject or UnregisterWaitEx not implemented\n");
+        return;
+    }
+
+    events = HeapAlloc(GetProcessHeap(), 0, NUM_MANY_WAITS * sizeof(*events));
+    wait_handles = HeapAlloc(GetProcessHeap(), 0, NUM_MANY_WAITS * sizeof(*wait_handles));
+    many_waits_done = CreateEvent(NULL, TRUE, FALSE, NULL);
+    many_waits_count = 0;
+
+    for (i = 0; i < NUM_MANY_WAITS; i++)
+    {
+        events[i] = CreateEvent(NULL, FALSE, FALSE, NULL);
+        if (!events[i]) break;
+    }
+    if (i < NUM_MANY_WAITS)
+    {
+        skip("could only create %u events\n", i);
+        while (i) CloseHandle(events[--i]);
+        goto done;
+    }
+
+    threads_before = count_process_threads();
+
+    for (i = 0; i < NUM_MANY_WAITS; i++)
+    {
+        ret = pRegisterWaitForSingleObject(&wait_handles[i], events[i], many_waits_function,
+                                           NULL, INFINITE, WT_EXECUTEONLYONCE);
+        ok(ret, "RegisterWaitForSingleObject failed with error %d\n", GetLastError());
+        if (!ret) break;
+    }
+
+    threads_after = count_process_threads();
+    trace("%u waits: %u threads (%u before)\n", i, threads_after, threads_before);
+    /* the waits are multiplexed on threads handling up to MAXIMUM_WAIT_OBJECTS - 1 objects each */
+    ok(threads_after - threads_before <= NUM_MANY_WAITS / (MAXIMUM_WAIT_OBJECTS - 1) + 16,
+       "%u threads were created for %u waits\n", threads_after - threads_before, i);
+
+    if (i == NUM_MANY_WAITS)
+    {
+        for (i = 0; i < NUM_MANY_WAITS; i++) SetEvent(events[i]);
+        result = WaitForSingleObject(many_waits_done, 10000);
+        ok(result == WAIT_OBJECT_0, "only %u callbacks were called\n", many_waits_count);
+    }
+
+    while (i)
+    {
+        i--;
+        ret = pUnregisterWaitEx(wait_handles[i], INVALID_HANDLE_VALUE);
+        ok(ret, "UnregisterWaitEx failed with error %d\n", GetLastError());
+    }
+    for (i = 0; i < NUM_MANY_WAITS; i++) CloseHandle(events[i]);
+
+done:
+    CloseHandle(many_waits_done);
+    HeapFree(GetProcessHeap(), 0, wait_handles);
+    HeapFree(GetProcessHeap(), 0, events);
 }
 
 static DWORD TLS_main;
@@ -1429,6 +1576,7 @@ START_TEST(thread)
    pSetThreadPriorityBoost=(void *)GetProcAddress(lib,"SetThreadPriorityBoost");
    pRegisterWaitForSingleObject=(void *)GetProcAddress(lib,"RegisterWaitForSingleObject");
    pUnregisterWait=(void *)GetProcAddress(lib,"UnregisterWait");
+   pUnregisterWaitEx=(void *)GetProcAddress(lib,"UnregisterWaitEx");
    pIsWow64Process=(void *)GetProcAddress(lib,"IsWow64Process");
    pSetThreadErrorMode=(void *)GetProcAddress(lib,"SetThreadErrorMode");
    pGetThreadErrorMode=(void *)GetProcAddress(lib,"GetThreadErrorMode");
@@ -1480,6 +1628,7 @@ START_TEST(thread)
 #endif
    test_QueueUserWorkItem();
    test_RegisterWaitForSingleObject();
+   test_RegisterWaitForSingleObject_many();
    test_TLS();
    test_ThreadErrorMode();
 #if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
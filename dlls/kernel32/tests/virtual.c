@@ -1380,6 +1380,65 @@ static void test_write_watch(void)
     VirtualFree( base, 0, MEM_FREE );
 }
 
+#define MANY_VIEWS 100000
+
+static void test_many_views(void)
+{
+    MEMORY_BASIC_INFORMATION info;
+    DWORD start, elapsed;
+    void **views;
+    SIZE_T ret;
+    int i, count;
+
+    views = HeapAlloc( GetProcessHeap(), 0, MANY_VIEWS * sizeof(*views) );
+    ok( views != NULL, "HeapAlloc failed\n" );
+    if (!views) return;
+
+    /* 32-bit processes run out of address space before reaching the limit */
+    start = GetTickCount();
+    for (count = 0; count < MANY_VIEWS; count++)
+        if (!(views[count] = VirtualAlloc( NULL, 0x10000, MEM_RESERVE, PAGE_NOACCESS ))) break;
+    elapsed = GetTickCount() - start;
+    ok( count > 1000, "only %u views could be allocated, error %u\n", count, GetLastError() );
+    trace( "allocated %u views in %u ms\n", count, elapsed );
+    if (!count)
+    {
+        HeapFree( GetProcessHeap(), 0, views );
+        return;
+    }
+
+    start = GetTickCount();
+    for (i = 0; i < MANY_VIEWS; i++)
+    {
+        void *ptr = (char *)views[(i * 7919) % count] + 0x1234;
+
+        ret = VirtualQuery( ptr, &info, sizeof(info) );
+        if (ret != sizeof(info) || info.AllocationBase != views[(i * 7919) % count] || info.RegionSize != 0xf000 ||
+            info.State != MEM_RESERVE)
+        {
+            ok( 0, "wrong info for %p: base %p size %lx state %x\n",
+                ptr, info.AllocationBase, info.RegionSize, info.State );
+            break;
+        }
+    }
+    elapsed = GetTickCount() - start;
+    trace( "%u queries with %u views took %u ms\n", MANY_VIEWS, count, elapsed );
+
+    start = GetTickCount();
+    for (i = 0; i < count; i++)
+    {
+        if (!VirtualFree( views[i], 0, MEM_RELEASE ))
+        {
+            ok( 0, "VirtualFree failed %u\n", GetLastError() );
+            break;
+        }
+    }
+    elapsed = GetTickCount() - start;
+    trace( "freed %u views in %u ms\n", count, elapsed );
+
+    HeapFree( GetProcessHeap(), 0, views );
+}
+
 START_TEST(virtual)
 {
     int argc;
@@ -1426,4 +1485,5 @@ START_TEST(virtual)
     test_IsBadWritePtr();
     test_IsBadCodePtr();
     test_write_watch();
+    test_many_views();
 }
@@ -32,6 +32,7 @@
 #include "windef.h"
 #include "winternl.h"
 #include "wine/debug.h"
+#include "wine/list.h"
 #include "ntdll_misc.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(ntdll);
@@ -58,30 +59,6 @@ static inline void small_pause(void)
 
 #if defined(linux) && defined(__i386__)
 
-static inline int futex_wait( int *addr, int val, struct timespec *timeout )
-{
-    int ret = syscall( 240/*SYS_futex*/, addr, 0/*FUTEX_WAIT*/, val, timeout, 0, 0 );
-    if (ret < 0)
-        return -errno;
-    return ret;
-}
-
-static inline int futex_wake( int *addr, int val )
-{
-    int ret = syscall( 240/*SYS_futex*/, addr, 1/*FUTEX_WAKE*/, val, NULL, 0, 0 );
-    if (ret < 0)
-        return -errno;
-    return ret;
-}
-
-static inline int use_futexes(void)
-{
-    static int supported = -1;
-
-    if (supported == -1) supported = (futex_wait( &supported, 10, NULL ) != -ENOSYS);
-    return supported;
-}
-
 static inline NTSTATUS fast_wait( RTL_CRITICAL_SECTION *crit, int timeout )
 {
     int val;
@@ -619,3 +596,558 @@ NTSTATUS WINAPI RtlLeaveCriticalSection( RTL_CRITICAL_SECTION *crit )
     }
     return STATUS_SUCCESS;
 }
+
+
+/*
+ * Thread parking
+ *
+ * SRW locks, condition variables and run-once structures only contain a
+ * pointer, so the waiting threads are kept in a process-wide table hashed
+ * by the address they are waiting on, in the manner of keyed events. A
+ * thread only goes to sleep if the value it is waiting on hasn't changed,
+ * which is checked with the bucket lock held; the threads that wake it up
+ * take the same lock, so no wake-up can be lost. With futexes none of this
+ * requires a server call.
+ */
+
+struct park_waiter
+{
+    struct list  entry;   /* entry in the bucket list */
+    const void  *key;     /* address the thread is waiting on */
+    int          queued;  /* still in the bucket list? */
+    int          woken;   /* futex word, set once the thread has been woken */
+    HANDLE       event;   /* event to wait on when futexes are not available */
+};
+
+struct park_bucket
+{
+    int          lock;    /* spin lock protecting the list */
+    struct list  waiters; /* list of waiting threads */
+};
+
+#define PARK_BUCKETS 64
+
+static struct park_bucket park_buckets[PARK_BUCKETS];
+
+static struct park_bucket *lock_park_bucket( const void *key )
+{
+    struct park_bucket *bucket = &park_buckets[((ULONG_PTR)key >> 4) % PARK_BUCKETS];
+    int spin = 0;
+
+    while (interlocked_cmpxchg( &bucket->lock, 1, 0 ))
+    {
+        if (++spin < 100) small_pause();
+        else NtYieldExecution();
+    }
+    if (!bucket->waiters.next) list_init( &bucket->waiters );
+    return bucket;
+}
+
+static inline void unlock_park_bucket( struct park_bucket *bucket )
+{
+    interlocked_xchg( &bucket->lock, 0 );
+}
+
+/* wait until woken, returns STATUS_TIMEOUT if the timeout expired first */
+static NTSTATUS park_wait( struct park_waiter *waiter, const LARGE_INTEGER *timeout )
+{
+#ifdef NTDLL_SYS_futex
+    if (use_futexes())
+    {
+        LARGE_INTEGER now, end;
+        struct timespec timespec, *ts = NULL;
+
+        if (timeout)
+        {
+            NtQuerySystemTime( &now );
+            end.QuadPart = timeout->QuadPart >= 0 ? timeout->QuadPart : now.QuadPart - timeout->QuadPart;
+        }
+        while (!waiter->woken)
+        {
+            if (timeout)
+            {
+                NtQuerySystemTime( &now );
+                if (now.QuadPart >= end.QuadPart) return STATUS_TIMEOUT;
+                timespec.tv_sec  = (end.QuadPart - now.QuadPart) / 10000000;
+                timespec.tv_nsec = (end.QuadPart - now.QuadPart) % 10000000 * 100;
+                ts = &timespec;
+            }
+            futex_wait( &waiter->woken, 0, ts );
+        }
+        return STATUS_SUCCESS;
+    }
+#endif
+    return NtWaitForSingleObject( waiter->event, FALSE, timeout );
+}
+
+/***********************************************************************
+ *           park
+ *
+ * Wait on key as long as *addr still contains val when checked under the bucket lock.
+ * Returns STATUS_TIMEOUT if the timeout expired; like futexes this can return spuriously.
+ */
+static NTSTATUS park( const void *key, const LONG *addr, LONG val, const LARGE_INTEGER *timeout )
+{
+    struct park_waiter waiter;
+    struct park_bucket *bucket;
+    NTSTATUS ret;
+
+    waiter.key    = key;
+    waiter.queued = 1;
+    waiter.woken  = 0;
+    waiter.event  = 0;
+    if (!use_futexes() && NtCreateEvent( &waiter.event, EVENT_ALL_ACCESS, NULL, SynchronizationEvent, FALSE ))
+        return STATUS_NO_MEMORY;
+
+    bucket = lock_park_bucket( key );
+    if (*addr != val)
+    {
+        unlock_park_bucket( bucket );
+        if (waiter.event) NtClose( waiter.event );
+        return STATUS_SUCCESS;
+    }
+    list_add_tail( &bucket->waiters, &waiter.entry );
+    unlock_park_bucket( bucket );
+
+    if ((ret = park_wait( &waiter, timeout )) == STATUS_TIMEOUT)
+    {
+        bucket = lock_park_bucket( key );
+        if (waiter.queued) list_remove( &waiter.entry );
+        else ret = STATUS_SUCCESS;  /* we are being woken up, wait for it to complete */
+        unlock_park_bucket( bucket );
+        if (ret != STATUS_TIMEOUT) park_wait( &waiter, NULL );
+    }
+    if (waiter.event) NtClose( waiter.event );
+    return ret == STATUS_TIMEOUT ? STATUS_TIMEOUT : STATUS_SUCCESS;
+}
+
+/* park() could not get an event to wait on, sleep a bit instead of spinning on the lock */
+static void park_backoff(void)
+{
+    LARGE_INTEGER timeout;
+
+    timeout.QuadPart = -10000;  /* 1ms */
+    NtDelayExecution( FALSE, &timeout );
+}
+
+/***********************************************************************
+ *           unpark
+ *
+ * Wake up to count threads waiting on key, or all of them if count is -1.
+ * If no waiter is left afterwards, the bits in clear are removed from *addr
+ * under the bucket lock. Returns the number of threads woken.
+ */
+static int unpark( const void *key, int count, LONG *addr, LONG clear )
+{
+    struct park_bucket *bucket = lock_park_bucket( key );
+    struct park_waiter *waiter, *next;
+    struct list woken = LIST_INIT( woken );
+    BOOL more = FALSE;
+    int ret = 0;
+    LONG val;
+
+    LIST_FOR_EACH_ENTRY_SAFE( waiter, next, &bucket->waiters, struct park_waiter, entry )
+    {
+        if (waiter->key != key) continue;
+        if (ret == count)
+        {
+            more = TRUE;
+            break;
+        }
+        list_remove( &waiter->entry );
+        list_add_tail( &woken, &waiter->entry );
+        waiter->queued = 0;
+        ret++;
+    }
+    if (!more && clear)
+    {
+        do val = *addr;
+        while (interlocked_cmpxchg( addr, val & ~clear, val ) != val);
+    }
+    unlock_park_bucket( bucket );
+
+    /* the waiters can go away as soon as they are woken, so fetch next first */
+    LIST_FOR_EACH_ENTRY_SAFE( waiter, next, &woken, struct park_waiter, entry )
+    {
+#ifdef NTDLL_SYS_futex
+        if (!waiter->event)
+        {
+            int *woken_ptr = &waiter->woken;
+            interlocked_xchg( woken_ptr, 1 );
+            futex_wake( woken_ptr, 1 );
+            continue;
+        }
+#endif
+        NtSetEvent( waiter->event, NULL );
+    }
+    return ret;
+}
+
+
+/*
+ * SRW locks
+ *
+ * The lock word holds the number of shared owners, an exclusive owner flag
+ * and one flag for each kind of parked waiter. Exclusive waiters are parked
+ * on the lock address and shared waiters on the following byte, which hashes
+ * to the same bucket so that all the flags are updated under the same
+ * bucket lock. Waiting
+ * writers block new readers, and a released lock wakes one writer if there
+ * is one, all the readers otherwise; the woken threads then compete for it
+ * again.
+ */
+
+#define SRWLOCK_MASK_SHARED       0x1fffffff
+#define SRWLOCK_EXCLUSIVE         0x20000000
+#define SRWLOCK_PARKED_SHARED     0x40000000
+#define SRWLOCK_PARKED_EXCLUSIVE  ((LONG)0x80000000)
+
+#define SRWLOCK_SPIN_COUNT        100
+
+static inline LONG *srwlock_state( RTL_SRWLOCK *lock )
+{
+    return (LONG *)&lock->Ptr;
+}
+
+static inline const void *srwlock_shared_key( RTL_SRWLOCK *lock )
+{
+    return (const char *)lock + 1;
+}
+
+/* wake up the waiters of a lock that just became free */
+static void srwlock_wake( RTL_SRWLOCK *lock )
+{
+    LONG *state = srwlock_state( lock );
+
+    if ((*state & SRWLOCK_PARKED_EXCLUSIVE) && unpark( lock, 1, state, SRWLOCK_PARKED_EXCLUSIVE ))
+        return;
+    if (*state & SRWLOCK_PARKED_SHARED)
+        unpark( srwlock_shared_key( lock ), -1, state, SRWLOCK_PARKED_SHARED );
+}
+
+/***********************************************************************
+ *           RtlInitializeSRWLock   (NTDLL.@)
+ */
+void WINAPI RtlInitializeSRWLock( RTL_SRWLOCK *lock )
+{
+    lock->Ptr = NULL;
+}
+
+/***********************************************************************
+ *           RtlAcquireSRWLockExclusive   (NTDLL.@)
+ */
+void WINAPI RtlAcquireSRWLockExclusive( RTL_SRWLOCK *lock )
+{
+    LONG *state = srwlock_state( lock );
+    LONG val, new;
+    int spin = 0;
+
+    for (;;)
+    {
+        val = *state;
+        if (!(val & (SRWLOCK_EXCLUSIVE | SRWLOCK_MASK_SHARED)))
+        {
+            if (interlocked_cmpxchg( state, val | SRWLOCK_EXCLUSIVE, val ) == val) return;
+            continue;
+        }
+        if (!(val & SRWLOCK_PARKED_EXCLUSIVE) && spin++ < SRWLOCK_SPIN_COUNT)
+        {
+            small_pause();
+            continue;
+        }
+        new = val | SRWLOCK_PARKED_EXCLUSIVE;
+        if (new != val && interlocked_cmpxchg( state, new, val ) != val) continue;
+        if (park( lock, state, new, NULL ) == STATUS_NO_MEMORY) park_backoff();
+    }
+}
+
+/***********************************************************************
+ *           RtlAcquireSRWLockShared   (NTDLL.@)
+ */
+void WINAPI RtlAcquireSRWLockShared( RTL_SRWLOCK *lock )
+{
+    LONG *state = srwlock_state( lock );
+    LONG val, new;
+    int spin = 0;
+
+    for (;;)
+    {
+        val = *state;
+        if (!(val & (SRWLOCK_EXCLUSIVE | SRWLOCK_PARKED_EXCLUSIVE)))
+        {
+            if (interlocked_cmpxchg( state, val + 1, val ) == val) return;
+            continue;
+        }
+        if (!(val & SRWLOCK_PARKED_SHARED) && spin++ < SRWLOCK_SPIN_COUNT)
+        {
+            small_pause();
+            continue;
+        }
+        new = val | SRWLOCK_PARKED_SHARED;
+        if (new != val && interlocked_cmpxchg( state, new, val ) != val) continue;
+        if (park( srwlock_shared_key( lock ), state, new, NULL ) == STATUS_NO_MEMORY) park_backoff();
+    }
+}
+
+/***********************************************************************
+ *           RtlReleaseSRWLockExclusive   (NTDLL.@)
+ */
+void WINAPI RtlReleaseSRWLockExclusive( RTL_SRWLOCK *lock )
+{
+    LONG val = interlocked_xchg_add( srwlock_state( lock ), -SRWLOCK_EXCLUSIVE ) - SRWLOCK_EXCLUSIVE;
+
+    if (val & (SRWLOCK_PARKED_EXCLUSIVE | SRWLOCK_PARKED_SHARED)) srwlock_wake( lock );
+}
+
+/***********************************************************************
+ *           RtlReleaseSRWLockShared   (NTDLL.@)
+ */
+void WINAPI RtlReleaseSRWLockShared( RTL_SRWLOCK *lock )
+{
+    LONG val = interlocked_xchg_add( srwlock_state( lock ), -1 ) - 1;
+
+    if (!(val & SRWLOCK_MASK_SHARED) && (val & (SRWLOCK_PARKED_EXCLUSIVE | SRWLOCK_PARKED_SHARED)))
+        srwlock_wake( lock );
+}
+
+/***********************************************************************
+ *           RtlTryAcquireSRWLockExclusive   (NTDLL.@)
+ */
+BOOLEAN WINAPI RtlTryAcquireSRWLockExclusive( RTL_SRWLOCK *lock )
+{
+    LONG *state = srwlock_state( lock );
+    LONG val;
+
+    do
+    {
+        val = *state;
+        if (val & (SRWLOCK_EXCLUSIVE | SRWLOCK_MASK_SHARED)) return FALSE;
+    }
+    while (interlocked_cmpxchg( state, val | SRWLOCK_EXCLUSIVE, val ) != val);
+    return TRUE;
+}
+
+/***********************************************************************
+ *           RtlTryAcquireSRWLockShared   (NTDLL.@)
+ */
+BOOLEAN WINAPI RtlTryAcquireSRWLockShared( RTL_SRWLOCK *lock )
+{
+    LONG *state = srwlock_state( lock );
+    LONG val;
+
+    do
+    {
+        val = *state;
+        if (val & (SRWLOCK_EXCLUSIVE | SRWLOCK_PARKED_EXCLUSIVE)) return FALSE;
+    }
+    while (interlocked_cmpxchg( state, val + 1, val ) != val);
+    return TRUE;
+}
+
+
+/*
+ * Condition variables
+ *
+ * The variable holds a sequence number that is incremented on every
+ * wake-up, so that a thread doesn't go to sleep if it missed one between
+ * releasing the lock and parking.
+ */
+
+/***********************************************************************
+ *           RtlInitializeConditionVariable   (NTDLL.@)
+ */
+void WINAPI RtlInitializeConditionVariable( RTL_CONDITION_VARIABLE *variable )
+{
+    variable->Ptr = NULL;
+}
+
+/***********************************************************************
+ *           RtlWakeConditionVariable   (NTDLL.@)
+ *
+ * Wakes up one thread waiting on the condition variable.
+ */
+void WINAPI RtlWakeConditionVariable( RTL_CONDITION_VARIABLE *variable )
+{
+    interlocked_xchg_add( (LONG *)&variable->Ptr, 1 );
+    unpark( variable, 1, NULL, 0 );
+}
+
+/***********************************************************************
+ *           RtlWakeAllConditionVariable   (NTDLL.@)
+ *
+ * Wakes up all threads waiting on the condition variable.
+ */
+void WINAPI RtlWakeAllConditionVariable( RTL_CONDITION_VARIABLE *variable )
+{
+    interlocked_xchg_add( (LONG *)&variable->Ptr, 1 );
+    unpark( variable, -1, NULL, 0 );
+}
+
+/***********************************************************************
+ *           RtlSleepConditionVariableCS   (NTDLL.@)
+ *
+ * Atomically releases the critical section and waits on the condition variable.
+ *
+ * RETURNS
+ *  STATUS_SUCCESS if woken up (possibly spuriously), STATUS_TIMEOUT otherwise.
+ *  The critical section is held again in both cases.
+ */
+NTSTATUS WINAPI RtlSleepConditionVariableCS( RTL_CONDITION_VARIABLE *variable, RTL_CRITICAL_SECTION *crit,
+                                             const LARGE_INTEGER *timeout )
+{
+    LONG val = *(LONG *)&variable->Ptr;
+    NTSTATUS status;
+
+    RtlLeaveCriticalSection( crit );
+    status = park( variable, (LONG *)&variable->Ptr, val, timeout );
+    RtlEnterCriticalSection( crit );
+    return status;
+}
+
+/***********************************************************************
+ *           RtlSleepConditionVariableSRW   (NTDLL.@)
+ *
+ * Atomically releases the SRW lock and waits on the condition variable.
+ *
+ * RETURNS
+ *  STATUS_SUCCESS if woken up (possibly spuriously), STATUS_TIMEOUT otherwise.
+ *  The lock is held again in the same mode in both cases.
+ */
+NTSTATUS WINAPI RtlSleepConditionVariableSRW( RTL_CONDITION_VARIABLE *variable, RTL_SRWLOCK *lock,
+                                              const LARGE_INTEGER *timeout, ULONG flags )
+{
+    LONG val = *(LONG *)&variable->Ptr;
+    NTSTATUS status;
+
+    if (flags & RTL_CONDITION_VARIABLE_LOCKMODE_SHARED)
+        RtlReleaseSRWLockShared( lock );
+    else
+        RtlReleaseSRWLockExclusive( lock );
+
+    status = park( variable, (LONG *)&variable->Ptr, val, timeout );
+
+    if (flags & RTL_CONDITION_VARIABLE_LOCKMODE_SHARED)
+        RtlAcquireSRWLockShared( lock );
+    else
+        RtlAcquireSRWLockExclusive( lock );
+    return status;
+}
+
+
+/*
+ * One-time initialization
+ *
+ * The low bits of the pointer hold the state: 0 not initialized, 1 being
+ * initialized synchronously, 2 done (the rest is the context), 3 being
+ * initialized asynchronously.
+ */
+
+/***********************************************************************
+ *           RtlRunOnceInitialize   (NTDLL.@)
+ */
+void WINAPI RtlRunOnceInitialize( RTL_RUN_ONCE *once )
+{
+    once->Ptr = NULL;
+}
+
+/***********************************************************************
+ *           RtlRunOnceBeginInitialize   (NTDLL.@)
+ *
+ * RETURNS
+ *  STATUS_SUCCESS if the initialization is complete, STATUS_PENDING if the
+ *  caller has to perform it and call RtlRunOnceComplete, an error otherwise.
+ */
+DWORD WINAPI RtlRunOnceBeginInitialize( RTL_RUN_ONCE *once, ULONG flags, void **context )
+{
+    if (flags & RTL_RUN_ONCE_CHECK_ONLY)
+    {
+        ULONG_PTR val = (ULONG_PTR)once->Ptr;
+
+        if (flags & RTL_RUN_ONCE_ASYNC) return STATUS_INVALID_PARAMETER;
+        if ((val & 3) != 2) return STATUS_UNSUCCESSFUL;
+        if (context) *context = (void *)(val & ~3);
+        return STATUS_SUCCESS;
+    }
+
+    for (;;)
+    {
+        ULONG_PTR val = (ULONG_PTR)once->Ptr;
+
+        switch (val & 3)
+        {
+        case 0:  /* first time */
+            if (!interlocked_cmpxchg_ptr( &once->Ptr,
+                                          (flags & RTL_RUN_ONCE_ASYNC) ? (void *)3 : (void *)1, 0 ))
+                return STATUS_PENDING;
+            break;
+
+        case 1:  /* in progress, wait */
+            if (flags & RTL_RUN_ONCE_ASYNC) return STATUS_INVALID_PARAMETER;
+            if (park( once, (LONG *)&once->Ptr, (LONG)val, NULL ) == STATUS_NO_MEMORY) park_backoff();
+            break;
+
+        case 2:  /* done */
+            if (context) *context = (void *)(val & ~3);
+            return STATUS_SUCCESS;
+
+        case 3:  /* in progress, async */
+            if (!(flags & RTL_RUN_ONCE_ASYNC)) return STATUS_INVALID_PARAMETER;
+            return STATUS_PENDING;
+        }
+    }
+}
+
+/***********************************************************************
+ *           RtlRunOnceComplete   (NTDLL.@)
+ */
+DWORD WINAPI RtlRunOnceComplete( RTL_RUN_ONCE *once, ULONG flags, void *context )
+{
+    if ((ULONG_PTR)context & ((1 << RTL_RUN_ONCE_CTX_RESERVED_BITS) - 1)) return STATUS_INVALID_PARAMETER;
+
+    if (flags & RTL_RUN_ONCE_INIT_FAILED)
+    {
+        if (context) return STATUS_INVALID_PARAMETER;
+        if (flags & RTL_RUN_ONCE_ASYNC) return STATUS_INVALID_PARAMETER;
+    }
+    else context = (void *)((ULONG_PTR)context | 2);
+
+    for (;;)
+    {
+        ULONG_PTR val = (ULONG_PTR)once->Ptr;
+
+        switch (val & 3)
+        {
+        case 1:  /* in progress */
+            if (interlocked_cmpxchg_ptr( &once->Ptr, context, (void *)val ) != (void *)val) break;
+            unpark( once, -1, NULL, 0 );
+            return STATUS_SUCCESS;
+
+        case 3:  /* in progress, async */
+            if (!(flags & RTL_RUN_ONCE_ASYNC)) return STATUS_INVALID_PARAMETER;
+            if (interlocked_cmpxchg_ptr( &once->Ptr, context, (void *)val ) != (void *)val) break;
+            return STATUS_SUCCESS;
+
+        default:
+            return STATUS_UNSUCCESSFUL;
+        }
+    }
+}
+
+/***********************************************************************
+ *           RtlRunOnceExecuteOnce   (NTDLL.@)
+ */
+DWORD WINAPI RtlRunOnceExecuteOnce( RTL_RUN_ONCE *once, PRTL_RUN_ONCE_INIT_FN func,
+                                    void *param, void **context )
+{
+    DWORD ret = RtlRunOnceBeginInitialize( once, 0, context );
+
+    if (ret != STATUS_PENDING) return ret;
+
+    if (!func( once, param, context ))
+    {
+        RtlRunOnceComplete( once, RTL_RUN_ONCE_INIT_FAILED, NULL );
+        return STATUS_UNSUCCESSFUL;
+    }
+
+    return RtlRunOnceComplete( once, 0, context ? *context : NULL );
+}
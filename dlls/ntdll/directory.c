@@ -60,6 +60,9 @@
 #ifdef HAVE_UNISTD_H
 # include <unistd.h>
 #endif
+#ifdef HAVE_SYS_SYSCALL_H
+# include <sys/syscall.h>
+#endif
 
 #define NONAMELESSUNION
 #define NONAMELESSSTRUCT
@@ -99,8 +102,6 @@ typedef struct
 # define O_DIRECTORY 0200000 /* must be directory */
 #endif
 
-#ifdef __i386__
-
 typedef struct
 {
     ULONG64        d_ino;
@@ -110,6 +111,8 @@ typedef struct
     char           d_name[256];
 } KERNEL_DIRENT64;
 
+#ifdef __i386__
+
 static inline int getdents64( int fd, char *de, unsigned int size )
 {
     int ret;
@@ -126,6 +129,11 @@ static inline int getdents64( int fd, char *de, unsigned int size )
 }
 #define USE_GETDENTS
 
+#elif defined(__x86_64__) && defined(__NR_getdents64)
+
+#define getdents64(fd,de,size) syscall( __NR_getdents64, (fd), (de), (size) )
+#define USE_GETDENTS
+
 #endif  /* i386 */
 
 #endif  /* linux */
@@ -1002,6 +1010,22 @@ static BOOLEAN match_filename( const UNICODE_STRING *name_str, const UNICODE_STR
 }
 
 
+/***********************************************************************
+ *           get_short_name
+ *
+ * Generate the short name of a long file name, if it doesn't fit in 8.3.
+ * This is only a hash of the name, so it isn't worth caching; append_entry
+ * only calls it when the information class or the mask needs it.
+ */
+static inline int get_short_name( const UNICODE_STRING *name, WCHAR *buffer )
+{
+    BOOLEAN spaces;
+
+    if (RtlIsNameLegalDOS8Dot3( name, NULL, &spaces ) && !spaces) return 0;
+    return hash_short_file_name( name, buffer );
+}
+
+
 /***********************************************************************
  *           append_entry
  *
@@ -1034,20 +1058,14 @@ static union file_directory_info *append_entry( void *info_ptr, IO_STATUS_BLOCK
                                      short_nameW, sizeof(short_nameW) / sizeof(WCHAR) );
         if (short_len == -1) short_len = sizeof(short_nameW) / sizeof(WCHAR);
     }
-    else  /* generate a short name if necessary */
-    {
-        BOOLEAN spaces;
-
-        short_len = 0;
-        if (!RtlIsNameLegalDOS8Dot3( &str, NULL, &spaces ) || spaces)
-            short_len = hash_short_file_name( &str, short_nameW );
-    }
+    else short_len = -1;  /* generated only when needed */
 
     TRACE( "long %s short %s mask %s\n",
-           debugstr_us(&str), debugstr_wn(short_nameW, short_len), debugstr_us(mask) );
+           debugstr_us(&str), debugstr_a(short_name), debugstr_us(mask) );
 
     if (mask && !match_filename( &str, mask ))
     {
+        if (short_len == -1) short_len = get_short_name( &str, short_nameW );
         if (!short_len) return NULL;  /* no short name to match */
         str.Buffer = short_nameW;
         str.Length = short_len * sizeof(WCHAR);
@@ -1103,6 +1121,7 @@ static union file_directory_info *append_entry( void *info_ptr, IO_STATUS_BLOCK
         break;
 
     case FileBothDirectoryInformation:
+        if (short_len == -1) short_len = get_short_name( &str, short_nameW );
         info->both.EaSize = 0; /* FIXME */
         info->both.ShortNameLength = short_len * sizeof(WCHAR);
         for (i = 0; i < short_len; i++) info->both.ShortName[i] = toupperW(short_nameW[i]);
@@ -1111,6 +1130,7 @@ static union file_directory_info *append_entry( void *info_ptr, IO_STATUS_BLOCK
         break;
 
     case FileIdBothDirectoryInformation:
+        if (short_len == -1) short_len = get_short_name( &str, short_nameW );
         info->id_both.EaSize = 0; /* FIXME */
         info->id_both.ShortNameLength = short_len * sizeof(WCHAR);
         for (i = 0; i < short_len; i++) info->id_both.ShortName[i] = toupperW(short_nameW[i]);
@@ -1258,38 +1278,110 @@ static int read_directory_vfat( int fd, IO_STATUS_BLOCK *io, void *buffer, ULONG
  * Read a directory using the Linux getdents64 system call; helper for NtQueryDirectoryFile.
  */
 #ifdef USE_GETDENTS
-static int read_directory_getdents( int fd, IO_STATUS_BLOCK *io, void *buffer, ULONG length,
+
+/* entries read ahead by getdents64 for a directory handle, protected by dir_section */
+struct dir_readahead
+{
+    HANDLE handle;       /* handle the entries were read for */
+    dev_t  dev;          /* directory the entries belong to */
+    ino_t  ino;
+    off_t  pos;          /* directory offset of the first unread entry */
+    char  *data;         /* buffer holding the entries */
+    int    start;        /* offset of the first unread entry in the buffer */
+    int    size;         /* size of the valid data in the buffer */
+};
+
+#define DIR_READAHEAD_SIZE  0x10000
+#define DIR_READAHEAD_SLOTS 8  /* number of handles that can be enumerated in parallel */
+
+static struct dir_readahead dir_readahead[DIR_READAHEAD_SLOTS];
+static unsigned int dir_readahead_next;  /* next slot to reuse, round-robin */
+
+/***********************************************************************
+ *           get_dir_readahead
+ *
+ * Get the readahead buffer of a directory handle, taking over the oldest
+ * one if the handle doesn't have one yet. dir_section must be held by caller.
+ */
+static struct dir_readahead *get_dir_readahead( HANDLE handle )
+{
+    struct dir_readahead *ra;
+    unsigned int i;
+
+    for (i = 0; i < DIR_READAHEAD_SLOTS; i++)
+        if (dir_readahead[i].handle == handle) return &dir_readahead[i];
+
+    ra = &dir_readahead[dir_readahead_next++ % DIR_READAHEAD_SLOTS];
+    ra->handle = handle;
+    ra->start = ra->size = 0;
+    return ra;
+}
+
+/***********************************************************************
+ *           readahead_getdents
+ *
+ * Get the directory entries starting at a given offset of the current
+ * directory, reading a new batch with getdents64 unless they are already
+ * buffered. dir_section must be held by caller.
+ */
+static int readahead_getdents( struct dir_readahead *ra, int fd, off_t pos, KERNEL_DIRENT64 **de )
+{
+    int res;
+
+    /* the handle may have been closed and reused for another directory, so check that too */
+    if (ra->start < ra->size && ra->pos == pos && ra->dev == curdir.dev && ra->ino == curdir.ino)
+    {
+        *de = (KERNEL_DIRENT64 *)(ra->data + ra->start);
+        return ra->size - ra->start;
+    }
+
+    ra->start = ra->size = 0;
+    if (!ra->data && !(ra->data = RtlAllocateHeap( GetProcessHeap(), 0, DIR_READAHEAD_SIZE )))
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+    if (lseek( fd, pos, SEEK_SET ) == -1) return -1;
+    if ((res = getdents64( fd, ra->data, DIR_READAHEAD_SIZE )) <= 0) return res;
+
+    ra->dev  = curdir.dev;
+    ra->ino  = curdir.ino;
+    ra->pos  = pos;
+    ra->size = res;
+    *de = (KERNEL_DIRENT64 *)ra->data;
+    return res;
+}
+
+/***********************************************************************
+ *           read_directory_getdents
+ *
+ * Read a directory using the Linux getdents64 system call; helper for NtQueryDirectoryFile.
+ */
+static int read_directory_getdents( HANDLE handle, int fd, IO_STATUS_BLOCK *io, void *buffer, ULONG length,
                                     BOOLEAN single_entry, const UNICODE_STRING *mask,
                                     BOOLEAN restart_scan, FILE_INFORMATION_CLASS class )
 {
-    off_t old_pos = 0;
-    size_t size = length;
+    struct dir_readahead *ra = get_dir_readahead( handle );
+    off_t pos = 0;
     int res, fake_dot_dot = 1;
-    char *data, local_buffer[8192];
+    BOOL full = FALSE;
     KERNEL_DIRENT64 *de;
     union file_directory_info *info, *last_info = NULL;
 
-    if (size <= sizeof(local_buffer) || !(data = RtlAllocateHeap( GetProcessHeap(), 0, size )))
-    {
-        size = sizeof(local_buffer);
-        data = local_buffer;
-    }
-
-    if (restart_scan) lseek( fd, 0, SEEK_SET );
-    else if (length < max_dir_info_size(class))  /* we may have to return a partial entry here */
+    if (restart_scan) ra->size = 0;  /* a new scan must see the current contents */
+    else
     {
-        old_pos = lseek( fd, 0, SEEK_CUR );
-        if (old_pos == -1 && errno == ENOENT)
+        pos = lseek( fd, 0, SEEK_CUR );
+        if (pos == -1)
         {
-            io->u.Status = STATUS_NO_MORE_FILES;
-            res = 0;
-            goto done;
+            io->u.Status = (errno == ENOENT) ? STATUS_NO_MORE_FILES : FILE_GetNtStatus();
+            return 0;
         }
     }
 
     io->u.Status = STATUS_SUCCESS;
 
-    res = getdents64( fd, data, size );
+    res = readahead_getdents( ra, fd, pos, &de );
     if (res == -1)
     {
         if (errno != ENOSYS)
@@ -1297,11 +1389,9 @@ static int read_directory_getdents( int fd, IO_STATUS_BLOCK *io, void *buffer, U
             io->u.Status = FILE_GetNtStatus();
             res = 0;
         }
-        goto done;
+        return res;
     }
 
-    de = (KERNEL_DIRENT64 *)data;
-
     if (restart_scan)
     {
         /* check if we got . and .. from getdents */
@@ -1309,7 +1399,7 @@ static int read_directory_getdents( int fd, IO_STATUS_BLOCK *io, void *buffer, U
         {
             if (!strcmp( de->d_name, "." ) && res > de->d_reclen)
             {
-                KERNEL_DIRENT64 *next_de = (KERNEL_DIRENT64 *)(data + de->d_reclen);
+                KERNEL_DIRENT64 *next_de = (KERNEL_DIRENT64 *)((char *)de + de->d_reclen);
                 if (!strcmp( next_de->d_name, ".." )) fake_dot_dot = 0;
             }
         }
@@ -1333,49 +1423,40 @@ static int read_directory_getdents( int fd, IO_STATUS_BLOCK *io, void *buffer, U
 
             /* check if we still have enough space for the largest possible entry */
             if (last_info && io->Information + max_dir_info_size(class) > length)
-            {
-                lseek( fd, 0, SEEK_SET );  /* reset pos to first entry */
-                res = 0;
-            }
+                full = TRUE;  /* keep pos on the first entry */
         }
     }
 
-    while (res > 0)
+    while (res > 0 && !full)
     {
-        res -= de->d_reclen;
         if (de->d_ino &&
             !(fake_dot_dot && (!strcmp( de->d_name, "." ) || !strcmp( de->d_name, ".." ))) &&
             (info = append_entry( buffer, io, length, de->d_name, NULL, mask, class )))
         {
             last_info = info;
-            if (io->u.Status == STATUS_BUFFER_OVERFLOW)
-            {
-                lseek( fd, old_pos, SEEK_SET );  /* restore pos to previous entry */
-                break;
-            }
+            if (io->u.Status == STATUS_BUFFER_OVERFLOW) break;  /* keep pos on this entry */
             /* check if we still have enough space for the largest possible entry */
-            if (single_entry || io->Information + max_dir_info_size(class) > length)
-            {
-                if (res > 0) lseek( fd, de->d_off, SEEK_SET );  /* set pos to next entry */
-                break;
-            }
+            if (single_entry || io->Information + max_dir_info_size(class) > length) full = TRUE;
         }
-        old_pos = de->d_off;
         /* move on to the next entry */
-        if (res > 0) de = (KERNEL_DIRENT64 *)((char *)de + de->d_reclen);
-        else
-        {
-            res = getdents64( fd, data, size );
-            de = (KERNEL_DIRENT64 *)data;
-        }
+        pos = de->d_off;
+        res -= de->d_reclen;
+        de = (KERNEL_DIRENT64 *)((char *)de + de->d_reclen);
+        if (res <= 0 && !full) res = readahead_getdents( ra, fd, pos, &de );
     }
 
+    /* keep the remaining entries for the next call */
+    if (res > 0)
+    {
+        ra->start = (char *)de - ra->data;
+        ra->pos   = pos;
+    }
+    else ra->size = 0;
+    lseek( fd, pos, SEEK_SET );
+
     if (last_info) last_info->next = 0;
     else io->u.Status = restart_scan ? STATUS_NO_SUCH_FILE : STATUS_NO_MORE_FILES;
-    res = 0;
-done:
-    if (data != local_buffer) RtlFreeHeap( GetProcessHeap(), 0, data );
-    return res;
+    return 0;
 }
 
 #elif defined HAVE_GETDIRENTRIES
@@ -1778,7 +1859,7 @@ NTSTATUS WINAPI NtQueryDirectoryFile( HANDLE handle, HANDLE event,
             read_directory_stat( fd, io, buffer, length, single_entry,
                                  mask, restart_scan, info_class ) != -1) goto done;
 #ifdef USE_GETDENTS
-        if ((read_directory_getdents( fd, io, buffer, length, single_entry,
+        if ((read_directory_getdents( handle, fd, io, buffer, length, single_entry,
                                       mask, restart_scan, info_class )) != -1) goto done;
 #elif defined HAVE_GETDIRENTRIES
         if ((read_directory_getdirentries( fd, io, buffer, length, single_entry,
@@ -1800,6 +1881,210 @@ NTSTATUS WINAPI NtQueryDirectoryFile( HANDLE handle, HANDLE event,
 }
 
 
+/* cached listing of a directory, used for case-insensitive lookups */
+struct dir_cache
+{
+    struct list   entry;         /* entry in dir_cache_list */
+    dev_t         dev;           /* device and inode of the directory */
+    ino_t         ino;
+    time_t        mtime;         /* modification time of the directory when it was read, 0 if unreliable */
+    struct list   buckets[1];    /* hash buckets of struct dir_cache_name */
+};
+
+struct dir_cache_name
+{
+    struct list   entry;         /* entry in the hash bucket */
+    const char   *unix_name;     /* name of the file in the Unix directory */
+    BOOLEAN       short_name;    /* whether this is a generated 8.3 name */
+    USHORT        len;           /* length of the name in WCHARs */
+    WCHAR         name[1];       /* Windows name, upper-case */
+};
+
+#define DIR_CACHE_MAX_DIRS 32    /* number of directories kept in the cache */
+#define DIR_CACHE_BUCKETS  127   /* hash buckets per directory */
+
+static struct list dir_cache_list = LIST_INIT( dir_cache_list );  /* most recently used first */
+static unsigned int dir_cache_count;
+
+static inline unsigned int dir_cache_hash( const WCHAR *name, int length )
+{
+    unsigned int hash = 0;
+    while (length--) hash = hash * 31 + toupperW( *name++ );
+    return hash % DIR_CACHE_BUCKETS;
+}
+
+static void free_dir_cache( struct dir_cache *cache )
+{
+    struct dir_cache_name *name, *next;
+    unsigned int i;
+
+    for (i = 0; i < DIR_CACHE_BUCKETS; i++)
+        LIST_FOR_EACH_ENTRY_SAFE( name, next, &cache->buckets[i], struct dir_cache_name, entry )
+            RtlFreeHeap( GetProcessHeap(), 0, name );
+    RtlFreeHeap( GetProcessHeap(), 0, cache );
+}
+
+/* add a name to a directory cache; the Unix name is copied for long names */
+static struct dir_cache_name *add_dir_cache_name( struct dir_cache *cache, const WCHAR *nameW, int length,
+                                                  const char *unix_name, BOOLEAN short_name )
+{
+    struct dir_cache_name *name;
+    size_t size = FIELD_OFFSET( struct dir_cache_name, name[length] );
+    int i;
+
+    if (!short_name) size += strlen( unix_name ) + 1;
+    if (!(name = RtlAllocateHeap( GetProcessHeap(), 0, size ))) return NULL;
+    for (i = 0; i < length; i++) name->name[i] = toupperW( nameW[i] );
+    name->len = length;
+    name->short_name = short_name;
+    if (short_name) name->unix_name = unix_name;
+    else name->unix_name = strcpy( (char *)(name->name + length), unix_name );
+    list_add_tail( &cache->buckets[dir_cache_hash( nameW, length )], &name->entry );
+    return name;
+}
+
+/***********************************************************************
+ *           read_dir_cache
+ *
+ * Read all the names of a directory into a new cache entry.
+ */
+static struct dir_cache *read_dir_cache( const char *unix_name, const struct stat *st )
+{
+    WCHAR buffer[MAX_DIR_ENTRY_LEN];
+    UNICODE_STRING str;
+    BOOLEAN spaces;
+    struct dir_cache *cache;
+    struct dir_cache_name *name;
+    struct dirent *de;
+    DIR *dir;
+    unsigned int i;
+    int ret;
+
+    if (!(dir = opendir( unix_name ))) return NULL;
+
+    if (!(cache = RtlAllocateHeap( GetProcessHeap(), 0,
+                                   FIELD_OFFSET( struct dir_cache, buckets[DIR_CACHE_BUCKETS] ))))
+    {
+        closedir( dir );
+        errno = ENOMEM;
+        return NULL;
+    }
+    cache->dev   = st->st_dev;
+    cache->ino   = st->st_ino;
+    cache->mtime = st->st_mtime;
+
+    /* timestamps can have a two second granularity (FAT), so don't trust the mtime
+     * if the directory changed shortly before we started reading it, it could be
+     * modified again without the mtime changing */
+    if (st->st_mtime >= time(NULL) - 2) cache->mtime = 0;
+    for (i = 0; i < DIR_CACHE_BUCKETS; i++) list_init( &cache->buckets[i] );
+
+    str.Buffer = buffer;
+    str.MaximumLength = sizeof(buffer);
+    while ((de = readdir( dir )))
+    {
+        ret = ntdll_umbstowcs( 0, de->d_name, strlen(de->d_name), buffer, MAX_DIR_ENTRY_LEN );
+        if (ret <= 0) continue;
+        if (!(name = add_dir_cache_name( cache, buffer, ret, de->d_name, FALSE ))) goto error;
+
+        /* also add the hashed short name, since we may be asked for it */
+        str.Length = ret * sizeof(WCHAR);
+        if (!RtlIsNameLegalDOS8Dot3( &str, NULL, &spaces ) || spaces)
+        {
+            WCHAR short_nameW[12];
+            ret = hash_short_file_name( &str, short_nameW );
+            if (!add_dir_cache_name( cache, short_nameW, ret, name->unix_name, TRUE )) goto error;
+        }
+    }
+    closedir( dir );
+    return cache;
+
+error:
+    closedir( dir );
+    free_dir_cache( cache );
+    errno = ENOMEM;
+    return NULL;
+}
+
+/***********************************************************************
+ *           find_dir_cache
+ *
+ * Find the cached listing of a directory, discarding it if it is out of date.
+ * Must be called with dir_section held.
+ */
+static struct dir_cache *find_dir_cache( const char *unix_name, const struct stat *st )
+{
+    struct dir_cache *cache;
+
+    LIST_FOR_EACH_ENTRY( cache, &dir_cache_list, struct dir_cache, entry )
+    {
+        if (cache->dev != st->st_dev || cache->ino != st->st_ino) continue;
+        list_remove( &cache->entry );
+        if (cache->mtime == st->st_mtime)
+        {
+            list_add_head( &dir_cache_list, &cache->entry );
+            return cache;
+        }
+        TRACE( "directory %s changed, reloading\n", debugstr_a(unix_name) );
+        free_dir_cache( cache );
+        dir_cache_count--;
+        break;
+    }
+    return NULL;
+}
+
+/***********************************************************************
+ *           insert_dir_cache
+ *
+ * Add a listing read by read_dir_cache to the cache, unless another thread
+ * already added one for the same directory in the meantime.
+ * Must be called with dir_section held.
+ */
+static struct dir_cache *insert_dir_cache( const char *unix_name, struct dir_cache *cache,
+                                           const struct stat *st )
+{
+    struct dir_cache *existing;
+
+    if ((existing = find_dir_cache( unix_name, st )))
+    {
+        free_dir_cache( cache );
+        return existing;
+    }
+
+    if (dir_cache_count == DIR_CACHE_MAX_DIRS)
+    {
+        struct dir_cache *last = LIST_ENTRY( list_tail( &dir_cache_list ), struct dir_cache, entry );
+        list_remove( &last->entry );
+        free_dir_cache( last );
+        dir_cache_count--;
+    }
+    list_add_head( &dir_cache_list, &cache->entry );
+    dir_cache_count++;
+    return cache;
+}
+
+/***********************************************************************
+ *           lookup_dir_cache
+ *
+ * Find a name in a directory cache. Long names take precedence over short ones.
+ */
+static const char *lookup_dir_cache( const struct dir_cache *cache, const WCHAR *name, int length,
+                                     int check_short )
+{
+    const struct dir_cache_name *entry;
+    const char *ret = NULL;
+
+    LIST_FOR_EACH_ENTRY( entry, &cache->buckets[dir_cache_hash( name, length )],
+                         const struct dir_cache_name, entry )
+    {
+        if (entry->len != length || memicmpW( entry->name, name, length )) continue;
+        if (!entry->short_name) return entry->unix_name;
+        if (check_short && !ret) ret = entry->unix_name;
+    }
+    return ret;
+}
+
+
 /***********************************************************************
  *           find_file_in_dir
  *
@@ -1810,11 +2095,10 @@ NTSTATUS WINAPI NtQueryDirectoryFile( HANDLE handle, HANDLE event,
 static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, int length,
                                   int check_case, int *is_win_dir )
 {
-    WCHAR buffer[MAX_DIR_ENTRY_LEN];
     UNICODE_STRING str;
     BOOLEAN spaces;
-    DIR *dir;
-    struct dirent *de;
+    struct dir_cache *cache;
+    const char *found;
     struct stat st;
     int ret, used_default, is_name_8_dot_3;
 
@@ -1854,6 +2138,7 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
         int fd = open( unix_name, O_RDONLY | O_DIRECTORY );
         if (fd != -1)
         {
+            WCHAR buffer[MAX_DIR_ENTRY_LEN];
             KERNEL_DIRENT *de;
 
             RtlEnterCriticalSection( &dir_section );
@@ -1905,40 +2190,33 @@ static NTSTATUS find_file_in_dir( char *unix_name, int pos, const WCHAR *name, i
     }
 #endif /* VFAT_IOCTL_READDIR_BOTH */
 
-    if (!(dir = opendir( unix_name )))
+    if (stat( unix_name, &st ) == -1)
     {
         if (errno == ENOENT) return STATUS_OBJECT_PATH_NOT_FOUND;
         else return FILE_GetNtStatus();
     }
-    unix_name[pos - 1] = '/';
-    str.Buffer = buffer;
-    str.MaximumLength = sizeof(buffer);
-    while ((de = readdir( dir )))
-    {
-        ret = ntdll_umbstowcs( 0, de->d_name, strlen(de->d_name), buffer, MAX_DIR_ENTRY_LEN );
-        if (ret == length && !memicmpW( buffer, name, length ))
-        {
-            strcpy( unix_name + pos, de->d_name );
-            closedir( dir );
-            goto success;
-        }
 
-        if (!is_name_8_dot_3) continue;
-
-        str.Length = ret * sizeof(WCHAR);
-        if (!RtlIsNameLegalDOS8Dot3( &str, NULL, &spaces ) || spaces)
+    RtlEnterCriticalSection( &dir_section );
+    if (!(cache = find_dir_cache( unix_name, &st )))
+    {
+        /* don't hold the lock while reading the directory */
+        RtlLeaveCriticalSection( &dir_section );
+        if (!(cache = read_dir_cache( unix_name, &st )))
         {
-            WCHAR short_nameW[12];
-            ret = hash_short_file_name( &str, short_nameW );
-            if (ret == length && !memicmpW( short_nameW, name, length ))
-            {
-                strcpy( unix_name + pos, de->d_name );
-                closedir( dir );
-                goto success;
-            }
+            if (errno == ENOENT) return STATUS_OBJECT_PATH_NOT_FOUND;
+            else return FILE_GetNtStatus();
         }
+        RtlEnterCriticalSection( &dir_section );
+        cache = insert_dir_cache( unix_name, cache, &st );
     }
-    closedir( dir );
+    unix_name[pos - 1] = '/';
+    if ((found = lookup_dir_cache( cache, name, length, is_name_8_dot_3 )))
+    {
+        strcpy( unix_name + pos, found );
+        RtlLeaveCriticalSection( &dir_section );
+        goto success;
+    }
+    RtlLeaveCriticalSection( &dir_section );
     goto not_found;  /* avoid warning */
 
 not_found:
@@ -2908,50 +3186,73 @@ static void WINAPI read_changes_user_apc( void *arg, IO_STATUS_BLOCK *io, ULONG
     RtlFreeHeap( GetProcessHeap(), 0, info );
 }
 
+/* convert the changes returned by the server to a list of FILE_NOTIFY_INFORMATION */
+static ULONG convert_change_events( char *data, data_size_t size, void *buffer, ULONG buffer_size )
+{
+    FILE_NOTIFY_INFORMATION *pfni = buffer, *prev = NULL;
+    ULONG len = 0, entry_size;
+    int i, name_len;
+
+    while (size >= FIELD_OFFSET( struct filesystem_event, name ))
+    {
+        struct filesystem_event *event = (struct filesystem_event *)data;
+        data_size_t event_size = (FIELD_OFFSET( struct filesystem_event, name[event->len] ) + sizeof(int) - 1)
+                                 & ~(sizeof(int) - 1);
+
+        if (event_size > size) break;
+
+        /* convert to an NT style path */
+        for (i = 0; i < event->len; i++)
+            if (event->name[i] == '/')
+                event->name[i] = '\\';
+
+        name_len = ntdll_umbstowcs( 0, event->name, event->len, NULL, 0 );
+        entry_size = FIELD_OFFSET( FILE_NOTIFY_INFORMATION, FileName[name_len] );
+        if ((char *)pfni + entry_size > (char *)buffer + buffer_size) return 0;  /* overflow */
+
+        if (prev) prev->NextEntryOffset = (char *)pfni - (char *)prev;
+        pfni->NextEntryOffset = 0;
+        pfni->Action = event->action;
+        pfni->FileNameLength = ntdll_umbstowcs( 0, event->name, event->len,
+                                                pfni->FileName, name_len ) * sizeof(WCHAR);
+        len = (char *)pfni - (char *)buffer + entry_size;
+
+        /* entries are DWORD aligned */
+        prev = pfni;
+        pfni = (FILE_NOTIFY_INFORMATION *)((char *)pfni + ((entry_size + 3) & ~3));
+        data += event_size;
+        size -= event_size;
+    }
+    return len;
+}
+
 static NTSTATUS read_changes_apc( void *user, PIO_STATUS_BLOCK iosb, NTSTATUS status, void **apc )
 {
     struct read_changes_info *info = user;
-    char path[PATH_MAX];
-    NTSTATUS ret = STATUS_SUCCESS;
-    int len, action, i;
+    NTSTATUS ret;
+    data_size_t size = 0;
+    char *data = NULL;
+    ULONG len = 0;
+
+    /* the events are smaller than their FILE_NOTIFY_INFORMATION counterpart for single-byte names */
+    if (info->Buffer)
+        data = RtlAllocateHeap( GetProcessHeap(), 0, info->BufferSize );
 
     SERVER_START_REQ( read_change )
     {
         req->handle = wine_server_obj_handle( info->FileHandle );
-        wine_server_set_reply( req, path, PATH_MAX );
+        if (data) wine_server_set_reply( req, data, info->BufferSize );
         ret = wine_server_call( req );
-        action = reply->action;
-        len = wine_server_reply_size( reply );
+        size = wine_server_reply_size( reply );
     }
     SERVER_END_REQ;
 
-    if (ret == STATUS_SUCCESS && info->Buffer && 
-        (info->BufferSize > (sizeof (FILE_NOTIFY_INFORMATION) + len*sizeof(WCHAR))))
-    {
-        PFILE_NOTIFY_INFORMATION pfni;
-
-        pfni = info->Buffer;
-
-        /* convert to an NT style path */
-        for (i=0; i<len; i++)
-            if (path[i] == '/')
-                path[i] = '\\';
-
-        len = ntdll_umbstowcs( 0, path, len, pfni->FileName,
-                               info->BufferSize - sizeof (*pfni) );
+    if (ret == STATUS_SUCCESS && data)
+        len = convert_change_events( data, size, info->Buffer, info->BufferSize );
 
-        pfni->NextEntryOffset = 0;
-        pfni->Action = action;
-        pfni->FileNameLength = len * sizeof (WCHAR);
-        pfni->FileName[len] = 0;
-        len = sizeof (*pfni) - sizeof (DWORD) + pfni->FileNameLength;
-    }
-    else
-    {
-        ret = STATUS_NOTIFY_ENUM_DIR;
-        len = 0;
-    }
+    if (!len) ret = STATUS_NOTIFY_ENUM_DIR;
 
+    RtlFreeHeap( GetProcessHeap(), 0, data );
     iosb->u.Status = ret;
     iosb->Information = len;
     *apc = read_changes_user_apc;
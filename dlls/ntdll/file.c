@@ -2144,6 +2144,7 @@ NTSTATUS WINAPI NtSetInformationFile(HANDLE handle, PIO_STATUS_BLOCK io,
                 io->u.Status  = wine_server_call( req );
             }
             SERVER_END_REQ;
+            if (!io->u.Status) reactor_set_completion( handle, info->CompletionPort, info->CompletionKey );
         } else
             io->u.Status = STATUS_INVALID_PARAMETER_3;
         break;
@@ -2807,6 +2808,8 @@ NTSTATUS WINAPI NtCancelIoFileEx( HANDLE hFile, PIO_STATUS_BLOCK iosb, PIO_STATU
 
     TRACE("%p %p %p\n", hFile, iosb, io_status );
 
+    reactor_cancel_async( hFile, FALSE, iosb, FALSE );
+
     SERVER_START_REQ( cancel_async )
     {
         req->handle      = wine_server_obj_handle( hFile );
@@ -2839,6 +2842,8 @@ NTSTATUS WINAPI NtCancelIoFile( HANDLE hFile, PIO_STATUS_BLOCK io_status )
 
     TRACE("%p %p\n", hFile, io_status );
 
+    reactor_cancel_async( hFile, TRUE, NULL, FALSE );
+
     SERVER_START_REQ( cancel_async )
     {
         req->handle      = wine_server_obj_handle( hFile );
@@ -43,6 +43,7 @@
 #include "wine/list.h"
 #include "wine/debug.h"
 #include "wine/server.h"
+#include "ntdll_misc.h"
 
 WINE_DEFAULT_DEBUG_CHANNEL(heap);
 
@@ -158,6 +159,7 @@ typedef struct tagHEAP
     ARENA_INUSE    **pending_free;  /* Ring buffer for pending free requests */
     RTL_CRITICAL_SECTION critSection; /* Critical section for serialization */
     FREE_LIST_ENTRY *freeList;      /* Free lists */
+    struct tagLFH_HEAP *lfh;        /* Low Fragmentation Heap data, if enabled */
 } HEAP;
 
 #define HEAP_MAGIC       ((DWORD)('H' | ('E'<<8) | ('A'<<16) | ('P'<<24)))
@@ -172,6 +174,94 @@ typedef struct tagHEAP
 #define HEAP_VALIDATE_ALL     0x20000000
 #define HEAP_VALIDATE_PARAMS  0x40000000
 
+/* Low Fragmentation Heap front-end: small blocks are carved out of slabs that
+ * are allocated as normal in-use arenas, and each thread keeps its own lists
+ * of free blocks so that allocating and freeing them doesn't take the heap lock.
+ */
+
+typedef struct
+{
+    WORD   offset;                  /* Offset of the arena from its slab */
+    WORD   data_size;               /* Size of user data */
+    DWORD  magic : 24;              /* Magic number, at the same place as in ARENA_INUSE */
+    DWORD  unused : 8;
+} ARENA_LFH;
+
+C_ASSERT( sizeof(ARENA_LFH) == sizeof(ARENA_INUSE) );
+
+#define ARENA_LFH_MAGIC        0x48464c
+#define ARENA_LFH_FREE_MAGIC   0x46464c
+
+/* Max size of the blocks in each size class */
+static const WORD LFH_classSizes[] =
+{
+    0x10, 0x20, 0x30, 0x40, 0x50, 0x60, 0x70, 0x80, 0xa0, 0xc0, 0xe0, 0x100,
+    0x140, 0x180, 0x1c0, 0x200, 0x280, 0x300, 0x380, 0x400
+};
+#define LFH_NB_CLASSES  (sizeof(LFH_classSizes)/sizeof(LFH_classSizes[0]))
+#define LFH_MAX_SIZE    0x400
+
+#define LFH_SLAB_SIZE    0x4000     /* size of the arena holding a slab */
+#define LFH_MAX_THREADS  256        /* number of threads that can have their own cache */
+#define LFH_NO_SLOT      (~0u)      /* no thread cache available for the thread */
+
+typedef struct
+{
+    DWORD                 magic;    /* Magic number */
+    DWORD                 class;    /* Size class of the blocks */
+    struct tagHEAP       *heap;     /* Heap owning the slab */
+} LFH_SLAB;
+
+#define LFH_SLAB_MAGIC   ((DWORD)('L' | ('F'<<8) | ('H'<<16) | ('S'<<24)))
+#define LFH_SLAB_HEADER_SIZE  ((sizeof(LFH_SLAB) + ALIGNMENT - 1) & ~(ALIGNMENT - 1))
+
+/* singly-linked list of free blocks, the link is stored in the block data */
+typedef struct
+{
+    void                 *head;
+    unsigned int          count;
+} LFH_BLOCK_LIST;
+
+typedef struct
+{
+    LFH_BLOCK_LIST        bins[LFH_NB_CLASSES];
+} LFH_THREAD_CACHE;
+
+/* directory of the slabs, indexed by the LFH_SLAB_SIZE granules they overlap */
+typedef struct
+{
+    ULONG_PTR             granule;  /* address >> LFH_GRANULE_SHIFT, 0 if the entry is free */
+    LFH_SLAB             *slab;
+} LFH_SLAB_ENTRY;
+
+typedef struct
+{
+    unsigned int          size;     /* number of entries, a power of two */
+    unsigned int          count;    /* number of entries in use */
+    LFH_SLAB_ENTRY        entries[1];
+} LFH_SLAB_TABLE;
+
+#define LFH_GRANULE_SHIFT     14    /* log2 of LFH_SLAB_SIZE */
+#define LFH_MIN_SLAB_ENTRIES  64
+
+C_ASSERT( LFH_SLAB_SIZE == 1 << LFH_GRANULE_SHIFT );
+
+typedef struct tagLFH_HEAP
+{
+    LFH_BLOCK_LIST        classes[LFH_NB_CLASSES];  /* shared free lists, protected by the heap lock */
+    LFH_THREAD_CACHE     *caches[LFH_MAX_THREADS];  /* per-thread caches, indexed by thread slot */
+    LFH_SLAB_TABLE * volatile slabs;                /* slab directory, read without the heap lock */
+} LFH_HEAP;
+
+/* heap flags that require every block to go through the arena code */
+#define HEAP_LFH_INCOMPATIBLE_FLAGS \
+    (HEAP_NO_SERIALIZE | HEAP_TAIL_CHECKING_ENABLED | HEAP_FREE_CHECKING_ENABLED | \
+     HEAP_PAGE_ALLOCS | HEAP_VALIDATE)
+
+static LONG lfh_thread_slots[LFH_MAX_THREADS / 32];  /* bitmap of the slots in use */
+
+static NTSTATUS heap_enable_lfh( HEAP *heap );
+
 static HEAP *processHeap;  /* main process heap */
 
 static BOOL HEAP_IsRealArena( HEAP *heapPtr, DWORD flags, LPCVOID block, BOOL quiet );
@@ -306,6 +396,42 @@ static inline ULONG get_protection_type( DWORD flags )
     return (flags & HEAP_CREATE_ENABLE_EXECUTE) ? PAGE_EXECUTE_READWRITE : PAGE_READWRITE;
 }
 
+static inline unsigned int lfh_hash_granule( ULONG_PTR granule )
+{
+    return (unsigned int)granule * 2654435761u;
+}
+
+/* retrieve the slab of a block if it has been allocated by the LFH */
+/* the pointer is looked up in the slab directory before anything is read from it */
+static inline LFH_SLAB *lfh_get_slab( const HEAP *heap, const void *ptr )
+{
+    ULONG_PTR granule = (ULONG_PTR)ptr >> LFH_GRANULE_SHIFT, key;
+    const LFH_SLAB_TABLE *table;
+    unsigned int i, mask;
+    SIZE_T offset, stride;
+    LFH_SLAB *slab;
+
+    if (!heap->lfh || (ULONG_PTR)ptr % ALIGNMENT) return NULL;
+    if (!(table = heap->lfh->slabs)) return NULL;
+
+    mask = table->size - 1;
+    for (i = lfh_hash_granule( granule ) & mask; (key = table->entries[i].granule); i = (i + 1) & mask)
+    {
+        if (key != granule) continue;
+        slab = table->entries[i].slab;
+        if ((const char *)ptr < (char *)slab + LFH_SLAB_HEADER_SIZE + ARENA_OFFSET + sizeof(ARENA_LFH))
+            continue;
+        if ((const char *)ptr >= (char *)slab + LFH_SLAB_SIZE) continue;
+
+        /* the pointer must be at the start of one of the blocks */
+        stride = LFH_classSizes[slab->class] + ALIGNMENT;
+        offset = (const char *)ptr - ((char *)slab + LFH_SLAB_HEADER_SIZE + ARENA_OFFSET + sizeof(ARENA_LFH));
+        if (offset % stride || offset + stride > LFH_SLAB_SIZE - LFH_SLAB_HEADER_SIZE) return NULL;
+        return slab;
+    }
+    return NULL;
+}
+
 static RTL_CRITICAL_SECTION_DEBUG process_heap_critsect_debug =
 {
     0, 0, NULL,  /* will be set later */
@@ -1321,7 +1447,12 @@ static BOOL HEAP_IsRealArena( HEAP *heapPtr,   /* [in] ptr to the heap */
     {
         const ARENA_INUSE *arena = (const ARENA_INUSE *)block - 1;
 
-        if (!(subheap = HEAP_FindSubHeap( heapPtr, arena )) ||
+        if (lfh_get_slab( heapPtr, block ))
+        {
+            ret = (arena->magic == ARENA_LFH_MAGIC);
+            if (!ret && quiet == NOISY) ERR( "Heap %p: block %p used after free\n", heapPtr, block );
+        }
+        else if (!(subheap = HEAP_FindSubHeap( heapPtr, arena )) ||
             ((const char *)arena < (char *)subheap->base + subheap->headerSize))
         {
             if (!(large_arena = find_large_block( heapPtr, block )))
@@ -1553,6 +1684,9 @@ HANDLE WINAPI RtlCreateHeap( ULONG flags, PVOID addr, SIZE_T totalSize, SIZE_T c
     }
 
     heap_set_debug_flags( subheap->heap );
+
+    /* the process heap uses the low fragmentation front-end by default */
+    if (subheap->heap == processHeap) heap_enable_lfh( processHeap );
     return subheap->heap;
 }
 
@@ -1621,35 +1755,17 @@ HANDLE WINAPI RtlDestroyHeap( HANDLE heap )
 
 
 /***********************************************************************
- *           RtlAllocateHeap   (NTDLL.@)
+ *           heap_allocate
  *
- * Allocate a memory block from a Heap.
- *
- * PARAMS
- *  heap  [I] Heap to allocate block from
- *  flags [I] HEAP_ flags from "winnt.h"
- *  size  [I] Size of the memory block to allocate
- *
- * RETURNS
- *  Success: A pointer to the newly allocated block
- *  Failure: NULL.
- *
- * NOTES
- *  This call does not SetLastError().
+ * Allocate a block from the heap arenas. The flags must include the heap flags.
  */
-PVOID WINAPI RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_T size )
+static void *heap_allocate( HEAP *heapPtr, ULONG flags, SIZE_T size )
 {
     ARENA_FREE *pArena;
     ARENA_INUSE *pInUse;
     SUBHEAP *subheap;
-    HEAP *heapPtr = HEAP_GetPtr( heap );
     SIZE_T rounded_size;
 
-    /* Validate the parameters */
-
-    if (!heapPtr) return NULL;
-    flags &= HEAP_GENERATE_EXCEPTIONS | HEAP_NO_SERIALIZE | HEAP_ZERO_MEMORY;
-    flags |= heapPtr->flags;
     rounded_size = ROUND_SIZE(size) + HEAP_TAIL_EXTRA_SIZE( flags );
     if (rounded_size < size)  /* overflow */
     {
@@ -1662,10 +1778,10 @@ PVOID WINAPI RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_T size )
 
     if (rounded_size >= HEAP_MIN_LARGE_BLOCK_SIZE && (flags & HEAP_GROWABLE))
     {
-        void *ret = allocate_large_block( heap, flags, size );
+        void *ret = allocate_large_block( heapPtr, flags, size );
         if (!(flags & HEAP_NO_SERIALIZE)) RtlLeaveCriticalSection( &heapPtr->critSection );
         if (!ret && (flags & HEAP_GENERATE_EXCEPTIONS)) RtlRaiseStatus( STATUS_NO_MEMORY );
-        TRACE("(%p,%08x,%08lx): returning %p\n", heap, flags, size, ret );
+        TRACE("(%p,%08x,%08lx): returning %p\n", heapPtr, flags, size, ret );
         return ret;
     }
 
@@ -1674,7 +1790,7 @@ PVOID WINAPI RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_T size )
     if (!(pArena = HEAP_FindFreeBlock( heapPtr, rounded_size, &subheap )))
     {
         TRACE("(%p,%08x,%08lx): returning NULL\n",
-                  heap, flags, size  );
+                  heapPtr, flags, size  );
         if (!(flags & HEAP_NO_SERIALIZE)) RtlLeaveCriticalSection( &heapPtr->critSection );
         if (flags & HEAP_GENERATE_EXCEPTIONS) RtlRaiseStatus( STATUS_NO_MEMORY );
         return NULL;
@@ -1703,11 +1819,397 @@ PVOID WINAPI RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_T size )
 
     if (!(flags & HEAP_NO_SERIALIZE)) RtlLeaveCriticalSection( &heapPtr->critSection );
 
-    TRACE("(%p,%08x,%08lx): returning %p\n", heap, flags, size, pInUse + 1 );
+    TRACE("(%p,%08x,%08lx): returning %p\n", heapPtr, flags, size, pInUse + 1 );
     return pInUse + 1;
 }
 
 
+/* size class of a block, size must not be larger than LFH_MAX_SIZE */
+static inline unsigned int lfh_get_class( SIZE_T size )
+{
+    unsigned int i;
+
+    if (size <= 0x80) return size ? (size - 1) / 0x10 : 0;
+    for (i = 8; i < LFH_NB_CLASSES - 1; i++) if (size <= LFH_classSizes[i]) break;
+    return i;
+}
+
+/* number of blocks moved at once between a thread cache and the shared lists */
+static inline unsigned int lfh_get_batch_count( unsigned int class )
+{
+    unsigned int count = 0x800 / LFH_classSizes[class];
+    return count < 4 ? 4 : count;
+}
+
+static inline void *lfh_list_pop( LFH_BLOCK_LIST *list )
+{
+    void *ptr = list->head;
+    list->head = *(void **)ptr;
+    list->count--;
+    return ptr;
+}
+
+static inline void lfh_list_push( LFH_BLOCK_LIST *list, void *ptr )
+{
+    *(void **)ptr = list->head;
+    list->head = ptr;
+    list->count++;
+}
+
+/* move up to count blocks from one list to another */
+static void lfh_list_move( LFH_BLOCK_LIST *dst, LFH_BLOCK_LIST *src, unsigned int count )
+{
+    while (count-- && src->head) lfh_list_push( dst, lfh_list_pop( src ) );
+}
+
+/* flags for the LFH internal allocations; they may be done with the heap lock held
+ * and fall back to the arenas on failure, so they must not raise exceptions */
+static inline ULONG lfh_internal_flags( const HEAP *heap )
+{
+    return heap->flags & ~HEAP_GENERATE_EXCEPTIONS;
+}
+
+/***********************************************************************
+ *           lfh_reserve_slab_entries
+ *
+ * Make sure the slab directory has room for a new slab. Must be called with the heap lock held.
+ */
+static BOOL lfh_reserve_slab_entries( HEAP *heap )
+{
+    LFH_SLAB_TABLE *table = heap->lfh->slabs, *new_table;
+    unsigned int i, j, size;
+
+    /* each slab uses at most two entries, keep the table half empty */
+    if (table && (table->count + 2) * 2 <= table->size) return TRUE;
+
+    size = table ? table->size * 2 : LFH_MIN_SLAB_ENTRIES;
+    if (!(new_table = heap_allocate( heap, lfh_internal_flags( heap ) | HEAP_ZERO_MEMORY,
+                                     FIELD_OFFSET( LFH_SLAB_TABLE, entries[size] ))))
+        return FALSE;
+    new_table->size = size;
+    if (table)
+    {
+        for (i = 0; i < table->size; i++)
+        {
+            if (!table->entries[i].granule) continue;
+            for (j = lfh_hash_granule( table->entries[i].granule ) & (size - 1);
+                 new_table->entries[j].granule; j = (j + 1) & (size - 1)) ;
+            new_table->entries[j] = table->entries[i];
+        }
+        new_table->count = table->count;
+    }
+    /* the old table may still be in use by lock-free lookups, it is freed with the heap */
+    interlocked_xchg_ptr( (void **)&heap->lfh->slabs, new_table );
+    return TRUE;
+}
+
+/***********************************************************************
+ *           lfh_add_slab_entry
+ *
+ * Add a granule of a slab to the slab directory. Must be called with the heap lock held.
+ */
+static void lfh_add_slab_entry( HEAP *heap, LFH_SLAB *slab, ULONG_PTR granule )
+{
+    LFH_SLAB_TABLE *table = heap->lfh->slabs;
+    unsigned int i, mask = table->size - 1;
+
+    for (i = lfh_hash_granule( granule ) & mask; table->entries[i].granule; i = (i + 1) & mask) ;
+    table->entries[i].slab = slab;
+    /* publish the entry once it is complete */
+    interlocked_xchg_ptr( (void **)&table->entries[i].granule, (void *)granule );
+    table->count++;
+}
+
+/***********************************************************************
+ *           lfh_create_slab
+ *
+ * Carve a new slab into free blocks. Must be called with the heap lock held.
+ */
+static BOOL lfh_create_slab( HEAP *heap, unsigned int class )
+{
+    SIZE_T stride = LFH_classSizes[class] + ALIGNMENT;
+    LFH_BLOCK_LIST *list = &heap->lfh->classes[class];
+    ULONG_PTR first, last;
+    LFH_SLAB *slab;
+    char *ptr, *end;
+
+    if (!lfh_reserve_slab_entries( heap )) return FALSE;
+    if (!(slab = heap_allocate( heap, lfh_internal_flags( heap ), LFH_SLAB_SIZE ))) return FALSE;
+    slab->magic = LFH_SLAB_MAGIC;
+    slab->class = class;
+    slab->heap  = heap;
+
+    /* each block is preceded by its arena, so that the data is aligned */
+    end = (char *)slab + LFH_SLAB_SIZE - stride;
+    for (ptr = (char *)slab + LFH_SLAB_HEADER_SIZE; ptr <= end; ptr += stride)
+    {
+        ARENA_LFH *arena = (ARENA_LFH *)(ptr + ARENA_OFFSET);
+
+        arena->offset    = (char *)arena - (char *)slab;
+        arena->data_size = 0;
+        arena->magic     = ARENA_LFH_FREE_MAGIC;
+        arena->unused    = 0;
+        lfh_list_push( list, arena + 1 );
+    }
+
+    first = (ULONG_PTR)slab >> LFH_GRANULE_SHIFT;
+    last = ((ULONG_PTR)slab + LFH_SLAB_SIZE - 1) >> LFH_GRANULE_SHIFT;
+    lfh_add_slab_entry( heap, slab, first );
+    if (last != first) lfh_add_slab_entry( heap, slab, last );
+    TRACE( "heap %p: new slab %p for blocks of %u bytes\n", heap, slab, LFH_classSizes[class] );
+    return TRUE;
+}
+
+static unsigned int lfh_alloc_thread_slot(void)
+{
+    unsigned int i, bit;
+    LONG mask;
+
+    for (i = 0; i < LFH_MAX_THREADS / 32; i++)
+    {
+        while ((ULONG)(mask = lfh_thread_slots[i]) != ~0u)
+        {
+            for (bit = 0; mask & (1u << bit); bit++) ;
+            if (interlocked_cmpxchg( &lfh_thread_slots[i], mask | (1u << bit), mask ) == mask)
+                return i * 32 + bit + 1;
+        }
+    }
+    WARN( "no thread cache slot left\n" );
+    return LFH_NO_SLOT;
+}
+
+/***********************************************************************
+ *           lfh_get_thread_cache
+ *
+ * Get the cache of the current thread for a heap, creating it if needed.
+ */
+static LFH_THREAD_CACHE *lfh_get_thread_cache( HEAP *heap )
+{
+    struct ntdll_thread_data_ext *ext = ntdll_get_thread_data_ext();
+    unsigned int slot = ext->heap_slot;
+    LFH_THREAD_CACHE *cache;
+
+    if (!slot) slot = ext->heap_slot = lfh_alloc_thread_slot();
+    if (slot == LFH_NO_SLOT) return NULL;
+
+    /* only the owner of the slot ever accesses the cache */
+    if (!(cache = heap->lfh->caches[slot - 1]))
+    {
+        cache = heap_allocate( heap, lfh_internal_flags( heap ) | HEAP_ZERO_MEMORY, sizeof(*cache) );
+        heap->lfh->caches[slot - 1] = cache;
+    }
+    return cache;
+}
+
+/***********************************************************************
+ *           lfh_allocate
+ *
+ * Allocate a small block from the LFH, returns NULL to fall back to the arenas.
+ */
+static void *lfh_allocate( HEAP *heap, ULONG flags, SIZE_T size )
+{
+    unsigned int class = lfh_get_class( size );
+    LFH_THREAD_CACHE *cache;
+    LFH_BLOCK_LIST *bin;
+    ARENA_LFH *arena;
+    void *ptr;
+
+    if (!(cache = lfh_get_thread_cache( heap ))) return NULL;
+
+    bin = &cache->bins[class];
+    if (!bin->head)
+    {
+        LFH_BLOCK_LIST *list = &heap->lfh->classes[class];
+
+        RtlEnterCriticalSection( &heap->critSection );
+        if (list->head || lfh_create_slab( heap, class ))
+            lfh_list_move( bin, list, lfh_get_batch_count( class ) );
+        RtlLeaveCriticalSection( &heap->critSection );
+        if (!bin->head) return NULL;
+    }
+
+    ptr = lfh_list_pop( bin );
+    arena = (ARENA_LFH *)ptr - 1;
+    arena->magic     = ARENA_LFH_MAGIC;
+    arena->data_size = size;
+    if (flags & HEAP_ZERO_MEMORY) memset( ptr, 0, size );
+    return ptr;
+}
+
+/***********************************************************************
+ *           lfh_free
+ */
+static BOOL lfh_free( HEAP *heap, const LFH_SLAB *slab, void *ptr )
+{
+    ARENA_LFH *arena = (ARENA_LFH *)ptr - 1;
+    unsigned int class = slab->class;
+    LFH_THREAD_CACHE *cache;
+    LFH_BLOCK_LIST *bin;
+
+    if (arena->magic != ARENA_LFH_MAGIC)
+    {
+        WARN( "Heap %p: block %p used after free\n", heap, ptr );
+        return FALSE;
+    }
+    arena->magic = ARENA_LFH_FREE_MAGIC;
+
+    if (!(cache = lfh_get_thread_cache( heap )))
+    {
+        RtlEnterCriticalSection( &heap->critSection );
+        lfh_list_push( &heap->lfh->classes[class], ptr );
+        RtlLeaveCriticalSection( &heap->critSection );
+        return TRUE;
+    }
+
+    bin = &cache->bins[class];
+    lfh_list_push( bin, ptr );
+    if (bin->count > 2 * lfh_get_batch_count( class ))
+    {
+        /* give some blocks back for the other threads to use */
+        RtlEnterCriticalSection( &heap->critSection );
+        lfh_list_move( &heap->lfh->classes[class], bin, lfh_get_batch_count( class ) );
+        RtlLeaveCriticalSection( &heap->critSection );
+    }
+    return TRUE;
+}
+
+/***********************************************************************
+ *           lfh_reallocate
+ */
+static void *lfh_reallocate( HEAP *heap, ULONG flags, const LFH_SLAB *slab, void *ptr, SIZE_T size )
+{
+    ARENA_LFH *arena = (ARENA_LFH *)ptr - 1;
+    SIZE_T old_size = arena->data_size;
+    void *ret;
+
+    if (arena->magic != ARENA_LFH_MAGIC)
+    {
+        WARN( "Heap %p: block %p used after free\n", heap, ptr );
+        RtlSetLastWin32ErrorAndNtStatusFromNtStatus( STATUS_INVALID_PARAMETER );
+        return NULL;
+    }
+
+    /* resize in place as long as the block stays in the same size class */
+    if (size <= LFH_classSizes[slab->class] &&
+        ((flags & HEAP_REALLOC_IN_PLACE_ONLY) || lfh_get_class( size ) == slab->class))
+    {
+        if (size > old_size && (flags & HEAP_ZERO_MEMORY))
+            memset( (char *)ptr + old_size, 0, size - old_size );
+        arena->data_size = size;
+        return ptr;
+    }
+    if (flags & HEAP_REALLOC_IN_PLACE_ONLY) goto oom;
+
+    if (!(ret = RtlAllocateHeap( heap, flags & (HEAP_NO_SERIALIZE | HEAP_ZERO_MEMORY), size ))) goto oom;
+    memcpy( ret, ptr, old_size < size ? old_size : size );
+    lfh_free( heap, slab, ptr );
+    return ret;
+
+oom:
+    if (flags & HEAP_GENERATE_EXCEPTIONS) RtlRaiseStatus( STATUS_NO_MEMORY );
+    RtlSetLastWin32ErrorAndNtStatusFromNtStatus( STATUS_NO_MEMORY );
+    return NULL;
+}
+
+/* give the blocks cached by a thread back to the heap */
+static void lfh_flush_thread_cache( HEAP *heap, unsigned int slot )
+{
+    LFH_THREAD_CACHE *cache;
+    unsigned int i;
+
+    if (!heap->lfh || !(cache = heap->lfh->caches[slot])) return;
+
+    RtlEnterCriticalSection( &heap->critSection );
+    for (i = 0; i < LFH_NB_CLASSES; i++)
+        lfh_list_move( &heap->lfh->classes[i], &cache->bins[i], ~0u );
+    RtlLeaveCriticalSection( &heap->critSection );
+}
+
+/***********************************************************************
+ *           heap_enable_lfh
+ */
+static NTSTATUS heap_enable_lfh( HEAP *heap )
+{
+    LFH_HEAP *lfh;
+
+    if (heap->lfh) return STATUS_SUCCESS;
+    if (!(heap->flags & HEAP_GROWABLE) || (heap->flags & HEAP_LFH_INCOMPATIBLE_FLAGS) || RUNNING_ON_VALGRIND)
+        return STATUS_UNSUCCESSFUL;
+
+    if (!(lfh = heap_allocate( heap, lfh_internal_flags( heap ) | HEAP_ZERO_MEMORY, sizeof(*lfh) )))
+        return STATUS_NO_MEMORY;
+    if (interlocked_cmpxchg_ptr( (void **)&heap->lfh, lfh, NULL ))
+        RtlFreeHeap( heap, 0, lfh );  /* somebody beat us to it */
+
+    TRACE( "enabled LFH for heap %p\n", heap );
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *           heap_thread_detach
+ *
+ * Release the LFH caches of the current thread, called on thread exit.
+ */
+void heap_thread_detach(void)
+{
+    struct ntdll_thread_data_ext *ext = ntdll_get_thread_data_ext();
+    unsigned int slot = ext->heap_slot;
+    HEAP *heap;
+    LONG mask;
+
+    if (!slot || slot == LFH_NO_SLOT) return;
+    ext->heap_slot = LFH_NO_SLOT;
+    slot--;
+
+    RtlEnterCriticalSection( &processHeap->critSection );
+    lfh_flush_thread_cache( processHeap, slot );
+    LIST_FOR_EACH_ENTRY( heap, &processHeap->entry, HEAP, entry )
+        lfh_flush_thread_cache( heap, slot );
+    RtlLeaveCriticalSection( &processHeap->critSection );
+
+    do mask = lfh_thread_slots[slot / 32];
+    while (interlocked_cmpxchg( &lfh_thread_slots[slot / 32], mask & ~(1u << (slot % 32)), mask ) != mask);
+}
+
+
+/***********************************************************************
+ *           RtlAllocateHeap   (NTDLL.@)
+ *
+ * Allocate a memory block from a Heap.
+ *
+ * PARAMS
+ *  heap  [I] Heap to allocate block from
+ *  flags [I] HEAP_ flags from "winnt.h"
+ *  size  [I] Size of the memory block to allocate
+ *
+ * RETURNS
+ *  Success: A pointer to the newly allocated block
+ *  Failure: NULL.
+ *
+ * NOTES
+ *  This call does not SetLastError().
+ */
+PVOID WINAPI RtlAllocateHeap( HANDLE heap, ULONG flags, SIZE_T size )
+{
+    HEAP *heapPtr = HEAP_GetPtr( heap );
+    void *ret;
+
+    /* Validate the parameters */
+
+    if (!heapPtr) return NULL;
+    flags &= HEAP_GENERATE_EXCEPTIONS | HEAP_NO_SERIALIZE | HEAP_ZERO_MEMORY;
+    flags |= heapPtr->flags;
+
+    if (heapPtr->lfh && size <= LFH_MAX_SIZE && !(heapPtr->flags & HEAP_LFH_INCOMPATIBLE_FLAGS) &&
+        (ret = lfh_allocate( heapPtr, flags, size )))
+    {
+        TRACE("(%p,%08x,%08lx): returning %p\n", heap, flags, size, ret );
+        return ret;
+    }
+    return heap_allocate( heapPtr, flags, size );
+}
+
+
 /***********************************************************************
  *           RtlFreeHeap   (NTDLL.@)
  *
@@ -1726,6 +2228,7 @@ BOOLEAN WINAPI RtlFreeHeap( HANDLE heap, ULONG flags, PVOID ptr )
 {
     ARENA_INUSE *pInUse;
     SUBHEAP *subheap;
+    LFH_SLAB *slab;
     HEAP *heapPtr;
 
     /* Validate the parameters */
@@ -1741,6 +2244,19 @@ BOOLEAN WINAPI RtlFreeHeap( HANDLE heap, ULONG flags, PVOID ptr )
 
     flags &= HEAP_NO_SERIALIZE;
     flags |= heapPtr->flags;
+
+    if ((slab = lfh_get_slab( heapPtr, ptr )))
+    {
+        if (!lfh_free( heapPtr, slab, ptr ))
+        {
+            RtlSetLastWin32ErrorAndNtStatusFromNtStatus( STATUS_INVALID_PARAMETER );
+            TRACE("(%p,%08x,%p): returning FALSE\n", heap, flags, ptr );
+            return FALSE;
+        }
+        TRACE("(%p,%08x,%p): returning TRUE\n", heap, flags, ptr );
+        return TRUE;
+    }
+
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
     /* Inform valgrind we are trying to free memory, so it can throw up an error message */
@@ -1787,6 +2303,7 @@ PVOID WINAPI RtlReAllocateHeap( HANDLE heap, ULONG flags, PVOID ptr, SIZE_T size
     ARENA_INUSE *pArena;
     HEAP *heapPtr;
     SUBHEAP *subheap;
+    LFH_SLAB *slab;
     SIZE_T oldBlockSize, oldActualSize, rounded_size;
     void *ret;
 
@@ -1802,6 +2319,14 @@ PVOID WINAPI RtlReAllocateHeap( HANDLE heap, ULONG flags, PVOID ptr, SIZE_T size
     flags &= HEAP_GENERATE_EXCEPTIONS | HEAP_NO_SERIALIZE | HEAP_ZERO_MEMORY |
              HEAP_REALLOC_IN_PLACE_ONLY;
     flags |= heapPtr->flags;
+
+    if ((slab = lfh_get_slab( heapPtr, ptr )))
+    {
+        ret = lfh_reallocate( heapPtr, flags, slab, ptr, size );
+        TRACE("(%p,%08x,%p,%08lx): returning %p\n", heap, flags, ptr, size, ret );
+        return ret;
+    }
+
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
     rounded_size = ROUND_SIZE(size) + HEAP_TAIL_EXTRA_SIZE(flags);
@@ -2018,6 +2543,21 @@ SIZE_T WINAPI RtlSizeHeap( HANDLE heap, ULONG flags, const void *ptr )
     }
     flags &= HEAP_NO_SERIALIZE;
     flags |= heapPtr->flags;
+
+    if (lfh_get_slab( heapPtr, ptr ))
+    {
+        const ARENA_LFH *lfh_arena = (const ARENA_LFH *)ptr - 1;
+
+        if (lfh_arena->magic == ARENA_LFH_MAGIC) ret = lfh_arena->data_size;
+        else
+        {
+            RtlSetLastWin32ErrorAndNtStatusFromNtStatus( STATUS_INVALID_PARAMETER );
+            ret = ~0UL;
+        }
+        TRACE("(%p,%08x,%p): returning %08lx\n", heap, flags, ptr, ret );
+        return ret;
+    }
+
     if (!(flags & HEAP_NO_SERIALIZE)) RtlEnterCriticalSection( &heapPtr->critSection );
 
     pArena = (const ARENA_INUSE *)ptr - 1;
@@ -2228,6 +2768,8 @@ ULONG WINAPI RtlGetProcessHeaps( ULONG count, HANDLE *heaps )
 NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS info_class,
                                          PVOID info, SIZE_T size_in, PSIZE_T size_out)
 {
+    HEAP *heapPtr;
+
     switch (info_class)
     {
     case HeapCompatibilityInformation:
@@ -2236,7 +2778,9 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS inf
         if (size_in < sizeof(ULONG))
             return STATUS_BUFFER_TOO_SMALL;
 
-        *(ULONG *)info = 0; /* standard heap */
+        if (!(heapPtr = HEAP_GetPtr( heap ))) return STATUS_INVALID_HANDLE;
+
+        *(ULONG *)info = heapPtr->lfh ? 2 /* low fragmentation heap */ : 0 /* standard heap */;
         return STATUS_SUCCESS;
 
     default:
@@ -2244,3 +2788,39 @@ NTSTATUS WINAPI RtlQueryHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS inf
         return STATUS_INVALID_INFO_CLASS;
     }
 }
+
+/***********************************************************************
+ *           RtlSetHeapInformation    (NTDLL.@)
+ */
+NTSTATUS WINAPI RtlSetHeapInformation( HANDLE heap, HEAP_INFORMATION_CLASS info_class,
+                                       PVOID info, SIZE_T size )
+{
+    HEAP *heapPtr;
+
+    TRACE( "%p %u %p %lu\n", heap, info_class, info, size );
+
+    switch (info_class)
+    {
+    case HeapCompatibilityInformation:
+        if (size < sizeof(ULONG))
+            return STATUS_BUFFER_TOO_SMALL;
+
+        if (!(heapPtr = HEAP_GetPtr( heap ))) return STATUS_INVALID_HANDLE;
+
+        switch (*(ULONG *)info)
+        {
+        case 0:  /* standard heap, the LFH can't be disabled once enabled */
+            return heapPtr->lfh ? STATUS_UNSUCCESSFUL : STATUS_SUCCESS;
+        case 1:  /* look-aside lists, not supported since Vista either */
+            return STATUS_UNSUCCESSFUL;
+        case 2:
+            return heap_enable_lfh( heapPtr );
+        default:
+            return STATUS_INVALID_PARAMETER;
+        }
+
+    default:
+        FIXME("Unknown heap information class %u\n", info_class);
+        return STATUS_INVALID_INFO_CLASS;
+    }
+}
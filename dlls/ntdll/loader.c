@@ -78,8 +78,13 @@ typedef struct _wine_modref
     LDR_MODULE            ldr;
     int                   nDeps;
     struct _wine_modref **deps;
+    DWORD                *export_hash;      /* hash index of the exported names */
+    DWORD                 export_hash_mask; /* size of the index minus one */
 } WINE_MODREF;
 
+/* modules with fewer exported names are simply searched with a binary search */
+#define MIN_EXPORT_HASH_NAMES 64
+
 /* info about the current builtin dll load */
 /* used to keep track of things across the register_dll constructor call */
 struct builtin_load_info
@@ -115,7 +120,7 @@ static NTSTATUS load_dll( LPCWSTR load_path, LPCWSTR libname, DWORD flags, WINE_
 static NTSTATUS process_attach( WINE_MODREF *wm, LPVOID lpReserved );
 static FARPROC find_ordinal_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *exports,
                                     DWORD exp_size, DWORD ordinal, LPCWSTR load_path );
-static FARPROC find_named_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *exports,
+static FARPROC find_named_export( WINE_MODREF *wm, const IMAGE_EXPORT_DIRECTORY *exports,
                                   DWORD exp_size, const char *name, int hint, LPCWSTR load_path );
 
 /* convert PE image VirtualAddress to Real Address */
@@ -407,7 +412,7 @@ static FARPROC find_forwarded_export( HMODULE module, const char *forward, LPCWS
         if (*name == '#')  /* ordinal */
             proc = find_ordinal_export( wm->ldr.BaseAddress, exports, exp_size, atoi(name+1), load_path );
         else
-            proc = find_named_export( wm->ldr.BaseAddress, exports, exp_size, name, -1, load_path );
+            proc = find_named_export( wm, exports, exp_size, name, -1, load_path );
     }
 
     if (!proc)
@@ -462,15 +467,55 @@ static FARPROC find_ordinal_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY
 }
 
 
+/* hash function for exported names */
+static inline DWORD hash_export_name( const char *name )
+{
+    DWORD hash = 0x811c9dc5;
+    while (*name) hash = (hash ^ (unsigned char)*name++) * 0x01000193;
+    return hash;
+}
+
+/*************************************************************************
+ *		build_export_hash
+ *
+ * Build the hash index of the exported names of a module.
+ * The loader_section must be locked while calling this function.
+ */
+static BOOL build_export_hash( WINE_MODREF *wm, const IMAGE_EXPORT_DIRECTORY *exports )
+{
+    HMODULE module = wm->ldr.BaseAddress;
+    const DWORD *names = get_rva( module, exports->AddressOfNames );
+    DWORD i, pos, mask;
+
+    /* keep the index at most half full */
+    for (mask = 127; mask < 2 * exports->NumberOfNames; mask = mask * 2 + 1) ;
+    if (!(wm->export_hash = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY,
+                                             (mask + 1) * sizeof(DWORD) )))
+        return FALSE;
+    wm->export_hash_mask = mask;
+
+    for (i = 0; i < exports->NumberOfNames; i++)
+    {
+        pos = hash_export_name( get_rva( module, names[i] )) & mask;
+        while (wm->export_hash[pos]) pos = (pos + 1) & mask;
+        wm->export_hash[pos] = i + 1;
+    }
+    TRACE( "%s: %u names, %u buckets\n", debugstr_w(wm->ldr.BaseDllName.Buffer),
+           exports->NumberOfNames, mask + 1 );
+    return TRUE;
+}
+
+
 /*************************************************************************
  *		find_named_export
  *
  * Find an exported function by name.
  * The loader_section must be locked while calling this function.
  */
-static FARPROC find_named_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *exports,
+static FARPROC find_named_export( WINE_MODREF *wm, const IMAGE_EXPORT_DIRECTORY *exports,
                                   DWORD exp_size, const char *name, int hint, LPCWSTR load_path )
 {
+    HMODULE module = wm->ldr.BaseAddress;
     const WORD *ordinals = get_rva( module, exports->AddressOfNameOrdinals );
     const DWORD *names = get_rva( module, exports->AddressOfNames );
     int min = 0, max = exports->NumberOfNames - 1;
@@ -483,7 +528,23 @@ static FARPROC find_named_export( HMODULE module, const IMAGE_EXPORT_DIRECTORY *
             return find_ordinal_export( module, exports, exp_size, ordinals[hint], load_path );
     }
 
-    /* then do a binary search */
+    /* then look it up in the hash index */
+    if (wm->export_hash || (exports->NumberOfNames >= MIN_EXPORT_HASH_NAMES &&
+                            build_export_hash( wm, exports )))
+    {
+        DWORD idx, pos = hash_export_name( name ) & wm->export_hash_mask;
+
+        while ((idx = wm->export_hash[pos]))
+        {
+            char *ename = get_rva( module, names[idx - 1] );
+            if (!strcmp( ename, name ))
+                return find_ordinal_export( module, exports, exp_size, ordinals[idx - 1], load_path );
+            pos = (pos + 1) & wm->export_hash_mask;
+        }
+        return NULL;
+    }
+
+    /* else do a binary search */
     while (min <= max)
     {
         int res, pos = (min + max) / 2;
@@ -613,7 +674,7 @@ static WINE_MODREF *import_dll( HMODULE module, const IMAGE_IMPORT_DESCRIPTOR *d
         {
             IMAGE_IMPORT_BY_NAME *pe_name;
             pe_name = get_rva( module, (DWORD)import_list->u1.AddressOfData );
-            thunk_list->u1.Function = (ULONG_PTR)find_named_export( imp_mod, exports, exp_size,
+            thunk_list->u1.Function = (ULONG_PTR)find_named_export( wmImp, exports, exp_size,
                                                                     (const char*)pe_name->Name,
                                                                     pe_name->Hint, load_path );
             if (!thunk_list->u1.Function)
@@ -769,6 +830,8 @@ static WINE_MODREF *alloc_module( HMODULE hModule, LPCWSTR filename )
 
     wm->nDeps    = 0;
     wm->deps     = NULL;
+    wm->export_hash = NULL;
+    wm->export_hash_mask = 0;
 
     wm->ldr.BaseAddress   = hModule;
     wm->ldr.EntryPoint    = NULL;
@@ -1292,16 +1355,17 @@ NTSTATUS WINAPI LdrGetProcedureAddress(HMODULE module, const ANSI_STRING *name,
     IMAGE_EXPORT_DIRECTORY *exports;
     DWORD exp_size;
     NTSTATUS ret = STATUS_PROCEDURE_NOT_FOUND;
+    WINE_MODREF *wm;
 
     RtlEnterCriticalSection( &loader_section );
 
     /* check if the module itself is invalid to return the proper error */
-    if (!get_modref( module )) ret = STATUS_DLL_NOT_FOUND;
+    if (!(wm = get_modref( module ))) ret = STATUS_DLL_NOT_FOUND;
     else if ((exports = RtlImageDirectoryEntryToData( module, TRUE,
                                                       IMAGE_DIRECTORY_ENTRY_EXPORT, &exp_size )))
     {
         LPCWSTR load_path = NtCurrentTeb()->Peb->ProcessParameters->DllPath.Buffer;
-        void *proc = name ? find_named_export( module, exports, exp_size, name->Buffer, -1, load_path )
+        void *proc = name ? find_named_export( wm, exports, exp_size, name->Buffer, -1, load_path )
                           : find_ordinal_export( module, exports, exp_size, ord - exports->Base, load_path );
         if (proc)
         {
@@ -2382,6 +2446,7 @@ static void free_modref( WINE_MODREF *wm )
     if (cached_modref == wm) cached_modref = NULL;
     RtlFreeUnicodeString( &wm->ldr.FullDllName );
     RtlFreeHeap( GetProcessHeap(), 0, wm->deps );
+    RtlFreeHeap( GetProcessHeap(), 0, wm->export_hash );
     RtlFreeHeap( GetProcessHeap(), 0, wm );
 }
 
@@ -71,6 +71,7 @@ extern void virtual_init(void);
 extern void virtual_init_threading(void);
 extern void fill_cpu_info(void);
 extern void heap_set_debug_flags( HANDLE handle );
+extern void heap_thread_detach(void);
 
 /* server support */
 extern timeout_t server_start_time;
@@ -91,6 +92,16 @@ extern int server_remove_fd_from_cache( HANDLE handle );
 extern int server_get_unix_fd( HANDLE handle, unsigned int access, int *unix_fd,
                                int *needs_close, enum server_fd_type *type, unsigned int *options );
 extern int server_pipe( int fd[2] );
+extern void server_init_request_shm(void);
+extern void server_free_request_shm(void);
+extern void server_init_sync_shm(void);
+extern struct sync_shm_entry *sync_shm_entries;
+extern void sync_shm_remove_handle( HANDLE handle );
+
+/* I/O reactor */
+extern void reactor_set_completion( HANDLE handle, HANDLE port, ULONG_PTR key );
+extern unsigned int reactor_cancel_async( HANDLE handle, BOOL only_thread, IO_STATUS_BLOCK *iosb,
+                                          BOOL close_handle );
 
 /* security descriptors */
 NTSTATUS NTDLL_create_struct_sd(PSECURITY_DESCRIPTOR nt_sd, struct security_descriptor **server_sd,
@@ -230,6 +241,67 @@ static inline struct ntdll_thread_data *ntdll_get_thread_data(void)
     return (struct ntdll_thread_data *)NtCurrentTeb()->SpareBytes1;
 }
 
+/* thread private data that doesn't fit in the above, stored in teb->GdiTebBatch after the vm86 data */
+struct ntdll_thread_data_ext
+{
+    WINE_VM86_TEB_INFO  vm86;         /* reserved for vm86 mode */
+    struct request_shm *request_shm;  /* shared memory area for server replies */
+    struct threadpool_worker *tp_worker; /* thread pool worker running on this thread */
+    unsigned int        heap_slot;    /* slot of the heap thread caches, plus one */
+};
+
+static inline struct ntdll_thread_data_ext *ntdll_get_thread_data_ext(void)
+{
+    return (struct ntdll_thread_data_ext *)&NtCurrentTeb()->GdiTebBatch;
+}
+
+/* futex support */
+
+#if defined(linux) && (defined(__i386__) || defined(__x86_64__))
+
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __i386__
+#define NTDLL_SYS_futex 240
+#else
+#define NTDLL_SYS_futex 202
+#endif
+
+static inline int futex_wait( int *addr, int val, struct timespec *timeout )
+{
+    int ret = syscall( NTDLL_SYS_futex, addr, 0/*FUTEX_WAIT*/, val, timeout, 0, 0 );
+    if (ret < 0)
+        return -errno;
+    return ret;
+}
+
+static inline int futex_wake( int *addr, int val )
+{
+    int ret = syscall( NTDLL_SYS_futex, addr, 1/*FUTEX_WAKE*/, val, NULL, 0, 0 );
+    if (ret < 0)
+        return -errno;
+    return ret;
+}
+
+static inline int use_futexes(void)
+{
+    static int supported = -1;
+
+    if (supported == -1) supported = (futex_wait( &supported, 10, NULL ) != -ENOSYS);
+    return supported;
+}
+
+#else  /* linux */
+
+static inline int use_futexes(void)
+{
+    return 0;
+}
+
+#endif  /* linux */
+
 /* Register functions */
 
 #ifdef __i386__
@@ -338,6 +338,8 @@ NTSTATUS WINAPI NtDuplicateObject( HANDLE source_process, HANDLE source,
                 {
                     int fd = server_remove_fd_from_cache( source );
                     if (fd != -1) close( fd );
+                    sync_shm_remove_handle( source );
+                    reactor_cancel_async( source, FALSE, NULL, TRUE );
                 }
             }
             else if (options & DUPLICATE_CLOSE_SOURCE)
@@ -363,7 +365,12 @@ NTSTATUS WINAPI NtDuplicateObject( HANDLE source_process, HANDLE source,
 NTSTATUS WINAPI NtClose( HANDLE Handle )
 {
     NTSTATUS ret;
-    int fd = server_remove_fd_from_cache( Handle );
+    int fd;
+
+    /* complete the reactor asyncs while the handle is still valid */
+    reactor_cancel_async( Handle, FALSE, NULL, TRUE );
+    fd = server_remove_fd_from_cache( Handle );
+    sync_shm_remove_handle( Handle );
 
     SERVER_START_REQ( close_handle )
     {
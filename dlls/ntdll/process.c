@@ -39,6 +39,30 @@ WINE_DEFAULT_DEBUG_CHANNEL(ntdll);
 
 static ULONG execute_flags = MEM_EXECUTE_OPTION_DISABLE;
 
+/* fill the memory counters of the current process */
+static void fill_VM_COUNTERS( VM_COUNTERS *pvmi )
+{
+#ifdef linux
+    unsigned long value;
+    char line[256];
+    FILE *f;
+
+    if (!(f = fopen( "/proc/self/status", "r" ))) return;
+    while (fgets( line, sizeof(line), f ))
+    {
+        if (sscanf( line, "VmPeak: %lu", &value ) == 1)
+            pvmi->PeakVirtualSize = (SIZE_T)value * 1024;
+        else if (sscanf( line, "VmSize: %lu", &value ) == 1)
+            pvmi->VirtualSize = (SIZE_T)value * 1024;
+        else if (sscanf( line, "VmHWM: %lu", &value ) == 1)
+            pvmi->PeakWorkingSetSize = (SIZE_T)value * 1024;
+        else if (sscanf( line, "VmRSS: %lu", &value ) == 1)
+            pvmi->WorkingSetSize = (SIZE_T)value * 1024;
+    }
+    fclose( f );
+#endif
+}
+
 /*
  *	Process object
  */
@@ -230,8 +254,9 @@ NTSTATUS WINAPI NtQueryInformationProcess(
                     ret = STATUS_INVALID_HANDLE;
                 else
                 {
-                    /* FIXME : real data */
+                    /* FIXME : real data for other processes */
                     memset(&pvmi, 0 , sizeof(VM_COUNTERS));
+                    if (ProcessHandle == GetCurrentProcess()) fill_VM_COUNTERS(&pvmi);
 
                     len = ProcessInformationLength;
                     if (len != FIELD_OFFSET(VM_COUNTERS,PrivatePageCount)) len = sizeof(VM_COUNTERS);
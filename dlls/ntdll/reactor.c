@@ -0,0 +1,494 @@
+/*
+ * Client-side I/O reactor for overlapped socket operations
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * Overlapped operations on handles bound to an I/O completion port are
+ * normally queued in the server, which polls the fd and sends an APC back
+ * to the client once it is ready. For servers with many connections that
+ * costs several round-trips per operation, so handles bound to a port can
+ * instead be watched by a per-process epoll thread that runs the async
+ * callbacks itself and posts the completions. The server is then only
+ * involved to validate the handle and to queue the completion packet.
+ *
+ * The completions are posted through a private handle to the port, so that
+ * they still reach it when the file handle is closed while a callback runs.
+ * Entries are keyed by handle value, so the watched fd is checked against
+ * the object the handle refers to before each operation is queued.
+ */
+
+#include "config.h"
+#include "wine/port.h"
+
+#include <assert.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <string.h>
+#ifdef HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+# include <sys/stat.h>
+#endif
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#define NONAMELESSUNION
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winternl.h"
+#include "wine/server.h"
+#include "wine/list.h"
+#include "wine/debug.h"
+#include "ntdll_misc.h"
+
+WINE_DEFAULT_DEBUG_CHANNEL(ntdll);
+
+#if defined(HAVE_SYS_EPOLL_H) && defined(HAVE_EPOLL_CREATE)
+
+#define REACTOR_HASH_SIZE  64
+
+struct reactor_async
+{
+    struct list   entry;      /* entry in the fd queue */
+    async_data_t  data;       /* async parameters, as passed to register_async */
+    HANDLE        thread;     /* ClientId.UniqueThread of the thread that queued the async */
+};
+
+struct reactor_fd
+{
+    struct list   entry;      /* entry in the hash table */
+    unsigned int  refcount;   /* references from the hash table and the running callbacks */
+    unsigned int  serial;     /* serial number to tell apart the fds of a reused handle value */
+    BOOL          closed;     /* removed from the hash table, the handle may be gone */
+    HANDLE        handle;     /* handle bound to a completion port */
+    HANDLE        port;       /* private handle to the completion port */
+    ULONG_PTR     key;        /* completion key */
+    int           unix_fd;    /* private copy of the unix fd, -1 until first used */
+    dev_t         dev;        /* device and inode of the unix fd, to detect a reused handle */
+    ino_t         ino;
+    struct list   queue[2];   /* pending read and write asyncs */
+};
+
+static struct list reactor_hash[REACTOR_HASH_SIZE];
+static unsigned int reactor_fd_count;  /* number of handles in the hash table */
+static unsigned int reactor_serial;
+static int reactor_epoll = -1;
+
+static RTL_CRITICAL_SECTION reactor_section;
+static RTL_CRITICAL_SECTION_DEBUG critsect_debug =
+{
+    0, 0, &reactor_section,
+    { &critsect_debug.ProcessLocksList, &critsect_debug.ProcessLocksList },
+      0, 0, { (DWORD_PTR)(__FILE__ ": reactor_section") }
+};
+static RTL_CRITICAL_SECTION reactor_section = { &critsect_debug, -1, 0, 0, 0, 0 };
+
+static inline struct list *get_hash_bucket( HANDLE handle )
+{
+    struct list *bucket = &reactor_hash[((ULONG_PTR)handle >> 2) % REACTOR_HASH_SIZE];
+    if (!bucket->next) list_init( bucket );
+    return bucket;
+}
+
+/* find the reactor state of a handle; must be called with the section held */
+static struct reactor_fd *find_reactor_fd( HANDLE handle )
+{
+    struct list *bucket = get_hash_bucket( handle );
+    struct reactor_fd *fd;
+
+    LIST_FOR_EACH_ENTRY( fd, bucket, struct reactor_fd, entry )
+        if (fd->handle == handle) return fd;
+    return NULL;
+}
+
+/* the epoll data identifies both the handle and the fd it was registered for */
+static inline ULONG64 get_epoll_data( struct reactor_fd *fd )
+{
+    return ((ULONG64)fd->serial << 32) | wine_server_obj_handle( fd->handle );
+}
+
+/* release a reference to a fd, freeing it once it has been closed */
+static void release_reactor_fd( struct reactor_fd *fd )
+{
+    unsigned int refcount;
+
+    RtlEnterCriticalSection( &reactor_section );
+    refcount = --fd->refcount;
+    RtlLeaveCriticalSection( &reactor_section );
+    if (refcount) return;
+
+    assert( fd->closed );
+    NtClose( fd->port );
+    RtlFreeHeap( GetProcessHeap(), 0, fd );
+}
+
+/* remove a fd from the hash table and take all its asyncs; must be called with the section held */
+/* the caller inherits the reference of the hash table */
+static void detach_reactor_fd( struct reactor_fd *fd, struct list *asyncs )
+{
+    struct epoll_event dummy;
+    unsigned int i;
+
+    for (i = 0; i < 2; i++) list_move_tail( asyncs, &fd->queue[i] );
+    list_remove( &fd->entry );
+    fd->closed = TRUE;
+    reactor_fd_count--;
+
+    /* don't keep the socket open once its handle is gone, the callbacks use the handle */
+    if (fd->unix_fd != -1)
+    {
+        epoll_ctl( reactor_epoll, EPOLL_CTL_DEL, fd->unix_fd, &dummy );
+        close( fd->unix_fd );
+        fd->unix_fd = -1;
+    }
+}
+
+/* (re)arm the epoll entry of a fd for its pending asyncs */
+static void update_reactor_events( struct reactor_fd *fd )
+{
+    struct epoll_event ev;
+
+    if (fd->unix_fd == -1) return;
+    ev.events = EPOLLONESHOT;
+    if (!list_empty( &fd->queue[0] )) ev.events |= EPOLLIN;
+    if (!list_empty( &fd->queue[1] )) ev.events |= EPOLLOUT;
+    if (ev.events == EPOLLONESHOT) return;
+    ev.data.u64 = get_epoll_data( fd );
+    epoll_ctl( reactor_epoll, EPOLL_CTL_MOD, fd->unix_fd, &ev );
+}
+
+/* run the async callback with the given status; returns TRUE once the async is done */
+/* the caller must hold a reference to the fd, the handle itself may already be closed */
+static BOOL run_reactor_async( struct reactor_fd *fd, struct reactor_async *async, NTSTATUS status )
+{
+    NTSTATUS (*func)(void *, IO_STATUS_BLOCK *, NTSTATUS, void **) = wine_server_get_ptr( async->data.callback );
+    IO_STATUS_BLOCK *iosb = wine_server_get_ptr( async->data.iosb );
+    void *arg = wine_server_get_ptr( async->data.arg );
+    void *apc = NULL;
+
+    if (func( arg, iosb, status, &apc ) == STATUS_PENDING) return FALSE;
+
+    if (async->data.cvalue)
+        NtSetIoCompletion( fd->port, fd->key, async->data.cvalue, iosb->u.Status, iosb->Information );
+    if (async->data.event) NtSetEvent( wine_server_ptr_handle( async->data.event ), NULL );
+    if (apc) ((PIO_APC_ROUTINE)apc)( arg, iosb, 0 );
+    RtlFreeHeap( GetProcessHeap(), 0, async );
+    return TRUE;
+}
+
+/* terminate a list of asyncs taken from a fd */
+static void terminate_reactor_asyncs( struct reactor_fd *fd, struct list *asyncs, NTSTATUS status )
+{
+    struct reactor_async *async, *next;
+
+    LIST_FOR_EACH_ENTRY_SAFE( async, next, asyncs, struct reactor_async, entry )
+    {
+        list_remove( &async->entry );
+        run_reactor_async( fd, async, status );
+    }
+}
+
+/* run the pending asyncs of a handle that became ready */
+static void process_reactor_events( ULONG64 data, unsigned int events )
+{
+    static const unsigned int queue_events[2] = { EPOLLIN, EPOLLOUT };
+    struct reactor_async *async;
+    struct reactor_fd *fd;
+    struct list *ptr;
+    BOOL closed;
+    int i;
+
+    RtlEnterCriticalSection( &reactor_section );
+    fd = find_reactor_fd( wine_server_ptr_handle( (obj_handle_t)data ));
+    if (fd && get_epoll_data( fd ) == data) fd->refcount++;
+    else fd = NULL;  /* event of a fd that has been closed meanwhile */
+    RtlLeaveCriticalSection( &reactor_section );
+    if (!fd) return;
+
+    for (i = 0; i < 2; i++)
+    {
+        if (!(events & (queue_events[i] | EPOLLERR | EPOLLHUP))) continue;
+        for (;;)
+        {
+            RtlEnterCriticalSection( &reactor_section );
+            if (fd->closed || !(ptr = list_head( &fd->queue[i] )))
+            {
+                RtlLeaveCriticalSection( &reactor_section );
+                break;
+            }
+            async = LIST_ENTRY( ptr, struct reactor_async, entry );
+            list_remove( &async->entry );
+            RtlLeaveCriticalSection( &reactor_section );
+
+            if (run_reactor_async( fd, async, STATUS_ALERTED )) continue;
+
+            /* not ready after all, put it back at the head of the queue */
+            RtlEnterCriticalSection( &reactor_section );
+            if (!(closed = fd->closed)) list_add_head( &fd->queue[i], &async->entry );
+            RtlLeaveCriticalSection( &reactor_section );
+            if (closed) run_reactor_async( fd, async, STATUS_HANDLES_CLOSED );
+            break;
+        }
+    }
+
+    RtlEnterCriticalSection( &reactor_section );
+    if (!fd->closed) update_reactor_events( fd );
+    RtlLeaveCriticalSection( &reactor_section );
+    release_reactor_fd( fd );
+}
+
+static void CALLBACK reactor_thread( void *arg )
+{
+    struct epoll_event events[32];
+    int i, count;
+
+    for (;;)
+    {
+        if ((count = epoll_wait( reactor_epoll, events, sizeof(events)/sizeof(events[0]), -1 )) == -1)
+        {
+            if (errno != EINTR) ERR( "epoll_wait failed: %s\n", strerror(errno) );
+            continue;
+        }
+        for (i = 0; i < count; i++)
+            process_reactor_events( events[i].data.u64, events[i].events );
+    }
+}
+
+/* create the epoll fd and the reactor thread; must be called with the section held */
+static BOOL init_reactor(void)
+{
+    HANDLE thread;
+    NTSTATUS status;
+
+    if (reactor_epoll != -1) return TRUE;
+    if ((reactor_epoll = epoll_create( 128 )) == -1) return FALSE;
+
+    status = RtlCreateUserThread( NtCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                                  reactor_thread, NULL, &thread, NULL );
+    if (status)
+    {
+        close( reactor_epoll );
+        reactor_epoll = -1;
+        return FALSE;
+    }
+    NtClose( thread );
+    return TRUE;
+}
+
+/* check that the fd watched by the reactor is still the one the handle refers to */
+/* must be called with the section held */
+static NTSTATUS validate_reactor_fd( struct reactor_fd *fd )
+{
+    struct epoll_event ev;
+    struct stat st;
+    int unix_fd, needs_close, ret;
+    NTSTATUS status;
+
+    if ((status = server_get_unix_fd( fd->handle, 0, &unix_fd, &needs_close, NULL, NULL ))) return status;
+    ret = fstat( unix_fd, &st );
+
+    if (fd->unix_fd == -1 && !ret)
+    {
+        fd->unix_fd = dup( unix_fd );
+        fd->dev = st.st_dev;
+        fd->ino = st.st_ino;
+        ev.events = 0;
+        ev.data.u64 = get_epoll_data( fd );
+        if (fd->unix_fd != -1 && epoll_ctl( reactor_epoll, EPOLL_CTL_ADD, fd->unix_fd, &ev ) == -1)
+        {
+            close( fd->unix_fd );
+            fd->unix_fd = -1;
+        }
+        if (fd->unix_fd == -1) status = STATUS_NOT_SUPPORTED;
+    }
+    /* the handle was closed behind our back and its value reused for another object */
+    else if (ret || st.st_dev != fd->dev || st.st_ino != fd->ino) status = STATUS_INVALID_HANDLE;
+
+    if (needs_close) close( unix_fd );
+    return status;
+}
+
+/***********************************************************************
+ *           __wine_queue_reactor_async   (NTDLL.@)
+ *
+ * Queue an overlapped operation to the reactor thread instead of the server.
+ * The callback is run from the reactor thread, so the async must not have a
+ * user APC to run in the calling thread. Returns STATUS_NOT_SUPPORTED if the
+ * handle is not bound to a completion port; the caller should then use the
+ * register_async request.
+ */
+NTSTATUS CDECL __wine_queue_reactor_async( int type, const async_data_t *data )
+{
+    HANDLE handle = wine_server_ptr_handle( data->handle );
+    struct reactor_async *async;
+    struct reactor_fd *fd, *stale_fd = NULL;
+    struct list stale = LIST_INIT( stale );
+    NTSTATUS status = STATUS_NOT_SUPPORTED;
+
+    if (type != ASYNC_TYPE_READ && type != ASYNC_TYPE_WRITE) return STATUS_NOT_SUPPORTED;
+
+    RtlEnterCriticalSection( &reactor_section );
+
+    if (!(fd = find_reactor_fd( handle ))) goto done;
+    if (!init_reactor()) goto done;
+
+    if ((status = validate_reactor_fd( fd )))
+    {
+        if (status == STATUS_INVALID_HANDLE)
+        {
+            /* forget the stale fd, the server knows whether the new object is bound */
+            detach_reactor_fd( fd, &stale );
+            stale_fd = fd;
+            status = STATUS_NOT_SUPPORTED;
+        }
+        goto done;
+    }
+
+    if (!(async = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*async) )))
+    {
+        status = STATUS_NO_MEMORY;
+        goto done;
+    }
+    if (data->event) NtResetEvent( wine_server_ptr_handle( data->event ), NULL );
+    async->data   = *data;
+    async->thread = NtCurrentTeb()->ClientId.UniqueThread;
+    list_add_tail( &fd->queue[type == ASYNC_TYPE_WRITE], &async->entry );
+    update_reactor_events( fd );
+    status = STATUS_PENDING;
+
+done:
+    RtlLeaveCriticalSection( &reactor_section );
+    if (stale_fd)
+    {
+        terminate_reactor_asyncs( stale_fd, &stale, STATUS_HANDLES_CLOSED );
+        release_reactor_fd( stale_fd );
+    }
+    return status;
+}
+
+/***********************************************************************
+ *           reactor_set_completion
+ *
+ * Start handling the overlapped operations of a handle in the reactor,
+ * once it has been bound to a completion port.
+ */
+void reactor_set_completion( HANDLE handle, HANDLE port, ULONG_PTR key )
+{
+    struct reactor_fd *fd, *stale_fd;
+    struct list stale = LIST_INIT( stale );
+
+    if (!(fd = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*fd) ))) return;
+
+    /* the completions are posted to the port directly, since the handle */
+    /* may already be closed when the last asyncs are terminated */
+    if (NtDuplicateObject( NtCurrentProcess(), port, NtCurrentProcess(), &fd->port,
+                           0, 0, DUPLICATE_SAME_ACCESS ))
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, fd );
+        return;
+    }
+    fd->refcount = 1;
+    fd->closed   = FALSE;
+    fd->handle   = handle;
+    fd->key      = key;
+    fd->unix_fd  = -1;
+    list_init( &fd->queue[0] );
+    list_init( &fd->queue[1] );
+
+    RtlEnterCriticalSection( &reactor_section );
+    /* a handle can only be bound once, so an existing entry belongs to a closed handle */
+    if ((stale_fd = find_reactor_fd( handle ))) detach_reactor_fd( stale_fd, &stale );
+    fd->serial = ++reactor_serial;
+    list_add_head( get_hash_bucket( handle ), &fd->entry );
+    reactor_fd_count++;
+    RtlLeaveCriticalSection( &reactor_section );
+
+    if (stale_fd)
+    {
+        terminate_reactor_asyncs( stale_fd, &stale, STATUS_HANDLES_CLOSED );
+        release_reactor_fd( stale_fd );
+    }
+}
+
+/***********************************************************************
+ *           reactor_cancel_async
+ *
+ * Terminate the reactor asyncs of a handle, either those of the current
+ * thread, those matching an iosb, or all of them when the handle is closed.
+ * Returns the number of asyncs that were terminated.
+ */
+unsigned int reactor_cancel_async( HANDLE handle, BOOL only_thread, IO_STATUS_BLOCK *iosb, BOOL close_handle )
+{
+    HANDLE thread = NtCurrentTeb()->ClientId.UniqueThread;
+    struct reactor_async *async, *next;
+    struct reactor_fd *fd;
+    struct list cancelled = LIST_INIT( cancelled );
+    unsigned int i, count = 0;
+
+    if (!reactor_fd_count) return 0;
+
+    RtlEnterCriticalSection( &reactor_section );
+    if ((fd = find_reactor_fd( handle )))
+    {
+        if (close_handle) detach_reactor_fd( fd, &cancelled );
+        else
+        {
+            for (i = 0; i < 2; i++)
+            {
+                LIST_FOR_EACH_ENTRY_SAFE( async, next, &fd->queue[i], struct reactor_async, entry )
+                {
+                    if (only_thread && async->thread != thread) continue;
+                    if (iosb && async->data.iosb != wine_server_client_ptr( iosb )) continue;
+                    list_remove( &async->entry );
+                    list_add_tail( &cancelled, &async->entry );
+                }
+            }
+            update_reactor_events( fd );
+            fd->refcount++;
+        }
+    }
+    RtlLeaveCriticalSection( &reactor_section );
+
+    if (!fd) return 0;
+
+    /* the fd is kept alive until the callbacks are done, the completions go to the port */
+    count = list_count( &cancelled );
+    terminate_reactor_asyncs( fd, &cancelled, close_handle ? STATUS_HANDLES_CLOSED : STATUS_CANCELLED );
+    release_reactor_fd( fd );
+    return count;
+}
+
+#else  /* HAVE_SYS_EPOLL_H && HAVE_EPOLL_CREATE */
+
+NTSTATUS CDECL __wine_queue_reactor_async( int type, const async_data_t *data )
+{
+    return STATUS_NOT_SUPPORTED;
+}
+
+void reactor_set_completion( HANDLE handle, HANDLE port, ULONG_PTR key )
+{
+}
+
+unsigned int reactor_cancel_async( HANDLE handle, BOOL only_thread, IO_STATUS_BLOCK *iosb, BOOL close_handle )
+{
+    return 0;
+}
+
+#endif  /* HAVE_SYS_EPOLL_H && HAVE_EPOLL_CREATE */
@@ -61,6 +61,9 @@
 #ifdef HAVE_UNISTD_H
 # include <unistd.h>
 #endif
+#ifdef HAVE_POLL_H
+#include <poll.h>
+#endif
 
 #include "ntstatus.h"
 #define WIN32_NO_STATUS
@@ -107,6 +110,9 @@ timeout_t server_start_time = 0;  /* time of server startup */
 sigset_t server_block_set;  /* signals to block during server calls */
 static int fd_socket = -1;  /* socket to exchange file descriptors with the server */
 static pid_t server_pid;
+static int use_request_shm;  /* whether replies should be returned through shared memory */
+
+#define REPLY_SPIN_COUNT 4000  /* number of times to poll for a shared memory reply before sleeping */
 
 static RTL_CRITICAL_SECTION fd_cache_section;
 static RTL_CRITICAL_SECTION_DEBUG critsect_debug =
@@ -255,6 +261,81 @@ static inline unsigned int wait_reply( struct __server_request_info *req )
 }
 
 
+/***********************************************************************
+ *           check_server_connection
+ *
+ * Make sure the server is still there while waiting for a shared memory reply.
+ */
+static void check_server_connection(void)
+{
+    struct pollfd pfd;
+
+    pfd.fd = ntdll_get_thread_data()->reply_fd;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+    /* the server closed the connection; time to die... */
+    if (poll( &pfd, 1, 0 ) == 1 && (pfd.revents & (POLLHUP | POLLERR))) abort_thread(0);
+}
+
+
+/***********************************************************************
+ *           read_barrier
+ *
+ * Make sure the reads that follow are not done before the preceding ones.
+ */
+static inline void read_barrier(void)
+{
+#if defined(__i386__) || defined(__x86_64__)
+    __asm__ __volatile__( "" : : : "memory" );  /* loads are not reordered with other loads */
+#else
+    __sync_synchronize();
+#endif
+}
+
+
+/***********************************************************************
+ *           wait_reply_shm
+ *
+ * Wait for a reply from the server in the shared memory area.
+ */
+static unsigned int wait_reply_shm( struct __server_request_info *req, struct request_shm *shm, int seq )
+{
+#ifdef NTDLL_SYS_futex
+    const union generic_reply *reply = (const union generic_reply *)(shm + 1);
+    volatile int *shm_seq = &shm->seq;
+    struct timespec timeout;
+    int i;
+
+    /* the server usually answers quickly, so avoid going to sleep if we can */
+    if (NtCurrentTeb()->Peb->NumberOfProcessors > 1)
+        for (i = 0; i < REPLY_SPIN_COUNT && *shm_seq == seq; i++)
+#if defined(__i386__) || defined(__x86_64__)
+            __asm__ __volatile__( "rep;nop" : : : "memory" );
+#else
+            __asm__ __volatile__( "" : : : "memory" );
+#endif
+
+    while (*shm_seq == seq)
+    {
+        interlocked_xchg( &shm->waiting, 1 );
+        if (*shm_seq != seq) break;
+        timeout.tv_sec  = 1;
+        timeout.tv_nsec = 0;
+        if (futex_wait( &shm->seq, seq, &timeout ) == -ETIMEDOUT) check_server_connection();
+    }
+
+    /* the server stores the reply before bumping the sequence number */
+    read_barrier();
+    req->u.reply = *reply;
+    if (req->u.reply.reply_header.reply_size)
+        memcpy( req->reply_data, reply + 1, req->u.reply.reply_header.reply_size );
+    return req->u.reply.reply_header.error;
+#else
+    server_protocol_error( "shared memory replies not supported\n" );
+#endif
+}
+
+
 /***********************************************************************
  *           wine_server_call (NTDLL.@)
  *
@@ -280,17 +361,104 @@ static inline unsigned int wait_reply( struct __server_request_info *req )
 unsigned int wine_server_call( void *req_ptr )
 {
     struct __server_request_info * const req = req_ptr;
+    struct request_shm *shm = ntdll_get_thread_data_ext()->request_shm;
     sigset_t old_set;
     unsigned int ret;
 
     pthread_sigmask( SIG_BLOCK, &server_block_set, &old_set );
-    ret = send_request( req );
-    if (!ret) ret = wait_reply( req );
+    if (shm && req->u.req.request_header.reply_size <= REQUEST_SHM_MAX_REPLY_SIZE)
+    {
+        int seq = shm->seq;
+        ret = send_request( req );
+        if (!ret) ret = wait_reply_shm( req, shm, seq );
+    }
+    else
+    {
+        ret = send_request( req );
+        if (!ret) ret = wait_reply( req );
+    }
     pthread_sigmask( SIG_SETMASK, &old_set, NULL );
     return ret;
 }
 
 
+/***********************************************************************
+ *           wine_server_call_batch (NTDLL.@)
+ *
+ * Perform several server calls in a single round-trip.
+ *
+ * PARAMS
+ *     req_ptrs [I/O] Array of requests, set up like for wine_server_call
+ *     count    [I]   Number of requests
+ *
+ * RETURNS
+ *     The status of the first request that failed, or STATUS_SUCCESS.
+ *
+ * NOTES
+ *     The requests are executed in order and execution stops at the first
+ *     failure; the replies of the requests that were not executed are left
+ *     untouched. Only the requests whitelisted in the server can be batched,
+ *     that is simple handle, synchronization object, registry and window
+ *     requests; the batch stops with STATUS_INVALID_PARAMETER at any other.
+ *     Use SERVER_INIT_REQ to set up the individual requests.
+ */
+unsigned int wine_server_call_batch( void *req_ptrs[], unsigned int count )
+{
+    struct __server_request_info **reqs = (struct __server_request_info **)req_ptrs;
+    data_size_t requests_size = 0, replies_size = 0, size;
+    unsigned int i, j, done = 0, ret = STATUS_SUCCESS, batch_status;
+    char *buffer, *ptr;
+
+    for (i = 0; i < count; i++)
+    {
+        requests_size += sizeof(reqs[i]->u.req) +
+                         BATCH_DATA_ALIGN( reqs[i]->u.req.request_header.request_size );
+        replies_size += sizeof(reqs[i]->u.reply) +
+                        BATCH_DATA_ALIGN( reqs[i]->u.req.request_header.reply_size );
+    }
+
+    /* the replies overwrite the requests once they have been sent */
+    if (!(buffer = RtlAllocateHeap( GetProcessHeap(), 0, max( requests_size, replies_size ) )))
+        return STATUS_NO_MEMORY;
+
+    for (i = 0, ptr = buffer; i < count; i++)
+    {
+        memcpy( ptr, &reqs[i]->u.req, sizeof(reqs[i]->u.req) );
+        ptr += sizeof(reqs[i]->u.req);
+        for (j = 0; j < reqs[i]->data_count; j++)
+        {
+            memcpy( ptr, reqs[i]->data[j].ptr, reqs[i]->data[j].size );
+            ptr += reqs[i]->data[j].size;
+        }
+        size = reqs[i]->u.req.request_header.request_size;
+        memset( ptr, 0, BATCH_DATA_ALIGN( size ) - size );
+        ptr += BATCH_DATA_ALIGN( size ) - size;
+    }
+
+    SERVER_START_REQ( call_batch )
+    {
+        wine_server_add_data( req, buffer, requests_size );
+        wine_server_set_reply( req, buffer, replies_size );
+        batch_status = wine_server_call( req );
+        done = reply->count;
+    }
+    SERVER_END_REQ;
+
+    /* the requests executed before an invalid one have their reply too */
+    for (i = 0, ptr = buffer; i < done; i++)
+    {
+        memcpy( &reqs[i]->u.reply, ptr, sizeof(reqs[i]->u.reply) );
+        ptr += sizeof(reqs[i]->u.reply);
+        if ((size = reqs[i]->u.reply.reply_header.reply_size))
+            memcpy( reqs[i]->reply_data, ptr, size );
+        ptr += BATCH_DATA_ALIGN( size );
+        if (!ret) ret = reqs[i]->u.reply.reply_header.error;
+    }
+    RtlFreeHeap( GetProcessHeap(), 0, buffer );
+    return ret ? ret : batch_status;
+}
+
+
 /***********************************************************************
  *           server_enter_uninterrupted_section
  */
@@ -529,14 +697,13 @@ int server_remove_fd_from_cache( HANDLE handle )
 
 
 /***********************************************************************
- *           server_get_unix_fd
+ *           get_unix_fd
  *
- * The returned unix_fd should be closed iff needs_close is non-zero.
+ * Caller must hold fd_cache_section.
  */
-int server_get_unix_fd( HANDLE handle, unsigned int wanted_access, int *unix_fd,
+static int get_unix_fd( HANDLE handle, unsigned int wanted_access, int *unix_fd,
                         int *needs_close, enum server_fd_type *type, unsigned int *options )
 {
-    sigset_t sigset;
     obj_handle_t fd_handle;
     int ret = 0, fd;
     unsigned int access = 0;
@@ -545,8 +712,6 @@ int server_get_unix_fd( HANDLE handle, unsigned int wanted_access, int *unix_fd,
     *needs_close = 0;
     wanted_access &= FILE_READ_DATA | FILE_WRITE_DATA;
 
-    server_enter_uninterrupted_section( &fd_cache_section, &sigset );
-
     fd = get_cached_fd( handle, type, &access, options );
     if (fd != -1) goto done;
 
@@ -571,17 +736,74 @@ int server_get_unix_fd( HANDLE handle, unsigned int wanted_access, int *unix_fd,
     SERVER_END_REQ;
 
 done:
-    server_leave_uninterrupted_section( &fd_cache_section, &sigset );
     if (!ret && ((access & wanted_access) != wanted_access))
     {
         ret = STATUS_ACCESS_DENIED;
         if (*needs_close) close( fd );
+        *needs_close = 0;
     }
     if (!ret) *unix_fd = fd;
     return ret;
 }
 
 
+/***********************************************************************
+ *           server_get_unix_fd
+ *
+ * The returned unix_fd should be closed iff needs_close is non-zero.
+ */
+int server_get_unix_fd( HANDLE handle, unsigned int wanted_access, int *unix_fd,
+                        int *needs_close, enum server_fd_type *type, unsigned int *options )
+{
+    sigset_t sigset;
+    int ret;
+
+    server_enter_uninterrupted_section( &fd_cache_section, &sigset );
+    ret = get_unix_fd( handle, wanted_access, unix_fd, needs_close, type, options );
+    server_leave_uninterrupted_section( &fd_cache_section, &sigset );
+    return ret;
+}
+
+
+/***********************************************************************
+ *           __wine_server_get_unix_fds   (NTDLL.@)
+ *
+ * Retrieve the Unix file descriptors of an array of handles in one go.
+ *
+ * Cached descriptors are returned as is instead of being duplicated, so
+ * they must not be used anymore once the handle has been closed. The
+ * descriptors flagged in needs_close must be closed by the caller.
+ *
+ * PARAMS
+ *     count       [I] Number of handles.
+ *     handles     [I] Wine file handles.
+ *     access      [I] Win32 file access rights requested for each handle.
+ *     unix_fds    [O] Unix file descriptors, -1 on failure.
+ *     needs_close [O] Whether each descriptor has to be closed.
+ *
+ * RETURNS
+ *     NTSTATUS code of the first handle that failed, all the other
+ *     handles are still processed.
+ */
+NTSTATUS CDECL __wine_server_get_unix_fds( unsigned int count, const HANDLE *handles,
+                                           const unsigned int *access, int *unix_fds,
+                                           int *needs_close )
+{
+    sigset_t sigset;
+    unsigned int i;
+    NTSTATUS status, ret = STATUS_SUCCESS;
+
+    server_enter_uninterrupted_section( &fd_cache_section, &sigset );
+    for (i = 0; i < count; i++)
+    {
+        status = get_unix_fd( handles[i], access[i], &unix_fds[i], &needs_close[i], NULL, NULL );
+        if (status && !ret) ret = status;
+    }
+    server_leave_uninterrupted_section( &fd_cache_section, &sigset );
+    return ret;
+}
+
+
 /***********************************************************************
  *           wine_server_fd_to_handle   (NTDLL.@)
  *
@@ -970,6 +1192,7 @@ void server_init_process(void)
 {
     obj_handle_t version;
     const char *env_socket = getenv( "WINESERVERSOCKET" );
+    const char *env_shm;
 
     server_pid = -1;
     if (env_socket)
@@ -981,6 +1204,8 @@ void server_init_process(void)
     }
     else fd_socket = server_connect();
 
+    if ((env_shm = getenv( "WINESERVERSHM" )) && atoi( env_shm )) use_request_shm = use_futexes();
+
     /* setup the signal mask */
     sigemptyset( &server_block_set );
     sigaddset( &server_block_set, SIGALRM );
@@ -1024,6 +1249,95 @@ void server_init_process(void)
 }
 
 
+/***********************************************************************
+ *           server_init_request_shm
+ *
+ * Setup the shared memory area used to receive replies for the current thread.
+ */
+void server_init_request_shm(void)
+{
+    struct request_shm *shm;
+    obj_handle_t dummy;
+    data_size_t size = 0;
+    sigset_t sigset;
+    int fd = -1;
+
+    if (!use_request_shm) return;
+
+    /* the fd is received on the shared socket, so make sure no other thread is receiving one */
+    server_enter_uninterrupted_section( &fd_cache_section, &sigset );
+    SERVER_START_REQ( create_request_shm )
+    {
+        if (!wine_server_call( req ))
+        {
+            size = reply->size;
+            fd = receive_fd( &dummy );
+        }
+    }
+    SERVER_END_REQ;
+    server_leave_uninterrupted_section( &fd_cache_section, &sigset );
+
+    if (fd == -1) return;  /* keep using the reply pipe */
+
+    /* from now on the server sends the replies through the shared area, we can't go back */
+    shm = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    close( fd );
+    if (shm == MAP_FAILED) server_protocol_perror( "mmap" );
+    ntdll_get_thread_data_ext()->request_shm = shm;
+}
+
+
+/***********************************************************************
+ *           server_free_request_shm
+ *
+ * Release the shared memory area of the current thread; no more requests can be made after this.
+ */
+void server_free_request_shm(void)
+{
+    struct request_shm *shm = ntdll_get_thread_data_ext()->request_shm;
+
+    if (!shm) return;
+    ntdll_get_thread_data_ext()->request_shm = NULL;
+    munmap( shm, REQUEST_SHM_SIZE );
+}
+
+
+/***********************************************************************
+ *           server_init_sync_shm
+ *
+ * Map the shared memory area holding the state of the process synchronization objects.
+ */
+void server_init_sync_shm(void)
+{
+    const char *env_shm = getenv( "WINESYNCSHM" );
+    obj_handle_t dummy;
+    data_size_t size = 0;
+    sigset_t sigset;
+    void *ptr;
+    int fd = -1;
+
+    if (!env_shm || !atoi( env_shm )) return;
+
+    server_enter_uninterrupted_section( &fd_cache_section, &sigset );
+    SERVER_START_REQ( get_sync_shm )
+    {
+        if (!wine_server_call( req ))
+        {
+            size = reply->size;
+            fd = receive_fd( &dummy );
+        }
+    }
+    SERVER_END_REQ;
+    server_leave_uninterrupted_section( &fd_cache_section, &sigset );
+
+    if (fd == -1) return;
+    ptr = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 );
+    close( fd );
+    /* without the mapping we simply never use the fast path */
+    if (ptr != MAP_FAILED) sync_shm_entries = ptr;
+}
+
+
 /***********************************************************************
  *           server_init_process_done
  */
@@ -1117,6 +1431,7 @@ size_t server_init_thread( void *entry_point )
     switch (ret)
     {
     case STATUS_SUCCESS:
+        server_init_request_shm();
         if (arch)
         {
             if (!strcmp( arch, "win32" ) && (is_win64 || is_wow64))
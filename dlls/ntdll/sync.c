@@ -22,6 +22,7 @@
  */
 
 #include "config.h"
+#include "wine/port.h"
 
 #include <assert.h>
 #include <errno.h>
@@ -41,6 +42,9 @@
 #ifdef HAVE_SCHED_H
 # include <sched.h>
 #endif
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
 #include <string.h>
 #include <stdarg.h>
 #include <stdio.h>
@@ -55,6 +59,7 @@
 #include "windef.h"
 #include "winternl.h"
 #include "wine/server.h"
+#include "wine/library.h"
 #include "wine/debug.h"
 #include "ntdll_misc.h"
 
@@ -130,6 +135,157 @@ void NTDLL_free_struct_sd(struct security_descriptor *server_sd)
     RtlFreeHeap(GetProcessHeap(), 0, server_sd);
 }
 
+/*
+ *	Shared memory state of events and semaphores
+ *
+ * The server hands out the location of the state of the objects we create
+ * when WINESYNCSHM is set. As long as no thread is waiting on an object in
+ * the server we are free to change its state with atomic operations;
+ * otherwise we have to go through the server so that it can wake up the
+ * waiters.
+ *
+ * Handles are only forgotten when we close them ourselves, so the server
+ * counts the handles closed by other processes in the area header; cache
+ * entries made before such a close may refer to a reused handle value and
+ * are no longer used.
+ */
+
+struct sync_shm_entry *sync_shm_entries;  /* shared memory area, NULL if not in use */
+
+struct sync_cache_entry
+{
+    unsigned int index;   /* index of the object state in the shared memory */
+    unsigned int serial;  /* serial number of the object, 0 if not cached */
+    unsigned int closed;  /* count of handles closed by other processes when it was cached */
+};
+
+#define SYNC_CACHE_BLOCK_SIZE  (65536 / sizeof(struct sync_cache_entry))
+#define SYNC_CACHE_ENTRIES     128
+
+static struct sync_cache_entry *sync_cache[SYNC_CACHE_ENTRIES];
+
+static inline unsigned int sync_handle_to_index( HANDLE handle, unsigned int *entry )
+{
+    unsigned int idx = (wine_server_obj_handle(handle) >> 2) - 1;
+    *entry = idx / SYNC_CACHE_BLOCK_SIZE;
+    return idx % SYNC_CACHE_BLOCK_SIZE;
+}
+
+/* number of handles closed by other processes, to be read before creating an object */
+static inline unsigned int get_sync_shm_close_count(void)
+{
+    if (!sync_shm_entries) return 0;
+    return *(volatile unsigned int *)&((struct sync_shm_header *)sync_shm_entries)->close_count;
+}
+
+/* remember the shared memory state of a newly created object */
+static void add_sync_shm_handle( HANDLE handle, unsigned int index, unsigned int serial, unsigned int closed )
+{
+    unsigned int entry, idx = sync_handle_to_index( handle, &entry );
+
+    if (!sync_shm_entries || !serial || !index || index >= SYNC_SHM_ENTRIES) return;
+    if (entry >= SYNC_CACHE_ENTRIES) return;
+
+    if (!sync_cache[entry])  /* do we need to allocate a new block of entries? */
+    {
+        void *ptr = wine_anon_mmap( NULL, SYNC_CACHE_BLOCK_SIZE * sizeof(struct sync_cache_entry),
+                                    PROT_READ | PROT_WRITE, 0 );
+        if (ptr == MAP_FAILED) return;
+        if (interlocked_cmpxchg_ptr( (void **)&sync_cache[entry], ptr, NULL ))
+            munmap( ptr, SYNC_CACHE_BLOCK_SIZE * sizeof(struct sync_cache_entry) );
+    }
+    sync_cache[entry][idx].index = index;
+    sync_cache[entry][idx].closed = closed;
+    interlocked_xchg( (int *)&sync_cache[entry][idx].serial, serial );
+}
+
+/* retrieve the shared memory state of a handle, or NULL if it has none */
+/* SYNC_SHM_FREE as type accepts any object type */
+static struct sync_shm_entry *get_sync_shm_handle( HANDLE handle, enum sync_shm_type type )
+{
+    unsigned int entry, idx = sync_handle_to_index( handle, &entry );
+    struct sync_shm_entry *shm;
+    unsigned int serial;
+
+    if (!sync_shm_entries || entry >= SYNC_CACHE_ENTRIES || !sync_cache[entry]) return NULL;
+    if (!(serial = sync_cache[entry][idx].serial)) return NULL;
+    /* the handle may have been closed by another process and its value reused */
+    if (sync_cache[entry][idx].closed != get_sync_shm_close_count()) return NULL;
+    shm = &sync_shm_entries[sync_cache[entry][idx].index];
+    /* make sure the object wasn't destroyed behind our back */
+    if (shm->serial != serial) return NULL;
+    if (type != SYNC_SHM_FREE && shm->type != type) return NULL;
+    return shm;
+}
+
+/***********************************************************************
+ *           sync_shm_remove_handle
+ *
+ * Forget the shared memory state of a handle that is being closed.
+ */
+void sync_shm_remove_handle( HANDLE handle )
+{
+    unsigned int entry, idx = sync_handle_to_index( handle, &entry );
+
+    if (entry < SYNC_CACHE_ENTRIES && sync_cache[entry])
+        interlocked_xchg( (int *)&sync_cache[entry][idx].serial, 0 );
+}
+
+/* atomically read the state of an object */
+static inline __int64 get_sync_shm_state( struct sync_shm_entry *shm )
+{
+    return interlocked_cmpxchg64( &shm->state, 0, 0 );
+}
+
+/* try to acquire an object without the server; return STATUS_PENDING if the server is needed */
+static NTSTATUS wait_sync_shm( HANDLE handle, const LARGE_INTEGER *timeout )
+{
+    struct sync_shm_entry *shm;
+    __int64 state, new_state;
+    unsigned int count;
+
+    if (!(shm = get_sync_shm_handle( handle, SYNC_SHM_FREE ))) return STATUS_PENDING;
+
+    for (;;)
+    {
+        state = get_sync_shm_state( shm );
+        if (SYNC_SHM_WAITERS( state )) return STATUS_PENDING;
+        if (!(count = SYNC_SHM_COUNT( state )))
+        {
+            if (!timeout || timeout->QuadPart) return STATUS_PENDING;
+            /* same as the server wait, see NTDLL_wait_for_multiple_objects */
+            NtYieldExecution();
+            return STATUS_TIMEOUT;
+        }
+        switch (shm->type)
+        {
+        case SYNC_SHM_MANUAL_EVENT: return STATUS_WAIT_0;
+        case SYNC_SHM_AUTO_EVENT:   new_state = SYNC_SHM_STATE( 0, 0 ); break;
+        case SYNC_SHM_SEMAPHORE:    new_state = SYNC_SHM_STATE( count - 1, 0 ); break;
+        default:                    return STATUS_PENDING;
+        }
+        if (interlocked_cmpxchg64( &shm->state, new_state, state ) == state) return STATUS_WAIT_0;
+    }
+}
+
+/* set the state of an event without the server; return STATUS_PENDING if the server is needed */
+static NTSTATUS set_sync_shm_event( HANDLE handle, unsigned int signaled )
+{
+    struct sync_shm_entry *shm;
+    __int64 state;
+
+    if (!(shm = get_sync_shm_handle( handle, SYNC_SHM_FREE ))) return STATUS_PENDING;
+    if (shm->type != SYNC_SHM_AUTO_EVENT && shm->type != SYNC_SHM_MANUAL_EVENT) return STATUS_PENDING;
+
+    do
+    {
+        state = get_sync_shm_state( shm );
+        if (SYNC_SHM_WAITERS( state )) return STATUS_PENDING;
+    }
+    while (interlocked_cmpxchg64( &shm->state, SYNC_SHM_STATE( signaled, 0 ), state ) != state);
+    return STATUS_SUCCESS;
+}
+
 /*
  *	Semaphores
  */
@@ -147,6 +303,7 @@ NTSTATUS WINAPI NtCreateSemaphore( OUT PHANDLE SemaphoreHandle,
     NTSTATUS ret;
     struct object_attributes objattr;
     struct security_descriptor *sd = NULL;
+    unsigned int closed = get_sync_shm_close_count();
 
     if (MaximumCount <= 0 || InitialCount < 0 || InitialCount > MaximumCount)
         return STATUS_INVALID_PARAMETER;
@@ -172,6 +329,7 @@ NTSTATUS WINAPI NtCreateSemaphore( OUT PHANDLE SemaphoreHandle,
         if (len) wine_server_add_data( req, attr->ObjectName->Buffer, len );
         ret = wine_server_call( req );
         *SemaphoreHandle = wine_server_ptr_handle( reply->handle );
+        if (!ret) add_sync_shm_handle( *SemaphoreHandle, reply->shm_index, reply->shm_serial, closed );
     }
     SERVER_END_REQ;
 
@@ -225,7 +383,27 @@ NTSTATUS WINAPI NtQuerySemaphore(
  */
 NTSTATUS WINAPI NtReleaseSemaphore( HANDLE handle, ULONG count, PULONG previous )
 {
+    struct sync_shm_entry *shm;
     NTSTATUS ret;
+
+    if ((shm = get_sync_shm_handle( handle, SYNC_SHM_SEMAPHORE )))
+    {
+        __int64 state;
+        unsigned int prev;
+
+        do
+        {
+            state = get_sync_shm_state( shm );
+            if (SYNC_SHM_WAITERS( state )) goto server;
+            prev = SYNC_SHM_COUNT( state );
+            if (prev + count < prev || prev + count > shm->max) return STATUS_SEMAPHORE_LIMIT_EXCEEDED;
+        }
+        while (interlocked_cmpxchg64( &shm->state, SYNC_SHM_STATE( prev + count, 0 ), state ) != state);
+        if (previous) *previous = prev;
+        return STATUS_SUCCESS;
+    }
+
+server:
     SERVER_START_REQ( release_semaphore )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -254,6 +432,7 @@ NTSTATUS WINAPI NtCreateEvent( PHANDLE EventHandle, ACCESS_MASK DesiredAccess,
     NTSTATUS ret;
     struct security_descriptor *sd = NULL;
     struct object_attributes objattr;
+    unsigned int closed = get_sync_shm_close_count();
 
     if (len >= MAX_PATH * sizeof(WCHAR)) return STATUS_NAME_TOO_LONG;
 
@@ -277,6 +456,7 @@ NTSTATUS WINAPI NtCreateEvent( PHANDLE EventHandle, ACCESS_MASK DesiredAccess,
         if (len) wine_server_add_data( req, attr->ObjectName->Buffer, len );
         ret = wine_server_call( req );
         *EventHandle = wine_server_ptr_handle( reply->handle );
+        if (!ret) add_sync_shm_handle( *EventHandle, reply->shm_index, reply->shm_serial, closed );
     }
     SERVER_END_REQ;
 
@@ -323,6 +503,8 @@ NTSTATUS WINAPI NtSetEvent( HANDLE handle, PULONG NumberOfThreadsReleased )
 
     /* FIXME: set NumberOfThreadsReleased */
 
+    if ((ret = set_sync_shm_event( handle, 1 )) != STATUS_PENDING) return ret;
+
     SERVER_START_REQ( event_op )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -343,6 +525,8 @@ NTSTATUS WINAPI NtResetEvent( HANDLE handle, PULONG NumberOfThreadsReleased )
     /* resetting an event can't release any thread... */
     if (NumberOfThreadsReleased) *NumberOfThreadsReleased = 0;
 
+    if ((ret = set_sync_shm_event( handle, 0 )) != STATUS_PENDING) return ret;
+
     SERVER_START_REQ( event_op )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -377,6 +561,9 @@ NTSTATUS WINAPI NtPulseEvent( HANDLE handle, PULONG PulseCount )
     if (PulseCount)
       FIXME("(%p,%d)\n", handle, *PulseCount);
 
+    /* without waiters pulsing simply leaves the event reset */
+    if ((ret = set_sync_shm_event( handle, 0 )) != STATUS_PENDING) return ret;
+
     SERVER_START_REQ( event_op )
     {
         req->handle = wine_server_obj_handle( handle );
@@ -1154,9 +1341,14 @@ NTSTATUS WINAPI NtWaitForMultipleObjects( DWORD count, const HANDLE *handles,
                                           const LARGE_INTEGER *timeout )
 {
     UINT flags = SELECT_INTERRUPTIBLE;
+    NTSTATUS ret;
 
     if (!count || count > MAXIMUM_WAIT_OBJECTS) return STATUS_INVALID_PARAMETER_1;
 
+    /* alertable waits need the server to deliver user APCs */
+    if (count == 1 && !alertable && (ret = wait_sync_shm( handles[0], timeout )) != STATUS_PENDING)
+        return ret;
+
     if (wait_all) flags |= SELECT_ALL;
     if (alertable) flags |= SELECT_ALERTABLE;
     return NTDLL_wait_for_multiple_objects( count, handles, flags, timeout, 0 );
@@ -24,6 +24,7 @@
 #include "stdio.h"
 #include "winnt.h"
 #include "stdlib.h"
+#include "wine/server.h"
 
 static HANDLE   (WINAPI *pCreateWaitableTimerA)(SECURITY_ATTRIBUTES*, BOOL, LPCSTR);
 static NTSTATUS (WINAPI *pRtlCreateUnicodeStringFromAsciiz)(PUNICODE_STRING, LPCSTR);
@@ -46,6 +47,7 @@ static NTSTATUS (WINAPI *pNtOpenSymbolicLinkObject)(PHANDLE, ACCESS_MASK, POBJEC
 static NTSTATUS (WINAPI *pNtCreateSymbolicLinkObject)(PHANDLE, ACCESS_MASK, POBJECT_ATTRIBUTES, PUNICODE_STRING);
 static NTSTATUS (WINAPI *pNtQuerySymbolicLinkObject)(HANDLE,PUNICODE_STRING,PULONG);
 static NTSTATUS (WINAPI *pNtQueryObject)(HANDLE,OBJECT_INFORMATION_CLASS,PVOID,ULONG,PULONG);
+static unsigned int (CDECL *pwine_server_call_batch)(void *[],unsigned int);
 
 
 static void test_case_sensitive (void)
@@ -736,10 +738,267 @@ static void test_query_object(void)
     pNtClose( handle );
 }
 
+static void test_handle_churn(void)
+{
+    static const int count = 100000;
+    HANDLE *handles;
+    NTSTATUS status = STATUS_SUCCESS, last_failure = STATUS_SUCCESS;
+    DWORD start;
+    int i, j, failures = 0;
+
+    handles = HeapAlloc( GetProcessHeap(), 0, count * sizeof(*handles) );
+    ok( handles != NULL, "HeapAlloc failed\n" );
+    if (!handles) return;
+
+    start = GetTickCount();
+    for (i = 0; i < count; i++)
+        if ((status = pNtCreateEvent( &handles[i], EVENT_ALL_ACCESS, NULL, FALSE, FALSE ))) break;
+    ok( i == count, "NtCreateEvent failed %08x after %d handles\n", status, i );
+    trace( "created %d handles in %u ms\n", i, GetTickCount() - start );
+    if (i < count)
+    {
+        while (i--) pNtClose( handles[i] );
+        HeapFree( GetProcessHeap(), 0, handles );
+        return;
+    }
+
+    /* close and reopen every other handle a few times, the new values can be any free slot */
+    start = GetTickCount();
+    for (j = 0; j < 5; j++)
+    {
+        for (i = j & 1; i < count; i += 2)
+        {
+            if (!handles[i] || !(status = pNtClose( handles[i] ))) continue;
+            last_failure = status;
+            failures++;
+        }
+        for (i = j & 1; i < count; i += 2)
+        {
+            if (!(status = pNtCreateEvent( &handles[i], EVENT_ALL_ACCESS, NULL, FALSE, FALSE ))) continue;
+            handles[i] = 0;
+            last_failure = status;
+            failures++;
+        }
+    }
+    trace( "%d close/create cycles took %u ms\n", 5 * count / 2, GetTickCount() - start );
+    ok( !failures, "%d close/create calls failed, last status %08x\n", failures, last_failure );
+
+    /* the handles must all refer to distinct, unsignaled events */
+    for (i = 0; i < count; i += count / 100)
+    {
+        if (!handles[i]) continue;
+        ok( WaitForSingleObject( handles[i], 0 ) == WAIT_TIMEOUT, "handle %p is not valid\n", handles[i] );
+        SetEvent( handles[i] );
+        ok( WaitForSingleObject( handles[i], 0 ) == WAIT_OBJECT_0, "handle %p is not valid\n", handles[i] );
+    }
+
+    start = GetTickCount();
+    for (i = count - 1; i >= 0; i--)
+        if (handles[i]) pNtClose( handles[i] );
+    trace( "closed %d handles in %u ms\n", count, GetTickCount() - start );
+
+    HeapFree( GetProcessHeap(), 0, handles );
+}
+
+static void test_server_call_rate(void)
+{
+    static const DWORD duration = 500;
+    static const WCHAR name[] = {'t','e','s','t','_','c','a','l','l','_','r','a','t','e',0};
+    char buffer[1024], shm[8];
+    UNICODE_STRING *str = (UNICODE_STRING *)buffer;
+    HANDLE event;
+    DWORD start, elapsed;
+    ULONG len;
+    int i, count = 0, failures = 0, bad_replies = 0;
+
+    event = CreateEventW( NULL, TRUE, FALSE, name );
+    ok( event != NULL, "CreateEvent failed %u\n", GetLastError() );
+    if (!event) return;
+
+    start = GetTickCount();
+    do
+    {
+        for (i = 0; i < 1000; i++)
+        {
+            if (!SetEvent( event )) failures++;
+            /* the name comes back as variable size reply data, check that it arrives intact */
+            len = 0;
+            memset( buffer, 0xcc, sizeof(buffer) );
+            if (pNtQueryObject( event, ObjectNameInformation, buffer, sizeof(buffer), &len ))
+                failures++;
+            else if (len != sizeof(UNICODE_STRING) + str->Length + sizeof(WCHAR) ||
+                     str->Length < sizeof(name) - sizeof(WCHAR) ||
+                     memcmp( str->Buffer + str->Length / sizeof(WCHAR) - lstrlenW(name), name, sizeof(name) ))
+                bad_replies++;
+        }
+        count += i;
+        elapsed = GetTickCount() - start;
+    } while (elapsed < duration);
+
+    if (!GetEnvironmentVariableA( "WINESERVERSHM", shm, sizeof(shm) )) shm[0] = 0;
+    ok( !failures, "%d calls out of %d failed\n", failures, count * 2 );
+    ok( !bad_replies, "%d replies out of %d were wrong%s\n", bad_replies, count,
+        atoi( shm ) ? " with shared memory replies" : "" );
+    trace( "%u server calls per second%s\n", (DWORD)(count * 2 * 1000.0 / elapsed),
+           atoi( shm ) ? " with shared memory replies" : "" );
+    pNtClose( event );
+}
+
+static void test_server_call_rate_shm( const char *argv0 )
+{
+    PROCESS_INFORMATION info;
+    STARTUPINFOA startup;
+    char buffer[MAX_PATH + 32];
+    BOOL ret;
+
+    memset( &startup, 0, sizeof(startup) );
+    startup.cb = sizeof(startup);
+    SetEnvironmentVariableA( "WINESERVERSHM", "1" );
+    sprintf( buffer, "%s om server_call_rate", argv0 );
+    ret = CreateProcessA( NULL, buffer, NULL, NULL, FALSE, 0, NULL, NULL, &startup, &info );
+    ok( ret, "failed to create child process error %u\n", GetLastError() );
+    SetEnvironmentVariableA( "WINESERVERSHM", NULL );
+    if (!ret) return;
+
+    winetest_wait_child_process( info.hProcess );
+    CloseHandle( info.hThread );
+    CloseHandle( info.hProcess );
+}
+
+static void test_call_batch(void)
+{
+    struct __server_request_info info[3];
+    struct set_handle_info_request *handle_req;
+    struct event_op_request *event_req;
+    struct get_handle_fd_request *fd_req;
+    void *reqs[3] = { &info[0], &info[1], &info[2] };
+    unsigned int status;
+    HANDLE event;
+
+    if (!pwine_server_call_batch)
+    {
+        win_skip("wine_server_call_batch is not available\n");
+        return;
+    }
+
+    status = pNtCreateEvent( &event, EVENT_ALL_ACCESS, NULL, TRUE, FALSE );
+    ok( status == STATUS_SUCCESS, "NtCreateEvent failed %08x\n", status );
+
+    /* all the requests are executed in order and get their own reply */
+    handle_req = SERVER_INIT_REQ( info[0], set_handle_info );
+    handle_req->handle = wine_server_obj_handle( event );
+    handle_req->flags  = HANDLE_FLAG_INHERIT;
+    handle_req->mask   = HANDLE_FLAG_INHERIT;
+    handle_req = SERVER_INIT_REQ( info[1], set_handle_info );
+    handle_req->handle = wine_server_obj_handle( event );
+    handle_req->flags  = 0;
+    handle_req->mask   = 0;
+    event_req = SERVER_INIT_REQ( info[2], event_op );
+    event_req->handle = wine_server_obj_handle( event );
+    event_req->op     = SET_EVENT;
+    status = pwine_server_call_batch( reqs, 3 );
+    ok( status == STATUS_SUCCESS, "batch failed %08x\n", status );
+    ok( !info[0].u.reply.reply_header.error, "wrong error %08x\n", info[0].u.reply.reply_header.error );
+    ok( !info[0].u.reply.set_handle_info_reply.old_flags, "wrong old flags %x\n",
+        info[0].u.reply.set_handle_info_reply.old_flags );
+    ok( info[1].u.reply.set_handle_info_reply.old_flags == HANDLE_FLAG_INHERIT, "wrong old flags %x\n",
+        info[1].u.reply.set_handle_info_reply.old_flags );
+    ok( !info[2].u.reply.reply_header.error, "wrong error %08x\n", info[2].u.reply.reply_header.error );
+    ok( WaitForSingleObject( event, 0 ) == WAIT_OBJECT_0, "event not signaled\n" );
+
+    /* execution stops at the first failure, the following requests are left untouched */
+    event_req = SERVER_INIT_REQ( info[0], event_op );
+    event_req->handle = wine_server_obj_handle( event );
+    event_req->op     = RESET_EVENT;
+    event_req = SERVER_INIT_REQ( info[1], event_op );
+    event_req->handle = 0xdeadbeef;
+    event_req->op     = SET_EVENT;
+    event_req = SERVER_INIT_REQ( info[2], event_op );
+    event_req->handle = wine_server_obj_handle( event );
+    event_req->op     = SET_EVENT;
+    info[2].u.reply.reply_header.error = 0xdeadbeef;
+    status = pwine_server_call_batch( reqs, 3 );
+    ok( status == STATUS_INVALID_HANDLE, "batch failed %08x\n", status );
+    ok( !info[0].u.reply.reply_header.error, "wrong error %08x\n", info[0].u.reply.reply_header.error );
+    ok( info[1].u.reply.reply_header.error == STATUS_INVALID_HANDLE, "wrong error %08x\n",
+        info[1].u.reply.reply_header.error );
+    ok( info[2].u.reply.reply_header.error == 0xdeadbeef, "request executed, error %08x\n",
+        info[2].u.reply.reply_header.error );
+    ok( WaitForSingleObject( event, 0 ) == WAIT_TIMEOUT, "event signaled\n" );
+
+    /* requests that transfer file descriptors are rejected, the previous replies are returned */
+    event_req = SERVER_INIT_REQ( info[0], event_op );
+    event_req->handle = wine_server_obj_handle( event );
+    event_req->op     = SET_EVENT;
+    fd_req = SERVER_INIT_REQ( info[1], get_handle_fd );
+    fd_req->handle = wine_server_obj_handle( event );
+    event_req = SERVER_INIT_REQ( info[2], event_op );
+    event_req->handle = wine_server_obj_handle( event );
+    event_req->op     = RESET_EVENT;
+    info[0].u.reply.reply_header.error = 0xdeadbeef;
+    info[1].u.reply.reply_header.error = 0xdeadbeef;
+    status = pwine_server_call_batch( reqs, 3 );
+    ok( status == STATUS_INVALID_PARAMETER, "batch failed %08x\n", status );
+    ok( !info[0].u.reply.reply_header.error, "wrong error %08x\n", info[0].u.reply.reply_header.error );
+    ok( info[1].u.reply.reply_header.error == 0xdeadbeef, "request executed, error %08x\n",
+        info[1].u.reply.reply_header.error );
+    ok( WaitForSingleObject( event, 0 ) == WAIT_OBJECT_0, "event not signaled\n" );
+
+    pNtClose( event );
+}
+
+static void test_many_named_objects(void)
+{
+    static const int count = 20000;
+    HANDLE *handles, handle;
+    char name[64];
+    DWORD start;
+    int i;
+
+    handles = HeapAlloc( GetProcessHeap(), 0, count * sizeof(*handles) );
+
+    start = GetTickCount();
+    for (i = 0; i < count; i++)
+    {
+        sprintf( name, "om.c-test-many-named-objects-%d", i );
+        handles[i] = CreateEventA( NULL, FALSE, FALSE, name );
+        ok( handles[i] != NULL, "CreateEvent %s failed %u\n", name, GetLastError() );
+    }
+    trace( "created %d named events in %u ms\n", count, GetTickCount() - start );
+
+    start = GetTickCount();
+    for (i = 0; i < count; i++)
+    {
+        sprintf( name, "OM.C-TEST-MANY-NAMED-OBJECTS-%d", i );
+        handle = OpenEventA( EVENT_ALL_ACCESS, FALSE, name );
+        ok( handle == NULL, "OpenEvent %s succeeded\n", name );
+        sprintf( name, "om.c-test-many-named-objects-%d", i );
+        handle = OpenEventA( EVENT_ALL_ACCESS, FALSE, name );
+        ok( handle != NULL, "OpenEvent %s failed %u\n", name, GetLastError() );
+        CloseHandle( handle );
+    }
+    trace( "opened %d named events in %u ms\n", 2 * count, GetTickCount() - start );
+
+    /* names of closed objects must disappear */
+    for (i = 0; i < count; i += 2) CloseHandle( handles[i] );
+    for (i = 0; i < count; i += count / 100)
+    {
+        sprintf( name, "om.c-test-many-named-objects-%d", i );
+        handle = OpenEventA( EVENT_ALL_ACCESS, FALSE, name );
+        if (i & 1) ok( handle != NULL, "OpenEvent %s failed %u\n", name, GetLastError() );
+        else ok( handle == NULL, "OpenEvent %s succeeded\n", name );
+        if (handle) CloseHandle( handle );
+    }
+    for (i = 1; i < count; i += 2) CloseHandle( handles[i] );
+    HeapFree( GetProcessHeap(), 0, handles );
+}
+
 START_TEST(om)
 {
     HMODULE hntdll = GetModuleHandleA("ntdll.dll");
     HMODULE hkernel32 = GetModuleHandleA("kernel32.dll");
+    char **argv;
+    int argc;
 
     if (!hntdll)
     {
@@ -767,6 +1026,14 @@ START_TEST(om)
     pNtCreateTimer          =  (void *)GetProcAddress(hntdll, "NtCreateTimer");
     pNtCreateSection        =  (void *)GetProcAddress(hntdll, "NtCreateSection");
     pNtQueryObject          =  (void *)GetProcAddress(hntdll, "NtQueryObject");
+    pwine_server_call_batch =  (void *)GetProcAddress(hntdll, "wine_server_call_batch");
+
+    argc = winetest_get_mainargs( &argv );
+    if (argc >= 3 && !strcmp( argv[2], "server_call_rate" ))
+    {
+        test_server_call_rate();
+        return;
+    }
 
     test_case_sensitive();
     test_namespace_pipe();
@@ -774,4 +1041,9 @@ START_TEST(om)
     test_directory();
     test_symboliclink();
     test_query_object();
+    test_handle_churn();
+    test_call_batch();
+    test_many_named_objects();
+    test_server_call_rate();
+    test_server_call_rate_shm( argv[0] );
 }
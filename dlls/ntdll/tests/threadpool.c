@@ -0,0 +1,356 @@
+/*
+ * Unit test suite for thread pool functions
+ *
+ * Copyright 2009 Wine project
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "ntdll_test.h"
+
+static NTSTATUS (WINAPI *pTpAllocCleanupGroup)(TP_CLEANUP_GROUP **);
+static NTSTATUS (WINAPI *pTpAllocPool)(TP_POOL **,void *);
+static NTSTATUS (WINAPI *pTpAllocTimer)(TP_TIMER **,PTP_TIMER_CALLBACK,void *,TP_CALLBACK_ENVIRON *);
+static NTSTATUS (WINAPI *pTpAllocWait)(TP_WAIT **,PTP_WAIT_CALLBACK,void *,TP_CALLBACK_ENVIRON *);
+static NTSTATUS (WINAPI *pTpAllocWork)(TP_WORK **,PTP_WORK_CALLBACK,void *,TP_CALLBACK_ENVIRON *);
+static BOOL     (WINAPI *pTpIsTimerSet)(TP_TIMER *);
+static void     (WINAPI *pTpPostWork)(TP_WORK *);
+static void     (WINAPI *pTpReleaseCleanupGroup)(TP_CLEANUP_GROUP *);
+static void     (WINAPI *pTpReleaseCleanupGroupMembers)(TP_CLEANUP_GROUP *,BOOL,void *);
+static void     (WINAPI *pTpReleasePool)(TP_POOL *);
+static void     (WINAPI *pTpReleaseTimer)(TP_TIMER *);
+static void     (WINAPI *pTpReleaseWait)(TP_WAIT *);
+static void     (WINAPI *pTpReleaseWork)(TP_WORK *);
+static void     (WINAPI *pTpSetPoolMaxThreads)(TP_POOL *,DWORD);
+static void     (WINAPI *pTpSetTimer)(TP_TIMER *,LARGE_INTEGER *,LONG,LONG);
+static void     (WINAPI *pTpSetWait)(TP_WAIT *,HANDLE,LARGE_INTEGER *);
+static NTSTATUS (WINAPI *pTpSimpleTryPost)(PTP_SIMPLE_CALLBACK,PVOID,TP_CALLBACK_ENVIRON *);
+static void     (WINAPI *pTpWaitForTimer)(TP_TIMER *,BOOL);
+static void     (WINAPI *pTpWaitForWait)(TP_WAIT *,BOOL);
+static void     (WINAPI *pTpWaitForWork)(TP_WORK *,BOOL);
+
+#define NTDLL_GET_PROC(func) \
+    do \
+    { \
+        p ## func = (void *)GetProcAddress( module, #func ); \
+        if (!p ## func) \
+        { \
+            win_skip( "Failed to get function pointer for %s\n", #func ); \
+            return FALSE; \
+        } \
+    } while (0)
+
+static BOOL init_threadpool(void)
+{
+    HMODULE module = GetModuleHandleA( "ntdll" );
+
+    NTDLL_GET_PROC(TpAllocCleanupGroup);
+    NTDLL_GET_PROC(TpAllocPool);
+    NTDLL_GET_PROC(TpAllocTimer);
+    NTDLL_GET_PROC(TpAllocWait);
+    NTDLL_GET_PROC(TpAllocWork);
+    NTDLL_GET_PROC(TpIsTimerSet);
+    NTDLL_GET_PROC(TpPostWork);
+    NTDLL_GET_PROC(TpReleaseCleanupGroup);
+    NTDLL_GET_PROC(TpReleaseCleanupGroupMembers);
+    NTDLL_GET_PROC(TpReleasePool);
+    NTDLL_GET_PROC(TpReleaseTimer);
+    NTDLL_GET_PROC(TpReleaseWait);
+    NTDLL_GET_PROC(TpReleaseWork);
+    NTDLL_GET_PROC(TpSetPoolMaxThreads);
+    NTDLL_GET_PROC(TpSetTimer);
+    NTDLL_GET_PROC(TpSetWait);
+    NTDLL_GET_PROC(TpSimpleTryPost);
+    NTDLL_GET_PROC(TpWaitForTimer);
+    NTDLL_GET_PROC(TpWaitForWait);
+    NTDLL_GET_PROC(TpWaitForWork);
+    return TRUE;
+}
+
+#undef NTDLL_GET_PROC
+
+static void CALLBACK simple_cb(TP_CALLBACK_INSTANCE *instance, void *userdata)
+{
+    HANDLE semaphore = userdata;
+    ReleaseSemaphore( semaphore, 1, NULL );
+}
+
+static void test_tp_simple(void)
+{
+    TP_CALLBACK_ENVIRON environment;
+    TP_POOL *pool;
+    HANDLE semaphore;
+    NTSTATUS status;
+    DWORD result;
+
+    semaphore = CreateSemaphoreA( NULL, 0, 1, NULL );
+    ok( semaphore != NULL, "CreateSemaphoreA failed %u\n", GetLastError() );
+
+    /* post the callback using the default pool */
+    status = pTpSimpleTryPost( simple_cb, semaphore, NULL );
+    ok( !status, "TpSimpleTryPost failed with status %x\n", status );
+    result = WaitForSingleObject( semaphore, 1000 );
+    ok( result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result );
+
+    /* post the callback using a private pool */
+    status = pTpAllocPool( &pool, NULL );
+    ok( !status, "TpAllocPool failed with status %x\n", status );
+    ok( pool != NULL, "expected pool != NULL\n" );
+
+    memset( &environment, 0, sizeof(environment) );
+    environment.Version = 1;
+    environment.Pool = pool;
+    status = pTpSimpleTryPost( simple_cb, semaphore, &environment );
+    ok( !status, "TpSimpleTryPost failed with status %x\n", status );
+    result = WaitForSingleObject( semaphore, 1000 );
+    ok( result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result );
+
+    pTpReleasePool( pool );
+    CloseHandle( semaphore );
+}
+
+static void CALLBACK work_cb(TP_CALLBACK_INSTANCE *instance, void *userdata, TP_WORK *work)
+{
+    LONG *count = userdata;
+    Sleep( 10 );
+    InterlockedIncrement( count );
+}
+
+static void CALLBACK work_nested_cb(TP_CALLBACK_INSTANCE *instance, void *userdata, TP_WORK *work)
+{
+    LONG *count = userdata;
+    /* items posted from a worker go to its local queue and may be stolen */
+    if (InterlockedIncrement( count ) <= 10) pTpPostWork( work );
+}
+
+static void test_tp_work(void)
+{
+    TP_CALLBACK_ENVIRON environment;
+    TP_WORK *work;
+    TP_POOL *pool;
+    NTSTATUS status;
+    LONG count;
+    int i;
+
+    status = pTpAllocPool( &pool, NULL );
+    ok( !status, "TpAllocPool failed with status %x\n", status );
+    pTpSetPoolMaxThreads( pool, 2 );
+
+    memset( &environment, 0, sizeof(environment) );
+    environment.Version = 1;
+    environment.Pool = pool;
+
+    /* the wait waits for all pending and running callbacks */
+    status = pTpAllocWork( &work, work_cb, &count, &environment );
+    ok( !status, "TpAllocWork failed with status %x\n", status );
+    count = 0;
+    for (i = 0; i < 10; i++) pTpPostWork( work );
+    pTpWaitForWork( work, FALSE );
+    ok( count == 10, "expected count = 10, got %u\n", count );
+
+    /* cancelling drops callbacks that did not start yet */
+    count = 0;
+    for (i = 0; i < 10; i++) pTpPostWork( work );
+    pTpWaitForWork( work, TRUE );
+    ok( count <= 10, "expected count <= 10, got %u\n", count );
+    pTpReleaseWork( work );
+
+    /* work posted from inside a callback */
+    status = pTpAllocWork( &work, work_nested_cb, &count, &environment );
+    ok( !status, "TpAllocWork failed with status %x\n", status );
+    count = 0;
+    pTpPostWork( work );
+    for (i = 0; i < 100 && count < 11; i++) Sleep( 10 );
+    pTpWaitForWork( work, FALSE );
+    ok( count == 11, "expected count = 11, got %u\n", count );
+    pTpReleaseWork( work );
+
+    pTpReleasePool( pool );
+}
+
+static void CALLBACK timer_cb(TP_CALLBACK_INSTANCE *instance, void *userdata, TP_TIMER *timer)
+{
+    HANDLE semaphore = userdata;
+    ReleaseSemaphore( semaphore, 1, NULL );
+}
+
+static void test_tp_timer(void)
+{
+    TP_TIMER *timer;
+    LARGE_INTEGER when;
+    HANDLE semaphore;
+    NTSTATUS status;
+    DWORD result, ticks;
+    int i;
+
+    semaphore = CreateSemaphoreA( NULL, 0, 10, NULL );
+    ok( semaphore != NULL, "CreateSemaphoreA failed %u\n", GetLastError() );
+
+    status = pTpAllocTimer( &timer, timer_cb, semaphore, NULL );
+    ok( !status, "TpAllocTimer failed with status %x\n", status );
+    ok( !pTpIsTimerSet( timer ), "expected timer not to be set\n" );
+
+    /* one-shot relative timer */
+    ticks = GetTickCount();
+    when.QuadPart = (ULONGLONG)200 * -10000;
+    pTpSetTimer( timer, &when, 0, 0 );
+    ok( pTpIsTimerSet( timer ), "expected timer to be set\n" );
+    result = WaitForSingleObject( semaphore, 1000 );
+    ok( result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result );
+    ticks = GetTickCount() - ticks;
+    ok( ticks >= 150 && ticks <= 500, "expected approximately 200 ticks, got %u\n", ticks );
+    result = WaitForSingleObject( semaphore, 100 );
+    ok( result == WAIT_TIMEOUT, "WaitForSingleObject returned %u\n", result );
+
+    /* periodic timer with a coalescing window */
+    when.QuadPart = 0;
+    pTpSetTimer( timer, &when, 50, 10 );
+    for (i = 0; i < 4; i++)
+    {
+        result = WaitForSingleObject( semaphore, 1000 );
+        ok( result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result );
+    }
+    pTpSetTimer( timer, NULL, 0, 0 );
+    ok( !pTpIsTimerSet( timer ), "expected timer not to be set\n" );
+    pTpWaitForTimer( timer, TRUE );
+
+    pTpReleaseTimer( timer );
+    CloseHandle( semaphore );
+}
+
+struct wait_info
+{
+    HANDLE semaphore;
+    LONG   userdata;
+};
+
+static void CALLBACK wait_cb(TP_CALLBACK_INSTANCE *instance, void *userdata,
+                             TP_WAIT *wait, TP_WAIT_RESULT result)
+{
+    struct wait_info *info = userdata;
+    if (result == WAIT_OBJECT_0)
+        InterlockedIncrement( &info->userdata );
+    else if (result == WAIT_TIMEOUT)
+        InterlockedExchangeAdd( &info->userdata, 0x10000 );
+    else
+        ok( 0, "unexpected result %u\n", result );
+    ReleaseSemaphore( info->semaphore, 1, NULL );
+}
+
+static void test_tp_wait(void)
+{
+    struct wait_info info;
+    TP_WAIT *wait;
+    LARGE_INTEGER timeout;
+    HANDLE event;
+    NTSTATUS status;
+    DWORD result;
+
+    info.semaphore = CreateSemaphoreA( NULL, 0, 1, NULL );
+    ok( info.semaphore != NULL, "CreateSemaphoreA failed %u\n", GetLastError() );
+    event = CreateEventA( NULL, FALSE, FALSE, NULL );
+    ok( event != NULL, "CreateEventA failed %u\n", GetLastError() );
+
+    status = pTpAllocWait( &wait, wait_cb, &info, NULL );
+    ok( !status, "TpAllocWait failed with status %x\n", status );
+
+    /* signaled object */
+    info.userdata = 0;
+    pTpSetWait( wait, event, NULL );
+    SetEvent( event );
+    result = WaitForSingleObject( info.semaphore, 1000 );
+    ok( result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result );
+    ok( info.userdata == 1, "expected info.userdata = 1, got %u\n", info.userdata );
+
+    /* the wait is one-shot, a second signal must not run the callback */
+    SetEvent( event );
+    result = WaitForSingleObject( info.semaphore, 100 );
+    ok( result == WAIT_TIMEOUT, "WaitForSingleObject returned %u\n", result );
+    ResetEvent( event );
+
+    /* timeout */
+    info.userdata = 0;
+    timeout.QuadPart = (ULONGLONG)100 * -10000;
+    pTpSetWait( wait, event, &timeout );
+    result = WaitForSingleObject( info.semaphore, 1000 );
+    ok( result == WAIT_OBJECT_0, "WaitForSingleObject returned %u\n", result );
+    ok( info.userdata == 0x10000, "expected info.userdata = 0x10000, got %u\n", info.userdata );
+
+    /* unsetting the wait */
+    info.userdata = 0;
+    pTpSetWait( wait, event, NULL );
+    pTpSetWait( wait, NULL, NULL );
+    pTpWaitForWait( wait, FALSE );
+    SetEvent( event );
+    result = WaitForSingleObject( info.semaphore, 100 );
+    ok( result == WAIT_TIMEOUT, "WaitForSingleObject returned %u\n", result );
+    ok( info.userdata == 0, "expected info.userdata = 0, got %u\n", info.userdata );
+
+    pTpReleaseWait( wait );
+    CloseHandle( event );
+    CloseHandle( info.semaphore );
+}
+
+static void CALLBACK group_cancel_cb(void *object, void *userdata)
+{
+    LONG *count = userdata;
+    InterlockedIncrement( count );
+}
+
+static void test_tp_group(void)
+{
+    TP_CALLBACK_ENVIRON environment;
+    TP_CLEANUP_GROUP *group;
+    TP_WORK *work;
+    TP_POOL *pool;
+    NTSTATUS status;
+    LONG count;
+    int i;
+
+    status = pTpAllocPool( &pool, NULL );
+    ok( !status, "TpAllocPool failed with status %x\n", status );
+    status = pTpAllocCleanupGroup( &group );
+    ok( !status, "TpAllocCleanupGroup failed with status %x\n", status );
+    ok( group != NULL, "expected group != NULL\n" );
+
+    memset( &environment, 0, sizeof(environment) );
+    environment.Version = 1;
+    environment.Pool = pool;
+    environment.CleanupGroup = group;
+    environment.CleanupGroupCancelCallback = group_cancel_cb;
+
+    /* releasing the members waits for pending callbacks and frees the objects */
+    count = 0;
+    status = pTpAllocWork( &work, work_cb, &count, &environment );
+    ok( !status, "TpAllocWork failed with status %x\n", status );
+    for (i = 0; i < 3; i++) pTpPostWork( work );
+    pTpReleaseCleanupGroupMembers( group, FALSE, NULL );
+    ok( count == 3, "expected count = 3, got %u\n", count );
+
+    pTpReleaseCleanupGroup( group );
+    pTpReleasePool( pool );
+}
+
+START_TEST(threadpool)
+{
+    if (!init_threadpool())
+        return;
+
+    test_tp_simple();
+    test_tp_work();
+    test_tp_timer();
+    test_tp_wait();
+    test_tp_group();
+}
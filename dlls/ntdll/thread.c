@@ -264,6 +264,7 @@ HANDLE thread_init(void)
     /* setup the server connection */
     server_init_process();
     info_size = server_init_thread( peb );
+    server_init_sync_shm();
 
     /* create the process heap */
     if (!(peb->ProcessHeap = RtlCreateHeap( HEAP_GROWABLE, NULL, 0, 0, NULL, NULL )))
@@ -313,6 +314,8 @@ void terminate_thread( int status )
     pthread_sigmask( SIG_BLOCK, &server_block_set, NULL );
     if (interlocked_xchg_add( &nb_threads, -1 ) <= 1) _exit( status );
 
+    heap_thread_detach();
+    server_free_request_shm();
     close( ntdll_get_thread_data()->wait_fd[0] );
     close( ntdll_get_thread_data()->wait_fd[1] );
     close( ntdll_get_thread_data()->reply_fd );
@@ -352,6 +355,7 @@ void exit_thread( int status )
     RtlReleasePebLock();
     RtlFreeHeap( GetProcessHeap(), 0, NtCurrentTeb()->FlsSlots );
     RtlFreeHeap( GetProcessHeap(), 0, NtCurrentTeb()->TlsExpansionSlots );
+    heap_thread_detach();
 
     pthread_sigmask( SIG_BLOCK, &server_block_set, NULL );
 
@@ -366,6 +370,7 @@ void exit_thread( int status )
         }
     }
 
+    server_free_request_shm();
     close( ntdll_get_thread_data()->wait_fd[0] );
     close( ntdll_get_thread_data()->wait_fd[1] );
     close( ntdll_get_thread_data()->reply_fd );
@@ -321,219 +321,6 @@ static inline PLARGE_INTEGER get_nt_timeout( PLARGE_INTEGER pTime, ULONG timeout
     return pTime;
 }
 
-struct wait_work_item
-{
-    HANDLE Object;
-    HANDLE CancelEvent;
-    WAITORTIMERCALLBACK Callback;
-    PVOID Context;
-    ULONG Milliseconds;
-    ULONG Flags;
-    HANDLE CompletionEvent;
-    LONG DeleteCount;
-    BOOLEAN CallbackInProgress;
-};
-
-static void delete_wait_work_item(struct wait_work_item *wait_work_item)
-{
-    NtClose( wait_work_item->CancelEvent );
-    RtlFreeHeap( GetProcessHeap(), 0, wait_work_item );
-}
-
-static DWORD CALLBACK wait_thread_proc(LPVOID Arg)
-{
-    struct wait_work_item *wait_work_item = Arg;
-    NTSTATUS status;
-    BOOLEAN alertable = (wait_work_item->Flags & WT_EXECUTEINIOTHREAD) ? TRUE : FALSE;
-    HANDLE handles[2] = { wait_work_item->Object, wait_work_item->CancelEvent };
-    LARGE_INTEGER timeout;
-    HANDLE completion_event;
-
-    TRACE("\n");
-
-    while (TRUE)
-    {
-        status = NtWaitForMultipleObjects( 2, handles, FALSE, alertable,
-                                           get_nt_timeout( &timeout, wait_work_item->Milliseconds ) );
-        if (status == STATUS_WAIT_0 || status == STATUS_TIMEOUT)
-        {
-            BOOLEAN TimerOrWaitFired;
-
-            if (status == STATUS_WAIT_0)
-            {
-                TRACE( "object %p signaled, calling callback %p with context %p\n",
-                    wait_work_item->Object, wait_work_item->Callback,
-                    wait_work_item->Context );
-                TimerOrWaitFired = FALSE;
-            }
-            else
-            {
-                TRACE( "wait for object %p timed out, calling callback %p with context %p\n",
-                    wait_work_item->Object, wait_work_item->Callback,
-                    wait_work_item->Context );
-                TimerOrWaitFired = TRUE;
-            }
-            wait_work_item->CallbackInProgress = TRUE;
-            wait_work_item->Callback( wait_work_item->Context, TimerOrWaitFired );
-            wait_work_item->CallbackInProgress = FALSE;
-
-            if (wait_work_item->Flags & WT_EXECUTEONLYONCE)
-                break;
-        }
-        else
-            break;
-    }
-
-    completion_event = wait_work_item->CompletionEvent;
-    if (completion_event) NtSetEvent( completion_event, NULL );
-
-    if (interlocked_inc( &wait_work_item->DeleteCount ) == 2 )
-        delete_wait_work_item( wait_work_item );
-
-    return 0;
-}
-
-/***********************************************************************
- *              RtlRegisterWait   (NTDLL.@)
- *
- * Registers a wait for a handle to become signaled.
- *
- * PARAMS
- *  NewWaitObject [I] Handle to the new wait object. Use RtlDeregisterWait() to free it.
- *  Object   [I] Object to wait to become signaled.
- *  Callback [I] Callback function to execute when the wait times out or the handle is signaled.
- *  Context  [I] Context to pass to the callback function when it is executed.
- *  Milliseconds [I] Number of milliseconds to wait before timing out.
- *  Flags    [I] Flags. See notes.
- *
- * RETURNS
- *  Success: STATUS_SUCCESS.
- *  Failure: Any NTSTATUS code.
- *
- * NOTES
- *  Flags can be one or more of the following:
- *|WT_EXECUTEDEFAULT - Executes the work item in a non-I/O worker thread.
- *|WT_EXECUTEINIOTHREAD - Executes the work item in an I/O worker thread.
- *|WT_EXECUTEINPERSISTENTTHREAD - Executes the work item in a thread that is persistent.
- *|WT_EXECUTELONGFUNCTION - Hints that the execution can take a long time.
- *|WT_TRANSFER_IMPERSONATION - Executes the function with the current access token.
- */
-NTSTATUS WINAPI RtlRegisterWait(PHANDLE NewWaitObject, HANDLE Object,
-                                RTL_WAITORTIMERCALLBACKFUNC Callback,
-                                PVOID Context, ULONG Milliseconds, ULONG Flags)
-{
-    struct wait_work_item *wait_work_item;
-    NTSTATUS status;
-
-    TRACE( "(%p, %p, %p, %p, %d, 0x%x)\n", NewWaitObject, Object, Callback, Context, Milliseconds, Flags );
-
-    wait_work_item = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*wait_work_item) );
-    if (!wait_work_item)
-        return STATUS_NO_MEMORY;
-
-    wait_work_item->Object = Object;
-    wait_work_item->Callback = Callback;
-    wait_work_item->Context = Context;
-    wait_work_item->Milliseconds = Milliseconds;
-    wait_work_item->Flags = Flags;
-    wait_work_item->CallbackInProgress = FALSE;
-    wait_work_item->DeleteCount = 0;
-    wait_work_item->CompletionEvent = NULL;
-
-    status = NtCreateEvent( &wait_work_item->CancelEvent, EVENT_ALL_ACCESS, NULL, NotificationEvent, FALSE );
-    if (status != STATUS_SUCCESS)
-    {
-        RtlFreeHeap( GetProcessHeap(), 0, wait_work_item );
-        return status;
-    }
-
-    Flags = Flags & (WT_EXECUTEINIOTHREAD | WT_EXECUTEINPERSISTENTTHREAD |
-                     WT_EXECUTELONGFUNCTION | WT_TRANSFER_IMPERSONATION);
-    status = RtlQueueWorkItem( wait_thread_proc, wait_work_item, Flags );
-    if (status != STATUS_SUCCESS)
-    {
-        delete_wait_work_item( wait_work_item );
-        return status;
-    }
-
-    *NewWaitObject = wait_work_item;
-    return status;
-}
-
-/***********************************************************************
- *              RtlDeregisterWaitEx   (NTDLL.@)
- *
- * Cancels a wait operation and frees the resources associated with calling
- * RtlRegisterWait().
- *
- * PARAMS
- *  WaitObject [I] Handle to the wait object to free.
- *
- * RETURNS
- *  Success: STATUS_SUCCESS.
- *  Failure: Any NTSTATUS code.
- */
-NTSTATUS WINAPI RtlDeregisterWaitEx(HANDLE WaitHandle, HANDLE CompletionEvent)
-{
-    struct wait_work_item *wait_work_item = WaitHandle;
-    NTSTATUS status = STATUS_SUCCESS;
-
-    TRACE( "(%p)\n", WaitHandle );
-
-    NtSetEvent( wait_work_item->CancelEvent, NULL );
-    if (wait_work_item->CallbackInProgress)
-    {
-        if (CompletionEvent != NULL)
-        {
-            if (CompletionEvent == INVALID_HANDLE_VALUE)
-            {
-                status = NtCreateEvent( &CompletionEvent, EVENT_ALL_ACCESS, NULL, NotificationEvent, FALSE );
-                if (status != STATUS_SUCCESS)
-                    return status;
-                interlocked_xchg_ptr( &wait_work_item->CompletionEvent, CompletionEvent );
-                if (wait_work_item->CallbackInProgress)
-                    NtWaitForSingleObject( CompletionEvent, FALSE, NULL );
-                NtClose( CompletionEvent );
-            }
-            else
-            {
-                interlocked_xchg_ptr( &wait_work_item->CompletionEvent, CompletionEvent );
-                if (wait_work_item->CallbackInProgress)
-                    status = STATUS_PENDING;
-            }
-        }
-        else
-            status = STATUS_PENDING;
-    }
-
-    if (interlocked_inc( &wait_work_item->DeleteCount ) == 2 )
-    {
-        status = STATUS_SUCCESS;
-        delete_wait_work_item( wait_work_item );
-    }
-
-    return status;
-}
-
-/***********************************************************************
- *              RtlDeregisterWait   (NTDLL.@)
- *
- * Cancels a wait operation and frees the resources associated with calling
- * RtlRegisterWait().
- *
- * PARAMS
- *  WaitObject [I] Handle to the wait object to free.
- *
- * RETURNS
- *  Success: STATUS_SUCCESS.
- *  Failure: Any NTSTATUS code.
- */
-NTSTATUS WINAPI RtlDeregisterWait(HANDLE WaitHandle)
-{
-    return RtlDeregisterWaitEx(WaitHandle, NULL);
-}
-
-
 /************************** Timer Queue Impl **************************/
 
 struct timer_queue;
@@ -1035,3 +822,2069 @@ NTSTATUS WINAPI RtlDeleteTimer(HANDLE TimerQueue, HANDLE Timer,
 
     return status;
 }
+
+
+/************************** Thread pool objects **************************/
+
+#define THREADPOOL_WORKER_TIMEOUT  5000   /* idle time before a worker exits, in ms */
+#define THREADPOOL_MAX_WORKERS     500
+#define THREADPOOL_DEQUE_SIZE      32
+#define WAITQUEUE_BUCKET_TIMEOUT   20000  /* idle time before a wait thread exits, in ms */
+
+struct threadpool_object;
+
+/* one pending callback, the object holds a reference for each of them */
+struct threadpool_task
+{
+    struct threadpool_object *object;
+    ULONG_PTR                 arg;     /* wait result or I/O completion */
+};
+
+/* Work-stealing queue: the owning worker pushes and pops at the tail so that
+ * it keeps running the most recently queued (and cache-hot) callbacks, while
+ * idle workers steal the oldest ones from the head. */
+struct threadpool_deque
+{
+    RTL_SRWLOCK             lock;
+    unsigned int            head;
+    unsigned int            tail;
+    unsigned int            size;     /* always a power of two */
+    struct threadpool_task *tasks;
+};
+
+struct threadpool_worker
+{
+    struct list             entry;    /* entry in pool workers list */
+    struct threadpool      *pool;
+    struct threadpool_deque deque;    /* callbacks queued by this worker */
+};
+
+struct threadpool
+{
+    LONG                    refcount;
+    BOOL                    shutdown;
+    RTL_CRITICAL_SECTION    cs;                 /* protects the worker list and counts */
+    struct threadpool_deque queue;              /* callbacks queued from other threads */
+    struct list             workers;
+    LONG                    pending;            /* number of tasks in all the queues */
+    LONG                    num_idle_workers;   /* workers sleeping on update_event */
+    LONG                    num_busy_workers;   /* workers running a callback */
+    int                     num_workers;
+    int                     max_workers;
+    int                     min_workers;
+    RTL_CONDITION_VARIABLE  update_event;       /* signaled when tasks are queued */
+};
+
+enum threadpool_objtype
+{
+    TP_OBJECT_TYPE_SIMPLE,
+    TP_OBJECT_TYPE_WORK,
+    TP_OBJECT_TYPE_TIMER,
+    TP_OBJECT_TYPE_WAIT,
+    TP_OBJECT_TYPE_IO
+};
+
+struct threadpool_object
+{
+    void                   *win32_callback;     /* leave space for kernel32 to store its callback */
+    LONG                    refcount;
+    BOOL                    shutdown;           /* released by the application */
+    enum threadpool_objtype type;
+    struct threadpool      *pool;
+    struct threadpool_group *group;
+    PVOID                   userdata;
+    PTP_CLEANUP_GROUP_CANCEL_CALLBACK group_cancel_callback;
+    PTP_SIMPLE_CALLBACK     finalization_callback;
+    BOOL                    may_run_long;
+    HMODULE                 race_dll;
+    struct list             group_entry;        /* protected by group->cs */
+    BOOL                    is_group_member;
+    RTL_SRWLOCK             lock;               /* protects the callback counts */
+    LONG                    num_pending_callbacks;
+    LONG                    num_running_callbacks;
+    LONG                    num_cancelled;      /* queued tasks that must not run */
+    RTL_CONDITION_VARIABLE  finished_event;     /* signaled when no callback is left */
+    HANDLE                  completion_event;   /* set when the object is destroyed */
+    union
+    {
+        struct
+        {
+            PTP_SIMPLE_CALLBACK callback;
+        } simple;
+        struct
+        {
+            PTP_WORK_CALLBACK callback;
+        } work;
+        struct
+        {
+            PTP_TIMER_CALLBACK callback;
+            struct list     timer_entry;        /* entry in timerqueue list, protected by timerqueue.cs */
+            BOOL            timer_pending;      /* in the timerqueue list? */
+            BOOL            timer_set;
+            ULONGLONG       timeout;            /* absolute, in 100ns units */
+            LONG            period;             /* in ms */
+            LONG            window;             /* in ms */
+        } timer;
+        struct
+        {
+            PTP_WAIT_CALLBACK callback;
+            struct waitqueue_bucket *bucket;
+            struct list     wait_entry;         /* entry in bucket lists, protected by waitqueue.cs */
+            BOOL            wait_pending;       /* in the bucket waiting list? */
+            ULONGLONG       timeout;            /* absolute, in 100ns units */
+            HANDLE          handle;
+            /* waits registered with RtlRegisterWait */
+            RTL_WAITORTIMERCALLBACKFUNC rtl_callback;
+            ULONG           rtl_flags;
+            ULONG           rtl_timeout;        /* in ms */
+        } wait;
+        struct
+        {
+            PTP_IO_CALLBACK callback;
+            LONG            pending_count;      /* started asynchronous operations */
+        } io;
+    } u;
+};
+
+/* state of a running callback, passed to it as TP_CALLBACK_INSTANCE */
+struct threadpool_instance
+{
+    struct threadpool_object *object;
+    DWORD                   threadid;
+    BOOL                    associated;
+    BOOL                    may_run_long;
+    struct
+    {
+        RTL_CRITICAL_SECTION *critical_section;
+        HANDLE              mutex;
+        HANDLE              semaphore;
+        LONG                semaphore_count;
+        HANDLE              event;
+        HMODULE             library;
+    } cleanup;
+};
+
+struct threadpool_group
+{
+    LONG                    refcount;
+    BOOL                    shutdown;
+    RTL_CRITICAL_SECTION    cs;
+    struct list             members;            /* objects allocated with this group */
+};
+
+struct io_completion
+{
+    IO_STATUS_BLOCK         iosb;
+    ULONG_PTR               cvalue;
+};
+
+static struct threadpool *default_threadpool;
+
+static inline struct threadpool *impl_from_TP_POOL( TP_POOL *pool )
+{
+    return (struct threadpool *)pool;
+}
+
+static inline struct threadpool_object *impl_from_TP_WORK( TP_WORK *work )
+{
+    struct threadpool_object *object = (struct threadpool_object *)work;
+    assert( object->type == TP_OBJECT_TYPE_WORK );
+    return object;
+}
+
+static inline struct threadpool_object *impl_from_TP_TIMER( TP_TIMER *timer )
+{
+    struct threadpool_object *object = (struct threadpool_object *)timer;
+    assert( object->type == TP_OBJECT_TYPE_TIMER );
+    return object;
+}
+
+static inline struct threadpool_object *impl_from_TP_WAIT( TP_WAIT *wait )
+{
+    struct threadpool_object *object = (struct threadpool_object *)wait;
+    assert( object->type == TP_OBJECT_TYPE_WAIT );
+    return object;
+}
+
+static inline struct threadpool_object *impl_from_TP_IO( TP_IO *io )
+{
+    struct threadpool_object *object = (struct threadpool_object *)io;
+    assert( object->type == TP_OBJECT_TYPE_IO );
+    return object;
+}
+
+static inline struct threadpool_group *impl_from_TP_CLEANUP_GROUP( TP_CLEANUP_GROUP *group )
+{
+    return (struct threadpool_group *)group;
+}
+
+static inline struct threadpool_instance *impl_from_TP_CALLBACK_INSTANCE( TP_CALLBACK_INSTANCE *instance )
+{
+    return (struct threadpool_instance *)instance;
+}
+
+static void tp_object_submit( struct threadpool_object *object, ULONG_PTR arg );
+static void tp_object_release( struct threadpool_object *object );
+
+
+/* deque helpers */
+
+static BOOL tp_deque_push( struct threadpool_deque *deque, const struct threadpool_task *task )
+{
+    BOOL ret = TRUE;
+
+    RtlAcquireSRWLockExclusive( &deque->lock );
+    if (deque->tail - deque->head == deque->size)
+    {
+        unsigned int i, size = deque->size ? deque->size * 2 : THREADPOOL_DEQUE_SIZE;
+        struct threadpool_task *tasks = RtlAllocateHeap( GetProcessHeap(), 0, size * sizeof(*tasks) );
+
+        if (!tasks) ret = FALSE;
+        else
+        {
+            for (i = 0; deque->head + i != deque->tail; i++)
+                tasks[i] = deque->tasks[(deque->head + i) & (deque->size - 1)];
+            RtlFreeHeap( GetProcessHeap(), 0, deque->tasks );
+            deque->tasks = tasks;
+            deque->size  = size;
+            deque->head  = 0;
+            deque->tail  = i;
+        }
+    }
+    if (ret) deque->tasks[deque->tail++ & (deque->size - 1)] = *task;
+    RtlReleaseSRWLockExclusive( &deque->lock );
+    return ret;
+}
+
+static BOOL tp_deque_pop_tail( struct threadpool_deque *deque, struct threadpool_task *task )
+{
+    BOOL ret = FALSE;
+
+    if (deque->tail == deque->head) return FALSE;
+    RtlAcquireSRWLockExclusive( &deque->lock );
+    if (deque->tail != deque->head)
+    {
+        *task = deque->tasks[--deque->tail & (deque->size - 1)];
+        ret = TRUE;
+    }
+    RtlReleaseSRWLockExclusive( &deque->lock );
+    return ret;
+}
+
+static BOOL tp_deque_pop_head( struct threadpool_deque *deque, struct threadpool_task *task )
+{
+    BOOL ret = FALSE;
+
+    if (deque->tail == deque->head) return FALSE;
+    RtlAcquireSRWLockExclusive( &deque->lock );
+    if (deque->tail != deque->head)
+    {
+        *task = deque->tasks[deque->head++ & (deque->size - 1)];
+        ret = TRUE;
+    }
+    RtlReleaseSRWLockExclusive( &deque->lock );
+    return ret;
+}
+
+
+/* pool and worker threads */
+
+static void tp_threadpool_release( struct threadpool *pool )
+{
+    if (interlocked_dec( &pool->refcount )) return;
+
+    assert( pool->shutdown );
+    assert( !pool->num_workers );
+    RtlFreeHeap( GetProcessHeap(), 0, pool->queue.tasks );
+    pool->cs.DebugInfo->Spare[0] = 0;
+    RtlDeleteCriticalSection( &pool->cs );
+    RtlFreeHeap( GetProcessHeap(), 0, pool );
+}
+
+/* find a task in the local queue, the pool queue, or steal one from another worker */
+static BOOL tp_worker_get_task( struct threadpool_worker *worker, struct threadpool_task *task )
+{
+    struct threadpool *pool = worker->pool;
+    struct threadpool_worker *other;
+    BOOL ret = FALSE;
+
+    if (pool->pending <= 0) return FALSE;
+
+    if (tp_deque_pop_tail( &worker->deque, task ) || tp_deque_pop_head( &pool->queue, task ))
+        ret = TRUE;
+    else
+    {
+        RtlEnterCriticalSection( &pool->cs );
+        LIST_FOR_EACH_ENTRY( other, &pool->workers, struct threadpool_worker, entry )
+        {
+            if (other != worker && (ret = tp_deque_pop_head( &other->deque, task ))) break;
+        }
+        RtlLeaveCriticalSection( &pool->cs );
+    }
+    if (ret) interlocked_dec( &pool->pending );
+    return ret;
+}
+
+static void tp_instance_cleanup( struct threadpool_instance *instance )
+{
+    if (instance->cleanup.critical_section)
+        RtlLeaveCriticalSection( instance->cleanup.critical_section );
+    if (instance->cleanup.mutex)
+        NtReleaseMutant( instance->cleanup.mutex, NULL );
+    if (instance->cleanup.semaphore)
+        NtReleaseSemaphore( instance->cleanup.semaphore, instance->cleanup.semaphore_count, NULL );
+    if (instance->cleanup.event)
+        NtSetEvent( instance->cleanup.event, NULL );
+    if (instance->cleanup.library)
+        LdrUnloadDll( instance->cleanup.library );
+}
+
+/* mark a running callback as finished, waking up the threads waiting for the object */
+static void tp_object_callback_done( struct threadpool_object *object )
+{
+    BOOL wake;
+
+    RtlAcquireSRWLockExclusive( &object->lock );
+    object->num_running_callbacks--;
+    wake = !object->num_pending_callbacks && !object->num_running_callbacks;
+    RtlReleaseSRWLockExclusive( &object->lock );
+
+    if (wake) RtlWakeAllConditionVariable( &object->finished_event );
+}
+
+static void tp_object_execute( struct threadpool_task *task )
+{
+    struct threadpool_object *object = task->object;
+    struct threadpool *pool = object->pool;
+    struct threadpool_instance instance;
+    TP_CALLBACK_INSTANCE *cb_instance = (TP_CALLBACK_INSTANCE *)&instance;
+    BOOL cancelled;
+
+    RtlAcquireSRWLockExclusive( &object->lock );
+    if ((cancelled = (object->num_cancelled > 0))) object->num_cancelled--;
+    else
+    {
+        object->num_pending_callbacks--;
+        object->num_running_callbacks++;
+    }
+    RtlReleaseSRWLockExclusive( &object->lock );
+
+    if (cancelled)
+    {
+        if (object->type == TP_OBJECT_TYPE_IO)
+            RtlFreeHeap( GetProcessHeap(), 0, (struct io_completion *)task->arg );
+        tp_object_release( object );
+        return;
+    }
+
+    memset( &instance, 0, sizeof(instance) );
+    instance.object       = object;
+    instance.threadid     = GetCurrentThreadId();
+    instance.associated   = TRUE;
+    instance.may_run_long = object->may_run_long;
+
+    interlocked_inc( &pool->num_busy_workers );
+
+    switch (object->type)
+    {
+    case TP_OBJECT_TYPE_SIMPLE:
+        TRACE( "executing simple callback %p(%p, %p)\n",
+               object->u.simple.callback, cb_instance, object->userdata );
+        object->u.simple.callback( cb_instance, object->userdata );
+        break;
+
+    case TP_OBJECT_TYPE_WORK:
+        TRACE( "executing work callback %p(%p, %p, %p)\n",
+               object->u.work.callback, cb_instance, object->userdata, object );
+        object->u.work.callback( cb_instance, object->userdata, (TP_WORK *)object );
+        break;
+
+    case TP_OBJECT_TYPE_TIMER:
+        TRACE( "executing timer callback %p(%p, %p, %p)\n",
+               object->u.timer.callback, cb_instance, object->userdata, object );
+        object->u.timer.callback( cb_instance, object->userdata, (TP_TIMER *)object );
+        break;
+
+    case TP_OBJECT_TYPE_WAIT:
+        TRACE( "executing wait callback %p(%p, %p, %p, %u)\n",
+               object->u.wait.callback, cb_instance, object->userdata, object, (DWORD)task->arg );
+        object->u.wait.callback( cb_instance, object->userdata, (TP_WAIT *)object, task->arg );
+        break;
+
+    case TP_OBJECT_TYPE_IO:
+    {
+        struct io_completion *completion = (struct io_completion *)task->arg;
+
+        TRACE( "executing I/O callback %p(%p, %p, %#lx, %p, %p)\n", object->u.io.callback,
+               cb_instance, object->userdata, completion->cvalue, &completion->iosb, object );
+        object->u.io.callback( cb_instance, object->userdata, (void *)completion->cvalue,
+                               &completion->iosb, (TP_IO *)object );
+        RtlFreeHeap( GetProcessHeap(), 0, completion );
+        break;
+    }
+    }
+
+    if (object->finalization_callback)
+    {
+        TRACE( "executing finalization callback %p(%p, %p)\n",
+               object->finalization_callback, cb_instance, object->userdata );
+        object->finalization_callback( cb_instance, object->userdata );
+    }
+
+    tp_instance_cleanup( &instance );
+    if (instance.associated) tp_object_callback_done( object );
+
+    interlocked_dec( &pool->num_busy_workers );
+    tp_object_release( object );
+}
+
+static void CALLBACK threadpool_worker_proc( void *param )
+{
+    struct threadpool_worker *worker = param;
+    struct threadpool *pool = worker->pool;
+    struct threadpool_task task;
+    LARGE_INTEGER timeout;
+    NTSTATUS status;
+
+    TRACE( "starting worker %p for pool %p\n", worker, pool );
+
+    ntdll_get_thread_data_ext()->tp_worker = worker;
+
+    for (;;)
+    {
+        if (tp_worker_get_task( worker, &task ))
+        {
+            tp_object_execute( &task );
+            continue;
+        }
+
+        /* the idle count is raised before checking for tasks so that tp_object_submit
+         * either sees us as idle or we see its task */
+        interlocked_inc( &pool->num_idle_workers );
+        RtlEnterCriticalSection( &pool->cs );
+        if (pool->pending <= 0)
+        {
+            if (pool->shutdown || pool->num_workers > pool->max_workers) break;
+
+            timeout.QuadPart = (ULONGLONG)THREADPOOL_WORKER_TIMEOUT * -10000;
+            status = RtlSleepConditionVariableCS( &pool->update_event, &pool->cs, &timeout );
+            if (status == STATUS_TIMEOUT && pool->pending <= 0 && pool->num_workers > pool->min_workers)
+                break;
+        }
+        RtlLeaveCriticalSection( &pool->cs );
+        interlocked_dec( &pool->num_idle_workers );
+    }
+
+    /* the pool critical section is held here, and our queue is empty
+     * since we only ever push tasks to it ourselves */
+    TRACE( "terminating worker %p for pool %p\n", worker, pool );
+    pool->num_workers--;
+    list_remove( &worker->entry );
+    interlocked_dec( &pool->num_idle_workers );
+    RtlLeaveCriticalSection( &pool->cs );
+
+    ntdll_get_thread_data_ext()->tp_worker = NULL;
+    RtlFreeHeap( GetProcessHeap(), 0, worker->deque.tasks );
+    RtlFreeHeap( GetProcessHeap(), 0, worker );
+    tp_threadpool_release( pool );
+
+    RtlExitUserThread( 0 );
+}
+
+/* start a new worker, must be called with the pool critical section held */
+static NTSTATUS tp_new_worker_thread( struct threadpool *pool )
+{
+    struct threadpool_worker *worker;
+    HANDLE thread;
+    NTSTATUS status;
+
+    if (!(worker = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*worker) )))
+        return STATUS_NO_MEMORY;
+    worker->pool = pool;
+
+    list_add_tail( &pool->workers, &worker->entry );
+    interlocked_inc( &pool->refcount );
+    pool->num_workers++;
+
+    status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                                  threadpool_worker_proc, worker, &thread, NULL );
+    if (status != STATUS_SUCCESS)
+    {
+        pool->num_workers--;
+        interlocked_dec( &pool->refcount );
+        list_remove( &worker->entry );
+        RtlFreeHeap( GetProcessHeap(), 0, worker );
+        return status;
+    }
+
+    NtClose( thread );
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS tp_threadpool_alloc( struct threadpool **out )
+{
+    struct threadpool *pool;
+
+    if (!(pool = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*pool) )))
+        return STATUS_NO_MEMORY;
+
+    pool->refcount    = 1;
+    pool->max_workers = THREADPOOL_MAX_WORKERS;
+    pool->min_workers = 0;
+    RtlInitializeCriticalSection( &pool->cs );
+    pool->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": threadpool.cs");
+    list_init( &pool->workers );
+
+    TRACE( "allocated threadpool %p\n", pool );
+    *out = pool;
+    return STATUS_SUCCESS;
+}
+
+static NTSTATUS tp_threadpool_lock( struct threadpool **out, TP_CALLBACK_ENVIRON *environment )
+{
+    struct threadpool *pool = NULL;
+    NTSTATUS status;
+
+    if (environment) pool = impl_from_TP_POOL( environment->Pool );
+
+    if (!pool)
+    {
+        if (!default_threadpool)
+        {
+            if ((status = tp_threadpool_alloc( &pool ))) return status;
+            if (interlocked_cmpxchg_ptr( (void **)&default_threadpool, pool, NULL ))
+            {
+                /* somebody beat us to it */
+                pool->shutdown = TRUE;
+                tp_threadpool_release( pool );
+            }
+        }
+        pool = default_threadpool;
+    }
+
+    interlocked_inc( &pool->refcount );
+    *out = pool;
+    return STATUS_SUCCESS;
+}
+
+
+/* objects */
+
+static void tp_group_release( struct threadpool_group *group )
+{
+    if (interlocked_dec( &group->refcount )) return;
+
+    TRACE( "destroying group %p\n", group );
+
+    assert( group->shutdown );
+    assert( list_empty( &group->members ) );
+
+    group->cs.DebugInfo->Spare[0] = 0;
+    RtlDeleteCriticalSection( &group->cs );
+    RtlFreeHeap( GetProcessHeap(), 0, group );
+}
+
+static void tp_object_initialize( struct threadpool_object *object, struct threadpool *pool,
+                                  PVOID userdata, TP_CALLBACK_ENVIRON *environment )
+{
+    object->refcount = 1;
+    object->pool     = pool;
+    object->userdata = userdata;
+
+    if (environment)
+    {
+        if (environment->Version != 1)
+            FIXME( "unsupported environment version %u\n", environment->Version );
+
+        object->group = impl_from_TP_CLEANUP_GROUP( environment->CleanupGroup );
+        object->group_cancel_callback = environment->CleanupGroupCancelCallback;
+        object->finalization_callback = environment->FinalizationCallback;
+        object->may_run_long          = environment->u.s.LongFunction != 0;
+        object->race_dll              = environment->RaceDll;
+
+        if (environment->ActivationContext)
+            FIXME( "activation context %p not supported\n", environment->ActivationContext );
+    }
+
+    if (object->race_dll) LdrAddRefDll( 0, object->race_dll );
+
+    if (object->group)
+    {
+        struct threadpool_group *group = object->group;
+
+        interlocked_inc( &group->refcount );
+        RtlEnterCriticalSection( &group->cs );
+        list_add_tail( &group->members, &object->group_entry );
+        object->is_group_member = TRUE;
+        RtlLeaveCriticalSection( &group->cs );
+    }
+
+    TRACE( "allocated object %p of type %u\n", object, object->type );
+}
+
+static inline void tp_object_addref( struct threadpool_object *object )
+{
+    interlocked_inc( &object->refcount );
+}
+
+static void tp_object_release( struct threadpool_object *object )
+{
+    if (interlocked_dec( &object->refcount )) return;
+
+    TRACE( "destroying object %p of type %u\n", object, object->type );
+
+    assert( object->shutdown );
+    assert( !object->num_pending_callbacks );
+    assert( !object->num_running_callbacks );
+
+    if (object->group)
+    {
+        struct threadpool_group *group = object->group;
+
+        RtlEnterCriticalSection( &group->cs );
+        if (object->is_group_member)
+        {
+            list_remove( &object->group_entry );
+            object->is_group_member = FALSE;
+        }
+        RtlLeaveCriticalSection( &group->cs );
+        tp_group_release( group );
+    }
+
+    tp_threadpool_release( object->pool );
+
+    if (object->race_dll) LdrUnloadDll( object->race_dll );
+
+    if (object->completion_event) NtSetEvent( object->completion_event, NULL );
+
+    RtlFreeHeap( GetProcessHeap(), 0, object );
+}
+
+static void tp_object_submit( struct threadpool_object *object, ULONG_PTR arg )
+{
+    struct threadpool *pool = object->pool;
+    struct threadpool_worker *worker = ntdll_get_thread_data_ext()->tp_worker;
+    struct threadpool_task task;
+
+    tp_object_addref( object );
+    task.object = object;
+    task.arg    = arg;
+
+    RtlAcquireSRWLockExclusive( &object->lock );
+    object->num_pending_callbacks++;
+    RtlReleaseSRWLockExclusive( &object->lock );
+
+    /* callbacks queued from a worker of the same pool stay on its own queue */
+    if (!((worker && worker->pool == pool && tp_deque_push( &worker->deque, &task )) ||
+          tp_deque_push( &pool->queue, &task )))
+    {
+        ERR( "out of memory, dropping callback for %p\n", object );
+        RtlAcquireSRWLockExclusive( &object->lock );
+        object->num_pending_callbacks--;
+        RtlReleaseSRWLockExclusive( &object->lock );
+        tp_object_release( object );
+        return;
+    }
+    interlocked_inc( &pool->pending );
+
+    if (pool->num_idle_workers)
+    {
+        RtlEnterCriticalSection( &pool->cs );
+        RtlWakeConditionVariable( &pool->update_event );
+        RtlLeaveCriticalSection( &pool->cs );
+    }
+    else if (pool->num_busy_workers >= pool->num_workers || object->may_run_long)
+    {
+        RtlEnterCriticalSection( &pool->cs );
+        if (!pool->num_idle_workers && pool->num_workers < pool->max_workers)
+            tp_new_worker_thread( pool );
+        else
+            RtlWakeConditionVariable( &pool->update_event );
+        RtlLeaveCriticalSection( &pool->cs );
+    }
+}
+
+/* wait for the callbacks of an object, optionally discarding the queued ones first */
+static void tp_object_wait( struct threadpool_object *object, BOOL cancel_pending )
+{
+    RtlAcquireSRWLockExclusive( &object->lock );
+    if (cancel_pending)
+    {
+        object->num_cancelled += object->num_pending_callbacks;
+        object->num_pending_callbacks = 0;
+    }
+    while (object->num_pending_callbacks || object->num_running_callbacks)
+        RtlSleepConditionVariableSRW( &object->finished_event, &object->lock, NULL, 0 );
+    RtlReleaseSRWLockExclusive( &object->lock );
+}
+
+static void tp_timerqueue_unlock( struct threadpool_object *timer );
+static void tp_waitqueue_unlock( struct threadpool_object *wait );
+
+/* stop the object from queuing new callbacks before it is released */
+static void tp_object_prepare_shutdown( struct threadpool_object *object )
+{
+    if (object->type == TP_OBJECT_TYPE_TIMER)
+        tp_timerqueue_unlock( object );
+    else if (object->type == TP_OBJECT_TYPE_WAIT)
+        tp_waitqueue_unlock( object );
+}
+
+static void tp_object_shutdown( struct threadpool_object *object )
+{
+    if (object->group)
+    {
+        struct threadpool_group *group = object->group;
+
+        RtlEnterCriticalSection( &group->cs );
+        if (object->is_group_member)
+        {
+            list_remove( &object->group_entry );
+            object->is_group_member = FALSE;
+        }
+        RtlLeaveCriticalSection( &group->cs );
+    }
+    tp_object_prepare_shutdown( object );
+    object->shutdown = TRUE;
+    tp_object_release( object );
+}
+
+
+/* timer queue: a single thread fires the timers of all the pools */
+
+static RTL_CRITICAL_SECTION_DEBUG timerqueue_debug;
+
+static struct
+{
+    RTL_CRITICAL_SECTION    cs;
+    LONG                    objcount;
+    BOOL                    thread_running;
+    struct list             pending_timers;     /* sorted by timeout */
+    RTL_CONDITION_VARIABLE  update_event;
+}
+timerqueue =
+{
+    { &timerqueue_debug, -1, 0, 0, 0, 0 },
+    0,
+    FALSE,
+    LIST_INIT( timerqueue.pending_timers ),
+    RTL_CONDITION_VARIABLE_INIT
+};
+
+static RTL_CRITICAL_SECTION_DEBUG timerqueue_debug =
+{
+    0, 0, &timerqueue.cs,
+    { &timerqueue_debug.ProcessLocksList, &timerqueue_debug.ProcessLocksList },
+    0, 0, { (DWORD_PTR)(__FILE__ ": timerqueue.cs") }
+};
+
+/* insert a timer in the sorted list, must be called with timerqueue.cs held */
+static void tp_timerqueue_insert( struct threadpool_object *timer )
+{
+    struct threadpool_object *other;
+    struct list *ptr = &timerqueue.pending_timers;
+
+    LIST_FOR_EACH_ENTRY( other, &timerqueue.pending_timers, struct threadpool_object, u.timer.timer_entry )
+    {
+        if (timer->u.timer.timeout < other->u.timer.timeout)
+        {
+            ptr = &other->u.timer.timer_entry;
+            break;
+        }
+    }
+    list_add_before( ptr, &timer->u.timer.timer_entry );
+    timer->u.timer.timer_pending = TRUE;
+}
+
+static void CALLBACK timerqueue_thread_proc( void *param )
+{
+    struct threadpool_object *timer;
+    LARGE_INTEGER now, timeout;
+    ULONGLONG wakeup;
+    NTSTATUS status;
+    struct list *ptr;
+
+    TRACE( "starting timer queue thread\n" );
+
+    RtlEnterCriticalSection( &timerqueue.cs );
+    for (;;)
+    {
+        NtQuerySystemTime( &now );
+
+        while ((ptr = list_head( &timerqueue.pending_timers )))
+        {
+            timer = LIST_ENTRY( ptr, struct threadpool_object, u.timer.timer_entry );
+            if (timer->u.timer.timeout > now.QuadPart) break;
+
+            list_remove( &timer->u.timer.timer_entry );
+            timer->u.timer.timer_pending = FALSE;
+            tp_object_submit( timer, 0 );
+
+            if (timer->u.timer.period)
+            {
+                timer->u.timer.timeout += (ULONGLONG)timer->u.timer.period * 10000;
+                if (timer->u.timer.timeout <= now.QuadPart) timer->u.timer.timeout = now.QuadPart + 1;
+                tp_timerqueue_insert( timer );
+            }
+            else timer->u.timer.timer_set = FALSE;
+        }
+
+        /* wake up at the earliest end of a window, all the timers that are due
+         * by then get fired together */
+        wakeup = ~(ULONGLONG)0;
+        LIST_FOR_EACH_ENTRY( timer, &timerqueue.pending_timers, struct threadpool_object, u.timer.timer_entry )
+        {
+            if (timer->u.timer.timeout >= wakeup) break;
+            wakeup = min( wakeup, timer->u.timer.timeout + (ULONGLONG)timer->u.timer.window * 10000 );
+        }
+
+        if (wakeup != ~(ULONGLONG)0)
+        {
+            timeout.QuadPart = wakeup;
+            RtlSleepConditionVariableCS( &timerqueue.update_event, &timerqueue.cs, &timeout );
+        }
+        else
+        {
+            if (!timerqueue.objcount)
+            {
+                /* exit if no timer gets allocated for a while */
+                timeout.QuadPart = (ULONGLONG)THREADPOOL_WORKER_TIMEOUT * -10000;
+                status = RtlSleepConditionVariableCS( &timerqueue.update_event, &timerqueue.cs, &timeout );
+                if (status == STATUS_TIMEOUT && !timerqueue.objcount) break;
+            }
+            else RtlSleepConditionVariableCS( &timerqueue.update_event, &timerqueue.cs, NULL );
+        }
+    }
+
+    timerqueue.thread_running = FALSE;
+    RtlLeaveCriticalSection( &timerqueue.cs );
+
+    TRACE( "terminating timer queue thread\n" );
+    RtlExitUserThread( 0 );
+}
+
+static NTSTATUS tp_timerqueue_lock( struct threadpool_object *timer )
+{
+    NTSTATUS status = STATUS_SUCCESS;
+    HANDLE thread;
+
+    assert( timer->type == TP_OBJECT_TYPE_TIMER );
+
+    timer->u.timer.timer_pending = FALSE;
+    timer->u.timer.timer_set     = FALSE;
+    timer->u.timer.timeout       = 0;
+    timer->u.timer.period        = 0;
+    timer->u.timer.window        = 0;
+
+    RtlEnterCriticalSection( &timerqueue.cs );
+    if (!timerqueue.thread_running)
+    {
+        status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                                      timerqueue_thread_proc, NULL, &thread, NULL );
+        if (status == STATUS_SUCCESS)
+        {
+            timerqueue.thread_running = TRUE;
+            NtClose( thread );
+        }
+    }
+    if (status == STATUS_SUCCESS) timerqueue.objcount++;
+    RtlLeaveCriticalSection( &timerqueue.cs );
+    return status;
+}
+
+static void tp_timerqueue_unlock( struct threadpool_object *timer )
+{
+    RtlEnterCriticalSection( &timerqueue.cs );
+    if (timer->u.timer.timer_pending)
+    {
+        list_remove( &timer->u.timer.timer_entry );
+        timer->u.timer.timer_pending = FALSE;
+    }
+    timer->u.timer.timer_set = FALSE;
+    if (!--timerqueue.objcount) RtlWakeAllConditionVariable( &timerqueue.update_event );
+    RtlLeaveCriticalSection( &timerqueue.cs );
+}
+
+
+/* wait queue: each bucket thread waits for up to MAXIMUM_WAIT_OBJECTS - 1 objects */
+
+struct waitqueue_bucket
+{
+    struct list             bucket_entry;       /* entry in waitqueue.buckets */
+    LONG                    objcount;           /* objects assigned to this bucket */
+    struct list             reserved;           /* objects with no pending wait */
+    struct list             waiting;            /* objects with a pending wait */
+    HANDLE                  update_event;       /* set when the waiting list changes */
+    BOOL                    alertable;
+};
+
+static RTL_CRITICAL_SECTION_DEBUG waitqueue_debug;
+
+static struct
+{
+    RTL_CRITICAL_SECTION    cs;
+    LONG                    num_buckets;
+    struct list             buckets;
+}
+waitqueue =
+{
+    { &waitqueue_debug, -1, 0, 0, 0, 0 },
+    0,
+    LIST_INIT( waitqueue.buckets )
+};
+
+static RTL_CRITICAL_SECTION_DEBUG waitqueue_debug =
+{
+    0, 0, &waitqueue.cs,
+    { &waitqueue_debug.ProcessLocksList, &waitqueue_debug.ProcessLocksList },
+    0, 0, { (DWORD_PTR)(__FILE__ ": waitqueue.cs") }
+};
+
+/* move a wait from the waiting to the reserved list and queue its callback,
+ * must be called with waitqueue.cs held; returns TRUE if the callback was
+ * executed right away, in which case waitqueue.cs has been released meanwhile */
+static BOOL tp_waitqueue_complete( struct waitqueue_bucket *bucket, struct threadpool_object *wait,
+                                   TP_WAIT_RESULT result )
+{
+    struct threadpool_task task;
+
+    list_remove( &wait->u.wait.wait_entry );
+    list_add_tail( &bucket->reserved, &wait->u.wait.wait_entry );
+    wait->u.wait.wait_pending = FALSE;
+
+    if (!(wait->u.wait.rtl_flags & WT_EXECUTEINWAITTHREAD))
+    {
+        tp_object_submit( wait, result );
+        return FALSE;
+    }
+
+    /* the callback runs in the wait queue thread, blocking the other waits of the bucket */
+    tp_object_addref( wait );
+    RtlAcquireSRWLockExclusive( &wait->lock );
+    wait->num_pending_callbacks++;
+    RtlReleaseSRWLockExclusive( &wait->lock );
+    task.object = wait;
+    task.arg    = result;
+
+    RtlLeaveCriticalSection( &waitqueue.cs );
+    tp_object_execute( &task );
+    RtlEnterCriticalSection( &waitqueue.cs );
+    return TRUE;
+}
+
+/* the object pointers saved before waiting may be stale, look them up again */
+static struct threadpool_object *tp_waitqueue_find( struct waitqueue_bucket *bucket,
+                                                    struct threadpool_object *object, HANDLE handle )
+{
+    struct threadpool_object *wait;
+
+    LIST_FOR_EACH_ENTRY( wait, &bucket->waiting, struct threadpool_object, u.wait.wait_entry )
+        if (wait == object && wait->u.wait.handle == handle) return wait;
+    return NULL;
+}
+
+static void CALLBACK waitqueue_thread_proc( void *param )
+{
+    struct threadpool_object *objects[MAXIMUM_WAIT_OBJECTS];
+    HANDLE handles[MAXIMUM_WAIT_OBJECTS];
+    struct waitqueue_bucket *bucket = param;
+    struct threadpool_object *wait, *next;
+    LARGE_INTEGER now, timeout, zero;
+    DWORD num_handles, i;
+    NTSTATUS status;
+    BOOL restart;
+
+    TRACE( "starting wait queue thread for bucket %p\n", bucket );
+
+    zero.QuadPart = 0;
+
+    RtlEnterCriticalSection( &waitqueue.cs );
+    for (;;)
+    {
+        NtQuerySystemTime( &now );
+        timeout.QuadPart = ~(ULONGLONG)0 >> 1;
+        num_handles = 0;
+        restart = FALSE;
+
+        LIST_FOR_EACH_ENTRY_SAFE( wait, next, &bucket->waiting, struct threadpool_object, u.wait.wait_entry )
+        {
+            if (wait->u.wait.timeout <= now.QuadPart)
+            {
+                /* the object may have been signaled at the last moment */
+                status = NtWaitForSingleObject( wait->u.wait.handle, FALSE, &zero );
+                /* the list may have changed if the callback was executed by this thread */
+                if ((restart = tp_waitqueue_complete( bucket, wait, status == STATUS_WAIT_0 ?
+                                                      WAIT_OBJECT_0 : WAIT_TIMEOUT ))) break;
+                continue;
+            }
+            if (wait->u.wait.timeout < timeout.QuadPart) timeout.QuadPart = wait->u.wait.timeout;
+            objects[num_handles] = wait;
+            handles[num_handles++] = wait->u.wait.handle;
+        }
+        if (restart) continue;
+
+        if (!bucket->objcount)
+        {
+            /* exit if no wait gets assigned to this bucket for a while */
+            timeout.QuadPart = (ULONGLONG)WAITQUEUE_BUCKET_TIMEOUT * -10000;
+            RtlLeaveCriticalSection( &waitqueue.cs );
+            status = NtWaitForSingleObject( bucket->update_event, FALSE, &timeout );
+            RtlEnterCriticalSection( &waitqueue.cs );
+            if (status == STATUS_TIMEOUT && !bucket->objcount) break;
+            continue;
+        }
+
+        handles[num_handles] = bucket->update_event;
+        RtlLeaveCriticalSection( &waitqueue.cs );
+        status = NtWaitForMultipleObjects( num_handles + 1, handles, FALSE, bucket->alertable,
+                                           timeout.QuadPart == ~(ULONGLONG)0 >> 1 ? NULL : &timeout );
+        RtlEnterCriticalSection( &waitqueue.cs );
+
+        if (status >= STATUS_WAIT_0 && status < STATUS_WAIT_0 + num_handles)
+            i = status - STATUS_WAIT_0;
+        else if (status >= STATUS_ABANDONED_WAIT_0 && status < STATUS_ABANDONED_WAIT_0 + num_handles)
+            i = status - STATUS_ABANDONED_WAIT_0;
+        else
+        {
+            if (status == STATUS_WAIT_0 + num_handles || status == STATUS_TIMEOUT || status == STATUS_USER_APC)
+                continue;
+
+            /* one of the handles is no longer valid, drop the waits on it */
+            for (i = 0; i < num_handles; i++)
+            {
+                if (!(wait = tp_waitqueue_find( bucket, objects[i], handles[i] ))) continue;
+                status = NtWaitForSingleObject( handles[i], FALSE, &zero );
+                if (status == STATUS_WAIT_0 || status == STATUS_TIMEOUT || status == STATUS_ABANDONED_WAIT_0)
+                    continue;
+                WARN( "wait on handle %p failed with status %x\n", handles[i], status );
+                list_remove( &wait->u.wait.wait_entry );
+                list_add_tail( &bucket->reserved, &wait->u.wait.wait_entry );
+                wait->u.wait.wait_pending = FALSE;
+            }
+            continue;
+        }
+
+        if ((wait = tp_waitqueue_find( bucket, objects[i], handles[i] )))
+            tp_waitqueue_complete( bucket, wait, WAIT_OBJECT_0 );
+    }
+
+    list_remove( &bucket->bucket_entry );
+    waitqueue.num_buckets--;
+    RtlLeaveCriticalSection( &waitqueue.cs );
+
+    TRACE( "terminating wait queue thread for bucket %p\n", bucket );
+    NtClose( bucket->update_event );
+    RtlFreeHeap( GetProcessHeap(), 0, bucket );
+    RtlExitUserThread( 0 );
+}
+
+/* assign a wait to a bucket with a free slot, creating one if needed */
+static NTSTATUS tp_waitqueue_lock( struct threadpool_object *wait, BOOL alertable )
+{
+    struct waitqueue_bucket *bucket;
+    NTSTATUS status;
+    HANDLE thread;
+
+    wait->u.wait.bucket       = NULL;
+    wait->u.wait.wait_pending = FALSE;
+    wait->u.wait.timeout      = 0;
+    wait->u.wait.handle       = NULL;
+
+    RtlEnterCriticalSection( &waitqueue.cs );
+
+    LIST_FOR_EACH_ENTRY( bucket, &waitqueue.buckets, struct waitqueue_bucket, bucket_entry )
+    {
+        if (bucket->objcount < MAXIMUM_WAIT_OBJECTS - 1 && bucket->alertable == alertable)
+            goto found;
+    }
+
+    if (!(bucket = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*bucket) )))
+    {
+        status = STATUS_NO_MEMORY;
+        goto done;
+    }
+    bucket->objcount  = 0;
+    bucket->alertable = alertable;
+    list_init( &bucket->reserved );
+    list_init( &bucket->waiting );
+
+    if ((status = NtCreateEvent( &bucket->update_event, EVENT_ALL_ACCESS, NULL,
+                                 SynchronizationEvent, FALSE )))
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, bucket );
+        goto done;
+    }
+    if ((status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                                       waitqueue_thread_proc, bucket, &thread, NULL )))
+    {
+        NtClose( bucket->update_event );
+        RtlFreeHeap( GetProcessHeap(), 0, bucket );
+        goto done;
+    }
+    NtClose( thread );
+    list_add_tail( &waitqueue.buckets, &bucket->bucket_entry );
+    waitqueue.num_buckets++;
+
+found:
+    wait->u.wait.bucket = bucket;
+    bucket->objcount++;
+    list_add_tail( &bucket->reserved, &wait->u.wait.wait_entry );
+    status = STATUS_SUCCESS;
+
+done:
+    RtlLeaveCriticalSection( &waitqueue.cs );
+    return status;
+}
+
+/* start or stop waiting for a handle, must be called with waitqueue.cs held */
+static void tp_waitqueue_set( struct threadpool_object *wait, HANDLE handle, ULONGLONG timeout )
+{
+    struct waitqueue_bucket *bucket = wait->u.wait.bucket;
+
+    list_remove( &wait->u.wait.wait_entry );
+    wait->u.wait.handle  = handle;
+    wait->u.wait.timeout = timeout;
+    if ((wait->u.wait.wait_pending = (handle != NULL)))
+        list_add_tail( &bucket->waiting, &wait->u.wait.wait_entry );
+    else
+        list_add_tail( &bucket->reserved, &wait->u.wait.wait_entry );
+    NtSetEvent( bucket->update_event, NULL );
+}
+
+static void tp_waitqueue_unlock( struct threadpool_object *wait )
+{
+    struct waitqueue_bucket *bucket = wait->u.wait.bucket;
+
+    RtlEnterCriticalSection( &waitqueue.cs );
+    list_remove( &wait->u.wait.wait_entry );
+    wait->u.wait.wait_pending = FALSE;
+    wait->u.wait.bucket = NULL;
+    bucket->objcount--;
+    NtSetEvent( bucket->update_event, NULL );
+    RtlLeaveCriticalSection( &waitqueue.cs );
+}
+
+
+/* I/O completion port shared by all the TP_IO objects */
+
+static RTL_CRITICAL_SECTION_DEBUG ioqueue_debug;
+
+static struct
+{
+    RTL_CRITICAL_SECTION    cs;
+    HANDLE                  port;
+}
+ioqueue =
+{
+    { &ioqueue_debug, -1, 0, 0, 0, 0 },
+    NULL
+};
+
+static RTL_CRITICAL_SECTION_DEBUG ioqueue_debug =
+{
+    0, 0, &ioqueue.cs,
+    { &ioqueue_debug.ProcessLocksList, &ioqueue_debug.ProcessLocksList },
+    0, 0, { (DWORD_PTR)(__FILE__ ": ioqueue.cs") }
+};
+
+static void CALLBACK ioqueue_thread_proc( void *param )
+{
+    struct threadpool_object *io;
+    struct io_completion *completion;
+    IO_STATUS_BLOCK iosb;
+    ULONG_PTR key, value;
+    NTSTATUS status;
+
+    TRACE( "starting I/O completion thread\n" );
+
+    for (;;)
+    {
+        status = NtRemoveIoCompletion( ioqueue.port, &key, &value, &iosb, NULL );
+        if (status)
+        {
+            ERR( "NtRemoveIoCompletion failed: 0x%x\n", status );
+            continue;
+        }
+        if (!(io = (struct threadpool_object *)key)) continue;
+
+        if (interlocked_dec( &io->u.io.pending_count ) < 0)
+        {
+            WARN( "completion for %p without a started operation\n", io );
+            interlocked_inc( &io->u.io.pending_count );
+            continue;
+        }
+
+        if (!(completion = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*completion) )))
+            ERR( "out of memory, dropping completion for %p\n", io );
+        else
+        {
+            completion->iosb   = iosb;
+            completion->cvalue = value;
+            tp_object_submit( io, (ULONG_PTR)completion );
+        }
+        /* release the reference taken by TpStartAsyncIo */
+        tp_object_release( io );
+    }
+}
+
+static NTSTATUS tp_ioqueue_lock( struct threadpool_object *io, HANDLE file )
+{
+    FILE_COMPLETION_INFORMATION info;
+    IO_STATUS_BLOCK iosb;
+    NTSTATUS status = STATUS_SUCCESS;
+    HANDLE thread;
+
+    RtlEnterCriticalSection( &ioqueue.cs );
+    if (!ioqueue.port)
+    {
+        HANDLE port;
+
+        if (!(status = NtCreateIoCompletion( &port, IO_COMPLETION_ALL_ACCESS, NULL, 0 )))
+        {
+            status = RtlCreateUserThread( GetCurrentProcess(), NULL, FALSE, NULL, 0, 0,
+                                          ioqueue_thread_proc, NULL, &thread, NULL );
+            if (!status)
+            {
+                NtClose( thread );
+                ioqueue.port = port;
+            }
+            else NtClose( port );
+        }
+    }
+    RtlLeaveCriticalSection( &ioqueue.cs );
+    if (status) return status;
+
+    info.CompletionPort = ioqueue.port;
+    info.CompletionKey  = (ULONG_PTR)io;
+    return NtSetInformationFile( file, &iosb, &info, sizeof(info), FileCompletionInformation );
+}
+
+
+/***********************************************************************
+ *           TpAllocPool    (NTDLL.@)
+ */
+NTSTATUS WINAPI TpAllocPool( TP_POOL **out, PVOID reserved )
+{
+    TRACE( "%p %p\n", out, reserved );
+
+    if (reserved) FIXME( "reserved argument is nonzero (%p)\n", reserved );
+
+    return tp_threadpool_alloc( (struct threadpool **)out );
+}
+
+/***********************************************************************
+ *           TpReleasePool    (NTDLL.@)
+ */
+VOID WINAPI TpReleasePool( TP_POOL *pool )
+{
+    struct threadpool *this = impl_from_TP_POOL( pool );
+
+    TRACE( "%p\n", pool );
+
+    RtlEnterCriticalSection( &this->cs );
+    this->shutdown = TRUE;
+    RtlWakeAllConditionVariable( &this->update_event );
+    RtlLeaveCriticalSection( &this->cs );
+
+    tp_threadpool_release( this );
+}
+
+/***********************************************************************
+ *           TpSetPoolMaxThreads    (NTDLL.@)
+ */
+VOID WINAPI TpSetPoolMaxThreads( TP_POOL *pool, DWORD maximum )
+{
+    struct threadpool *this = impl_from_TP_POOL( pool );
+
+    TRACE( "%p %u\n", pool, maximum );
+
+    RtlEnterCriticalSection( &this->cs );
+    this->max_workers = max( maximum, 1 );
+    this->min_workers = min( this->min_workers, this->max_workers );
+    /* let the extra workers exit once they are idle */
+    RtlWakeAllConditionVariable( &this->update_event );
+    RtlLeaveCriticalSection( &this->cs );
+}
+
+/***********************************************************************
+ *           TpSetPoolMinThreads    (NTDLL.@)
+ */
+BOOL WINAPI TpSetPoolMinThreads( TP_POOL *pool, DWORD minimum )
+{
+    struct threadpool *this = impl_from_TP_POOL( pool );
+    NTSTATUS status = STATUS_SUCCESS;
+
+    TRACE( "%p %u\n", pool, minimum );
+
+    RtlEnterCriticalSection( &this->cs );
+    while (this->num_workers < minimum)
+    {
+        if ((status = tp_new_worker_thread( this ))) break;
+    }
+    if (status == STATUS_SUCCESS)
+    {
+        this->min_workers = minimum;
+        this->max_workers = max( this->min_workers, this->max_workers );
+    }
+    RtlLeaveCriticalSection( &this->cs );
+
+    return !status;
+}
+
+/***********************************************************************
+ *           TpAllocCleanupGroup    (NTDLL.@)
+ */
+NTSTATUS WINAPI TpAllocCleanupGroup( TP_CLEANUP_GROUP **out )
+{
+    struct threadpool_group *group;
+
+    TRACE( "%p\n", out );
+
+    if (!(group = RtlAllocateHeap( GetProcessHeap(), 0, sizeof(*group) )))
+        return STATUS_NO_MEMORY;
+
+    group->refcount = 1;
+    group->shutdown = FALSE;
+    RtlInitializeCriticalSection( &group->cs );
+    group->cs.DebugInfo->Spare[0] = (DWORD_PTR)(__FILE__ ": threadpool_group.cs");
+    list_init( &group->members );
+
+    TRACE( "allocated group %p\n", group );
+    *out = (TP_CLEANUP_GROUP *)group;
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *           TpReleaseCleanupGroup    (NTDLL.@)
+ */
+VOID WINAPI TpReleaseCleanupGroup( TP_CLEANUP_GROUP *group )
+{
+    struct threadpool_group *this = impl_from_TP_CLEANUP_GROUP( group );
+
+    TRACE( "%p\n", group );
+
+    this->shutdown = TRUE;
+    tp_group_release( this );
+}
+
+/***********************************************************************
+ *           TpReleaseCleanupGroupMembers    (NTDLL.@)
+ */
+VOID WINAPI TpReleaseCleanupGroupMembers( TP_CLEANUP_GROUP *group, BOOL cancel_pending, PVOID userdata )
+{
+    struct threadpool_group *this = impl_from_TP_CLEANUP_GROUP( group );
+    struct threadpool_object *object, *next;
+    struct list members;
+
+    TRACE( "%p %u %p\n", group, cancel_pending, userdata );
+
+    RtlEnterCriticalSection( &this->cs );
+    list_init( &members );
+    LIST_FOR_EACH_ENTRY_SAFE( object, next, &this->members, struct threadpool_object, group_entry )
+    {
+        tp_object_addref( object );
+        object->is_group_member = FALSE;
+        list_remove( &object->group_entry );
+        list_add_tail( &members, &object->group_entry );
+    }
+    RtlLeaveCriticalSection( &this->cs );
+
+    LIST_FOR_EACH_ENTRY( object, &members, struct threadpool_object, group_entry )
+        tp_object_prepare_shutdown( object );
+
+    LIST_FOR_EACH_ENTRY_SAFE( object, next, &members, struct threadpool_object, group_entry )
+    {
+        list_remove( &object->group_entry );
+        tp_object_wait( object, cancel_pending );
+        if (cancel_pending && object->group_cancel_callback)
+        {
+            TRACE( "executing group cancel callback %p(%p, %p)\n",
+                   object->group_cancel_callback, object->userdata, userdata );
+            object->group_cancel_callback( object->userdata, userdata );
+        }
+        /* simple callbacks don't hold an application reference */
+        if (!object->shutdown)
+        {
+            object->shutdown = TRUE;
+            tp_object_release( object );
+        }
+        tp_object_release( object );
+    }
+}
+
+/***********************************************************************
+ *           TpSimpleTryPost    (NTDLL.@)
+ */
+NTSTATUS WINAPI TpSimpleTryPost( PTP_SIMPLE_CALLBACK callback, PVOID userdata,
+                                 TP_CALLBACK_ENVIRON *environment )
+{
+    struct threadpool_object *object;
+    struct threadpool *pool;
+    NTSTATUS status;
+
+    TRACE( "%p %p %p\n", callback, userdata, environment );
+
+    if (!(object = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*object) )))
+        return STATUS_NO_MEMORY;
+
+    if ((status = tp_threadpool_lock( &pool, environment )))
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, object );
+        return status;
+    }
+
+    object->type = TP_OBJECT_TYPE_SIMPLE;
+    object->u.simple.callback = callback;
+    tp_object_initialize( object, pool, userdata, environment );
+
+    /* the callback may run and release the object as soon as it is submitted */
+    object->shutdown = TRUE;
+    tp_object_submit( object, 0 );
+    tp_object_release( object );
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *           TpAllocWork    (NTDLL.@)
+ */
+NTSTATUS WINAPI TpAllocWork( TP_WORK **out, PTP_WORK_CALLBACK callback, PVOID userdata,
+                             TP_CALLBACK_ENVIRON *environment )
+{
+    struct threadpool_object *object;
+    struct threadpool *pool;
+    NTSTATUS status;
+
+    TRACE( "%p %p %p %p\n", out, callback, userdata, environment );
+
+    if (!(object = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*object) )))
+        return STATUS_NO_MEMORY;
+
+    if ((status = tp_threadpool_lock( &pool, environment )))
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, object );
+        return status;
+    }
+
+    object->type = TP_OBJECT_TYPE_WORK;
+    object->u.work.callback = callback;
+    tp_object_initialize( object, pool, userdata, environment );
+
+    *out = (TP_WORK *)object;
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *           TpPostWork    (NTDLL.@)
+ */
+VOID WINAPI TpPostWork( TP_WORK *work )
+{
+    struct threadpool_object *this = impl_from_TP_WORK( work );
+
+    TRACE( "%p\n", work );
+
+    tp_object_submit( this, 0 );
+}
+
+/***********************************************************************
+ *           TpWaitForWork    (NTDLL.@)
+ */
+VOID WINAPI TpWaitForWork( TP_WORK *work, BOOL cancel_pending )
+{
+    struct threadpool_object *this = impl_from_TP_WORK( work );
+
+    TRACE( "%p %u\n", work, cancel_pending );
+
+    tp_object_wait( this, cancel_pending );
+}
+
+/***********************************************************************
+ *           TpReleaseWork    (NTDLL.@)
+ */
+VOID WINAPI TpReleaseWork( TP_WORK *work )
+{
+    struct threadpool_object *this = impl_from_TP_WORK( work );
+
+    TRACE( "%p\n", work );
+
+    tp_object_shutdown( this );
+}
+
+/***********************************************************************
+ *           TpAllocTimer    (NTDLL.@)
+ */
+NTSTATUS WINAPI TpAllocTimer( TP_TIMER **out, PTP_TIMER_CALLBACK callback, PVOID userdata,
+                              TP_CALLBACK_ENVIRON *environment )
+{
+    struct threadpool_object *object;
+    struct threadpool *pool;
+    NTSTATUS status;
+
+    TRACE( "%p %p %p %p\n", out, callback, userdata, environment );
+
+    if (!(object = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*object) )))
+        return STATUS_NO_MEMORY;
+
+    if ((status = tp_threadpool_lock( &pool, environment )))
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, object );
+        return status;
+    }
+
+    object->type = TP_OBJECT_TYPE_TIMER;
+    object->u.timer.callback = callback;
+
+    if ((status = tp_timerqueue_lock( object )))
+    {
+        tp_threadpool_release( pool );
+        RtlFreeHeap( GetProcessHeap(), 0, object );
+        return status;
+    }
+
+    tp_object_initialize( object, pool, userdata, environment );
+
+    *out = (TP_TIMER *)object;
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *           TpSetTimer    (NTDLL.@)
+ */
+VOID WINAPI TpSetTimer( TP_TIMER *timer, LARGE_INTEGER *timeout, LONG period, LONG window_length )
+{
+    struct threadpool_object *this = impl_from_TP_TIMER( timer );
+    LARGE_INTEGER now;
+    ULONGLONG due = 0;
+    BOOL submit = FALSE;
+
+    TRACE( "%p %p %u %u\n", timer, timeout, period, window_length );
+
+    if (timeout)
+    {
+        NtQuerySystemTime( &now );
+        if (!timeout->QuadPart)
+        {
+            /* fire immediately, and then every period */
+            submit = TRUE;
+            if (period) due = now.QuadPart + (ULONGLONG)period * 10000;
+        }
+        else if (timeout->QuadPart < 0) due = now.QuadPart - timeout->QuadPart;
+        else due = timeout->QuadPart;
+    }
+
+    RtlEnterCriticalSection( &timerqueue.cs );
+
+    if (this->u.timer.timer_pending)
+    {
+        list_remove( &this->u.timer.timer_entry );
+        this->u.timer.timer_pending = FALSE;
+    }
+
+    this->u.timer.timer_set = timeout != NULL;
+    this->u.timer.timeout   = due;
+    this->u.timer.period    = period;
+    this->u.timer.window    = window_length;
+
+    if (due)
+    {
+        tp_timerqueue_insert( this );
+        if (list_head( &timerqueue.pending_timers ) == &this->u.timer.timer_entry)
+            RtlWakeAllConditionVariable( &timerqueue.update_event );
+    }
+    else if (submit) this->u.timer.timer_set = FALSE;
+
+    if (submit) tp_object_submit( this, 0 );
+
+    RtlLeaveCriticalSection( &timerqueue.cs );
+}
+
+/***********************************************************************
+ *           TpIsTimerSet    (NTDLL.@)
+ */
+BOOL WINAPI TpIsTimerSet( TP_TIMER *timer )
+{
+    struct threadpool_object *this = impl_from_TP_TIMER( timer );
+
+    TRACE( "%p\n", timer );
+
+    return this->u.timer.timer_set;
+}
+
+/***********************************************************************
+ *           TpWaitForTimer    (NTDLL.@)
+ */
+VOID WINAPI TpWaitForTimer( TP_TIMER *timer, BOOL cancel_pending )
+{
+    struct threadpool_object *this = impl_from_TP_TIMER( timer );
+
+    TRACE( "%p %u\n", timer, cancel_pending );
+
+    tp_object_wait( this, cancel_pending );
+}
+
+/***********************************************************************
+ *           TpReleaseTimer    (NTDLL.@)
+ */
+VOID WINAPI TpReleaseTimer( TP_TIMER *timer )
+{
+    struct threadpool_object *this = impl_from_TP_TIMER( timer );
+
+    TRACE( "%p\n", timer );
+
+    tp_object_shutdown( this );
+}
+
+/***********************************************************************
+ *           TpAllocWait    (NTDLL.@)
+ */
+NTSTATUS WINAPI TpAllocWait( TP_WAIT **out, PTP_WAIT_CALLBACK callback, PVOID userdata,
+                             TP_CALLBACK_ENVIRON *environment )
+{
+    struct threadpool_object *object;
+    struct threadpool *pool;
+    NTSTATUS status;
+
+    TRACE( "%p %p %p %p\n", out, callback, userdata, environment );
+
+    if (!(object = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*object) )))
+        return STATUS_NO_MEMORY;
+
+    if ((status = tp_threadpool_lock( &pool, environment )))
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, object );
+        return status;
+    }
+
+    object->type = TP_OBJECT_TYPE_WAIT;
+    object->u.wait.callback = callback;
+
+    if ((status = tp_waitqueue_lock( object, FALSE )))
+    {
+        tp_threadpool_release( pool );
+        RtlFreeHeap( GetProcessHeap(), 0, object );
+        return status;
+    }
+
+    tp_object_initialize( object, pool, userdata, environment );
+
+    *out = (TP_WAIT *)object;
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *           TpSetWait    (NTDLL.@)
+ */
+VOID WINAPI TpSetWait( TP_WAIT *wait, HANDLE handle, LARGE_INTEGER *timeout )
+{
+    struct threadpool_object *this = impl_from_TP_WAIT( wait );
+    LARGE_INTEGER now;
+    ULONGLONG due = ~(ULONGLONG)0 >> 1;
+
+    TRACE( "%p %p %p\n", wait, handle, timeout );
+
+    if (handle && timeout)
+    {
+        NtQuerySystemTime( &now );
+        if (timeout->QuadPart <= 0) due = now.QuadPart - timeout->QuadPart;
+        else due = timeout->QuadPart;
+    }
+
+    RtlEnterCriticalSection( &waitqueue.cs );
+    tp_waitqueue_set( this, handle, due );
+    RtlLeaveCriticalSection( &waitqueue.cs );
+}
+
+/***********************************************************************
+ *           TpWaitForWait    (NTDLL.@)
+ */
+VOID WINAPI TpWaitForWait( TP_WAIT *wait, BOOL cancel_pending )
+{
+    struct threadpool_object *this = impl_from_TP_WAIT( wait );
+
+    TRACE( "%p %u\n", wait, cancel_pending );
+
+    tp_object_wait( this, cancel_pending );
+}
+
+/***********************************************************************
+ *           TpReleaseWait    (NTDLL.@)
+ */
+VOID WINAPI TpReleaseWait( TP_WAIT *wait )
+{
+    struct threadpool_object *this = impl_from_TP_WAIT( wait );
+
+    TRACE( "%p\n", wait );
+
+    tp_object_shutdown( this );
+}
+
+static ULONGLONG rtl_wait_timeout( ULONG milliseconds )
+{
+    LARGE_INTEGER now;
+
+    if (milliseconds == INFINITE) return ~(ULONGLONG)0 >> 1;
+    NtQuerySystemTime( &now );
+    return now.QuadPart + (ULONGLONG)milliseconds * 10000;
+}
+
+/* wait callback of the objects created by RtlRegisterWait */
+static void CALLBACK rtl_wait_callback( TP_CALLBACK_INSTANCE *instance, void *userdata,
+                                        TP_WAIT *wait, TP_WAIT_RESULT result )
+{
+    struct threadpool_object *object = (struct threadpool_object *)wait;
+
+    object->u.wait.rtl_callback( userdata, result == WAIT_TIMEOUT );
+
+    if (object->u.wait.rtl_flags & WT_EXECUTEONLYONCE) return;
+
+    /* wait again once the callback returned, unless the wait got deregistered meanwhile */
+    RtlEnterCriticalSection( &waitqueue.cs );
+    if (object->u.wait.bucket && !object->u.wait.wait_pending)
+        tp_waitqueue_set( object, object->u.wait.handle, rtl_wait_timeout( object->u.wait.rtl_timeout ) );
+    RtlLeaveCriticalSection( &waitqueue.cs );
+}
+
+/***********************************************************************
+ *              RtlRegisterWait   (NTDLL.@)
+ *
+ * Registers a wait for a handle to become signaled.
+ *
+ * PARAMS
+ *  NewWaitObject [I] Handle to the new wait object. Use RtlDeregisterWait() to free it.
+ *  Object   [I] Object to wait to become signaled.
+ *  Callback [I] Callback function to execute when the wait times out or the handle is signaled.
+ *  Context  [I] Context to pass to the callback function when it is executed.
+ *  Milliseconds [I] Number of milliseconds to wait before timing out.
+ *  Flags    [I] Flags. See notes.
+ *
+ * RETURNS
+ *  Success: STATUS_SUCCESS.
+ *  Failure: Any NTSTATUS code.
+ *
+ * NOTES
+ *  Flags can be one or more of the following:
+ *|WT_EXECUTEDEFAULT - Executes the work item in a non-I/O worker thread.
+ *|WT_EXECUTEINIOTHREAD - Executes the work item in an I/O worker thread.
+ *|WT_EXECUTEINPERSISTENTTHREAD - Executes the work item in a thread that is persistent.
+ *|WT_EXECUTELONGFUNCTION - Hints that the execution can take a long time.
+ *|WT_TRANSFER_IMPERSONATION - Executes the function with the current access token.
+ *|WT_EXECUTEINWAITTHREAD - Executes the callback in the thread waiting for the object.
+ *
+ *  The waits share the wait queue threads of the thread pool, each of them
+ *  waiting for up to MAXIMUM_WAIT_OBJECTS - 1 objects, and the callbacks are
+ *  executed by the default pool workers unless WT_EXECUTEINWAITTHREAD is set.
+ */
+NTSTATUS WINAPI RtlRegisterWait(PHANDLE NewWaitObject, HANDLE Object,
+                                RTL_WAITORTIMERCALLBACKFUNC Callback,
+                                PVOID Context, ULONG Milliseconds, ULONG Flags)
+{
+    struct threadpool_object *object;
+    struct threadpool *pool;
+    NTSTATUS status;
+
+    TRACE( "(%p, %p, %p, %p, %d, 0x%x)\n", NewWaitObject, Object, Callback, Context, Milliseconds, Flags );
+
+    if (!(object = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*object) )))
+        return STATUS_NO_MEMORY;
+
+    if ((status = tp_threadpool_lock( &pool, NULL )))
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, object );
+        return status;
+    }
+
+    object->type = TP_OBJECT_TYPE_WAIT;
+    object->u.wait.callback = rtl_wait_callback;
+
+    if ((status = tp_waitqueue_lock( object, (Flags & WT_EXECUTEINIOTHREAD) != 0 )))
+    {
+        tp_threadpool_release( pool );
+        RtlFreeHeap( GetProcessHeap(), 0, object );
+        return status;
+    }
+
+    object->u.wait.rtl_callback = Callback;
+    object->u.wait.rtl_flags    = Flags;
+    object->u.wait.rtl_timeout  = Milliseconds;
+    tp_object_initialize( object, pool, Context, NULL );
+    object->may_run_long = (Flags & WT_EXECUTELONGFUNCTION) != 0;
+
+    RtlEnterCriticalSection( &waitqueue.cs );
+    tp_waitqueue_set( object, Object, rtl_wait_timeout( Milliseconds ) );
+    RtlLeaveCriticalSection( &waitqueue.cs );
+
+    *NewWaitObject = object;
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *              RtlDeregisterWaitEx   (NTDLL.@)
+ *
+ * Cancels a wait operation and frees the resources associated with calling
+ * RtlRegisterWait().
+ *
+ * PARAMS
+ *  WaitObject [I] Handle to the wait object to free.
+ *  CompletionEvent [I] Event to signal once the callbacks completed, or
+ *                      INVALID_HANDLE_VALUE to wait for them.
+ *
+ * RETURNS
+ *  Success: STATUS_SUCCESS.
+ *  Failure: Any NTSTATUS code, STATUS_PENDING if a callback is still running.
+ */
+NTSTATUS WINAPI RtlDeregisterWaitEx(HANDLE WaitHandle, HANDLE CompletionEvent)
+{
+    struct threadpool_object *object = WaitHandle;
+    NTSTATUS status = STATUS_SUCCESS;
+
+    TRACE( "(%p, %p)\n", WaitHandle, CompletionEvent );
+
+    /* no callback gets queued after this */
+    tp_waitqueue_unlock( object );
+
+    if (CompletionEvent == INVALID_HANDLE_VALUE)
+        tp_object_wait( object, TRUE );
+    else
+    {
+        /* the event is set when the last running callback releases the object */
+        object->completion_event = CompletionEvent;
+
+        RtlAcquireSRWLockExclusive( &object->lock );
+        object->num_cancelled += object->num_pending_callbacks;
+        object->num_pending_callbacks = 0;
+        if (object->num_running_callbacks) status = STATUS_PENDING;
+        RtlReleaseSRWLockExclusive( &object->lock );
+    }
+
+    object->shutdown = TRUE;
+    tp_object_release( object );
+    return status;
+}
+
+/***********************************************************************
+ *              RtlDeregisterWait   (NTDLL.@)
+ *
+ * Cancels a wait operation and frees the resources associated with calling
+ * RtlRegisterWait().
+ *
+ * PARAMS
+ *  WaitObject [I] Handle to the wait object to free.
+ *
+ * RETURNS
+ *  Success: STATUS_SUCCESS.
+ *  Failure: Any NTSTATUS code.
+ */
+NTSTATUS WINAPI RtlDeregisterWait(HANDLE WaitHandle)
+{
+    return RtlDeregisterWaitEx(WaitHandle, NULL);
+}
+
+/***********************************************************************
+ *           TpAllocIoCompletion    (NTDLL.@)
+ */
+NTSTATUS WINAPI TpAllocIoCompletion( TP_IO **out, HANDLE file, PTP_IO_CALLBACK callback,
+                                     PVOID userdata, TP_CALLBACK_ENVIRON *environment )
+{
+    struct threadpool_object *object;
+    struct threadpool *pool;
+    NTSTATUS status;
+
+    TRACE( "%p %p %p %p %p\n", out, file, callback, userdata, environment );
+
+    if (!(object = RtlAllocateHeap( GetProcessHeap(), HEAP_ZERO_MEMORY, sizeof(*object) )))
+        return STATUS_NO_MEMORY;
+
+    if ((status = tp_threadpool_lock( &pool, environment )))
+    {
+        RtlFreeHeap( GetProcessHeap(), 0, object );
+        return status;
+    }
+
+    object->type = TP_OBJECT_TYPE_IO;
+    object->u.io.callback = callback;
+
+    if ((status = tp_ioqueue_lock( object, file )))
+    {
+        tp_threadpool_release( pool );
+        RtlFreeHeap( GetProcessHeap(), 0, object );
+        return status;
+    }
+
+    tp_object_initialize( object, pool, userdata, environment );
+
+    *out = (TP_IO *)object;
+    return STATUS_SUCCESS;
+}
+
+/***********************************************************************
+ *           TpStartAsyncIo    (NTDLL.@)
+ */
+VOID WINAPI TpStartAsyncIo( TP_IO *io )
+{
+    struct threadpool_object *this = impl_from_TP_IO( io );
+
+    TRACE( "%p\n", io );
+
+    /* the pending operation keeps the object alive until its completion is queued */
+    tp_object_addref( this );
+    interlocked_inc( &this->u.io.pending_count );
+}
+
+/***********************************************************************
+ *           TpCancelAsyncIo    (NTDLL.@)
+ */
+VOID WINAPI TpCancelAsyncIo( TP_IO *io )
+{
+    struct threadpool_object *this = impl_from_TP_IO( io );
+
+    TRACE( "%p\n", io );
+
+    if (interlocked_dec( &this->u.io.pending_count ) < 0)
+    {
+        interlocked_inc( &this->u.io.pending_count );
+        return;
+    }
+    tp_object_release( this );
+}
+
+/***********************************************************************
+ *           TpWaitForIoCompletion    (NTDLL.@)
+ */
+VOID WINAPI TpWaitForIoCompletion( TP_IO *io, BOOL cancel_pending )
+{
+    struct threadpool_object *this = impl_from_TP_IO( io );
+
+    TRACE( "%p %u\n", io, cancel_pending );
+
+    tp_object_wait( this, cancel_pending );
+}
+
+/***********************************************************************
+ *           TpReleaseIoCompletion    (NTDLL.@)
+ */
+VOID WINAPI TpReleaseIoCompletion( TP_IO *io )
+{
+    struct threadpool_object *this = impl_from_TP_IO( io );
+
+    TRACE( "%p\n", io );
+
+    tp_object_shutdown( this );
+}
+
+/***********************************************************************
+ *           TpCallbackMayRunLong    (NTDLL.@)
+ */
+NTSTATUS WINAPI TpCallbackMayRunLong( TP_CALLBACK_INSTANCE *instance )
+{
+    struct threadpool_instance *this = impl_from_TP_CALLBACK_INSTANCE( instance );
+    struct threadpool *pool = this->object->pool;
+    NTSTATUS status = STATUS_SUCCESS;
+
+    TRACE( "%p\n", instance );
+
+    if (this->threadid != GetCurrentThreadId())
+    {
+        ERR( "called from wrong thread, ignoring\n" );
+        return STATUS_UNSUCCESSFUL;
+    }
+
+    if (this->may_run_long) return STATUS_SUCCESS;
+
+    /* make sure another worker is available for the queued callbacks */
+    RtlEnterCriticalSection( &pool->cs );
+    if (!pool->num_idle_workers)
+    {
+        if (pool->num_workers < pool->max_workers) status = tp_new_worker_thread( pool );
+        else status = STATUS_TOO_MANY_THREADS;
+    }
+    RtlLeaveCriticalSection( &pool->cs );
+
+    this->may_run_long = TRUE;
+    return status;
+}
+
+/***********************************************************************
+ *           TpDisassociateCallback    (NTDLL.@)
+ */
+VOID WINAPI TpDisassociateCallback( TP_CALLBACK_INSTANCE *instance )
+{
+    struct threadpool_instance *this = impl_from_TP_CALLBACK_INSTANCE( instance );
+
+    TRACE( "%p\n", instance );
+
+    if (this->threadid != GetCurrentThreadId())
+    {
+        ERR( "called from wrong thread, ignoring\n" );
+        return;
+    }
+
+    if (!this->associated) return;
+
+    this->associated = FALSE;
+    tp_object_callback_done( this->object );
+}
+
+/***********************************************************************
+ *           TpCallbackLeaveCriticalSectionOnCompletion    (NTDLL.@)
+ */
+VOID WINAPI TpCallbackLeaveCriticalSectionOnCompletion( TP_CALLBACK_INSTANCE *instance,
+                                                        RTL_CRITICAL_SECTION *crit )
+{
+    struct threadpool_instance *this = impl_from_TP_CALLBACK_INSTANCE( instance );
+
+    TRACE( "%p %p\n", instance, crit );
+
+    if (!this->cleanup.critical_section) this->cleanup.critical_section = crit;
+}
+
+/***********************************************************************
+ *           TpCallbackReleaseMutexOnCompletion    (NTDLL.@)
+ */
+VOID WINAPI TpCallbackReleaseMutexOnCompletion( TP_CALLBACK_INSTANCE *instance, HANDLE mutex )
+{
+    struct threadpool_instance *this = impl_from_TP_CALLBACK_INSTANCE( instance );
+
+    TRACE( "%p %p\n", instance, mutex );
+
+    if (!this->cleanup.mutex) this->cleanup.mutex = mutex;
+}
+
+/***********************************************************************
+ *           TpCallbackReleaseSemaphoreOnCompletion    (NTDLL.@)
+ */
+VOID WINAPI TpCallbackReleaseSemaphoreOnCompletion( TP_CALLBACK_INSTANCE *instance,
+                                                    HANDLE semaphore, DWORD count )
+{
+    struct threadpool_instance *this = impl_from_TP_CALLBACK_INSTANCE( instance );
+
+    TRACE( "%p %p %u\n", instance, semaphore, count );
+
+    if (!this->cleanup.semaphore)
+    {
+        this->cleanup.semaphore = semaphore;
+        this->cleanup.semaphore_count = count;
+    }
+}
+
+/***********************************************************************
+ *           TpCallbackSetEventOnCompletion    (NTDLL.@)
+ */
+VOID WINAPI TpCallbackSetEventOnCompletion( TP_CALLBACK_INSTANCE *instance, HANDLE event )
+{
+    struct threadpool_instance *this = impl_from_TP_CALLBACK_INSTANCE( instance );
+
+    TRACE( "%p %p\n", instance, event );
+
+    if (!this->cleanup.event) this->cleanup.event = event;
+}
+
+/***********************************************************************
+ *           TpCallbackUnloadDllOnCompletion    (NTDLL.@)
+ */
+VOID WINAPI TpCallbackUnloadDllOnCompletion( TP_CALLBACK_INSTANCE *instance, HMODULE module )
+{
+    struct threadpool_instance *this = impl_from_TP_CALLBACK_INSTANCE( instance );
+
+    TRACE( "%p %p\n", instance, module );
+
+    if (!this->cleanup.library) this->cleanup.library = module;
+}
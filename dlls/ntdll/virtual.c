@@ -55,6 +55,7 @@
 #include "wine/server.h"
 #include "wine/exception.h"
 #include "wine/list.h"
+#include "wine/rbtree.h"
 #include "wine/debug.h"
 #include "ntdll_misc.h"
 
@@ -73,6 +74,7 @@ WINE_DECLARE_DEBUG_CHANNEL(module);
 struct file_view
 {
     struct list   entry;       /* Entry in global view list */
+    struct wine_rb_entry tree_entry; /* Entry in global view tree */
     void         *base;        /* Base address */
     size_t        size;        /* Size in bytes */
     HANDLE        mapping;     /* Handle to the file mapping */
@@ -102,7 +104,8 @@ static const BYTE VIRTUAL_Win32Flags[16] =
     PAGE_EXECUTE_WRITECOPY      /* READ | WRITE | EXEC | WRITECOPY */
 };
 
-static struct list views_list = LIST_INIT(views_list);
+static struct list views_list = LIST_INIT(views_list);  /* views sorted by address */
+static struct wine_rb_tree views_tree;  /* same views, indexed by base address */
 
 static RTL_CRITICAL_SECTION csVirtual;
 static RTL_CRITICAL_SECTION_DEBUG critsect_debug =
@@ -248,6 +251,79 @@ static void VIRTUAL_Dump(void)
 #endif
 
 
+/* functions for the views tree, the tree memory comes from the virtual heap */
+static void *views_tree_alloc( size_t size )
+{
+    return RtlAllocateHeap( virtual_heap, 0, size );
+}
+
+static void *views_tree_realloc( void *ptr, size_t size )
+{
+    return RtlReAllocateHeap( virtual_heap, 0, ptr, size );
+}
+
+static void views_tree_free( void *ptr )
+{
+    RtlFreeHeap( virtual_heap, 0, ptr );
+}
+
+static int views_tree_compare( const void *key, const struct wine_rb_entry *entry )
+{
+    const struct file_view *view = WINE_RB_ENTRY_VALUE( entry, const struct file_view, tree_entry );
+
+    if ((const char *)key < (const char *)view->base) return -1;
+    if ((const char *)key > (const char *)view->base) return 1;
+    return 0;
+}
+
+static const struct wine_rb_functions views_tree_functions =
+{
+    views_tree_alloc,
+    views_tree_realloc,
+    views_tree_free,
+    views_tree_compare
+};
+
+
+/***********************************************************************
+ *           find_view_before
+ *
+ * Find the last view starting at or before a given address.
+ * The csVirtual section must be held by caller.
+ */
+static struct file_view *find_view_before( const void *addr )
+{
+    struct wine_rb_entry *ptr = views_tree.root;
+    struct file_view *ret = NULL;
+
+    while (ptr)
+    {
+        struct file_view *view = WINE_RB_ENTRY_VALUE( ptr, struct file_view, tree_entry );
+
+        if ((const char *)view->base > (const char *)addr) ptr = ptr->left;
+        else
+        {
+            ret = view;
+            ptr = ptr->right;
+        }
+    }
+    return ret;
+}
+
+
+/***********************************************************************
+ *           next_view
+ *
+ * Find the view following a given one, or the first view if NULL.
+ * The csVirtual section must be held by caller.
+ */
+static inline struct file_view *next_view( struct file_view *view )
+{
+    struct list *ptr = view ? list_next( &views_list, &view->entry ) : list_head( &views_list );
+    return ptr ? LIST_ENTRY( ptr, struct file_view, entry ) : NULL;
+}
+
+
 /***********************************************************************
  *           VIRTUAL_FindView
  *
@@ -262,17 +338,13 @@ static void VIRTUAL_Dump(void)
  */
 static struct file_view *VIRTUAL_FindView( const void *addr, size_t size )
 {
-    struct file_view *view;
+    struct file_view *view = find_view_before( addr );
 
-    LIST_FOR_EACH_ENTRY( view, &views_list, struct file_view, entry )
-    {
-        if (view->base > addr) break;  /* no matching view */
-        if ((const char *)view->base + view->size <= (const char *)addr) continue;
-        if ((const char *)view->base + view->size < (const char *)addr + size) break;  /* size too large */
-        if ((const char *)addr + size < (const char *)addr) break; /* overflow */
-        return view;
-    }
-    return NULL;
+    if (!view) return NULL;  /* no matching view */
+    if ((const char *)view->base + view->size <= (const char *)addr) return NULL;
+    if ((const char *)view->base + view->size < (const char *)addr + size) return NULL;  /* size too large */
+    if ((const char *)addr + size < (const char *)addr) return NULL; /* overflow */
+    return view;
 }
 
 
@@ -295,13 +367,10 @@ static inline UINT_PTR get_mask( ULONG zero_bits )
  */
 static struct file_view *find_view_range( const void *addr, size_t size )
 {
-    struct file_view *view;
+    struct file_view *view = find_view_before( addr );
 
-    LIST_FOR_EACH_ENTRY( view, &views_list, struct file_view, entry )
-    {
-        if ((const char *)view->base >= (const char *)addr + size) break;
-        if ((const char *)view->base + view->size > (const char *)addr) return view;
-    }
+    if (view && (const char *)view->base + view->size > (const char *)addr) return view;
+    if ((view = next_view( view )) && (const char *)view->base < (const char *)addr + size) return view;
     return NULL;
 }
 
@@ -314,6 +383,7 @@ static struct file_view *find_view_range( const void *addr, size_t size )
  */
 static void *find_free_area( void *base, void *end, size_t size, size_t mask, int top_down )
 {
+    struct file_view *view;
     struct list *ptr;
     void *start;
 
@@ -322,9 +392,12 @@ static void *find_free_area( void *base, void *end, size_t size, size_t mask, in
         start = ROUND_ADDR( (char *)end - size, mask );
         if (start >= end || start < base) return NULL;
 
-        for (ptr = views_list.prev; ptr != &views_list; ptr = ptr->prev)
+        /* skip the views above the area */
+        if (!(view = find_view_before( (char *)start + size - 1 ))) return start;
+
+        for (ptr = &view->entry; ptr != &views_list; ptr = ptr->prev)
         {
-            struct file_view *view = LIST_ENTRY( ptr, struct file_view, entry );
+            view = LIST_ENTRY( ptr, struct file_view, entry );
 
             if ((char *)view->base + view->size <= (char *)start) break;
             if ((char *)view->base >= (char *)start + size) continue;
@@ -338,9 +411,12 @@ static void *find_free_area( void *base, void *end, size_t size, size_t mask, in
         start = ROUND_ADDR( (char *)base + mask, mask );
         if (start >= end || (char *)end - (char *)start < size) return NULL;
 
-        for (ptr = views_list.next; ptr != &views_list; ptr = ptr->next)
+        /* skip the views below the area */
+        ptr = (view = find_view_before( start )) ? &view->entry : views_list.next;
+
+        for (; ptr != &views_list; ptr = ptr->next)
         {
-            struct file_view *view = LIST_ENTRY( ptr, struct file_view, entry );
+            view = LIST_ENTRY( ptr, struct file_view, entry );
 
             if ((char *)view->base >= (char *)start + size) break;
             if ((char *)view->base + view->size <= (char *)start) continue;
@@ -443,6 +519,7 @@ static inline void unmap_area( void *addr, size_t size )
 static void delete_view( struct file_view *view ) /* [in] View */
 {
     if (!(view->protect & VPROT_SYSTEM)) unmap_area( view->base, view->size );
+    wine_rb_remove( &views_tree, view->base );
     list_remove( &view->entry );
     if (view->mapping) NtClose( view->mapping );
     RtlFreeHeap( virtual_heap, 0, view );
@@ -456,8 +533,7 @@ static void delete_view( struct file_view *view ) /* [in] View */
  */
 static NTSTATUS create_view( struct file_view **view_ret, void *base, size_t size, unsigned int vprot )
 {
-    struct file_view *view;
-    struct list *ptr;
+    struct file_view *view, *prev, *next;
     int unix_prot = VIRTUAL_GetUnixProt( vprot );
 
     assert( !((UINT_PTR)base & page_mask) );
@@ -477,44 +553,39 @@ static NTSTATUS create_view( struct file_view **view_ret, void *base, size_t siz
     view->protect = vprot;
     memset( view->prot, vprot, size >> page_shift );
 
-    /* Insert it in the linked list */
-
-    LIST_FOR_EACH( ptr, &views_list )
-    {
-        struct file_view *next = LIST_ENTRY( ptr, struct file_view, entry );
-        if (next->base > base) break;
-    }
-    list_add_before( ptr, &view->entry );
-
     /* Check for overlapping views. This can happen if the previous view
      * was a system view that got unmapped behind our back. In that case
      * we recover by simply deleting it. */
 
-    if ((ptr = list_prev( &views_list, &view->entry )) != NULL)
+    if ((prev = find_view_before( base )) && (char *)prev->base + prev->size > (char *)base)
     {
-        struct file_view *prev = LIST_ENTRY( ptr, struct file_view, entry );
-        if ((char *)prev->base + prev->size > (char *)base)
-        {
-            TRACE( "overlapping prev view %p-%p for %p-%p\n",
-                   prev->base, (char *)prev->base + prev->size,
-                   base, (char *)base + view->size );
-            assert( prev->protect & VPROT_SYSTEM );
-            delete_view( prev );
-        }
+        TRACE( "overlapping prev view %p-%p for %p-%p\n",
+               prev->base, (char *)prev->base + prev->size,
+               base, (char *)base + view->size );
+        assert( prev->protect & VPROT_SYSTEM );
+        delete_view( prev );
+        prev = find_view_before( base );
     }
-    if ((ptr = list_next( &views_list, &view->entry )) != NULL)
+    if ((next = next_view( prev )) && (char *)base + view->size > (char *)next->base)
     {
-        struct file_view *next = LIST_ENTRY( ptr, struct file_view, entry );
-        if ((char *)base + view->size > (char *)next->base)
-        {
-            TRACE( "overlapping next view %p-%p for %p-%p\n",
-                   next->base, (char *)next->base + next->size,
-                   base, (char *)base + view->size );
-            assert( next->protect & VPROT_SYSTEM );
-            delete_view( next );
-        }
+        TRACE( "overlapping next view %p-%p for %p-%p\n",
+               next->base, (char *)next->base + next->size,
+               base, (char *)base + view->size );
+        assert( next->protect & VPROT_SYSTEM );
+        delete_view( next );
     }
 
+    /* Insert it in the tree and the linked list */
+
+    if (wine_rb_put( &views_tree, base, &view->tree_entry ))
+    {
+        FIXME( "out of memory in virtual heap for %p-%p\n", base, (char *)base + size );
+        RtlFreeHeap( virtual_heap, 0, view );
+        return STATUS_NO_MEMORY;
+    }
+    if (prev) list_add_after( &prev->entry, &view->entry );
+    else list_add_head( &views_list, &view->entry );
+
     *view_ret = view;
     VIRTUAL_DEBUG_DUMP_VIEW( view );
 
@@ -1392,6 +1463,11 @@ void virtual_init(void)
     assert( heap_base != (void *)-1 );
     virtual_heap = RtlCreateHeap( HEAP_NO_SERIALIZE, heap_base, VIRTUAL_HEAP_SIZE,
                                   VIRTUAL_HEAP_SIZE, NULL, NULL );
+    if (wine_rb_init( &views_tree, &views_tree_functions ) == -1)
+    {
+        ERR( "failed to initialize the views tree\n" );
+        exit(1);
+    }
     create_view( &heap_view, heap_base, VIRTUAL_HEAP_SIZE, VPROT_COMMITTED | VPROT_READ | VPROT_WRITE );
 
     /* make the DOS area accessible to hide bugs in broken apps like Excel 2003 */
@@ -2123,7 +2199,6 @@ NTSTATUS WINAPI NtQueryVirtualMemory( HANDLE process, LPCVOID addr,
 {
     struct file_view *view;
     char *base, *alloc_base = 0;
-    struct list *ptr;
     SIZE_T size = 0;
     MEMORY_BASIC_INFORMATION *info = buffer;
     sigset_t sigset;
@@ -2179,30 +2254,20 @@ NTSTATUS WINAPI NtQueryVirtualMemory( HANDLE process, LPCVOID addr,
     /* Find the view containing the address */
 
     server_enter_uninterrupted_section( &csVirtual, &sigset );
-    ptr = list_head( &views_list );
-    for (;;)
+    if ((view = find_view_before( base )) && (char *)view->base + view->size > base)
     {
-        if (!ptr)
-        {
-            size = (char *)working_set_limit - alloc_base;
-            view = NULL;
-            break;
-        }
-        view = LIST_ENTRY( ptr, struct file_view, entry );
-        if ((char *)view->base > base)
-        {
-            size = (char *)view->base - alloc_base;
-            view = NULL;
-            break;
-        }
-        if ((char *)view->base + view->size > base)
-        {
-            alloc_base = view->base;
-            size = view->size;
-            break;
-        }
-        alloc_base = (char *)view->base + view->size;
-        ptr = list_next( &views_list, ptr );
+        alloc_base = view->base;
+        size = view->size;
+    }
+    else
+    {
+        /* free area between the previous view and the next one */
+        struct file_view *next = next_view( view );
+
+        if (view) alloc_base = (char *)view->base + view->size;
+        if (next) size = (char *)next->base - alloc_base;
+        else size = (char *)working_set_limit - alloc_base;
+        view = NULL;
     }
 
     /* Fill the info structure */
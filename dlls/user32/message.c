@@ -2584,6 +2584,138 @@ static inline void call_sendmsg_callback( SENDASYNCPROC callback, HWND hwnd, UIN
 }
 
 
+/***********************************************************************
+ *           get_queue_ring
+ *
+ * Map the ring of the messages posted by the current thread to itself.
+ */
+static struct queue_ring *get_queue_ring(void)
+{
+    struct user_thread_info *thread_info = get_user_thread_info();
+    HANDLE handle = 0;
+
+    if (thread_info->queue_ring) return thread_info->queue_ring;
+
+    SERVER_START_REQ( get_queue_ring )
+    {
+        if (!wine_server_call( req )) handle = wine_server_ptr_handle( reply->handle );
+    }
+    SERVER_END_REQ;
+    if (!handle) return NULL;
+    thread_info->queue_ring = MapViewOfFile( handle, FILE_MAP_WRITE, 0, 0, 0 );
+    CloseHandle( handle );
+    return thread_info->queue_ring;
+}
+
+
+/***********************************************************************
+ *           post_ring_message
+ *
+ * Store a message posted to the current thread in the queue ring.
+ * Return FALSE if the message has to go through the server.
+ */
+static BOOL post_ring_message( const struct send_message_info *info )
+{
+    struct queue_ring *ring;
+    struct ring_message *msg;
+
+    if (info->msg & 0x80000000) return FALSE;  /* internal message */
+    if (info->msg >= WM_DDE_FIRST && info->msg <= WM_DDE_LAST) return FALSE;
+    if (!(ring = get_queue_ring())) return FALSE;
+    /* messages queued in the server have to be retrieved first */
+    if (ring->server_posted) return FALSE;
+    if (ring->tail - ring->head == QUEUE_RING_MESSAGES) return FALSE;
+
+    msg = &ring->msgs[ring->tail & (QUEUE_RING_MESSAGES - 1)];
+    msg->win     = wine_server_user_handle( WIN_GetFullHandle( info->hwnd ));
+    msg->msg     = info->msg;
+    msg->wparam  = info->wparam;
+    msg->lparam  = info->lparam;
+    msg->time    = GetTickCount();
+    msg->removed = 0;
+    msg->x       = ring->cursor_x;  /* avoid a driver round-trip for the cursor position */
+    msg->y       = ring->cursor_y;
+    ring->tail++;
+    ring->count++;
+    ring->posted++;
+    return TRUE;
+}
+
+
+/***********************************************************************
+ *           remove_ring_message
+ */
+static void remove_ring_message( struct queue_ring *ring, struct ring_message *msg )
+{
+    msg->removed = 1;
+    ring->count--;
+    while (ring->head != ring->tail && ring->msgs[ring->head & (QUEUE_RING_MESSAGES - 1)].removed)
+        ring->head++;
+}
+
+
+/***********************************************************************
+ *           match_ring_window
+ *
+ * Check a message window against the window filter, like the server does.
+ */
+static BOOL match_ring_window( HWND hwnd, HWND msg_hwnd )
+{
+    if (!hwnd) return TRUE;
+    if (hwnd == (HWND)-1 || hwnd == (HWND)1) return !msg_hwnd;
+    hwnd = WIN_GetFullHandle( hwnd );
+    for ( ; msg_hwnd; msg_hwnd = GetAncestor( msg_hwnd, GA_PARENT ))
+        if (msg_hwnd == hwnd) return TRUE;
+    return FALSE;
+}
+
+
+/***********************************************************************
+ *           peek_ring_message
+ *
+ * Retrieve a message that the current thread posted to itself, without
+ * a server round-trip.
+ */
+static BOOL peek_ring_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags )
+{
+    struct queue_ring *ring = get_user_thread_info()->queue_ring;
+    struct ring_message *entry;
+    unsigned int i;
+    HWND win;
+
+    if (!ring || !ring->count) return FALSE;
+    if (HIWORD(flags) && !(HIWORD(flags) & QS_POSTMESSAGE)) return FALSE;
+    if (ring->wake_bits & QS_SENDMESSAGE) return FALSE;  /* sent messages are processed first */
+
+    for (i = ring->head; i != ring->tail; i++)
+    {
+        entry = &ring->msgs[i & (QUEUE_RING_MESSAGES - 1)];
+        if (entry->removed) continue;
+        win = wine_server_ptr_handle( entry->win );
+        if (win && !WIN_IsCurrentThread( win ))  /* the window has been destroyed */
+        {
+            remove_ring_message( ring, entry );
+            continue;
+        }
+        if (!match_ring_window( hwnd, win )) continue;
+        if (entry->msg < first || entry->msg > last) continue;
+
+        msg->hwnd    = win;
+        msg->message = entry->msg;
+        msg->wParam  = entry->wparam;
+        msg->lParam  = entry->lparam;
+        msg->time    = entry->time;
+        msg->pt.x    = entry->x;
+        msg->pt.y    = entry->y;
+        ring->get_posted = ring->posted;  /* tell the server to reset the changed bits */
+        ring->last_get = GetTickCount();  /* and that the thread is not hung */
+        if (flags & PM_REMOVE) remove_ring_message( ring, entry );
+        return TRUE;
+    }
+    return FALSE;
+}
+
+
 /***********************************************************************
  *           peek_message
  *
@@ -2596,11 +2728,9 @@ static BOOL peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags
     struct user_thread_info *thread_info = get_user_thread_info();
     struct received_message_info info, *old_info;
     unsigned int hw_id = 0;  /* id of previous hardware message */
-    void *buffer;
+    void *buffer = NULL;
     size_t buffer_size = 256;
 
-    if (!(buffer = HeapAlloc( GetProcessHeap(), 0, buffer_size ))) return FALSE;
-
     if (!first && !last) last = ~0;
     if (hwnd == HWND_BROADCAST) hwnd = HWND_TOPMOST;
 
@@ -2608,7 +2738,20 @@ static BOOL peek_message( MSG *msg, HWND hwnd, UINT first, UINT last, UINT flags
     {
         NTSTATUS res;
         size_t size = 0;
-        const message_data_t *msg_data = buffer;
+        const message_data_t *msg_data;
+
+        if (peek_ring_message( msg, hwnd, first, last, flags ))
+        {
+            thread_info->GetMessagePosVal = MAKELONG( msg->pt.x, msg->pt.y );
+            thread_info->GetMessageTimeVal = msg->time;
+            thread_info->GetMessageExtraInfoVal = 0;
+            HeapFree( GetProcessHeap(), 0, buffer );
+            HOOK_CallHooks( WH_GETMESSAGE, HC_ACTION, flags & PM_REMOVE, (LPARAM)msg, TRUE );
+            return TRUE;
+        }
+
+        if (!buffer && !(buffer = HeapAlloc( GetProcessHeap(), 0, buffer_size ))) return FALSE;
+        msg_data = buffer;
 
         SERVER_START_REQ( get_message )
         {
@@ -2906,6 +3049,10 @@ static BOOL put_message_in_queue( const struct send_message_info *info, size_t *
     {
         return post_dde_message( &data, info );
     }
+    else if (info->type == MSG_POSTED && info->dest_tid == GetCurrentThreadId() && post_ring_message( info ))
+    {
+        return TRUE;
+    }
 
     SERVER_START_REQ( send_message )
     {
@@ -10026,6 +10026,84 @@ done:
     flush_events();
 }
 
+static void test_posted_messages_order(void)
+{
+    HWND hwnd;
+    MSG msg;
+    POINT pt;
+    DWORD ret, start, elapsed;
+    int i, count;
+
+    hwnd = CreateWindowA("TestWindowClass", "posted messages", WS_OVERLAPPEDWINDOW,
+                         10, 10, 100, 100, NULL, NULL, NULL, NULL);
+    assert(hwnd);
+    flush_events();
+
+    /* more messages than fit in a single batch, alternating windows and thread messages */
+    for (i = 0; i < 3000; i++)
+    {
+        if (i & 1) ok( PostMessageA( hwnd, WM_USER, i, 0 ), "PostMessage failed\n" );
+        else ok( PostThreadMessageA( GetCurrentThreadId(), WM_USER + 1, i, 0 ), "PostThreadMessage failed\n" );
+    }
+    PostQuitMessage( 0x1234 );
+
+    ret = GetQueueStatus( QS_POSTMESSAGE );
+    ok( HIWORD(ret) & QS_POSTMESSAGE, "wrong status %08x\n", ret );
+    ret = MsgWaitForMultipleObjects( 0, NULL, FALSE, 0, QS_POSTMESSAGE );
+    ok( ret == WAIT_OBJECT_0, "MsgWaitForMultipleObjects returned %x\n", ret );
+
+    /* window filter only returns the window messages */
+    for (i = 1; i < 3000; i += 2)
+    {
+        ok( PeekMessageA( &msg, hwnd, 0, 0, PM_REMOVE ), "no message %d\n", i );
+        ok( msg.hwnd == hwnd && msg.message == WM_USER && msg.wParam == i,
+            "wrong message %p %04x %ld, expected %d\n", msg.hwnd, msg.message, msg.wParam, i );
+    }
+    /* then the thread messages come out in order, before the quit message */
+    for (i = 0; i < 3000; i += 2)
+    {
+        ok( PeekMessageA( &msg, 0, 0, 0, PM_REMOVE ), "no message %d\n", i );
+        ok( !msg.hwnd && msg.message == WM_USER + 1 && msg.wParam == i,
+            "wrong message %p %04x %ld, expected %d\n", msg.hwnd, msg.message, msg.wParam, i );
+    }
+    ok( PeekMessageA( &msg, 0, 0, 0, PM_REMOVE ), "no quit message\n" );
+    ok( msg.message == WM_QUIT && msg.wParam == 0x1234, "wrong message %04x %ld\n", msg.message, msg.wParam );
+    ok( !PeekMessageA( &msg, 0, 0, 0, PM_REMOVE ), "unexpected message %04x\n", msg.message );
+    ret = GetQueueStatus( QS_POSTMESSAGE );
+    ok( !LOWORD(ret), "wrong status %08x\n", ret );
+
+    /* peeking at a message resets the changed bits and sets the message position */
+    ok( PostMessageA( hwnd, WM_USER, 0, 0 ), "PostMessage failed\n" );
+    ok( PeekMessageA( &msg, hwnd, WM_USER, WM_USER, PM_NOREMOVE ), "no message\n" );
+    ret = GetMessagePos();
+    pt.x = (short)LOWORD( ret );
+    pt.y = (short)HIWORD( ret );
+    ok( msg.pt.x == pt.x && msg.pt.y == pt.y, "wrong position %d,%d, expected %d,%d\n",
+        msg.pt.x, msg.pt.y, pt.x, pt.y );
+    ret = MsgWaitForMultipleObjects( 0, NULL, FALSE, 0, QS_POSTMESSAGE );
+    ok( ret == WAIT_TIMEOUT, "MsgWaitForMultipleObjects returned %x\n", ret );
+    ret = GetQueueStatus( QS_POSTMESSAGE );
+    ok( ret == QS_POSTMESSAGE, "wrong status %08x\n", ret );
+    ok( PeekMessageA( &msg, hwnd, WM_USER, WM_USER, PM_REMOVE ), "no message\n" );
+    ret = GetQueueStatus( QS_POSTMESSAGE );
+    ok( !ret, "wrong status %08x\n", ret );
+
+    /* messages for a destroyed window are discarded */
+    ok( PostMessageA( hwnd, WM_USER, 0, 0 ), "PostMessage failed\n" );
+    DestroyWindow( hwnd );
+    ok( !PeekMessageA( &msg, 0, WM_USER, WM_USER, PM_REMOVE ), "got message for destroyed window\n" );
+
+    start = GetTickCount();
+    for (i = count = 0; i < 100000; i++)
+    {
+        PostThreadMessageA( GetCurrentThreadId(), WM_USER, i, 0 );
+        if (PeekMessageA( &msg, 0, WM_USER, WM_USER, PM_REMOVE ) && msg.wParam == i) count++;
+    }
+    elapsed = GetTickCount() - start;
+    ok( count == i, "got %d messages out of %d\n", count, i );
+    trace( "%d posted messages in %u ms\n", i, elapsed );
+}
+
 static void test_quit_message(void)
 {
     MSG msg;
@@ -12719,6 +12797,7 @@ START_TEST(msg)
     test_ShowWindow();
     test_PeekMessage();
     test_PeekMessage2();
+    test_posted_messages_order();
     test_WaitForInputIdle( test_argv[0] );
     test_scrollwindowex();
     test_messages();
@@ -68,6 +68,7 @@ static HHOOK hhook;
 static const char* szAWRClass = "Winsize";
 static HMENU hmenu;
 static DWORD our_pid;
+static char **test_argv;
 
 static BOOL is_win9x = FALSE;
 
@@ -6253,6 +6254,115 @@ static void test_rtl_layout(void)
     DestroyWindow( parent );
 }
 
+/* check the state of a window of the parent process, as passed on the command line */
+static void window_state_child( char **argv )
+{
+    HWND hwnd, parent;
+    LONG style, exstyle;
+    DWORD pid;
+    int visible;
+    RECT expect, rect;
+
+    sscanf( argv[3], "%p", &hwnd );
+    sscanf( argv[4], "%p", &parent );
+    sscanf( argv[5], "%x", &style );
+    sscanf( argv[6], "%x", &exstyle );
+    sscanf( argv[7], "%d", &visible );
+    sscanf( argv[8], "%d,%d-%d,%d", &expect.left, &expect.top, &expect.right, &expect.bottom );
+
+    GetWindowThreadProcessId( hwnd, &pid );
+    ok( pid && pid != GetCurrentProcessId(), "window belongs to process %04x\n", pid );
+    ok( GetWindowLongW( hwnd, GWL_STYLE ) == style, "wrong style %08x/%08x\n",
+        GetWindowLongW( hwnd, GWL_STYLE ), style );
+    ok( GetWindowLongW( hwnd, GWL_EXSTYLE ) == exstyle, "wrong exstyle %08x/%08x\n",
+        GetWindowLongW( hwnd, GWL_EXSTYLE ), exstyle );
+    ok( !IsWindowVisible( hwnd ) == !visible, "wrong visibility %d/%d\n", IsWindowVisible( hwnd ), visible );
+    ok( GetParent( hwnd ) == parent, "wrong parent %p/%p\n", GetParent( hwnd ), parent );
+    if (pGetAncestor)
+        ok( pGetAncestor( hwnd, GA_PARENT ) == parent, "wrong ancestor %p/%p\n",
+            pGetAncestor( hwnd, GA_PARENT ), parent );
+    GetWindowRect( hwnd, &rect );
+    ok( EqualRect( &rect, &expect ), "wrong rect %d,%d-%d,%d/%d,%d-%d,%d\n",
+        rect.left, rect.top, rect.right, rect.bottom, expect.left, expect.top, expect.right, expect.bottom );
+}
+
+/* run a child process checking the state of a window of this process */
+static void check_window_state_in_child( HWND hwnd )
+{
+    char cmdline[MAX_PATH + 160];
+    STARTUPINFOA startup;
+    PROCESS_INFORMATION info;
+    RECT rect;
+
+    GetWindowRect( hwnd, &rect );
+    sprintf( cmdline, "%s win window_state %p %p %x %x %d %d,%d-%d,%d", test_argv[0], hwnd, GetParent( hwnd ),
+             GetWindowLongW( hwnd, GWL_STYLE ), GetWindowLongW( hwnd, GWL_EXSTYLE ), IsWindowVisible( hwnd ),
+             rect.left, rect.top, rect.right, rect.bottom );
+
+    memset( &startup, 0, sizeof(startup) );
+    startup.cb = sizeof(startup);
+    ok( CreateProcessA( NULL, cmdline, NULL, NULL, FALSE, 0, NULL, NULL, &startup, &info ),
+        "CreateProcess failed, error %u\n", GetLastError() );
+    winetest_wait_child_process( info.hProcess );
+    CloseHandle( info.hProcess );
+    CloseHandle( info.hThread );
+}
+
+/* the state of windows of other processes is read from memory shared with the server */
+static void test_desktop_window_state(void)
+{
+    HWND desktop = GetDesktopWindow(), parent, child;
+    LONG style, exstyle;
+    RECT rect;
+    DWORD start, elapsed;
+    int i, changed = 0;
+
+    style = GetWindowLongW( desktop, GWL_STYLE );
+    ok( style & WS_VISIBLE, "desktop not visible, style %08x\n", style );
+    ok( IsWindowVisible( desktop ), "desktop not visible\n" );
+    ok( !GetParent( desktop ), "desktop has a parent\n" );
+    ok( !GetAncestor( desktop, GA_PARENT ), "desktop has a parent\n" );
+    GetWindowRect( desktop, &rect );
+    ok( rect.right == GetSystemMetrics( SM_CXSCREEN ) && rect.bottom == GetSystemMetrics( SM_CYSCREEN ),
+        "wrong desktop rect %d,%d-%d,%d\n", rect.left, rect.top, rect.right, rect.bottom );
+
+    exstyle = GetWindowLongW( desktop, GWL_EXSTYLE );
+    start = GetTickCount();
+    for (i = 0; i < 100000; i++)
+    {
+        if (GetWindowLongW( desktop, GWL_STYLE ) != style) changed++;
+        if (GetWindowLongW( desktop, GWL_EXSTYLE ) != exstyle) changed++;
+    }
+    elapsed = GetTickCount() - start;
+    ok( !changed, "desktop style changed %d times\n", changed );
+    trace( "%d desktop style queries in %u ms\n", 2 * i, elapsed );
+
+    /* the state must be up to date after changes made by the owner process */
+
+    parent = CreateWindowExA( 0, "MainWindowClass", "state parent", WS_POPUP | WS_VISIBLE,
+                              100, 100, 200, 200, 0, 0, GetModuleHandleA( NULL ), NULL );
+    child = CreateWindowExA( 0, "MainWindowClass", "state child", WS_CHILD | WS_VISIBLE,
+                             10, 10, 50, 50, parent, 0, GetModuleHandleA( NULL ), NULL );
+    ok( parent != 0 && child != 0, "failed to create windows\n" );
+    check_window_state_in_child( child );
+
+    SetWindowPos( child, 0, 20, 30, 60, 70, SWP_NOZORDER | SWP_NOACTIVATE );
+    check_window_state_in_child( child );
+
+    SetWindowPos( parent, 0, 150, 120, 0, 0, SWP_NOSIZE | SWP_NOZORDER | SWP_NOACTIVATE );
+    check_window_state_in_child( child );
+
+    SetWindowLongW( child, GWL_STYLE, GetWindowLongW( child, GWL_STYLE ) & ~WS_VISIBLE );
+    SetWindowLongW( child, GWL_EXSTYLE, WS_EX_TRANSPARENT );
+    check_window_state_in_child( child );
+
+    SetWindowLongW( child, GWL_STYLE, GetWindowLongW( child, GWL_STYLE ) | WS_VISIBLE );
+    ShowWindow( parent, SW_HIDE );
+    check_window_state_in_child( child );
+
+    DestroyWindow( parent );
+}
+
 static void test_FindWindowEx(void)
 {
     HWND hwnd, found;
@@ -6313,6 +6423,8 @@ START_TEST(win)
 {
     HMODULE user32 = GetModuleHandleA( "user32.dll" );
     HMODULE gdi32 = GetModuleHandleA("gdi32.dll");
+    int argc = winetest_get_mainargs( &test_argv );
+
     pGetAncestor = (void *)GetProcAddress( user32, "GetAncestor" );
     pGetWindowInfo = (void *)GetProcAddress( user32, "GetWindowInfo" );
     pGetWindowModuleFileNameA = (void *)GetProcAddress( user32, "GetWindowModuleFileNameA" );
@@ -6329,6 +6441,12 @@ START_TEST(win)
     pSetLayout = (void *)GetProcAddress( gdi32, "SetLayout" );
     pMirrorRgn = (void *)GetProcAddress( gdi32, "MirrorRgn" );
 
+    if (argc == 9 && !strcmp( test_argv[2], "window_state" ))
+    {
+        window_state_child( test_argv );
+        return;
+    }
+
     if (!RegisterWindowClasses()) assert(0);
 
     SetLastError(0xdeafbeef);
@@ -6368,6 +6486,7 @@ START_TEST(win)
     test_capture_3(hwndMain, hwndMain2);
     test_capture_4();
     test_rtl_layout();
+    test_desktop_window_state();
 
     test_CreateWindow();
     test_parent_owner();
@@ -310,6 +310,8 @@ static void thread_detach(void)
 
     if (thread_info->top_window) WIN_DestroyThreadWindows( thread_info->top_window );
     if (thread_info->msg_window) WIN_DestroyThreadWindows( thread_info->msg_window );
+    WIN_ReleaseDesktopShm();
+    if (thread_info->queue_ring) UnmapViewOfFile( thread_info->queue_ring );
     CloseHandle( thread_info->server_queue );
     HeapFree( GetProcessHeap(), 0, thread_info->wmchar_data );
 
@@ -178,8 +178,10 @@ struct user_thread_info
     UINT                          active_hooks;           /* Bitmap of active hooks */
     HWND                          top_window;             /* Desktop window */
     HWND                          msg_window;             /* HWND_MESSAGE parent window */
+    const struct window_shm      *desktop_shm;            /* Shared window state of the desktop */
+    struct queue_ring            *queue_ring;             /* Ring of messages posted to the thread */
 
-    ULONG                         pad[11];                /* Available for more data */
+    ULONG                         pad[7];                 /* Available for more data */
 };
 
 struct hook_extra_info
@@ -220,6 +222,7 @@ extern HPEN SYSCOLOR_GetPen( INT index ) DECLSPEC_HIDDEN;
 extern void SYSPARAMS_Init(void) DECLSPEC_HIDDEN;
 extern void USER_CheckNotLock(void) DECLSPEC_HIDDEN;
 extern BOOL USER_IsExitingThread( DWORD tid ) DECLSPEC_HIDDEN;
+extern void WIN_ReleaseDesktopShm(void) DECLSPEC_HIDDEN;
 
 extern BOOL USER_SetWindowPos( WINDOWPOS * winpos ) DECLSPEC_HIDDEN;
 
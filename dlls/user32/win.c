@@ -332,6 +332,80 @@ static HWND *list_window_children( HDESK desktop, HWND hwnd, LPCWSTR class, DWOR
 }
 
 
+/*******************************************************************
+ *           get_desktop_shm
+ *
+ * Map the shared window state of the thread desktop.
+ */
+static const struct window_shm *get_desktop_shm(void)
+{
+    struct user_thread_info *thread_info = get_user_thread_info();
+    HANDLE handle = 0;
+
+    if (thread_info->desktop_shm) return thread_info->desktop_shm;
+
+    SERVER_START_REQ( get_desktop_shm )
+    {
+        if (!wine_server_call( req )) handle = wine_server_ptr_handle( reply->handle );
+    }
+    SERVER_END_REQ;
+    if (!handle) return NULL;
+    thread_info->desktop_shm = MapViewOfFile( handle, FILE_MAP_READ, 0, 0, 0 );
+    CloseHandle( handle );
+    return thread_info->desktop_shm;
+}
+
+
+/*******************************************************************
+ *           WIN_ReleaseDesktopShm
+ *
+ * Unmap the shared window state when the thread leaves its desktop.
+ */
+void WIN_ReleaseDesktopShm(void)
+{
+    struct user_thread_info *thread_info = get_user_thread_info();
+
+    if (!thread_info->desktop_shm) return;
+    UnmapViewOfFile( thread_info->desktop_shm );
+    thread_info->desktop_shm = NULL;
+}
+
+
+/*******************************************************************
+ *           get_window_shm
+ *
+ * Read a consistent copy of the server state of a window without a server
+ * round-trip. Fails if the window isn't on the thread desktop.
+ */
+static BOOL get_window_shm( HWND hwnd, struct window_shm *ret )
+{
+    const volatile struct window_shm *entry;
+    const struct window_shm *shm;
+    WORD index = USER_HANDLE_TO_INDEX(hwnd);
+    unsigned int seq;
+
+    if (index >= NB_USER_HANDLES) return FALSE;
+    if (!(shm = get_desktop_shm())) return FALSE;
+    entry = &shm[index];
+
+    for (;;)
+    {
+        /* the server makes the sequence number odd while it updates the entry */
+        if ((seq = entry->seq) & 1)
+        {
+            Sleep( 0 );
+            continue;
+        }
+        *ret = *entry;
+        if (entry->seq == seq) break;
+    }
+    if (!ret->handle) return FALSE;
+    if (ret->handle == wine_server_user_handle( hwnd )) return TRUE;
+    /* partial handles match any generation */
+    return (HIWORD(hwnd) == 0 || HIWORD(hwnd) == 0xffff) && LOWORD(ret->handle) == LOWORD(hwnd);
+}
+
+
 /*******************************************************************
  *           list_window_parents
  *
@@ -350,15 +424,24 @@ static HWND *list_window_parents( HWND hwnd )
     for (;;)
     {
         if (!(win = WIN_GetPtr( current ))) goto empty;
-        if (win == WND_OTHER_PROCESS) break;  /* need to do it the hard way */
-        if (win == WND_DESKTOP)
+        if (win == WND_OTHER_PROCESS)
+        {
+            struct window_shm shm;
+
+            if (!get_window_shm( current, &shm )) break;  /* need to do it the hard way */
+            list[pos] = current = wine_server_ptr_handle( shm.parent );
+        }
+        else if (win == WND_DESKTOP)
         {
             if (!pos) goto empty;
             list[pos] = 0;
             return list;
         }
-        list[pos] = current = win->parent;
-        WIN_ReleasePtr( win );
+        else
+        {
+            list[pos] = current = win->parent;
+            WIN_ReleasePtr( win );
+        }
         if (!current) return list;
         if (++pos == size - 1)
         {
@@ -648,6 +731,64 @@ ULONG WIN_SetStyle( HWND hwnd, ULONG set_bits, ULONG clear_bits )
 }
 
 
+/***********************************************************************
+ *           get_shm_rectangles
+ *
+ * Compute the window rectangles from the shared window state, the same
+ * way the get_window_rectangles request does.
+ */
+static BOOL get_shm_rectangles( HWND hwnd, enum coords_relative relative, RECT *rectWindow, RECT *rectClient )
+{
+    struct window_shm win, parent;
+    RECT window_rect, client_rect, rect;
+
+    if (!get_window_shm( hwnd, &win )) return FALSE;
+
+    SetRect( &window_rect, win.window.left, win.window.top, win.window.right, win.window.bottom );
+    SetRect( &client_rect, win.client.left, win.client.top, win.client.right, win.client.bottom );
+
+    switch (relative)
+    {
+    case COORDS_CLIENT:
+        rect = client_rect;
+        OffsetRect( &window_rect, -rect.left, -rect.top );
+        OffsetRect( &client_rect, -rect.left, -rect.top );
+        if (win.ex_style & WS_EX_LAYOUTRTL) mirror_rect( &rect, &window_rect );
+        break;
+    case COORDS_WINDOW:
+        rect = window_rect;
+        OffsetRect( &window_rect, -rect.left, -rect.top );
+        OffsetRect( &client_rect, -rect.left, -rect.top );
+        if (win.ex_style & WS_EX_LAYOUTRTL) mirror_rect( &rect, &client_rect );
+        break;
+    case COORDS_PARENT:
+        if (!win.parent) break;
+        if (!get_window_shm( wine_server_ptr_handle( win.parent ), &parent )) return FALSE;
+        if (parent.ex_style & WS_EX_LAYOUTRTL)
+        {
+            SetRect( &rect, parent.client.left, parent.client.top, parent.client.right, parent.client.bottom );
+            mirror_rect( &rect, &window_rect );
+            mirror_rect( &rect, &client_rect );
+        }
+        break;
+    case COORDS_SCREEN:
+        while (win.parent)
+        {
+            if (!get_window_shm( wine_server_ptr_handle( win.parent ), &win )) return FALSE;
+            if (!win.parent) break;  /* desktop window */
+            OffsetRect( &window_rect, win.client.left, win.client.top );
+            OffsetRect( &client_rect, win.client.left, win.client.top );
+        }
+        break;
+    default:
+        return FALSE;
+    }
+    if (rectWindow) *rectWindow = window_rect;
+    if (rectClient) *rectClient = client_rect;
+    return TRUE;
+}
+
+
 /***********************************************************************
  *           WIN_GetRectangles
  *
@@ -752,6 +893,8 @@ BOOL WIN_GetRectangles( HWND hwnd, enum coords_relative relative, RECT *rectWind
     }
 
 other_process:
+    if (get_shm_rectangles( hwnd, relative, rectWindow, rectClient )) return TRUE;
+
     SERVER_START_REQ( get_window_rectangles )
     {
         req->handle = wine_server_user_handle( hwnd );
@@ -2034,11 +2177,16 @@ static LONG_PTR WIN_GetWindowLong( HWND hwnd, INT offset, UINT size, BOOL unicod
 
     if (wndPtr == WND_OTHER_PROCESS || wndPtr == WND_DESKTOP)
     {
+        struct window_shm shm;
+
         if (offset == GWLP_WNDPROC)
         {
             SetLastError( ERROR_ACCESS_DENIED );
             return 0;
         }
+        if ((offset == GWL_STYLE || offset == GWL_EXSTYLE) && get_window_shm( hwnd, &shm ))
+            return offset == GWL_STYLE ? shm.style : shm.ex_style;
+
         SERVER_START_REQ( set_window_info )
         {
             req->handle = wine_server_user_handle( hwnd );
@@ -2684,7 +2832,16 @@ HWND WINAPI GetParent( HWND hwnd )
     if (wndPtr == WND_DESKTOP) return 0;
     if (wndPtr == WND_OTHER_PROCESS)
     {
-        LONG style = GetWindowLongW( hwnd, GWL_STYLE );
+        struct window_shm shm;
+        LONG style;
+
+        if (get_window_shm( hwnd, &shm ))
+        {
+            if (shm.style & WS_POPUP) retvalue = wine_server_ptr_handle( shm.owner );
+            else if (shm.style & WS_CHILD) retvalue = wine_server_ptr_handle( shm.parent );
+            return retvalue;
+        }
+        style = GetWindowLongW( hwnd, GWL_STYLE );
         if (style & (WS_POPUP | WS_CHILD))
         {
             SERVER_START_REQ( get_window_tree )
@@ -2731,14 +2888,20 @@ HWND WINAPI GetAncestor( HWND hwnd, UINT type )
             ret = win->parent;
             WIN_ReleasePtr( win );
         }
-        else /* need to query the server */
+        else
         {
-            SERVER_START_REQ( get_window_tree )
+            struct window_shm shm;
+
+            if (get_window_shm( hwnd, &shm )) ret = wine_server_ptr_handle( shm.parent );
+            else  /* need to query the server */
             {
-                req->handle = wine_server_user_handle( hwnd );
-                if (!wine_server_call_err( req )) ret = wine_server_ptr_handle( reply->parent );
+                SERVER_START_REQ( get_window_tree )
+                {
+                    req->handle = wine_server_user_handle( hwnd );
+                    if (!wine_server_call_err( req )) ret = wine_server_ptr_handle( reply->parent );
+                }
+                SERVER_END_REQ;
             }
-            SERVER_END_REQ;
         }
         break;
 
@@ -3387,6 +3550,53 @@ UINT WINAPI GetWindowModuleFileNameW( HWND hwnd, LPWSTR module, UINT size )
     return GetModuleFileNameW( hinst, module, size );
 }
 
+/******************************************************************************
+ *              get_other_process_window_info
+ *
+ * Retrieve the rectangles and styles of a window belonging to another process,
+ * using a single server round-trip.
+ */
+static BOOL get_other_process_window_info( HWND hwnd, WINDOWINFO *info )
+{
+    struct __server_request_info rect_info, style_info;
+    const struct get_window_rectangles_reply *rect_reply = &rect_info.u.reply.get_window_rectangles_reply;
+    const struct set_window_info_reply *style_reply = &style_info.u.reply.set_window_info_reply;
+    struct get_window_rectangles_request *rect_req;
+    struct set_window_info_request *style_req;
+    unsigned int status;
+    void *reqs[2];
+
+    rect_req = SERVER_INIT_REQ( rect_info, get_window_rectangles );
+    rect_req->handle = wine_server_user_handle( hwnd );
+    rect_req->relative = COORDS_SCREEN;
+
+    style_req = SERVER_INIT_REQ( style_info, set_window_info );
+    style_req->handle = wine_server_user_handle( hwnd );
+    style_req->flags  = 0;  /* don't set anything, just retrieve */
+    style_req->extra_offset = -1;
+    style_req->extra_size = 0;
+
+    reqs[0] = &rect_info;
+    reqs[1] = &style_info;
+    if ((status = wine_server_call_batch( reqs, 2 )))
+    {
+        SetLastError( RtlNtStatusToDosError( status ));
+        return FALSE;
+    }
+
+    info->rcWindow.left   = rect_reply->window.left;
+    info->rcWindow.top    = rect_reply->window.top;
+    info->rcWindow.right  = rect_reply->window.right;
+    info->rcWindow.bottom = rect_reply->window.bottom;
+    info->rcClient.left   = rect_reply->client.left;
+    info->rcClient.top    = rect_reply->client.top;
+    info->rcClient.right  = rect_reply->client.right;
+    info->rcClient.bottom = rect_reply->client.bottom;
+    info->dwStyle   = style_reply->old_style;
+    info->dwExStyle = style_reply->old_ex_style;
+    return TRUE;
+}
+
 /******************************************************************************
  *              GetWindowInfo (USER32.@)
  *
@@ -3394,11 +3604,22 @@ UINT WINAPI GetWindowModuleFileNameW( HWND hwnd, LPWSTR module, UINT size )
  */
 BOOL WINAPI GetWindowInfo( HWND hwnd, PWINDOWINFO pwi)
 {
+    WND *win;
+
     if (!pwi) return FALSE;
-    if (!WIN_GetRectangles( hwnd, COORDS_SCREEN, &pwi->rcWindow, &pwi->rcClient )) return FALSE;
 
-    pwi->dwStyle = GetWindowLongW(hwnd, GWL_STYLE);
-    pwi->dwExStyle = GetWindowLongW(hwnd, GWL_EXSTYLE);
+    if ((win = WIN_GetPtr( hwnd )) == WND_OTHER_PROCESS)
+    {
+        if (!get_other_process_window_info( hwnd, pwi )) return FALSE;
+    }
+    else
+    {
+        if (win && win != WND_DESKTOP) WIN_ReleasePtr( win );
+        if (!WIN_GetRectangles( hwnd, COORDS_SCREEN, &pwi->rcWindow, &pwi->rcClient )) return FALSE;
+
+        pwi->dwStyle = GetWindowLongW(hwnd, GWL_STYLE);
+        pwi->dwExStyle = GetWindowLongW(hwnd, GWL_EXSTYLE);
+    }
     pwi->dwWindowStatus = ((GetActiveWindow() == hwnd) ? WS_ACTIVECAPTION : 0);
 
     pwi->cxWindowBorders = pwi->rcClient.left - pwi->rcWindow.left;
@@ -127,6 +127,9 @@
 #ifdef HAVE_SYS_TIME_H
 # include <sys/time.h>
 #endif
+#ifdef HAVE_SYS_SENDFILE_H
+# include <sys/sendfile.h>
+#endif
 
 #define NONAMELESSUNION
 #define NONAMELESSSTRUCT
@@ -179,13 +182,15 @@ static int WS2_sendto( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
                        LPDWORD lpNumberOfBytesSent, DWORD dwFlags,
                        const struct WS_sockaddr *to, int tolen,
                        LPWSAOVERLAPPED lpOverlapped,
-                       LPWSAOVERLAPPED_COMPLETION_ROUTINE lpCompletionRoutine );
+                       LPWSAOVERLAPPED_COMPLETION_ROUTINE lpCompletionRoutine,
+                       LPWSABUF lpControlBuffer );
 
 static int WS2_recvfrom( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
                          LPDWORD lpNumberOfBytesRecvd, LPDWORD lpFlags,
                          struct WS_sockaddr *lpFrom,
                          LPINT lpFromlen, LPWSAOVERLAPPED lpOverlapped,
-                         LPWSAOVERLAPPED_COMPLETION_ROUTINE lpCompletionRoutine );
+                         LPWSAOVERLAPPED_COMPLETION_ROUTINE lpCompletionRoutine,
+                         LPWSABUF lpControlBuffer );
 
 /* critical section to protect some non-reentrant net function */
 static CRITICAL_SECTION csWSgetXXXbyYYY;
@@ -261,6 +266,8 @@ typedef struct ws2_async
         int *ptr;    /* for recv operations */
     }                                   addrlen;
     DWORD                               flags;
+    LPWSABUF                            control;    /* control data for WSARecvMsg/WSASendMsg */
+    LPDWORD                             lpFlags;    /* message flags returned by WSARecvMsg */
     unsigned int                        n_iovecs;
     unsigned int                        first_iovec;
     struct iovec                        iovec[1];
@@ -279,6 +286,25 @@ typedef struct ws2_accept_async
     struct ws2_async    *read;
 } ws2_accept_async;
 
+typedef struct ws2_transmit_element
+{
+    HANDLE              file;     /* file to send from, 0 for a memory buffer */
+    char               *buffer;   /* memory buffer */
+    ULONGLONG           offset;   /* current offset in the file or buffer */
+    ULONGLONG           end;      /* end offset, ~0 to send up to the end of the file */
+} ws2_transmit_element;
+
+typedef struct ws2_transmit_async
+{
+    HANDLE                  hSocket;
+    IO_STATUS_BLOCK         local_iosb;
+    DWORD                   flags;        /* TF_* flags */
+    DWORD                   sent;         /* total bytes sent so far */
+    unsigned int            n_elements;
+    unsigned int            cur_element;
+    ws2_transmit_element    elements[1];
+} ws2_transmit_async;
+
 /****************************************************************/
 
 /* ----------------------------------- internal data */
@@ -375,6 +401,9 @@ static const int ws_ip_map[][2] =
 #endif
     MAP_OPTION( IP_TOS ),
     MAP_OPTION( IP_TTL ),
+#ifdef IP_PKTINFO
+    MAP_OPTION( IP_PKTINFO ),
+#endif
 };
 
 static const int ws_ipv6_map[][2] =
@@ -1406,6 +1435,125 @@ static void WINAPI ws2_async_apc( void *arg, IO_STATUS_BLOCK *iosb, ULONG reserv
     HeapFree( GetProcessHeap(), 0, wsa );
 }
 
+#ifndef HAVE_STRUCT_MSGHDR_MSG_ACCRIGHTS
+
+/* append a control message to a Windows control buffer */
+static char *fill_control_message( int level, int type, char *current, ULONG *maxsize,
+                                   const void *data, int len )
+{
+    ULONG msgsize = sizeof(WSACMSGHDR) + WSA_CMSG_ALIGN(len);
+    WSACMSGHDR *cmsg = (WSACMSGHDR *)current;
+
+    if (msgsize > *maxsize) return NULL;
+    *maxsize -= msgsize;
+    cmsg->cmsg_len   = sizeof(WSACMSGHDR) + len;
+    cmsg->cmsg_level = level;
+    cmsg->cmsg_type  = type;
+    memcpy( WSA_CMSG_DATA(cmsg), data, len );
+    return current + msgsize;
+}
+
+/* convert the control messages returned by recvmsg to the Windows format */
+static BOOL convert_control_headers_u2ws( struct msghdr *hdr, WSABUF *control )
+{
+    char *ptr = control->buf;
+    ULONG maxsize = control->len;
+    struct cmsghdr *cmsg_unix;
+
+    for (cmsg_unix = CMSG_FIRSTHDR(hdr); cmsg_unix; cmsg_unix = CMSG_NXTHDR(hdr, cmsg_unix))
+    {
+#ifdef IP_PKTINFO
+        if (cmsg_unix->cmsg_level == IPPROTO_IP && cmsg_unix->cmsg_type == IP_PKTINFO)
+        {
+            struct in_pktinfo *data_unix = (struct in_pktinfo *)CMSG_DATA(cmsg_unix);
+            IN_PKTINFO data_win;
+
+            memcpy( &data_win.ipi_addr, &data_unix->ipi_addr, sizeof(data_win.ipi_addr) );
+            data_win.ipi_ifindex = data_unix->ipi_ifindex;
+            if (!(ptr = fill_control_message( WS_IPPROTO_IP, WS_IP_PKTINFO, ptr, &maxsize,
+                                              &data_win, sizeof(data_win) )))
+            {
+                control->len = 0;
+                return FALSE;
+            }
+            continue;
+        }
+#endif
+        FIXME( "unhandled control message level %d type %d\n", cmsg_unix->cmsg_level, cmsg_unix->cmsg_type );
+    }
+    control->len = ptr - control->buf;
+    return TRUE;
+}
+
+/* convert the control messages passed to WSASendMsg to the unix format */
+static int convert_control_headers_ws2u( const WSABUF *control, void *buffer, socklen_t size )
+{
+    const char *ptr = control->buf, *end = control->buf + control->len;
+    struct cmsghdr *cmsg_unix;
+    struct msghdr hdr;
+    int len = 0;
+
+    memset( buffer, 0, size );
+    hdr.msg_control = buffer;
+    hdr.msg_controllen = size;
+    cmsg_unix = CMSG_FIRSTHDR(&hdr);
+
+    while (ptr + sizeof(WSACMSGHDR) <= end)
+    {
+        const WSACMSGHDR *cmsg_win = (const WSACMSGHDR *)ptr;
+
+        if (cmsg_win->cmsg_len < sizeof(WSACMSGHDR) || cmsg_win->cmsg_len > end - ptr) return -1;
+#ifdef IP_PKTINFO
+        if (cmsg_win->cmsg_level == WS_IPPROTO_IP && cmsg_win->cmsg_type == WS_IP_PKTINFO)
+        {
+            const IN_PKTINFO *data_win = (const IN_PKTINFO *)WSA_CMSG_DATA(cmsg_win);
+            struct in_pktinfo data_unix;
+
+            if (!cmsg_unix || cmsg_win->cmsg_len < sizeof(WSACMSGHDR) + sizeof(*data_win)) return -1;
+            memset( &data_unix, 0, sizeof(data_unix) );
+            memcpy( &data_unix.ipi_spec_dst, &data_win->ipi_addr, sizeof(data_unix.ipi_spec_dst) );
+            data_unix.ipi_ifindex = data_win->ipi_ifindex;
+            cmsg_unix->cmsg_level = IPPROTO_IP;
+            cmsg_unix->cmsg_type  = IP_PKTINFO;
+            cmsg_unix->cmsg_len   = CMSG_LEN( sizeof(data_unix) );
+            memcpy( CMSG_DATA(cmsg_unix), &data_unix, sizeof(data_unix) );
+            len += CMSG_SPACE( sizeof(data_unix) );
+            cmsg_unix = CMSG_NXTHDR( &hdr, cmsg_unix );
+        }
+        else
+#endif
+            FIXME( "unhandled control message level %d type %d\n", cmsg_win->cmsg_level, cmsg_win->cmsg_type );
+        ptr += WSA_CMSG_ALIGN( cmsg_win->cmsg_len );
+    }
+    return len;
+}
+
+#endif  /* HAVE_STRUCT_MSGHDR_MSG_ACCRIGHTS */
+
+/***********************************************************************
+ *              WS2_register_async      (INTERNAL)
+ *
+ * Queue an overlapped operation. When there is no completion routine to run
+ * in the calling thread, the ntdll reactor gets to handle it if the socket
+ * is bound to a completion port, which saves the server round-trips.
+ */
+static NTSTATUS WS2_register_async( int type, const async_data_t *async, BOOL use_reactor )
+{
+    NTSTATUS status;
+
+    if (use_reactor && (status = __wine_queue_reactor_async( type, async )) != STATUS_NOT_SUPPORTED)
+        return status;
+
+    SERVER_START_REQ( register_async )
+    {
+        req->type  = type;
+        req->async = *async;
+        status = wine_server_call( req );
+    }
+    SERVER_END_REQ;
+    return status;
+}
+
 /***********************************************************************
  *              WS2_recv                (INTERNAL)
  *
@@ -1415,6 +1563,9 @@ static int WS2_recv( int fd, struct ws2_async *wsa )
 {
     struct msghdr hdr;
     union generic_unix_sockaddr unix_sockaddr;
+#ifndef HAVE_STRUCT_MSGHDR_MSG_ACCRIGHTS
+    ULONG_PTR control_buffer[512 / sizeof(ULONG_PTR)];
+#endif
     int n;
 
     hdr.msg_name = NULL;
@@ -1433,14 +1584,27 @@ static int WS2_recv( int fd, struct ws2_async *wsa )
     hdr.msg_accrights = NULL;
     hdr.msg_accrightslen = 0;
 #else
-    hdr.msg_control = NULL;
-    hdr.msg_controllen = 0;
+    hdr.msg_control = wsa->control ? control_buffer : NULL;
+    hdr.msg_controllen = wsa->control ? sizeof(control_buffer) : 0;
     hdr.msg_flags = 0;
 #endif
 
     if ( (n = recvmsg(fd, &hdr, wsa->flags)) == -1 )
         return -1;
 
+    if (wsa->control)
+    {
+        DWORD flags = 0;
+#ifdef HAVE_STRUCT_MSGHDR_MSG_ACCRIGHTS
+        wsa->control->len = 0;
+#else
+        if (hdr.msg_flags & MSG_TRUNC) flags |= WS_MSG_TRUNC;
+        if ((hdr.msg_flags & MSG_CTRUNC) || !convert_control_headers_u2ws( &hdr, wsa->control ))
+            flags |= WS_MSG_CTRUNC;
+#endif
+        *wsa->lpFlags = flags;
+    }
+
     /* if this socket is connected and lpFrom is not NULL, Linux doesn't give us
      * msg_name and msg_namelen from recvmsg, but it does set msg_namelen to zero.
      *
@@ -1629,6 +1793,9 @@ static int WS2_send( int fd, struct ws2_async *wsa )
 {
     struct msghdr hdr;
     union generic_unix_sockaddr unix_addr;
+#ifndef HAVE_STRUCT_MSGHDR_MSG_ACCRIGHTS
+    ULONG_PTR control_buffer[512 / sizeof(ULONG_PTR)];
+#endif
 
     hdr.msg_name = NULL;
     hdr.msg_namelen = 0;
@@ -1670,6 +1837,21 @@ static int WS2_send( int fd, struct ws2_async *wsa )
     hdr.msg_control = NULL;
     hdr.msg_controllen = 0;
     hdr.msg_flags = 0;
+    if (wsa->control && wsa->control->len)
+    {
+        int len = convert_control_headers_ws2u( wsa->control, control_buffer, sizeof(control_buffer) );
+
+        if (len == -1)
+        {
+            errno = EINVAL;
+            return -1;
+        }
+        if (len)
+        {
+            hdr.msg_control = control_buffer;
+            hdr.msg_controllen = len;
+        }
+    }
 #endif
 
     return sendmsg(fd, &hdr, wsa->flags);
@@ -1917,6 +2099,7 @@ static BOOL WINAPI WS2_AcceptEx(SOCKET listener, SOCKET acceptor, PVOID dest, DW
         wsa->read->hSocket     = wsa->accept_socket;
         wsa->read->flags       = 0;
         wsa->read->addr        = NULL;
+        wsa->read->control     = NULL;
         wsa->read->addrlen.ptr = NULL;
         wsa->read->n_iovecs    = 1;
         wsa->read->first_iovec = 0;
@@ -2215,6 +2398,7 @@ static BOOL WINAPI WS2_ConnectEx(SOCKET s, const struct WS_sockaddr* name, int n
             wsa->addr        = NULL;
             wsa->addrlen.val = 0;
             wsa->flags       = 0;
+            wsa->control     = NULL;
             wsa->n_iovecs    = sendBuf ? 1 : 0;
             wsa->first_iovec = 0;
             wsa->completion_func = NULL;
@@ -2256,6 +2440,393 @@ connection_success:
 }
 
 
+/***********************************************************************
+ *             WSARecvMsg
+ */
+static int WINAPI WS2_WSARecvMsg( SOCKET s, LPWSAMSG msg, LPDWORD lpNumberOfBytesRecvd,
+                                  LPWSAOVERLAPPED lpOverlapped,
+                                  LPWSAOVERLAPPED_COMPLETION_ROUTINE lpCompletionRoutine )
+{
+    if (!msg)
+    {
+        SetLastError( WSAEFAULT );
+        return SOCKET_ERROR;
+    }
+
+    return WS2_recvfrom( s, msg->lpBuffers, msg->dwBufferCount, lpNumberOfBytesRecvd,
+                         &msg->dwFlags, msg->name, &msg->namelen,
+                         lpOverlapped, lpCompletionRoutine, &msg->Control );
+}
+
+/***********************************************************************
+ *             WSASendMsg
+ */
+static int WINAPI WS2_WSASendMsg( SOCKET s, LPWSAMSG msg, DWORD dwFlags, LPDWORD lpNumberOfBytesSent,
+                                  LPWSAOVERLAPPED lpOverlapped,
+                                  LPWSAOVERLAPPED_COMPLETION_ROUTINE lpCompletionRoutine )
+{
+    if (!msg)
+    {
+        SetLastError( WSAEFAULT );
+        return SOCKET_ERROR;
+    }
+
+    return WS2_sendto( s, msg->lpBuffers, msg->dwBufferCount, lpNumberOfBytesSent,
+                       dwFlags, msg->name, msg->namelen,
+                       lpOverlapped, lpCompletionRoutine, &msg->Control );
+}
+
+/***********************************************************************
+ *              WS2_transmit_file       (INTERNAL)
+ *
+ * Send the next part of a file element, without copying the data through
+ * user space when the platform supports it.
+ */
+static int WS2_transmit_file( int fd, struct ws2_transmit_element *elem )
+{
+    char buffer[65536];
+    size_t count = min( elem->end - elem->offset, 0x7ffff000 );
+    NTSTATUS status;
+    int file_fd, ret;
+
+    if ((status = wine_server_handle_to_fd( elem->file, FILE_READ_DATA, &file_fd, NULL )))
+    {
+        WARN( "invalid file handle %p, status %08x\n", elem->file, status );
+        errno = EBADF;
+        return -1;
+    }
+
+#if defined(HAVE_SENDFILE) && defined(HAVE_SYS_SENDFILE_H)
+    {
+        off_t offset = elem->offset;
+
+        ret = sendfile( fd, file_fd, &offset, count );
+        if (ret != -1 || (errno != EINVAL && errno != ENOSYS))
+        {
+            wine_server_release_fd( elem->file, file_fd );
+            return ret;
+        }
+    }
+#endif
+
+    /* fall back to reading the file into a bounce buffer */
+    ret = pread( file_fd, buffer, min( count, sizeof(buffer) ), elem->offset );
+    if (ret > 0) ret = send( fd, buffer, ret, 0 );
+    wine_server_release_fd( elem->file, file_fd );
+    return ret;
+}
+
+/***********************************************************************
+ *              WS2_transmit            (INTERNAL)
+ *
+ * Workhorse for TransmitFile and TransmitPackets. Returns 0 once all the
+ * elements have been sent, -1 with errno set otherwise.
+ */
+static int WS2_transmit( int fd, struct ws2_transmit_async *wsa )
+{
+    while (wsa->cur_element < wsa->n_elements)
+    {
+        struct ws2_transmit_element *elem = &wsa->elements[wsa->cur_element];
+        int ret;
+
+        if (elem->offset >= elem->end)
+        {
+            wsa->cur_element++;
+            continue;
+        }
+
+        if (elem->file)
+            ret = WS2_transmit_file( fd, elem );
+        else
+            ret = send( fd, elem->buffer + elem->offset, min( elem->end - elem->offset, 0x7ffff000 ), 0 );
+
+        if (ret == -1)
+        {
+            if (errno == EINTR) continue;
+            return -1;
+        }
+        if (!ret)
+        {
+            /* end of file reached */
+            elem->end = elem->offset;
+            continue;
+        }
+        elem->offset += ret;
+        wsa->sent += ret;
+    }
+    return 0;
+}
+
+/* user APC called upon TransmitFile/TransmitPackets completion */
+static void WINAPI ws2_transmit_apc( void *arg, IO_STATUS_BLOCK *iosb, ULONG reserved )
+{
+    HeapFree( GetProcessHeap(), 0, arg );
+}
+
+/***********************************************************************
+ *              WS2_async_transmit      (INTERNAL)
+ *
+ * Handler for overlapped TransmitFile and TransmitPackets operations.
+ */
+static NTSTATUS WS2_async_transmit( void *user, IO_STATUS_BLOCK *iosb, NTSTATUS status, void **apc )
+{
+    ws2_transmit_async *wsa = user;
+    int fd;
+
+    switch (status)
+    {
+    case STATUS_ALERTED:
+        if ((status = wine_server_handle_to_fd( wsa->hSocket, FILE_WRITE_DATA, &fd, NULL ) ))
+            break;
+
+        if (!WS2_transmit( fd, wsa ))
+        {
+            status = STATUS_SUCCESS;
+            if (wsa->flags & TF_DISCONNECT) shutdown( fd, 1 );
+        }
+        else if (errno == EAGAIN)
+        {
+            status = STATUS_PENDING;
+            _enable_event( wsa->hSocket, FD_WRITE, 0, 0 );
+        }
+        else status = wsaErrStatus();
+
+        wine_server_release_fd( wsa->hSocket, fd );
+        break;
+    }
+    if (status != STATUS_PENDING)
+    {
+        iosb->u.Status = status;
+        iosb->Information = wsa->sent;
+        *apc = ws2_transmit_apc;
+    }
+    return status;
+}
+
+/***********************************************************************
+ *              WS2_transmit_elements   (INTERNAL)
+ *
+ * Common part of TransmitFile and TransmitPackets; takes ownership of wsa.
+ */
+static BOOL WS2_transmit_elements( SOCKET s, struct ws2_transmit_async *wsa, LPOVERLAPPED ov )
+{
+    ULONG_PTR cvalue = (ov && ((ULONG_PTR)ov->hEvent & 1) == 0) ? (ULONG_PTR)ov : 0;
+    unsigned int options;
+    int fd, ret, err;
+
+    if ((fd = get_sock_fd( s, FILE_WRITE_DATA, &options )) == -1)
+    {
+        HeapFree( GetProcessHeap(), 0, wsa );
+        return FALSE;
+    }
+
+    wsa->hSocket     = SOCKET2HANDLE(s);
+    wsa->sent        = 0;
+    wsa->cur_element = 0;
+
+    ret = WS2_transmit( fd, wsa );
+
+    if (ret == -1 && errno == EAGAIN && ov &&
+        !(options & (FILE_SYNCHRONOUS_IO_ALERT | FILE_SYNCHRONOUS_IO_NONALERT)))
+    {
+        IO_STATUS_BLOCK *iosb = (IO_STATUS_BLOCK *)ov;
+        async_data_t async;
+        NTSTATUS status;
+
+        release_sock_fd( s, fd );
+        iosb->u.Status = STATUS_PENDING;
+        iosb->Information = wsa->sent;
+
+        async.handle   = wine_server_obj_handle( wsa->hSocket );
+        async.callback = wine_server_client_ptr( WS2_async_transmit );
+        async.iosb     = wine_server_client_ptr( iosb );
+        async.arg      = wine_server_client_ptr( wsa );
+        async.event    = wine_server_obj_handle( ov->hEvent );
+        async.cvalue   = cvalue;
+        status = WS2_register_async( ASYNC_TYPE_WRITE, &async, TRUE );
+
+        if (status != STATUS_PENDING) HeapFree( GetProcessHeap(), 0, wsa );
+        WSASetLastError( NtStatusToWSAError( status ));
+        return FALSE;
+    }
+
+    /* TransmitFile blocks until everything is sent when not overlapped, */
+    /* unless the socket is non-blocking in which case it fails with WSAEWOULDBLOCK */
+    if (ret == -1 && errno == EAGAIN)
+    {
+        if (_is_blocking( s ))
+        {
+            do
+            {
+                struct pollfd pfd;
+
+                pfd.fd = fd;
+                pfd.events = POLLOUT;
+                poll( &pfd, 1, -1 );
+                ret = WS2_transmit( fd, wsa );
+            } while (ret == -1 && errno == EAGAIN);
+        }
+        else errno = EWOULDBLOCK;  /* the server call may have clobbered it */
+    }
+
+    if (ret == -1)
+    {
+        int loc_errno = errno;
+
+        err = wsaErrno();
+        if (ov)
+        {
+            ((IO_STATUS_BLOCK *)ov)->u.Status = sock_get_ntstatus( loc_errno );
+            ((IO_STATUS_BLOCK *)ov)->Information = wsa->sent;
+        }
+        if (cvalue) WS_AddCompletion( s, cvalue, sock_get_ntstatus( loc_errno ), wsa->sent );
+        release_sock_fd( s, fd );
+        HeapFree( GetProcessHeap(), 0, wsa );
+        WARN( " -> ERROR %d\n", err );
+        WSASetLastError( err );
+        return FALSE;
+    }
+
+    if (wsa->flags & TF_DISCONNECT) shutdown( fd, 1 );
+    release_sock_fd( s, fd );
+
+    TRACE( " -> %u bytes\n", wsa->sent );
+    if (ov)
+    {
+        ((IO_STATUS_BLOCK *)ov)->u.Status = STATUS_SUCCESS;
+        ((IO_STATUS_BLOCK *)ov)->Information = wsa->sent;
+        if (cvalue) WS_AddCompletion( s, cvalue, STATUS_SUCCESS, wsa->sent );
+        if (ov->hEvent) SetEvent( ov->hEvent );
+    }
+    HeapFree( GetProcessHeap(), 0, wsa );
+    WSASetLastError( 0 );
+    return TRUE;
+}
+
+/* set up a file element, starting at the current file position if offset is NULL */
+static BOOL init_transmit_file_element( struct ws2_transmit_element *elem, HANDLE file,
+                                        const LARGE_INTEGER *offset, DWORD len )
+{
+    LARGE_INTEGER pos;
+
+    if (!offset)
+    {
+        pos.QuadPart = 0;
+        if (!SetFilePointerEx( file, pos, &pos, FILE_CURRENT )) return FALSE;
+        offset = &pos;
+    }
+    elem->file   = file;
+    elem->buffer = NULL;
+    elem->offset = offset->QuadPart;
+    elem->end    = len ? elem->offset + len : ~(ULONGLONG)0;
+    return TRUE;
+}
+
+static void init_transmit_memory_element( struct ws2_transmit_element *elem, void *buffer, DWORD len )
+{
+    elem->file   = 0;
+    elem->buffer = buffer;
+    elem->offset = 0;
+    elem->end    = buffer ? len : 0;
+}
+
+/***********************************************************************
+ *             TransmitFile
+ */
+static BOOL WINAPI WS2_TransmitFile( SOCKET s, HANDLE file, DWORD total_len, DWORD chunk_len,
+                                     LPOVERLAPPED ov, LPTRANSMIT_FILE_BUFFERS buffers, DWORD flags )
+{
+    struct ws2_transmit_async *wsa;
+    LARGE_INTEGER offset;
+    unsigned int n = 0;
+
+    TRACE( "socket %04lx, file %p, total_len %u, chunk_len %u, ov %p, buffers %p, flags %x\n",
+           s, file, total_len, chunk_len, ov, buffers, flags );
+
+    if (flags & TF_REUSE_SOCKET) FIXME( "TF_REUSE_SOCKET not supported\n" );
+
+    if (!(wsa = HeapAlloc( GetProcessHeap(), 0, FIELD_OFFSET( struct ws2_transmit_async, elements[3] ))))
+    {
+        WSASetLastError( WSAENOBUFS );
+        return FALSE;
+    }
+
+    if (buffers) init_transmit_memory_element( &wsa->elements[n++], buffers->Head, buffers->HeadLength );
+    if (file)
+    {
+        if (ov)
+        {
+            offset.u.LowPart  = ov->u.s.Offset;
+            offset.u.HighPart = ov->u.s.OffsetHigh;
+        }
+        if (!init_transmit_file_element( &wsa->elements[n++], file, ov ? &offset : NULL, total_len ))
+        {
+            HeapFree( GetProcessHeap(), 0, wsa );
+            WSASetLastError( WSAEINVAL );
+            return FALSE;
+        }
+    }
+    if (buffers) init_transmit_memory_element( &wsa->elements[n++], buffers->Tail, buffers->TailLength );
+
+    wsa->flags      = flags;
+    wsa->n_elements = n;
+    return WS2_transmit_elements( s, wsa, ov );
+}
+
+/***********************************************************************
+ *             TransmitPackets
+ */
+static BOOL WINAPI WS2_TransmitPackets( SOCKET s, LPTRANSMIT_PACKETS_ELEMENT packets, DWORD count,
+                                        DWORD send_size, LPOVERLAPPED ov, DWORD flags )
+{
+    struct ws2_transmit_async *wsa;
+    unsigned int i;
+
+    TRACE( "socket %04lx, packets %p, count %u, send_size %u, ov %p, flags %x\n",
+           s, packets, count, send_size, ov, flags );
+
+    if (count && !packets)
+    {
+        WSASetLastError( WSAEINVAL );
+        return FALSE;
+    }
+    if (flags & TP_REUSE_SOCKET) FIXME( "TP_REUSE_SOCKET not supported\n" );
+
+    if (!(wsa = HeapAlloc( GetProcessHeap(), 0,
+                           FIELD_OFFSET( struct ws2_transmit_async, elements[max( count, 1 )] ))))
+    {
+        WSASetLastError( WSAENOBUFS );
+        return FALSE;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        struct ws2_transmit_element *elem = &wsa->elements[i];
+
+        switch (packets[i].dwElFlags & (TP_ELEMENT_MEMORY | TP_ELEMENT_FILE))
+        {
+        case TP_ELEMENT_MEMORY:
+            init_transmit_memory_element( elem, packets[i].u.pBuffer, packets[i].cLength );
+            break;
+        case TP_ELEMENT_FILE:
+            if (init_transmit_file_element( elem, packets[i].u.s.hFile,
+                                            packets[i].u.s.nFileOffset.QuadPart == -1 ?
+                                            NULL : &packets[i].u.s.nFileOffset,
+                                            packets[i].cLength ))
+                break;
+            /* fall through */
+        default:
+            HeapFree( GetProcessHeap(), 0, wsa );
+            WSASetLastError( WSAEINVAL );
+            return FALSE;
+        }
+    }
+
+    wsa->flags      = flags;
+    wsa->n_elements = count;
+    return WS2_transmit_elements( s, wsa, ov );
+}
+
 /***********************************************************************
  *		getpeername		(WS2_32.5)
  */
@@ -2676,6 +3247,9 @@ INT WINAPI WS_getsockopt(SOCKET s, INT level,
         case WS_IP_MULTICAST_LOOP:
         case WS_IP_MULTICAST_TTL:
         case WS_IP_OPTIONS:
+#ifdef IP_PKTINFO
+        case WS_IP_PKTINFO:
+#endif
         case WS_IP_TOS:
         case WS_IP_TTL:
             if ( (fd = get_sock_fd( s, 0, NULL )) == -1)
@@ -3193,19 +3767,23 @@ INT WINAPI WSAIoctl(SOCKET s,
         }
         else if ( IsEqualGUID(&transmitfile_guid, lpvInBuffer) )
         {
-            FIXME("SIO_GET_EXTENSION_FUNCTION_POINTER: unimplemented TransmitFile\n");
+            *(LPFN_TRANSMITFILE *)lpbOutBuffer = WS2_TransmitFile;
+            return 0;
         }
         else if ( IsEqualGUID(&transmitpackets_guid, lpvInBuffer) )
         {
-            FIXME("SIO_GET_EXTENSION_FUNCTION_POINTER: unimplemented TransmitPackets\n");
+            *(LPFN_TRANSMITPACKETS *)lpbOutBuffer = WS2_TransmitPackets;
+            return 0;
         }
         else if ( IsEqualGUID(&wsarecvmsg_guid, lpvInBuffer) )
         {
-            FIXME("SIO_GET_EXTENSION_FUNCTION_POINTER: unimplemented WSARecvMsg\n");
+            *(LPFN_WSARECVMSG *)lpbOutBuffer = WS2_WSARecvMsg;
+            return 0;
         }
         else if ( IsEqualGUID(&wsasendmsg_guid, lpvInBuffer) )
         {
-            FIXME("SIO_GET_EXTENSION_FUNCTION_POINTER: unimplemented WSASendMsg\n");
+            *(LPFN_WSASENDMSG *)lpbOutBuffer = WS2_WSASendMsg;
+            return 0;
         }
         else
             FIXME("SIO_GET_EXTENSION_FUNCTION_POINTER %s: stub\n", debugstr_guid(lpvInBuffer));
@@ -3461,7 +4039,7 @@ int WINAPI WS_recv(SOCKET s, char *buf, int len, int flags)
     wsabuf.len = len;
     wsabuf.buf = buf;
 
-    if ( WS2_recvfrom(s, &wsabuf, 1, &n, &dwFlags, NULL, NULL, NULL, NULL) == SOCKET_ERROR )
+    if ( WS2_recvfrom(s, &wsabuf, 1, &n, &dwFlags, NULL, NULL, NULL, NULL, NULL) == SOCKET_ERROR )
         return SOCKET_ERROR;
     else
         return n;
@@ -3479,107 +4057,148 @@ int WINAPI WS_recvfrom(SOCKET s, char *buf, INT len, int flags,
     wsabuf.len = len;
     wsabuf.buf = buf;
 
-    if ( WS2_recvfrom(s, &wsabuf, 1, &n, &dwFlags, from, fromlen, NULL, NULL) == SOCKET_ERROR )
+    if ( WS2_recvfrom(s, &wsabuf, 1, &n, &dwFlags, from, fromlen, NULL, NULL, NULL) == SOCKET_ERROR )
         return SOCKET_ERROR;
     else
         return n;
 }
 
-/* allocate a poll array for the corresponding fd sets */
-static struct pollfd *fd_sets_to_poll( const WS_fd_set *readfds, const WS_fd_set *writefds,
-                                       const WS_fd_set *exceptfds, int *count_ptr )
+/* poll array built from a set of sockets */
+struct sock_poll_fds
 {
-    unsigned int i, j = 0, count = 0;
-    struct pollfd *fds;
+    unsigned int   count;
+    HANDLE        *handles;     /* socket handles */
+    unsigned int  *access;      /* access rights required on each socket */
+    int           *unix_fds;    /* unix fds returned by ntdll */
+    int           *needs_close; /* whether each unix fd is a private copy */
+    struct pollfd *fds;         /* array passed to poll() */
+};
 
-    if (readfds) count += readfds->fd_count;
-    if (writefds) count += writefds->fd_count;
-    if (exceptfds) count += exceptfds->fd_count;
-    *count_ptr = count;
-    if (!count)
+static BOOL alloc_poll_fds( struct sock_poll_fds *poll_fds, unsigned int count )
+{
+    char *ptr;
+
+    if (!(ptr = HeapAlloc( GetProcessHeap(), 0, count * (sizeof(HANDLE) + sizeof(struct pollfd) +
+                                                        sizeof(unsigned int) + 2 * sizeof(int) ))))
     {
-        SetLastError(WSAEINVAL);
-        return NULL;
+        SetLastError( ERROR_NOT_ENOUGH_MEMORY );
+        return FALSE;
     }
-    if (!(fds = HeapAlloc( GetProcessHeap(), 0, count * sizeof(fds[0]))))
+    poll_fds->count       = count;
+    poll_fds->handles     = (HANDLE *)ptr;
+    poll_fds->fds         = (struct pollfd *)(poll_fds->handles + count);
+    poll_fds->access      = (unsigned int *)(poll_fds->fds + count);
+    poll_fds->unix_fds    = (int *)(poll_fds->access + count);
+    poll_fds->needs_close = poll_fds->unix_fds + count;
+    return TRUE;
+}
+
+static inline void set_poll_socket( struct sock_poll_fds *poll_fds, unsigned int i, SOCKET s,
+                                    unsigned int access, short events )
+{
+    poll_fds->handles[i]    = SOCKET2HANDLE(s);
+    poll_fds->access[i]     = access;
+    poll_fds->fds[i].events = events;
+}
+
+/* retrieve the unix fds of all the sockets with a single ntdll call */
+/* sockets whose fd can't be retrieved are left with fd -1 */
+static NTSTATUS get_poll_fds( struct sock_poll_fds *poll_fds )
+{
+    unsigned int i;
+    NTSTATUS status;
+
+    status = __wine_server_get_unix_fds( poll_fds->count, poll_fds->handles, poll_fds->access,
+                                         poll_fds->unix_fds, poll_fds->needs_close );
+    for (i = 0; i < poll_fds->count; i++)
     {
-        SetLastError( ERROR_NOT_ENOUGH_MEMORY );
-        return NULL;
+        poll_fds->fds[i].fd = poll_fds->unix_fds[i];
+        poll_fds->fds[i].revents = 0;
     }
-    if (readfds)
-        for (i = 0; i < readfds->fd_count; i++, j++)
-        {
-            fds[j].fd = get_sock_fd( readfds->fd_array[i], FILE_READ_DATA, NULL );
-            if (fds[j].fd == -1) goto failed;
-            fds[j].events = POLLIN;
-            fds[j].revents = 0;
-        }
-    if (writefds)
-        for (i = 0; i < writefds->fd_count; i++, j++)
-        {
-            fds[j].fd = get_sock_fd( writefds->fd_array[i], FILE_WRITE_DATA, NULL );
-            if (fds[j].fd == -1) goto failed;
-            fds[j].events = POLLOUT;
-            fds[j].revents = 0;
-        }
-    if (exceptfds)
-        for (i = 0; i < exceptfds->fd_count; i++, j++)
+    return status;
+}
+
+/* close the private fds returned by get_poll_fds and free the poll array */
+static void release_poll_fds( struct sock_poll_fds *poll_fds )
+{
+    unsigned int i;
+
+    for (i = 0; i < poll_fds->count; i++)
+        if (poll_fds->unix_fds[i] != -1 && poll_fds->needs_close[i]) close( poll_fds->unix_fds[i] );
+    HeapFree( GetProcessHeap(), 0, poll_fds->handles );
+}
+
+/* call poll(), restarting it on EINTR with the remaining time */
+static int do_poll( struct pollfd *fds, unsigned int count, int timeout )
+{
+    struct timeval tv1, tv2;
+    int ret, torig = timeout;
+
+    if (timeout > 0) gettimeofday( &tv1, 0 );
+
+    while ((ret = poll( fds, count, timeout )) < 0)
+    {
+        if (errno == EINTR)
         {
-            fds[j].fd = get_sock_fd( exceptfds->fd_array[i], 0, NULL );
-            if (fds[j].fd == -1) goto failed;
-            fds[j].events = POLLHUP;
-            fds[j].revents = 0;
-        }
-    return fds;
+            if (timeout < 0) continue;
+            if (!timeout) break;
+            gettimeofday( &tv2, 0 );
 
-failed:
-    count = j;
-    j = 0;
-    if (readfds)
-        for (i = 0; i < readfds->fd_count && j < count; i++, j++)
-            release_sock_fd( readfds->fd_array[i], fds[j].fd );
-    if (writefds)
-        for (i = 0; i < writefds->fd_count && j < count; i++, j++)
-            release_sock_fd( writefds->fd_array[i], fds[j].fd );
-    if (exceptfds)
-        for (i = 0; i < exceptfds->fd_count && j < count; i++, j++)
-            release_sock_fd( exceptfds->fd_array[i], fds[j].fd );
-    HeapFree( GetProcessHeap(), 0, fds );
-    return NULL;
+            tv2.tv_sec  -= tv1.tv_sec;
+            tv2.tv_usec -= tv1.tv_usec;
+            if (tv2.tv_usec < 0)
+            {
+                tv2.tv_usec += 1000000;
+                tv2.tv_sec  -= 1;
+            }
+
+            timeout = torig - (tv2.tv_sec * 1000) - (tv2.tv_usec + 999) / 1000;
+            if (timeout <= 0) break;
+        } else break;
+    }
+    return ret;
 }
 
-/* release the file descriptor obtained in fd_sets_to_poll */
-/* must be called with the original fd_set arrays, before calling get_poll_results */
-static void release_poll_fds( const WS_fd_set *readfds, const WS_fd_set *writefds,
-                              const WS_fd_set *exceptfds, struct pollfd *fds )
+/* build the poll array for the corresponding fd sets */
+static BOOL fd_sets_to_poll( const WS_fd_set *readfds, const WS_fd_set *writefds,
+                             const WS_fd_set *exceptfds, struct sock_poll_fds *poll_fds )
 {
-    unsigned int i, j = 0;
+    unsigned int i, j = 0, count = 0;
+    NTSTATUS status;
 
-    if (readfds)
+    if (readfds) count += readfds->fd_count;
+    if (writefds) count += writefds->fd_count;
+    if (exceptfds) count += exceptfds->fd_count;
+    if (!count)
     {
-        for (i = 0; i < readfds->fd_count; i++, j++)
-            if (fds[j].fd != -1) release_sock_fd( readfds->fd_array[i], fds[j].fd );
+        SetLastError(WSAEINVAL);
+        return FALSE;
     }
+    if (!alloc_poll_fds( poll_fds, count )) return FALSE;
+
+    if (readfds)
+        for (i = 0; i < readfds->fd_count; i++, j++)
+            set_poll_socket( poll_fds, j, readfds->fd_array[i], FILE_READ_DATA, POLLIN );
     if (writefds)
-    {
         for (i = 0; i < writefds->fd_count; i++, j++)
-            if (fds[j].fd != -1) release_sock_fd( writefds->fd_array[i], fds[j].fd );
-    }
+            set_poll_socket( poll_fds, j, writefds->fd_array[i], FILE_WRITE_DATA, POLLOUT );
     if (exceptfds)
-    {
         for (i = 0; i < exceptfds->fd_count; i++, j++)
-            if (fds[j].fd != -1)
-            {
-                /* make sure we have a real error before releasing the fd */
-                if (!sock_error_p( fds[j].fd )) fds[j].revents = 0;
-                release_sock_fd( exceptfds->fd_array[i], fds[j].fd );
-            }
+            set_poll_socket( poll_fds, j, exceptfds->fd_array[i], 0, POLLHUP );
+
+    if ((status = get_poll_fds( poll_fds )))
+    {
+        release_poll_fds( poll_fds );
+        set_error( status );
+        return FALSE;
     }
+    return TRUE;
 }
 
 /* map the poll results back into the Windows fd sets */
+/* must be called with the original fd_set arrays, before releasing the poll fds */
 static int get_poll_results( WS_fd_set *readfds, WS_fd_set *writefds, WS_fd_set *exceptfds,
-                             const struct pollfd *fds )
+                             struct pollfd *fds )
 {
     unsigned int i, j = 0, k, total = 0;
 
@@ -3600,7 +4219,11 @@ static int get_poll_results( WS_fd_set *readfds, WS_fd_set *writefds, WS_fd_set
     if (exceptfds)
     {
         for (i = k = 0; i < exceptfds->fd_count; i++, j++)
+        {
+            /* make sure we have a real error */
+            if (fds[j].revents && !sock_error_p( fds[j].fd )) fds[j].revents = 0;
             if (fds[j].revents) exceptfds->fd_array[k++] = exceptfds->fd_array[i];
+        }
         exceptfds->fd_count = k;
         total += k;
     }
@@ -3615,49 +4238,99 @@ int WINAPI WS_select(int nfds, WS_fd_set *ws_readfds,
                      WS_fd_set *ws_writefds, WS_fd_set *ws_exceptfds,
                      const struct WS_timeval* ws_timeout)
 {
-    struct pollfd *pollfds;
-    struct timeval tv1, tv2;
-    int torig = 0;
-    int count, ret, timeout = -1;
+    struct sock_poll_fds poll_fds;
+    int ret, timeout = -1;
 
     TRACE("read %p, write %p, excp %p timeout %p\n",
           ws_readfds, ws_writefds, ws_exceptfds, ws_timeout);
 
-    if (!(pollfds = fd_sets_to_poll( ws_readfds, ws_writefds, ws_exceptfds, &count )))
+    if (!fd_sets_to_poll( ws_readfds, ws_writefds, ws_exceptfds, &poll_fds ))
         return SOCKET_ERROR;
 
     if (ws_timeout)
+        timeout = (ws_timeout->tv_sec * 1000) + (ws_timeout->tv_usec + 999) / 1000;
+
+    ret = do_poll( poll_fds.fds, poll_fds.count, timeout );
+
+    if (ret == -1) SetLastError(wsaErrno());
+    else ret = get_poll_results( ws_readfds, ws_writefds, ws_exceptfds, poll_fds.fds );
+    release_poll_fds( &poll_fds );
+    return ret;
+}
+
+
+/***********************************************************************
+ *		WSAPoll			(WS2_32.@)
+ */
+int WINAPI WSAPoll( WSAPOLLFD *wfds, ULONG count, int timeout )
+{
+    struct sock_poll_fds poll_fds;
+    unsigned int i, j, total = 0;
+    BOOL invalid = FALSE;
+    int ret;
+
+    TRACE( "(%p, %u, %d)\n", wfds, count, timeout );
+
+    if (!count)
+    {
+        SetLastError( WSAEINVAL );
+        return SOCKET_ERROR;
+    }
+    if (!wfds)
     {
-        torig = (ws_timeout->tv_sec * 1000) + (ws_timeout->tv_usec + 999) / 1000;
-        timeout = torig;
-        gettimeofday( &tv1, 0 );
+        SetLastError( WSAEFAULT );
+        return SOCKET_ERROR;
     }
 
-    while ((ret = poll( pollfds, count, timeout )) < 0)
+    /* negative sockets are ignored */
+    for (i = 0; i < count; i++)
+        if ((INT_PTR)wfds[i].fd >= 0) total++;
+    if (!alloc_poll_fds( &poll_fds, max( total, 1 ) )) return SOCKET_ERROR;
+    poll_fds.count = total;
+
+    for (i = j = 0; i < count; i++)
     {
-        if (errno == EINTR)
-        {
-            if (!ws_timeout) continue;
-            gettimeofday( &tv2, 0 );
+        short events = 0;
 
-            tv2.tv_sec  -= tv1.tv_sec;
-            tv2.tv_usec -= tv1.tv_usec;
-            if (tv2.tv_usec < 0)
-            {
-                tv2.tv_usec += 1000000;
-                tv2.tv_sec  -= 1;
-            }
+        if ((INT_PTR)wfds[i].fd < 0) continue;
+        if (wfds[i].events & WS_POLLIN) events |= POLLIN;
+        if (wfds[i].events & WS_POLLPRI) events |= POLLPRI;
+        if (wfds[i].events & (WS_POLLOUT | WS_POLLWRBAND)) events |= POLLOUT;
+        set_poll_socket( &poll_fds, j++, wfds[i].fd, 0, events );
+    }
 
-            timeout = torig - (tv2.tv_sec * 1000) - (tv2.tv_usec + 999) / 1000;
-            if (timeout <= 0) break;
-        } else break;
+    /* invalid sockets are reported through POLLNVAL, don't wait if there are any */
+    if (get_poll_fds( &poll_fds )) invalid = TRUE;
+
+    if ((ret = do_poll( poll_fds.fds, poll_fds.count, invalid ? 0 : timeout )) == -1)
+    {
+        SetLastError( wsaErrno() );
+        release_poll_fds( &poll_fds );
+        return SOCKET_ERROR;
     }
-    release_poll_fds( ws_readfds, ws_writefds, ws_exceptfds, pollfds );
 
-    if (ret == -1) SetLastError(wsaErrno());
-    else ret = get_poll_results( ws_readfds, ws_writefds, ws_exceptfds, pollfds );
-    HeapFree( GetProcessHeap(), 0, pollfds );
-    return ret;
+    for (i = j = 0, total = 0; i < count; i++)
+    {
+        short revents = 0;
+
+        wfds[i].revents = 0;
+        if ((INT_PTR)wfds[i].fd < 0) continue;
+        if (poll_fds.fds[j].fd == -1) revents = WS_POLLNVAL;
+        else
+        {
+            if (poll_fds.fds[j].revents & POLLIN) revents |= wfds[i].events & WS_POLLIN;
+            if (poll_fds.fds[j].revents & POLLPRI) revents |= wfds[i].events & WS_POLLPRI;
+            if (poll_fds.fds[j].revents & POLLOUT)
+                revents |= wfds[i].events & (WS_POLLOUT | WS_POLLWRBAND);
+            if (poll_fds.fds[j].revents & POLLERR) revents |= WS_POLLERR;
+            if (poll_fds.fds[j].revents & POLLHUP) revents |= WS_POLLHUP;
+            if (poll_fds.fds[j].revents & POLLNVAL) revents |= WS_POLLNVAL;
+        }
+        j++;
+        if ((wfds[i].revents = revents)) total++;
+    }
+    release_poll_fds( &poll_fds );
+    return total;
 }
 
 /* helper to send completion messages for client-only i/o operation case */
@@ -3687,7 +4360,7 @@ int WINAPI WS_send(SOCKET s, const char *buf, int len, int flags)
     wsabuf.len = len;
     wsabuf.buf = (char*) buf;
 
-    if ( WS2_sendto( s, &wsabuf, 1, &n, flags, NULL, 0, NULL, NULL) == SOCKET_ERROR )
+    if ( WS2_sendto( s, &wsabuf, 1, &n, flags, NULL, 0, NULL, NULL, NULL) == SOCKET_ERROR )
         return SOCKET_ERROR;
     else
         return n;
@@ -3702,7 +4375,7 @@ INT WINAPI WSASend( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
                     LPWSAOVERLAPPED_COMPLETION_ROUTINE lpCompletionRoutine )
 {
     return WS2_sendto( s, lpBuffers, dwBufferCount, lpNumberOfBytesSent, dwFlags,
-                      NULL, 0, lpOverlapped, lpCompletionRoutine );
+                      NULL, 0, lpOverlapped, lpCompletionRoutine, NULL );
 }
 
 /***********************************************************************
@@ -3718,7 +4391,8 @@ static int WS2_sendto( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
                        LPDWORD lpNumberOfBytesSent, DWORD dwFlags,
                        const struct WS_sockaddr *to, int tolen,
                        LPWSAOVERLAPPED lpOverlapped,
-                       LPWSAOVERLAPPED_COMPLETION_ROUTINE lpCompletionRoutine )
+                       LPWSAOVERLAPPED_COMPLETION_ROUTINE lpCompletionRoutine,
+                       LPWSABUF lpControlBuffer )
 {
     unsigned int i, options;
     int n, fd, err;
@@ -3745,6 +4419,8 @@ static int WS2_sendto( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
     wsa->addr        = (struct WS_sockaddr *)to;
     wsa->addrlen.val = tolen;
     wsa->flags       = dwFlags;
+    wsa->control     = lpControlBuffer;
+    wsa->lpFlags     = NULL;
     wsa->n_iovecs    = dwBufferCount;
     wsa->first_iovec = 0;
     for ( i = 0; i < dwBufferCount; i++ )
@@ -3784,21 +4460,17 @@ static int WS2_sendto( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
 
         if (n == -1)
         {
+            async_data_t async;
+
             iosb->u.Status = STATUS_PENDING;
             iosb->Information = 0;
-
-            SERVER_START_REQ( register_async )
-            {
-                req->type           = ASYNC_TYPE_WRITE;
-                req->async.handle   = wine_server_obj_handle( wsa->hSocket );
-                req->async.callback = wine_server_client_ptr( WS2_async_send );
-                req->async.iosb     = wine_server_client_ptr( iosb );
-                req->async.arg      = wine_server_client_ptr( wsa );
-                req->async.event    = wine_server_obj_handle( lpCompletionRoutine ? 0 : lpOverlapped->hEvent );
-                req->async.cvalue   = cvalue;
-                err = wine_server_call( req );
-            }
-            SERVER_END_REQ;
+            async.handle   = wine_server_obj_handle( wsa->hSocket );
+            async.callback = wine_server_client_ptr( WS2_async_send );
+            async.iosb     = wine_server_client_ptr( iosb );
+            async.arg      = wine_server_client_ptr( wsa );
+            async.event    = wine_server_obj_handle( lpCompletionRoutine ? 0 : lpOverlapped->hEvent );
+            async.cvalue   = cvalue;
+            err = WS2_register_async( ASYNC_TYPE_WRITE, &async, !lpCompletionRoutine );
 
             if (err != STATUS_PENDING) HeapFree( GetProcessHeap(), 0, wsa );
             WSASetLastError( NtStatusToWSAError( err ));
@@ -3905,7 +4577,7 @@ INT WINAPI WSASendTo( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
     return WS2_sendto( s, lpBuffers, dwBufferCount,
                 lpNumberOfBytesSent, dwFlags,
                 to, tolen,
-                lpOverlapped, lpCompletionRoutine );
+                lpOverlapped, lpCompletionRoutine, NULL );
 }
 
 /***********************************************************************
@@ -3920,7 +4592,7 @@ int WINAPI WS_sendto(SOCKET s, const char *buf, int len, int flags,
     wsabuf.len = len;
     wsabuf.buf = (char*) buf;
 
-    if ( WS2_sendto(s, &wsabuf, 1, &n, flags, to, tolen, NULL, NULL) == SOCKET_ERROR )
+    if ( WS2_sendto(s, &wsabuf, 1, &n, flags, to, tolen, NULL, NULL, NULL) == SOCKET_ERROR )
         return SOCKET_ERROR;
     else
         return n;
@@ -4141,6 +4813,9 @@ int WINAPI WS_setsockopt(SOCKET s, int level, int optname,
         case WS_IP_MULTICAST_LOOP:
         case WS_IP_MULTICAST_TTL:
         case WS_IP_OPTIONS:
+#ifdef IP_PKTINFO
+        case WS_IP_PKTINFO:
+#endif
         case WS_IP_TOS:
         case WS_IP_TTL:
             convert_sockopt(&level, &optname);
@@ -5517,13 +6192,14 @@ int WINAPI WSARecv(SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
                    LPWSAOVERLAPPED_COMPLETION_ROUTINE lpCompletionRoutine)
 {
     return WS2_recvfrom(s, lpBuffers, dwBufferCount, NumberOfBytesReceived, lpFlags,
-                       NULL, NULL, lpOverlapped, lpCompletionRoutine);
+                       NULL, NULL, lpOverlapped, lpCompletionRoutine, NULL);
 }
 
 static int WS2_recvfrom( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
                          LPDWORD lpNumberOfBytesRecvd, LPDWORD lpFlags, struct WS_sockaddr *lpFrom,
                          LPINT lpFromlen, LPWSAOVERLAPPED lpOverlapped,
-                         LPWSAOVERLAPPED_COMPLETION_ROUTINE lpCompletionRoutine )
+                         LPWSAOVERLAPPED_COMPLETION_ROUTINE lpCompletionRoutine,
+                         LPWSABUF lpControlBuffer )
 
 {
     unsigned int i, options;
@@ -5552,6 +6228,8 @@ static int WS2_recvfrom( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
     wsa->flags       = *lpFlags;
     wsa->addr        = lpFrom;
     wsa->addrlen.ptr = lpFromlen;
+    wsa->control     = lpControlBuffer;
+    wsa->lpFlags     = lpFlags;
     wsa->n_iovecs    = dwBufferCount;
     wsa->first_iovec = 0;
     for (i = 0; i < dwBufferCount; i++)
@@ -5594,21 +6272,17 @@ static int WS2_recvfrom( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
 
             if (n == -1)
             {
+                async_data_t async;
+
                 iosb->u.Status = STATUS_PENDING;
                 iosb->Information = 0;
-
-                SERVER_START_REQ( register_async )
-                {
-                    req->type           = ASYNC_TYPE_READ;
-                    req->async.handle   = wine_server_obj_handle( wsa->hSocket );
-                    req->async.callback = wine_server_client_ptr( WS2_async_recv );
-                    req->async.iosb     = wine_server_client_ptr( iosb );
-                    req->async.arg      = wine_server_client_ptr( wsa );
-                    req->async.event    = wine_server_obj_handle( lpCompletionRoutine ? 0 : lpOverlapped->hEvent );
-                    req->async.cvalue   = cvalue;
-                    err = wine_server_call( req );
-                }
-                SERVER_END_REQ;
+                async.handle   = wine_server_obj_handle( wsa->hSocket );
+                async.callback = wine_server_client_ptr( WS2_async_recv );
+                async.iosb     = wine_server_client_ptr( iosb );
+                async.arg      = wine_server_client_ptr( wsa );
+                async.event    = wine_server_obj_handle( lpCompletionRoutine ? 0 : lpOverlapped->hEvent );
+                async.cvalue   = cvalue;
+                err = WS2_register_async( ASYNC_TYPE_READ, &async, !lpCompletionRoutine );
 
                 if (err != STATUS_PENDING) HeapFree( GetProcessHeap(), 0, wsa );
                 WSASetLastError( NtStatusToWSAError( err ));
@@ -5688,7 +6362,7 @@ INT WINAPI WSARecvFrom( SOCKET s, LPWSABUF lpBuffers, DWORD dwBufferCount,
     return WS2_recvfrom( s, lpBuffers, dwBufferCount,
                 lpNumberOfBytesRecvd, lpFlags,
                 lpFrom, lpFromlen,
-                lpOverlapped, lpCompletionRoutine );
+                lpOverlapped, lpCompletionRoutine, NULL );
 }
 
 /***********************************************************************
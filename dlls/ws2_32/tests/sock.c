@@ -56,6 +56,7 @@
 static void   (WINAPI  *pFreeAddrInfoW)(PADDRINFOW) = 0;
 static int    (WINAPI  *pGetAddrInfoW)(LPCWSTR,LPCWSTR,const ADDRINFOW *,PADDRINFOW *) = 0;
 static PCSTR  (WINAPI  *pInetNtop)(INT,LPVOID,LPSTR,ULONG) = 0;
+static int    (WINAPI  *pWSAPoll)(WSAPOLLFD *,ULONG,INT) = 0;
 
 /**************** Structs and typedefs ***************/
 
@@ -875,6 +876,7 @@ static void Init (void)
     pFreeAddrInfoW = (void *)GetProcAddress(hws2_32, "FreeAddrInfoW");
     pGetAddrInfoW = (void *)GetProcAddress(hws2_32, "GetAddrInfoW");
     pInetNtop = (void *)GetProcAddress(hws2_32, "inet_ntop");
+    pWSAPoll = (void *)GetProcAddress(hws2_32, "WSAPoll");
 
     ok ( WSAStartup ( ver, &data ) == 0, "WSAStartup failed\n" );
     tls = TlsAlloc();
@@ -2023,6 +2025,172 @@ static void test_select(void)
     ok ( !FD_ISSET(fdRead, &exceptfds), "FD should not be set\n");
 }
 
+static void test_WSAPoll(void)
+{
+    struct sockaddr_in addr;
+    WSAPOLLFD fds[4];
+    SOCKET src, dst, closed;
+    int len, ret;
+    char buf[16];
+
+    if (!pWSAPoll)
+    {
+        win_skip("WSAPoll is not available\n");
+        return;
+    }
+
+    SetLastError(0xdeadbeef);
+    ret = pWSAPoll(fds, 0, 0);
+    ok(ret == SOCKET_ERROR, "WSAPoll returned %d\n", ret);
+    ok(WSAGetLastError() == WSAEINVAL, "got error %d\n", WSAGetLastError());
+
+    src = socket(AF_INET, SOCK_DGRAM, 0);
+    ok(src != INVALID_SOCKET, "socket failed, error %d\n", WSAGetLastError());
+    dst = socket(AF_INET, SOCK_DGRAM, 0);
+    ok(dst != INVALID_SOCKET, "socket failed, error %d\n", WSAGetLastError());
+    closed = socket(AF_INET, SOCK_DGRAM, 0);
+    ok(closed != INVALID_SOCKET, "socket failed, error %d\n", WSAGetLastError());
+    closesocket(closed);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    ret = bind(dst, (struct sockaddr *)&addr, sizeof(addr));
+    ok(!ret, "bind failed, error %d\n", WSAGetLastError());
+    len = sizeof(addr);
+    ret = getsockname(dst, (struct sockaddr *)&addr, &len);
+    ok(!ret, "getsockname failed, error %d\n", WSAGetLastError());
+
+    fds[0].fd = dst;
+    fds[0].events = POLLRDNORM;
+    fds[0].revents = 0xdead;
+    fds[1].fd = src;
+    fds[1].events = POLLWRNORM;
+    fds[1].revents = 0xdead;
+    ret = pWSAPoll(fds, 2, 0);
+    ok(ret == 1, "WSAPoll returned %d\n", ret);
+    ok(!fds[0].revents, "got revents %x\n", fds[0].revents);
+    ok(fds[1].revents == POLLWRNORM, "got revents %x\n", fds[1].revents);
+
+    ret = sendto(src, "hello", 5, 0, (struct sockaddr *)&addr, sizeof(addr));
+    ok(ret == 5, "sendto returned %d, error %d\n", ret, WSAGetLastError());
+    fds[1].events = POLLRDNORM;
+    ret = pWSAPoll(fds, 2, 1000);
+    ok(ret == 1, "WSAPoll returned %d\n", ret);
+    ok(fds[0].revents == POLLRDNORM, "got revents %x\n", fds[0].revents);
+    ok(!fds[1].revents, "got revents %x\n", fds[1].revents);
+    ret = recv(dst, buf, sizeof(buf), 0);
+    ok(ret == 5, "recv returned %d, error %d\n", ret, WSAGetLastError());
+
+    /* closed sockets are flagged, negative ones are ignored */
+    fds[0].fd = closed;
+    fds[0].events = POLLRDNORM;
+    fds[1].fd = INVALID_SOCKET;
+    fds[1].events = POLLRDNORM;
+    fds[1].revents = 0xdead;
+    ret = pWSAPoll(fds, 2, 1000);
+    ok(ret == 1, "WSAPoll returned %d\n", ret);
+    ok(fds[0].revents == POLLNVAL, "got revents %x\n", fds[0].revents);
+    ok(!fds[1].revents, "got revents %x\n", fds[1].revents);
+
+    closesocket(src);
+    closesocket(dst);
+}
+
+/* WSAPoll and select over a large number of idle sockets with only a few active ones */
+static void test_poll_many_sockets(void)
+{
+    static const int active[] = { 0, 17, 4999, 9999 };
+    struct sockaddr_in addr;
+    struct { u_int fd_count; SOCKET fd_array[10000]; } *set;
+    WSAPOLLFD *fds;
+    SOCKET *socks, src;
+    int i, j, count, len, ret;
+    DWORD start, ticks;
+    char buf[16];
+
+    socks = HeapAlloc(GetProcessHeap(), 0, 10000 * sizeof(*socks));
+    fds = HeapAlloc(GetProcessHeap(), 0, 10000 * sizeof(*fds));
+    set = HeapAlloc(GetProcessHeap(), 0, sizeof(*set));
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    for (count = 0; count < 10000; count++)
+    {
+        if ((socks[count] = socket(AF_INET, SOCK_DGRAM, 0)) == INVALID_SOCKET) break;
+        if (bind(socks[count], (struct sockaddr *)&addr, sizeof(addr)))
+        {
+            closesocket(socks[count]);
+            break;
+        }
+    }
+    if (count < 10000)
+    {
+        skip("could only create %d sockets\n", count);
+        goto done;
+    }
+
+    src = socket(AF_INET, SOCK_DGRAM, 0);
+    ok(src != INVALID_SOCKET, "socket failed, error %d\n", WSAGetLastError());
+    for (i = 0; i < sizeof(active) / sizeof(active[0]); i++)
+    {
+        struct sockaddr_in dst;
+
+        len = sizeof(dst);
+        getsockname(socks[active[i]], (struct sockaddr *)&dst, &len);
+        ret = sendto(src, "x", 1, 0, (struct sockaddr *)&dst, sizeof(dst));
+        ok(ret == 1, "sendto returned %d, error %d\n", ret, WSAGetLastError());
+    }
+    closesocket(src);
+    Sleep(100);
+
+    if (pWSAPoll)
+    {
+        for (i = 0; i < count; i++)
+        {
+            fds[i].fd = socks[i];
+            fds[i].events = POLLRDNORM;
+        }
+        start = GetTickCount();
+        for (i = 0; i < 100; i++)
+        {
+            ret = pWSAPoll(fds, count, 0);
+            if (ret != sizeof(active) / sizeof(active[0])) break;
+        }
+        ticks = GetTickCount() - start;
+        ok(i == 100, "WSAPoll returned %d\n", ret);
+        for (i = j = 0; i < count && j < sizeof(active) / sizeof(active[0]); i++)
+            if (fds[i].revents) ok(i == active[j++], "socket %d is readable\n", i);
+        trace("100 WSAPoll calls over %d sockets took %u ms\n", count, ticks);
+    }
+
+    start = GetTickCount();
+    for (i = 0; i < 100; i++)
+    {
+        struct timeval timeout = { 0, 0 };
+
+        set->fd_count = count;
+        memcpy(set->fd_array, socks, count * sizeof(*socks));
+        ret = select(0, (fd_set *)set, NULL, NULL, &timeout);
+        if (ret != sizeof(active) / sizeof(active[0])) break;
+    }
+    ticks = GetTickCount() - start;
+    ok(i == 100, "select returned %d\n", ret);
+    for (i = 0; i < set->fd_count && i < sizeof(active) / sizeof(active[0]); i++)
+        ok(set->fd_array[i] == socks[active[i]], "got socket %x\n", (DWORD)set->fd_array[i]);
+    trace("100 select calls over %d sockets took %u ms\n", count, ticks);
+
+    for (i = 0; i < sizeof(active) / sizeof(active[0]); i++)
+        recv(socks[active[i]], buf, sizeof(buf), 0);
+
+done:
+    for (i = 0; i < count; i++) closesocket(socks[i]);
+    HeapFree(GetProcessHeap(), 0, set);
+    HeapFree(GetProcessHeap(), 0, fds);
+    HeapFree(GetProcessHeap(), 0, socks);
+}
+
 static DWORD WINAPI AcceptKillThread(select_thread_params *par)
 {
     struct sockaddr_in address;
@@ -2641,6 +2809,159 @@ end:
     HeapFree(GetProcessHeap(), 0, buffer);
 }
 
+struct transmit_reader
+{
+    SOCKET sock;
+    char  *buffer;
+    int    size;
+    int    received;
+};
+
+static DWORD WINAPI transmit_reader_thread(LPVOID arg)
+{
+    struct transmit_reader *reader = arg;
+    int ret;
+
+    while (reader->received < reader->size)
+    {
+        ret = recv(reader->sock, reader->buffer + reader->received, reader->size - reader->received, 0);
+        if (ret <= 0) break;
+        reader->received += ret;
+    }
+    return 0;
+}
+
+static void check_transmitted_data(struct transmit_reader *reader, HANDLE thread, const char *file_data,
+                                   int file_len, const char *head, const char *tail)
+{
+    int head_len = strlen(head), tail_len = strlen(tail);
+
+    ok(WaitForSingleObject(thread, 10000) == WAIT_OBJECT_0, "reader thread did not finish\n");
+    ok(reader->received == head_len + file_len + tail_len, "received %d bytes, expected %d\n",
+       reader->received, head_len + file_len + tail_len);
+    if (reader->received != head_len + file_len + tail_len) return;
+    ok(!memcmp(reader->buffer, head, head_len), "wrong head data\n");
+    ok(!memcmp(reader->buffer + head_len, file_data, file_len), "wrong file data\n");
+    ok(!memcmp(reader->buffer + head_len + file_len, tail, tail_len), "wrong tail data\n");
+}
+
+static void test_TransmitFile(void)
+{
+    GUID transmitfile_guid = WSAID_TRANSMITFILE;
+    GUID transmitpackets_guid = WSAID_TRANSMITPACKETS;
+    LPFN_TRANSMITFILE pTransmitFile = NULL;
+    LPFN_TRANSMITPACKETS pTransmitPackets = NULL;
+    const int file_len = 4 * 1024 * 1024;
+    char head[] = "head data", tail[] = "tail data";
+    char temp_path[MAX_PATH], file_name[MAX_PATH];
+    TRANSMIT_FILE_BUFFERS buffers;
+    TRANSMIT_PACKETS_ELEMENT packets[3];
+    struct transmit_reader reader;
+    SOCKET src, dst;
+    OVERLAPPED ov;
+    HANDLE file, thread;
+    char *file_data;
+    DWORD bytes, id, start, ticks;
+    BOOL bret;
+    int i, iret;
+
+    if (tcp_socketpair(&src, &dst) != 0)
+    {
+        ok(0, "creating socket pair failed, skipping test\n");
+        return;
+    }
+
+    iret = WSAIoctl(src, SIO_GET_EXTENSION_FUNCTION_POINTER, &transmitfile_guid, sizeof(transmitfile_guid),
+                    &pTransmitFile, sizeof(pTransmitFile), &bytes, NULL, NULL);
+    if (iret)
+    {
+        skip("TransmitFile not supported\n");
+        closesocket(src);
+        closesocket(dst);
+        return;
+    }
+    iret = WSAIoctl(src, SIO_GET_EXTENSION_FUNCTION_POINTER, &transmitpackets_guid, sizeof(transmitpackets_guid),
+                    &pTransmitPackets, sizeof(pTransmitPackets), &bytes, NULL, NULL);
+    if (iret) win_skip("TransmitPackets not supported\n");
+
+    file_data = HeapAlloc(GetProcessHeap(), 0, file_len);
+    reader.buffer = HeapAlloc(GetProcessHeap(), 0, file_len + sizeof(head) + sizeof(tail));
+    for (i = 0; i < file_len; i++) file_data[i] = (char)(i * 7 + i / 251);
+
+    GetTempPathA(MAX_PATH, temp_path);
+    GetTempFileNameA(temp_path, "wst", 0, file_name);
+    file = CreateFileA(file_name, GENERIC_READ | GENERIC_WRITE, 0, NULL, CREATE_ALWAYS,
+                       FILE_FLAG_DELETE_ON_CLOSE, NULL);
+    ok(file != INVALID_HANDLE_VALUE, "CreateFile failed, error %d\n", GetLastError());
+    bret = WriteFile(file, file_data, file_len, &bytes, NULL);
+    ok(bret && bytes == file_len, "WriteFile failed, error %d\n", GetLastError());
+
+    buffers.Head = head;
+    buffers.HeadLength = strlen(head);
+    buffers.Tail = tail;
+    buffers.TailLength = strlen(tail);
+
+    /* synchronous, from the current file position */
+    SetFilePointer(file, 0, NULL, FILE_BEGIN);
+    reader.sock = dst;
+    reader.size = strlen(head) + file_len + strlen(tail);
+    reader.received = 0;
+    thread = CreateThread(NULL, 0, transmit_reader_thread, &reader, 0, &id);
+    start = GetTickCount();
+    bret = pTransmitFile(src, file, 0, 0, NULL, &buffers, 0);
+    ok(bret, "TransmitFile failed, error %d\n", WSAGetLastError());
+    check_transmitted_data(&reader, thread, file_data, file_len, head, tail);
+    ticks = GetTickCount() - start;
+    trace("TransmitFile sent %d bytes in %u ms (%u MB/s)\n", file_len, ticks,
+          ticks ? file_len / 1024 / ticks * 1000 / 1024 : 0);
+    CloseHandle(thread);
+
+    /* overlapped, with an explicit offset and length */
+    memset(&ov, 0, sizeof(ov));
+    ov.Offset = 1000;
+    ov.hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+    reader.size = 65536;
+    reader.received = 0;
+    thread = CreateThread(NULL, 0, transmit_reader_thread, &reader, 0, &id);
+    bret = pTransmitFile(src, file, 65536, 0, &ov, NULL, 0);
+    ok(bret || WSAGetLastError() == ERROR_IO_PENDING, "TransmitFile failed, error %d\n", WSAGetLastError());
+    bret = GetOverlappedResult((HANDLE)src, &ov, &bytes, TRUE);
+    ok(bret, "GetOverlappedResult failed, error %d\n", GetLastError());
+    ok(bytes == 65536, "sent %u bytes, expected 65536\n", bytes);
+    check_transmitted_data(&reader, thread, file_data + 1000, 65536, "", "");
+    CloseHandle(thread);
+    CloseHandle(ov.hEvent);
+
+    if (pTransmitPackets)
+    {
+        memset(packets, 0, sizeof(packets));
+        packets[0].dwElFlags = TP_ELEMENT_MEMORY;
+        packets[0].cLength = strlen(head);
+        packets[0].pBuffer = head;
+        packets[1].dwElFlags = TP_ELEMENT_FILE;
+        packets[1].cLength = 0;
+        packets[1].nFileOffset.QuadPart = 0;
+        packets[1].hFile = file;
+        packets[2].dwElFlags = TP_ELEMENT_MEMORY | TP_ELEMENT_EOP;
+        packets[2].cLength = strlen(tail);
+        packets[2].pBuffer = tail;
+
+        reader.size = strlen(head) + file_len + strlen(tail);
+        reader.received = 0;
+        thread = CreateThread(NULL, 0, transmit_reader_thread, &reader, 0, &id);
+        bret = pTransmitPackets(src, packets, 3, 0, NULL, 0);
+        ok(bret, "TransmitPackets failed, error %d\n", WSAGetLastError());
+        check_transmitted_data(&reader, thread, file_data, file_len, head, tail);
+        CloseHandle(thread);
+    }
+
+    CloseHandle(file);
+    closesocket(src);
+    closesocket(dst);
+    HeapFree(GetProcessHeap(), 0, reader.buffer);
+    HeapFree(GetProcessHeap(), 0, file_data);
+}
+
 typedef struct async_message
 {
     SOCKET socket;
@@ -3546,6 +3867,222 @@ end:
         WSACloseEvent(ov.hEvent);
 }
 
+static void test_completion_port(void)
+{
+    SOCKET src, dst;
+    HANDLE port;
+    WSAOVERLAPPED ov, *povl;
+    WSABUF wsabuf;
+    char buf[64];
+    DWORD bytes, flags, start, ticks;
+    ULONG_PTR key;
+    BOOL bret;
+    int i, iret;
+
+    if (tcp_socketpair(&src, &dst) != 0)
+    {
+        ok(0, "creating socket pair failed, skipping test\n");
+        return;
+    }
+
+    port = CreateIoCompletionPort((HANDLE)dst, NULL, 125, 0);
+    ok(port != NULL, "CreateIoCompletionPort failed, error %d\n", GetLastError());
+
+    wsabuf.buf = buf;
+    wsabuf.len = sizeof(buf);
+
+    /* pending receive completed through the port */
+    memset(&ov, 0, sizeof(ov));
+    flags = 0;
+    iret = WSARecv(dst, &wsabuf, 1, &bytes, &flags, &ov, NULL);
+    ok(iret == SOCKET_ERROR && GetLastError() == ERROR_IO_PENDING, "WSARecv returned %d, error %d\n",
+       iret, GetLastError());
+
+    bret = GetQueuedCompletionStatus(port, &bytes, &key, &povl, 100);
+    ok(!bret && GetLastError() == WAIT_TIMEOUT, "got unexpected completion, error %d\n", GetLastError());
+
+    iret = send(src, "hello", 5, 0);
+    ok(iret == 5, "send returned %d\n", iret);
+
+    bytes = 0xdeadbeef;
+    key = 0xdeadbeef;
+    povl = NULL;
+    bret = GetQueuedCompletionStatus(port, &bytes, &key, &povl, 1000);
+    ok(bret, "GetQueuedCompletionStatus failed, error %d\n", GetLastError());
+    ok(bytes == 5, "got %u bytes\n", bytes);
+    ok(key == 125, "got key %x\n", (DWORD)key);
+    ok(povl == &ov, "got overlapped %p\n", povl);
+    ok(!memcmp(buf, "hello", 5), "got wrong data\n");
+
+    /* ping-pong through the port to measure the latency of a pending receive */
+    start = GetTickCount();
+    for (i = 0; i < 1000; i++)
+    {
+        memset(&ov, 0, sizeof(ov));
+        flags = 0;
+        iret = WSARecv(dst, &wsabuf, 1, &bytes, &flags, &ov, NULL);
+        if (iret && GetLastError() != ERROR_IO_PENDING) break;
+        send(src, "x", 1, 0);
+        if (!GetQueuedCompletionStatus(port, &bytes, &key, &povl, 1000)) break;
+    }
+    ticks = GetTickCount() - start;
+    ok(i == 1000, "round trip %d failed, error %d\n", i, GetLastError());
+    trace("1000 pending receives completed in %u ms\n", ticks);
+
+    /* cancelled receive */
+    memset(&ov, 0, sizeof(ov));
+    flags = 0;
+    iret = WSARecv(dst, &wsabuf, 1, &bytes, &flags, &ov, NULL);
+    ok(iret == SOCKET_ERROR && GetLastError() == ERROR_IO_PENDING, "WSARecv returned %d, error %d\n",
+       iret, GetLastError());
+    bret = CancelIo((HANDLE)dst);
+    ok(bret, "CancelIo failed, error %d\n", GetLastError());
+    povl = NULL;
+    bret = GetQueuedCompletionStatus(port, &bytes, &key, &povl, 1000);
+    ok(!bret && GetLastError() == ERROR_OPERATION_ABORTED, "got %d, error %d\n", bret, GetLastError());
+    ok(povl == &ov, "got overlapped %p\n", povl);
+
+    /* receive aborted by closing the socket */
+    memset(&ov, 0, sizeof(ov));
+    flags = 0;
+    iret = WSARecv(dst, &wsabuf, 1, &bytes, &flags, &ov, NULL);
+    ok(iret == SOCKET_ERROR && GetLastError() == ERROR_IO_PENDING, "WSARecv returned %d, error %d\n",
+       iret, GetLastError());
+    closesocket(dst);
+    povl = NULL;
+    bret = GetQueuedCompletionStatus(port, &bytes, &key, &povl, 1000);
+    ok(!bret, "GetQueuedCompletionStatus succeeded\n");
+    ok(povl == &ov, "got overlapped %p\n", povl);
+
+    closesocket(src);
+    CloseHandle(port);
+}
+
+static void test_WSARecvMsg(void)
+{
+    GUID wsarecvmsg_guid = WSAID_WSARECVMSG;
+    GUID wsasendmsg_guid = WSAID_WSASENDMSG;
+    LPFN_WSARECVMSG pWSARecvMsg = NULL;
+    LPFN_WSASENDMSG pWSASendMsg = NULL;
+    struct sockaddr_in addr, from;
+    char buf[32], control[64], bufs[4][32];
+    WSAOVERLAPPED ov[4];
+    WSABUF wsabuf, wsabufs[4];
+    WSAMSG msg, msgs[4];
+    WSACMSGHDR *cmsg;
+    SOCKET src, dst;
+    DWORD bytes, on = 1;
+    int i, iret, addrlen;
+    BOOL bret;
+
+    src = socket(AF_INET, SOCK_DGRAM, 0);
+    dst = socket(AF_INET, SOCK_DGRAM, 0);
+    ok(src != INVALID_SOCKET && dst != INVALID_SOCKET, "socket failed, error %d\n", WSAGetLastError());
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = inet_addr("127.0.0.1");
+    iret = bind(dst, (struct sockaddr *)&addr, sizeof(addr));
+    ok(!iret, "bind failed, error %d\n", WSAGetLastError());
+    addrlen = sizeof(addr);
+    iret = getsockname(dst, (struct sockaddr *)&addr, &addrlen);
+    ok(!iret, "getsockname failed, error %d\n", WSAGetLastError());
+
+    iret = WSAIoctl(dst, SIO_GET_EXTENSION_FUNCTION_POINTER, &wsarecvmsg_guid, sizeof(wsarecvmsg_guid),
+                    &pWSARecvMsg, sizeof(pWSARecvMsg), &bytes, NULL, NULL);
+    if (iret)
+    {
+        win_skip("WSARecvMsg not supported\n");
+        goto end;
+    }
+    iret = WSAIoctl(src, SIO_GET_EXTENSION_FUNCTION_POINTER, &wsasendmsg_guid, sizeof(wsasendmsg_guid),
+                    &pWSASendMsg, sizeof(pWSASendMsg), &bytes, NULL, NULL);
+    if (iret) win_skip("WSASendMsg not supported\n");
+
+    iret = setsockopt(dst, IPPROTO_IP, IP_PKTINFO, (const char *)&on, sizeof(on));
+    ok(!iret, "setsockopt(IP_PKTINFO) failed, error %d\n", WSAGetLastError());
+
+    strcpy(buf, "hello");
+    iret = sendto(src, buf, 6, 0, (struct sockaddr *)&addr, sizeof(addr));
+    ok(iret == 6, "sendto returned %d, error %d\n", iret, WSAGetLastError());
+
+    memset(buf, 0, sizeof(buf));
+    wsabuf.buf = buf;
+    wsabuf.len = sizeof(buf);
+    memset(&msg, 0, sizeof(msg));
+    msg.name = (struct sockaddr *)&from;
+    msg.namelen = sizeof(from);
+    msg.lpBuffers = &wsabuf;
+    msg.dwBufferCount = 1;
+    msg.Control.buf = control;
+    msg.Control.len = sizeof(control);
+    iret = pWSARecvMsg(dst, &msg, &bytes, NULL, NULL);
+    ok(!iret, "WSARecvMsg failed, error %d\n", WSAGetLastError());
+    ok(bytes == 6, "received %u bytes\n", bytes);
+    ok(!strcmp(buf, "hello"), "received %s\n", buf);
+    ok(from.sin_addr.s_addr == inet_addr("127.0.0.1"), "wrong source address\n");
+    ok(!(msg.dwFlags & (MSG_TRUNC | MSG_CTRUNC)), "got flags %x\n", msg.dwFlags);
+
+    cmsg = WSA_CMSG_FIRSTHDR(&msg);
+    ok(cmsg != NULL, "no control message returned\n");
+    if (cmsg)
+    {
+        IN_PKTINFO *pktinfo = (IN_PKTINFO *)WSA_CMSG_DATA(cmsg);
+
+        ok(cmsg->cmsg_level == IPPROTO_IP, "got level %d\n", cmsg->cmsg_level);
+        ok(cmsg->cmsg_type == IP_PKTINFO, "got type %d\n", cmsg->cmsg_type);
+        ok(pktinfo->ipi_addr.s_addr == inet_addr("127.0.0.1"), "wrong destination address\n");
+    }
+
+    /* several overlapped receives pending on the same socket */
+    for (i = 0; i < 4; i++)
+    {
+        memset(&ov[i], 0, sizeof(ov[i]));
+        ov[i].hEvent = CreateEventA(NULL, TRUE, FALSE, NULL);
+        wsabufs[i].buf = bufs[i];
+        wsabufs[i].len = sizeof(bufs[i]);
+        memset(&msgs[i], 0, sizeof(msgs[i]));
+        msgs[i].lpBuffers = &wsabufs[i];
+        msgs[i].dwBufferCount = 1;
+        iret = pWSARecvMsg(dst, &msgs[i], &bytes, &ov[i], NULL);
+        ok(iret == SOCKET_ERROR && WSAGetLastError() == ERROR_IO_PENDING,
+           "WSARecvMsg returned %d, error %d\n", iret, WSAGetLastError());
+    }
+
+    for (i = 0; i < 4; i++)
+    {
+        sprintf(buf, "datagram %d", i);
+        wsabuf.buf = buf;
+        wsabuf.len = strlen(buf) + 1;
+        if (pWSASendMsg)
+        {
+            memset(&msg, 0, sizeof(msg));
+            msg.name = (struct sockaddr *)&addr;
+            msg.namelen = sizeof(addr);
+            msg.lpBuffers = &wsabuf;
+            msg.dwBufferCount = 1;
+            iret = pWSASendMsg(src, &msg, 0, &bytes, NULL, NULL);
+            ok(!iret, "WSASendMsg failed, error %d\n", WSAGetLastError());
+            ok(bytes == wsabuf.len, "sent %u bytes\n", bytes);
+        }
+        else sendto(src, buf, wsabuf.len, 0, (struct sockaddr *)&addr, sizeof(addr));
+    }
+
+    for (i = 0; i < 4; i++)
+    {
+        ok(WaitForSingleObject(ov[i].hEvent, 1000) == WAIT_OBJECT_0, "receive %d not completed\n", i);
+        bret = GetOverlappedResult((HANDLE)dst, &ov[i], &bytes, FALSE);
+        ok(bret, "GetOverlappedResult failed, error %d\n", GetLastError());
+        ok(bytes == strlen("datagram 0") + 1, "receive %d got %u bytes\n", i, bytes);
+        ok(!strncmp(bufs[i], "datagram ", 9), "receive %d got %s\n", i, bufs[i]);
+        CloseHandle(ov[i].hEvent);
+    }
+
+end:
+    closesocket(src);
+    closesocket(dst);
+}
+
 static void test_GetAddrInfoW(void)
 {
     static const WCHAR port[] = {'8','0',0};
@@ -4428,6 +4965,8 @@ START_TEST( sock )
     test_WSAStringToAddressW();
 
     test_select();
+    test_WSAPoll();
+    test_poll_many_sockets();
     test_accept();
     test_getpeername();
     test_getsockname();
@@ -4439,6 +4978,8 @@ START_TEST( sock )
 
     test_WSASendTo();
     test_WSARecv();
+    test_WSARecvMsg();
+    test_completion_port();
 
     test_events(0);
     test_events(1);
@@ -4452,6 +4993,7 @@ START_TEST( sock )
     test_sioRoutingInterfaceQuery();
 
     /* this is a io heavy test, do it at the end so the kernel doesn't start dropping packets */
+    test_TransmitFile();
     test_send();
 
     Exit();
@@ -88,6 +88,7 @@
 @ stdcall WSANSPIoctl(ptr long ptr long ptr long ptr ptr)
 @ stdcall WSANtohl(long long ptr)
 @ stdcall WSANtohs(long long ptr)
+@ stdcall WSAPoll(ptr long long)
 @ stdcall WSAProviderConfigChange(ptr ptr ptr)
 @ stdcall WSARecv(long ptr long ptr ptr ptr ptr)
 @ stdcall WSARecvDisconnect(long ptr)
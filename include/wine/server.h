@@ -50,10 +50,15 @@ struct __server_request_info
 };
 
 extern unsigned int wine_server_call( void *req_ptr );
+extern unsigned int wine_server_call_batch( void *req_ptrs[], unsigned int count );
 extern void CDECL wine_server_send_fd( int fd );
 extern int CDECL wine_server_fd_to_handle( int fd, unsigned int access, unsigned int attributes, HANDLE *handle );
 extern int CDECL wine_server_handle_to_fd( HANDLE handle, unsigned int access, int *unix_fd, unsigned int *options );
 extern void CDECL wine_server_release_fd( HANDLE handle, int unix_fd );
+extern NTSTATUS CDECL __wine_server_get_unix_fds( unsigned int count, const HANDLE *handles,
+                                                  const unsigned int *access, int *unix_fds,
+                                                  int *needs_close );
+extern NTSTATUS CDECL __wine_queue_reactor_async( int type, const async_data_t *async );
 
 /* do a server call and set the last error code */
 static inline unsigned int wine_server_call_err( void *req_ptr )
@@ -138,5 +143,13 @@ static inline void *wine_server_get_ptr( client_ptr_t ptr )
         while(0); \
     } while(0)
 
+/* set up a request to be passed to wine_server_call_batch, returns the request structure */
+#define SERVER_INIT_REQ(info,type) \
+    (memset( &(info).u.req, 0, sizeof((info).u.req) ), \
+     (info).u.req.request_header.req = REQ_##type, \
+     (info).data_count = 0, \
+     (info).reply_data = NULL, \
+     &(info).u.req.type##_request)
+
 
 #endif  /* __WINE_WINE_SERVER_H */
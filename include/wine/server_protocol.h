@@ -50,6 +50,67 @@ struct request_max_size
     int pad[16];
 };
 
+
+
+struct request_shm
+{
+    int          seq;
+    int          waiting;
+    int          __pad[2];
+};
+#define REQUEST_SHM_SIZE  0x10000
+
+#define REQUEST_SHM_MAX_REPLY_SIZE (REQUEST_SHM_SIZE - sizeof(struct request_shm) - sizeof(union generic_reply))
+
+
+#define REQUEST_STATS_BUCKETS 24
+struct request_stats
+{
+    unsigned __int64 total_time;
+    unsigned __int64 reply_bytes;
+    unsigned int     count;
+    unsigned int     max_time;
+    unsigned int     histogram[REQUEST_STATS_BUCKETS];
+    char             name[32];
+};
+
+
+struct filesystem_event
+{
+    int              action;
+    data_size_t      len;
+    char             name[1];
+};
+
+
+
+struct sync_shm_entry
+{
+    __int64      state;
+    unsigned int type;
+    unsigned int max;
+    unsigned int serial;
+    unsigned int __pad[3];
+};
+
+struct sync_shm_header
+{
+    unsigned int close_count;
+    unsigned int __pad[7];
+};
+enum sync_shm_type
+{
+    SYNC_SHM_FREE,
+    SYNC_SHM_AUTO_EVENT,
+    SYNC_SHM_MANUAL_EVENT,
+    SYNC_SHM_SEMAPHORE
+};
+#define SYNC_SHM_SIZE     0x20000
+#define SYNC_SHM_ENTRIES  (SYNC_SHM_SIZE / sizeof(struct sync_shm_entry))
+#define SYNC_SHM_COUNT(state)    ((unsigned int)(state))
+#define SYNC_SHM_WAITERS(state)  ((unsigned int)((unsigned __int64)(state) >> 32))
+#define SYNC_SHM_STATE(count,waiters) (((__int64)(waiters) << 32) | (unsigned int)(count))
+
 #define FIRST_USER_HANDLE 0x0020
 #define LAST_USER_HANDLE  0xffef
 
@@ -265,6 +326,23 @@ typedef struct
 } rectangle_t;
 
 
+
+struct window_shm
+{
+    unsigned int   seq;
+    user_handle_t  handle;
+    user_handle_t  parent;
+    user_handle_t  owner;
+    unsigned int   style;
+    unsigned int   ex_style;
+    rectangle_t    window;
+    rectangle_t    client;
+};
+
+#define DESKTOP_SHM_WINDOWS  ((LAST_USER_HANDLE - FIRST_USER_HANDLE + 1) >> 1)
+#define DESKTOP_SHM_SIZE     (DESKTOP_SHM_WINDOWS * sizeof(struct window_shm))
+
+
 typedef struct
 {
     obj_handle_t    handle;
@@ -310,6 +388,40 @@ typedef union
 } message_data_t;
 
 
+struct ring_message
+{
+    user_handle_t   win;
+    unsigned int    msg;
+    lparam_t        wparam;
+    lparam_t        lparam;
+    unsigned int    time;
+    unsigned int    removed;
+    int             x;
+    int             y;
+};
+
+#define QUEUE_RING_MESSAGES 1024
+
+
+
+struct queue_ring
+{
+    unsigned int        head;
+    unsigned int        tail;
+    unsigned int        count;
+    unsigned int        posted;
+    unsigned int        seen;
+    unsigned int        wake_bits;
+    unsigned int        server_posted;
+    unsigned int        get_posted;
+    unsigned int        get_seen;
+    unsigned int        last_get;
+    int                 cursor_x;
+    int                 cursor_y;
+    struct ring_message msgs[QUEUE_RING_MESSAGES];
+};
+
+
 typedef struct
 {
     WCHAR          ch;
@@ -683,6 +795,73 @@ struct init_thread_reply
 
 
 
+
+struct create_request_shm_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct create_request_shm_reply
+{
+    struct reply_header __header;
+    data_size_t  size;
+    char __pad_12[4];
+};
+
+
+
+
+struct get_sync_shm_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_sync_shm_reply
+{
+    struct reply_header __header;
+    data_size_t  size;
+    char __pad_12[4];
+};
+
+
+
+
+struct get_server_stats_request
+{
+    struct request_header __header;
+    process_id_t   pid;
+};
+struct get_server_stats_reply
+{
+    struct reply_header __header;
+    unsigned int   total;
+    /* VARARG(stats,request_stats); */
+    char __pad_12[4];
+};
+
+
+
+
+
+
+
+struct call_batch_request
+{
+    struct request_header __header;
+    /* VARARG(requests,bytes); */
+    char __pad_12[4];
+};
+struct call_batch_reply
+{
+    struct reply_header __header;
+    unsigned int   count;
+    /* VARARG(replies,bytes); */
+    char __pad_12[4];
+};
+#define BATCH_DATA_ALIGN(size) (((size) + 7) & ~7)
+
+
+
 struct terminate_process_request
 {
     struct request_header __header;
@@ -1027,7 +1206,9 @@ struct create_event_reply
 {
     struct reply_header __header;
     obj_handle_t handle;
-    char __pad_12[4];
+    unsigned int shm_index;
+    unsigned int shm_serial;
+    char __pad_20[4];
 };
 
 
@@ -1125,7 +1306,9 @@ struct create_semaphore_reply
 {
     struct reply_header __header;
     obj_handle_t handle;
-    char __pad_12[4];
+    unsigned int shm_index;
+    unsigned int shm_serial;
+    char __pad_20[4];
 };
 
 
@@ -1871,6 +2054,7 @@ struct read_directory_changes_reply
 };
 
 
+
 struct read_change_request
 {
     struct request_header __header;
@@ -1879,9 +2063,7 @@ struct read_change_request
 struct read_change_reply
 {
     struct reply_header __header;
-    int          action;
-    /* VARARG(name,string); */
-    char __pad_12[4];
+    /* VARARG(events,filesystem_events); */
 };
 
 
@@ -2652,6 +2834,20 @@ struct get_msg_queue_reply
 
 
 
+struct get_queue_ring_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_queue_ring_reply
+{
+    struct reply_header __header;
+    obj_handle_t handle;
+    char __pad_12[4];
+};
+
+
+
 struct set_queue_fd_request
 {
     struct request_header __header;
@@ -3090,6 +3286,20 @@ struct get_desktop_window_reply
 
 
 
+struct get_desktop_shm_request
+{
+    struct request_header __header;
+    char __pad_12[4];
+};
+struct get_desktop_shm_reply
+{
+    struct reply_header __header;
+    obj_handle_t   handle;
+    char __pad_12[4];
+};
+
+
+
 struct set_window_owner_request
 {
     struct request_header __header;
@@ -4782,6 +4992,10 @@ enum request
     REQ_get_startup_info,
     REQ_init_process_done,
     REQ_init_thread,
+    REQ_create_request_shm,
+    REQ_get_sync_shm,
+    REQ_get_server_stats,
+    REQ_call_batch,
     REQ_terminate_process,
     REQ_terminate_thread,
     REQ_get_process_info,
@@ -4895,6 +5109,7 @@ enum request
     REQ_empty_atom_table,
     REQ_init_atom_table,
     REQ_get_msg_queue,
+    REQ_get_queue_ring,
     REQ_set_queue_fd,
     REQ_set_queue_mask,
     REQ_get_queue_status,
@@ -4920,6 +5135,7 @@ enum request
     REQ_create_window,
     REQ_destroy_window,
     REQ_get_desktop_window,
+    REQ_get_desktop_shm,
     REQ_set_window_owner,
     REQ_get_window_info,
     REQ_set_window_info,
@@ -5032,6 +5248,10 @@ union generic_request
     struct get_startup_info_request get_startup_info_request;
     struct init_process_done_request init_process_done_request;
     struct init_thread_request init_thread_request;
+    struct create_request_shm_request create_request_shm_request;
+    struct get_sync_shm_request get_sync_shm_request;
+    struct get_server_stats_request get_server_stats_request;
+    struct call_batch_request call_batch_request;
     struct terminate_process_request terminate_process_request;
     struct terminate_thread_request terminate_thread_request;
     struct get_process_info_request get_process_info_request;
@@ -5145,6 +5365,7 @@ union generic_request
     struct empty_atom_table_request empty_atom_table_request;
     struct init_atom_table_request init_atom_table_request;
     struct get_msg_queue_request get_msg_queue_request;
+    struct get_queue_ring_request get_queue_ring_request;
     struct set_queue_fd_request set_queue_fd_request;
     struct set_queue_mask_request set_queue_mask_request;
     struct get_queue_status_request get_queue_status_request;
@@ -5170,6 +5391,7 @@ union generic_request
     struct create_window_request create_window_request;
     struct destroy_window_request destroy_window_request;
     struct get_desktop_window_request get_desktop_window_request;
+    struct get_desktop_shm_request get_desktop_shm_request;
     struct set_window_owner_request set_window_owner_request;
     struct get_window_info_request get_window_info_request;
     struct set_window_info_request set_window_info_request;
@@ -5280,6 +5502,10 @@ union generic_reply
     struct get_startup_info_reply get_startup_info_reply;
     struct init_process_done_reply init_process_done_reply;
     struct init_thread_reply init_thread_reply;
+    struct create_request_shm_reply create_request_shm_reply;
+    struct get_sync_shm_reply get_sync_shm_reply;
+    struct get_server_stats_reply get_server_stats_reply;
+    struct call_batch_reply call_batch_reply;
     struct terminate_process_reply terminate_process_reply;
     struct terminate_thread_reply terminate_thread_reply;
     struct get_process_info_reply get_process_info_reply;
@@ -5393,6 +5619,7 @@ union generic_reply
     struct empty_atom_table_reply empty_atom_table_reply;
     struct init_atom_table_reply init_atom_table_reply;
     struct get_msg_queue_reply get_msg_queue_reply;
+    struct get_queue_ring_reply get_queue_ring_reply;
     struct set_queue_fd_reply set_queue_fd_reply;
     struct set_queue_mask_reply set_queue_mask_reply;
     struct get_queue_status_reply get_queue_status_reply;
@@ -5418,6 +5645,7 @@ union generic_reply
     struct create_window_reply create_window_reply;
     struct destroy_window_reply destroy_window_reply;
     struct get_desktop_window_reply get_desktop_window_reply;
+    struct get_desktop_shm_reply get_desktop_shm_reply;
     struct set_window_owner_reply set_window_owner_reply;
     struct get_window_info_reply get_window_info_reply;
     struct set_window_info_reply set_window_info_reply;
@@ -5519,6 +5747,6 @@ union generic_reply
     struct set_cursor_reply set_cursor_reply;
 };
 
-#define SERVER_PROTOCOL_VERSION 411
+#define SERVER_PROTOCOL_VERSION 421
 
 #endif /* __WINE_WINE_SERVER_PROTOCOL_H */
@@ -0,0 +1,193 @@
+/*
+ * Print the request statistics of the wineserver
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+#include "config.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winbase.h"
+#include "winternl.h"
+#include "tlhelp32.h"
+#include "wine/server.h"
+#include "wine/debug.h"
+
+/* options */
+static unsigned int top_count = 10;
+static int show_histogram;
+
+/* retrieve the statistics of a process, or of the whole server if pid is 0 */
+static struct request_stats *get_server_stats( DWORD pid, unsigned int *count )
+{
+    struct request_stats *stats = NULL;
+    unsigned int total = 256;
+    NTSTATUS status;
+
+    for (;;)
+    {
+        HeapFree( GetProcessHeap(), 0, stats );
+        if (!(stats = HeapAlloc( GetProcessHeap(), 0, total * sizeof(*stats) ))) return NULL;
+
+        SERVER_START_REQ( get_server_stats )
+        {
+            req->pid = pid;
+            wine_server_set_reply( req, stats, total * sizeof(*stats) );
+            if (!(status = wine_server_call( req )))
+            {
+                *count = wine_server_reply_size( reply ) / sizeof(*stats);
+                if (reply->total > total) status = STATUS_BUFFER_OVERFLOW;
+                total = reply->total;
+            }
+        }
+        SERVER_END_REQ;
+
+        if (status != STATUS_BUFFER_OVERFLOW) break;
+    }
+    if (status)
+    {
+        HeapFree( GetProcessHeap(), 0, stats );
+        return NULL;
+    }
+    return stats;
+}
+
+/* sort by decreasing total time, then by decreasing call count */
+static int compare_stats( const void *p1, const void *p2 )
+{
+    const struct request_stats *stats1 = p1, *stats2 = p2;
+
+    if (stats1->total_time > stats2->total_time) return -1;
+    if (stats1->total_time < stats2->total_time) return 1;
+    if (stats1->count > stats2->count) return -1;
+    if (stats1->count < stats2->count) return 1;
+    return 0;
+}
+
+static void print_stats( struct request_stats *stats, unsigned int count )
+{
+    unsigned int i, j;
+
+    qsort( stats, count, sizeof(*stats), compare_stats );
+
+    printf( "  %-30s %10s %12s %10s %10s %12s\n",
+            "request", "count", "total usec", "avg usec", "max usec", "reply bytes" );
+    for (i = 0; i < count && i < top_count; i++)
+    {
+        if (!stats[i].count) break;
+        printf( "  %-30s %10u %12.0f %10u %10u %12.0f\n", stats[i].name, stats[i].count,
+                (double)stats[i].total_time, (unsigned int)(stats[i].total_time / stats[i].count),
+                stats[i].max_time, (double)stats[i].reply_bytes );
+        if (!show_histogram) continue;
+        for (j = 0; j < REQUEST_STATS_BUCKETS; j++)
+        {
+            if (!stats[i].histogram[j]) continue;
+            printf( "      < %8u usec: %u\n", 1u << j, stats[i].histogram[j] );
+        }
+    }
+}
+
+static void print_server_stats(void)
+{
+    struct request_stats *stats;
+    unsigned int count;
+
+    if (!(stats = get_server_stats( 0, &count )))
+    {
+        fprintf( stderr, "wineserverstats: cannot retrieve the server statistics\n" );
+        return;
+    }
+    printf( "wineserver:\n" );
+    print_stats( stats, count );
+    HeapFree( GetProcessHeap(), 0, stats );
+}
+
+static void print_process_stats( DWORD pid, const WCHAR *name )
+{
+    struct request_stats *stats;
+    unsigned int count;
+
+    if (!(stats = get_server_stats( pid, &count )))
+    {
+        fprintf( stderr, "wineserverstats: cannot retrieve the statistics of process %04x\n", pid );
+        return;
+    }
+    printf( "\nprocess %04x %s:\n", pid, name ? wine_dbgstr_w( name ) : "" );
+    print_stats( stats, count );
+    HeapFree( GetProcessHeap(), 0, stats );
+}
+
+static void print_all_processes(void)
+{
+    PROCESSENTRY32W entry;
+    HANDLE snapshot;
+
+    snapshot = CreateToolhelp32Snapshot( TH32CS_SNAPPROCESS, 0 );
+    if (snapshot == INVALID_HANDLE_VALUE) return;
+
+    entry.dwSize = sizeof(entry);
+    if (Process32FirstW( snapshot, &entry ))
+    {
+        do print_process_stats( entry.th32ProcessID, entry.szExeFile );
+        while (Process32NextW( snapshot, &entry ));
+    }
+    CloseHandle( snapshot );
+}
+
+static void usage(void)
+{
+    printf( "Usage: wineserverstats [-n count] [-H] [-a | pid...]\n\n" );
+    printf( "Print the statistics of the requests handled by the wineserver.\n\n" );
+    printf( "  -n count  Print the count busiest requests (default %u)\n", top_count );
+    printf( "  -H        Print the histogram of the handler times\n" );
+    printf( "  -a        Print the busiest requests of each process\n" );
+    printf( "  pid       Print the busiest requests of the given process\n" );
+    exit( 1 );
+}
+
+int main( int argc, char *argv[] )
+{
+    int i, all = 0, pids = 0;
+
+    for (i = 1; i < argc; i++)
+    {
+        if (!strcmp( argv[i], "-n" ) && i + 1 < argc) top_count = atoi( argv[++i] );
+        else if (!strcmp( argv[i], "-H" )) show_histogram = 1;
+        else if (!strcmp( argv[i], "-a" )) all = 1;
+        else if (argv[i][0] == '-') usage();
+        else pids++;
+    }
+
+    if (pids)
+    {
+        for (i = 1; i < argc; i++)
+        {
+            if (!strcmp( argv[i], "-n" )) i++;
+            else if (argv[i][0] != '-') print_process_stats( strtoul( argv[i], NULL, 16 ), NULL );
+        }
+        return 0;
+    }
+
+    print_server_stats();
+    if (all) print_all_processes();
+    return 0;
+}
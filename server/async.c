@@ -330,3 +330,18 @@ void async_wake_up( struct async_queue *queue, unsigned int status )
         if (status == STATUS_ALERTED) break;  /* only wake up the first one */
     }
 }
+
+/* wake up the first async of a queue that is still waiting */
+void async_wake_up_waiting( struct async_queue *queue, unsigned int status )
+{
+    struct async *async;
+
+    if (!queue) return;
+
+    LIST_FOR_EACH_ENTRY( async, &queue->queue, struct async, queue_entry )
+    {
+        if (async->status != STATUS_PENDING) continue;
+        async_terminate( async, status );
+        break;
+    }
+}
@@ -161,6 +161,7 @@ struct dir
     struct list    change_records;   /* data for the change */
     struct list    in_entry; /* entry in the inode dirs list */
     struct inode  *inode;    /* inode of the associated directory */
+    struct timeout_user *notify_timeout; /* pending delayed notification */
 };
 
 static struct fd *dir_get_fd( struct object *obj );
@@ -402,6 +403,9 @@ static void dir_destroy( struct object *obj )
     if (dir->filter)
         remove_change( dir );
 
+    if (dir->notify_timeout)
+        remove_timeout_user( dir->notify_timeout );
+
     if (dir->inode)
     {
         list_remove( &dir->in_entry );
@@ -436,7 +440,7 @@ static enum server_fd_type dir_get_fd_type( struct fd *fd )
 
 #ifdef USE_INOTIFY
 
-#define HASH_SIZE 31
+#define HASH_SIZE 1021
 
 struct inode {
     struct list ch_entry;    /* entry in the children list */
@@ -445,15 +449,23 @@ struct inode {
     struct list dirs;        /* directory handles watching this inode */
     struct list ino_entry;   /* entry in the inode hash */
     struct list wd_entry;    /* entry in the watch descriptor hash */
+    struct list scan_entry;  /* entry in the list of directories to scan */
     dev_t dev;               /* device number */
     ino_t ino;               /* device's inode number */
     int wd;                  /* inotify's watch descriptor */
+    int scan_new;            /* report the entries found by the scan as added */
     char *name;              /* basename name of the inode */
 };
 
 static struct list inode_hash[ HASH_SIZE ];
 static struct list wd_hash[ HASH_SIZE ];
 
+/* directories whose existing subdirectories still have to be watched */
+static struct list scan_list = LIST_INIT(scan_list);
+static struct timeout_user *scan_timeout;
+
+#define SCAN_BATCH 64  /* number of directories scanned per main loop iteration */
+
 static int inotify_add_dir( char *path, unsigned int filter );
 
 static struct inode *inode_from_wd( int wd )
@@ -494,9 +506,11 @@ static struct inode *create_inode( dev_t dev, ino_t ino )
     {
         list_init( &inode->children );
         list_init( &inode->dirs );
+        list_init( &inode->scan_entry );
         inode->ino = ino;
         inode->dev = dev;
         inode->wd = -1;
+        inode->scan_new = 0;
         inode->parent = NULL;
         inode->name = NULL;
         list_add_tail( get_hash_list( dev, ino ), &inode->ino_entry );
@@ -570,6 +584,7 @@ static void free_inode( struct inode *inode )
         list_remove( &inode->wd_entry );
     }
     list_remove( &inode->ino_entry );
+    list_remove( &inode->scan_entry );
 
     free( inode->name );
     free( inode );
@@ -625,6 +640,36 @@ static int inotify_get_poll_events( struct fd *fd )
     return POLLIN;
 }
 
+/* maximum number of pending records checked for a duplicate modification */
+#define MAX_COALESCE_SCAN 64
+
+/* check if the same modification is still pending, with no other change to that name since */
+static int is_duplicate_change( struct dir *dir, unsigned int action, const char *relpath, size_t len )
+{
+    struct change_record *record;
+    struct list *ptr;
+    int count = 0;
+
+    if (action != FILE_ACTION_MODIFIED) return 0;
+
+    for (ptr = list_tail( &dir->change_records ); ptr && count < MAX_COALESCE_SCAN;
+         ptr = list_prev( &dir->change_records, ptr ), count++)
+    {
+        record = LIST_ENTRY( ptr, struct change_record, entry );
+        if (record->len != len || memcmp( record->name, relpath, len )) continue;
+        return record->action == FILE_ACTION_MODIFIED;
+    }
+    return 0;
+}
+
+static void dir_notify_timeout( void *private )
+{
+    struct dir *dir = private;
+
+    dir->notify_timeout = NULL;
+    fd_async_wake_up( dir->fd, ASYNC_TYPE_WAIT, STATUS_ALERTED );
+}
+
 static void inotify_do_change_notify( struct dir *dir, unsigned int action,
                                       const char *relpath )
 {
@@ -635,6 +680,11 @@ static void inotify_do_change_notify( struct dir *dir, unsigned int action,
     if (dir->want_data)
     {
         size_t len = strlen(relpath);
+
+        /* the client will be woken up for the pending one */
+        if (is_duplicate_change( dir, action, relpath, len ))
+            return;
+
         record = malloc( offsetof(struct change_record, name[len]) );
         if (!record)
             return;
@@ -646,6 +696,15 @@ static void inotify_do_change_notify( struct dir *dir, unsigned int action,
         list_add_tail( &dir->change_records, &record->entry );
     }
 
+    /* give the changes coming right after this one a chance to be returned together */
+    if (notify_delay)
+    {
+        if (!dir->notify_timeout)
+            dir->notify_timeout = add_timeout_user( notify_delay, dir_notify_timeout, dir );
+        if (dir->notify_timeout)
+            return;
+    }
+
     fd_async_wake_up( dir->fd, ASYNC_TYPE_WAIT, STATUS_ALERTED );
 }
 
@@ -719,7 +778,20 @@ static char *inode_get_path( struct inode *inode, int sz )
     return path;
 }
 
-static int inode_check_dir( struct inode *parent, const char *name )
+static void scan_directories( void *private );
+static void inode_notify( struct inode *inode, unsigned int filter, unsigned int action, const char *name );
+
+/* queue a directory to have its existing subdirectories watched */
+static void inode_queue_scan( struct inode *inode )
+{
+    list_remove( &inode->scan_entry );
+    list_add_tail( &scan_list, &inode->scan_entry );
+    if (!scan_timeout)
+        scan_timeout = add_timeout_user( 0, scan_directories, NULL );
+}
+
+/* check if a new entry is a directory, and start watching it if it is */
+static int inode_check_dir( struct inode *parent, const char *name, int is_new )
 {
     char *path;
     unsigned int filter;
@@ -754,7 +826,13 @@ static int inode_check_dir( struct inode *parent, const char *name )
 
     wd = inotify_add_dir( path, filter );
     if (wd != -1)
+    {
         inode_set_wd( inode, wd );
+        /* entries created in a new directory before the watch was added didn't
+         * generate any event, so the scan reports them now that it's in place */
+        inode->scan_new = is_new;
+        inode_queue_scan( inode );
+    }
     else
         free_inode( inode );
 
@@ -763,6 +841,66 @@ end:
     return r;
 }
 
+/* add watches for the subdirectories of a directory */
+static void inode_scan_dir( struct inode *inode )
+{
+    struct dirent *de;
+    DIR *unix_dir;
+    char *path;
+    int is_new = inode->scan_new;
+
+    path = inode_get_path( inode, 0 );
+    if (!path)
+        return;
+
+    if ((unix_dir = opendir( path )))
+    {
+        while ((de = readdir( unix_dir )))
+        {
+            if (!strcmp( de->d_name, "." ) || !strcmp( de->d_name, ".." ))
+                continue;
+#ifdef DT_DIR
+            if (!is_new && de->d_type != DT_DIR && de->d_type != DT_UNKNOWN)
+                continue;
+#endif
+            switch (inode_check_dir( inode, de->d_name, is_new ))
+            {
+            case 1:
+                if (is_new) inode_notify( inode, FILE_NOTIFY_CHANGE_DIR_NAME, FILE_ACTION_ADDED, de->d_name );
+                break;
+            case 0:
+                if (is_new) inode_notify( inode, FILE_NOTIFY_CHANGE_FILE_NAME, FILE_ACTION_ADDED, de->d_name );
+                break;
+            }
+        }
+        closedir( unix_dir );
+    }
+    free( path );
+    inode->scan_new = 0;
+}
+
+/* walk the watched trees a few directories at a time to keep the server responsive */
+static void scan_directories( void *private )
+{
+    struct inode *inode;
+    struct list *ptr;
+    int count;
+
+    scan_timeout = NULL;
+
+    for (count = 0; count < SCAN_BATCH && (ptr = list_head( &scan_list )); count++)
+    {
+        inode = LIST_ENTRY( ptr, struct inode, scan_entry );
+        list_remove( ptr );
+        list_init( ptr );
+        if (inotify_fd)
+            inode_scan_dir( inode );
+    }
+
+    if (!list_empty( &scan_list ))
+        scan_timeout = add_timeout_user( 0, scan_directories, NULL );
+}
+
 static int prepend( char **path, const char *segment )
 {
     int extra;
@@ -790,12 +928,38 @@ static int prepend( char **path, const char *segment )
     return 1;
 }
 
+/* notify the watches on a directory and the recursive watches on its parents */
+static void inode_notify( struct inode *inode, unsigned int filter, unsigned int action, const char *name )
+{
+    struct inode *i;
+    char *path = NULL;
+    struct dir *dir;
+
+    /*
+     * Work our way up the inode hierarchy
+     *  extending the relative path as we go
+     *  and notifying all recursive watches.
+     */
+    if (!prepend( &path, name ))
+        return;
+
+    for (i = inode; i; i = i->parent)
+    {
+        LIST_FOR_EACH_ENTRY( dir, &i->dirs, struct dir, in_entry )
+            if ((filter & dir->filter) && (i==inode || dir->subtree))
+                inotify_do_change_notify( dir, action, path );
+
+        if (!i->name || !prepend( &path, i->name ))
+            break;
+    }
+
+    free( path );
+}
+
 static void inotify_notify_all( struct inotify_event *ie )
 {
     unsigned int filter, action;
     struct inode *inode, *i;
-    char *path = NULL;
-    struct dir *dir;
 
     inode = inode_from_wd( ie->wd );
     if (!inode)
@@ -808,7 +972,7 @@ static void inotify_notify_all( struct inotify_event *ie )
     
     if (ie->mask & IN_CREATE)
     {
-        switch (inode_check_dir( inode, ie->name ))
+        switch (inode_check_dir( inode, ie->name, 1 ))
         {
         case 1:
             filter &= ~FILE_NOTIFY_CHANGE_FILE_NAME;
@@ -827,25 +991,7 @@ static void inotify_notify_all( struct inotify_event *ie )
     else
         action = FILE_ACTION_MODIFIED;
 
-    /*
-     * Work our way up the inode hierarchy
-     *  extending the relative path as we go
-     *  and notifying all recursive watches.
-     */
-    if (!prepend( &path, ie->name ))
-        return;
-
-    for (i = inode; i; i = i->parent)
-    {
-        LIST_FOR_EACH_ENTRY( dir, &i->dirs, struct dir, in_entry )
-            if ((filter & dir->filter) && (i==inode || dir->subtree))
-                inotify_do_change_notify( dir, action, path );
-
-        if (!i->name || !prepend( &path, i->name ))
-            break;
-    }
-
-    free( path );
+    inode_notify( inode, filter, action, ie->name );
 
     if (ie->mask & IN_DELETE)
     {
@@ -855,28 +1001,36 @@ static void inotify_notify_all( struct inotify_event *ie )
     }
 }
 
+#define MAX_INOTIFY_READS 16  /* maximum number of reads per poll event */
+
 static void inotify_poll_event( struct fd *fd, int event )
 {
-    int r, ofs, unix_fd;
-    char buffer[0x1000];
+    static int buffer[0x10000 / sizeof(int)];  /* int to get the event alignment */
+    int r, ofs, unix_fd, count;
     struct inotify_event *ie;
 
     unix_fd = get_unix_fd( fd );
-    r = read( unix_fd, buffer, sizeof buffer );
-    if (r < 0)
-    {
-        fprintf(stderr,"inotify_poll_event(): inotify read failed!\n");
-        return;
-    }
 
-    for( ofs = 0; ofs < r - offsetof(struct inotify_event, name); )
+    /* drain the queue with large reads, without starving the other clients */
+    for (count = 0; count < MAX_INOTIFY_READS; count++)
     {
-        ie = (struct inotify_event*) &buffer[ofs];
-        if (!ie->len)
-            break;
-        ofs += offsetof( struct inotify_event, name[ie->len] );
-        if (ofs > r) break;
-        inotify_notify_all( ie );
+        r = read( unix_fd, buffer, sizeof buffer );
+        if (r < 0)
+        {
+            if (errno != EAGAIN && errno != EINTR)
+                fprintf(stderr,"inotify_poll_event(): inotify read failed!\n");
+            return;
+        }
+
+        for (ofs = 0; ofs + offsetof(struct inotify_event, name) <= r; )
+        {
+            ie = (struct inotify_event *)((char *)buffer + ofs);
+            ofs += offsetof( struct inotify_event, name[ie->len] );
+            if (ofs > r) break;
+            /* events without a name are about the watched directory itself */
+            if (ie->len)
+                inotify_notify_all( ie );
+        }
     }
 }
 
@@ -887,6 +1041,7 @@ static inline struct fd *create_inotify_fd( void )
     unix_fd = inotify_init();
     if (unix_fd<0)
         return NULL;
+    fcntl( unix_fd, F_SETFL, O_NONBLOCK );
     return create_anonymous_fd( &inotify_fd_ops, unix_fd, NULL, 0 );
 }
 
@@ -946,7 +1101,7 @@ static int inotify_adjust_changes( struct dir *dir )
     struct inode *inode;
     struct stat st;
     char path[32];
-    int wd, unix_fd;
+    int wd, unix_fd, new_watch = 0;
 
     if (!inotify_fd)
         return 0;
@@ -956,6 +1111,7 @@ static int inotify_adjust_changes( struct dir *dir )
     inode = dir->inode;
     if (!inode)
     {
+        new_watch = 1;
         /* check if this fd is already being watched */
         if (-1 == fstat( unix_fd, &st ))
             return 0;
@@ -977,6 +1133,10 @@ static int inotify_adjust_changes( struct dir *dir )
 
     inode_set_wd( inode, wd );
 
+    /* watch the existing subdirectories too, new ones are added as they are created */
+    if (new_watch && dir->subtree)
+        inode_queue_scan( inode );
+
     return 1;
 }
 
@@ -1116,6 +1276,7 @@ struct object *create_dir_obj( struct fd *fd, unsigned int access, mode_t mode )
     dir->notified = 0;
     dir->want_data = 0;
     dir->inode = NULL;
+    dir->notify_timeout = NULL;
     grab_object( fd );
     dir->fd = fd;
     dir->mode = mode;
@@ -1156,8 +1317,8 @@ DECL_HANDLER(read_directory_changes)
         dir->want_data = req->want_data;
     }
 
-    /* if there's already a change in the queue, send it */
-    if (!list_empty( &dir->change_records ))
+    /* if there's already a change in the queue, send it, unless it's being delayed */
+    if (!list_empty( &dir->change_records ) && !dir->notify_timeout)
         fd_async_wake_up( dir->fd, ASYNC_TYPE_WAIT, STATUS_ALERTED );
 
     /* setup the real notification */
@@ -1171,23 +1332,64 @@ end:
     release_object( dir );
 }
 
+static inline data_size_t get_event_size( data_size_t len )
+{
+    return (offsetof( struct filesystem_event, name[len] ) + sizeof(int) - 1) & ~(sizeof(int) - 1);
+}
+
+/* upper bound of the size of the FILE_NOTIFY_INFORMATION the client converts an event to */
+/* the name is converted to at most one WCHAR per byte, and entries are DWORD aligned */
+static inline data_size_t get_notify_size( data_size_t len )
+{
+    return (offsetof( FILE_NOTIFY_INFORMATION, FileName[len] ) + sizeof(DWORD) - 1) & ~(sizeof(DWORD) - 1);
+}
+
+/* retrieve the pending changes of a directory */
 DECL_HANDLER(read_change)
 {
     struct change_record *record;
+    struct filesystem_event *event;
     struct dir *dir;
+    struct list *ptr;
+    data_size_t size = 0, notify_size = 0;
+    char *data;
 
     dir = get_dir_obj( current->process, req->handle, 0 );
     if (!dir)
         return;
 
-    if ((record = get_first_change_record( dir )) != NULL)
+    /* return as many records as fit in the client buffer once converted, */
+    /* the raw events are smaller so they always fit in the reply as well */
+    LIST_FOR_EACH( ptr, &dir->change_records )
     {
-        reply->action = record->action;
-        set_reply_data( record->name, record->len );
-        free( record );
+        record = LIST_ENTRY( ptr, struct change_record, entry );
+        if (notify_size + get_notify_size( record->len ) > get_reply_max_size()) break;
+        notify_size += get_notify_size( record->len );
+        size += get_event_size( record->len );
+    }
+
+    if (!size)
+    {
+        /* a record too large for the client is dropped, the client reports an overflow */
+        if ((record = get_first_change_record( dir )) != NULL)
+            free( record );
+        else
+            set_error( STATUS_NO_DATA_DETECTED );
+    }
+    else if ((data = set_reply_data_size( size )))
+    {
+        while (size)
+        {
+            record = get_first_change_record( dir );
+            event = (struct filesystem_event *)data;
+            event->action = record->action;
+            event->len = record->len;
+            memcpy( event->name, record->name, record->len );
+            data += get_event_size( record->len );
+            size -= get_event_size( record->len );
+            free( record );
+        }
     }
-    else
-        set_error( STATUS_NO_DATA_DETECTED );
 
     release_object( dir );
 }
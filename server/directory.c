@@ -185,7 +185,7 @@ static void directory_destroy( struct object *obj )
 {
     struct directory *dir = (struct directory *)obj;
     assert( obj->ops == &directory_ops );
-    free( dir->entries );
+    free_namespace( dir->entries );
 }
 
 static struct directory *create_directory( struct directory *root, const struct unicode_str *name,
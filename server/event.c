@@ -38,9 +38,11 @@
 
 struct event
 {
-    struct object  obj;             /* object header */
-    int            manual_reset;    /* is it a manual reset event? */
-    int            signaled;        /* event has been signaled */
+    struct object    obj;             /* object header */
+    int              manual_reset;    /* is it a manual reset event? */
+    int              signaled;        /* event has been signaled */
+    struct sync_shm *shm;             /* shared memory holding the state, if any */
+    unsigned int     shm_index;       /* index of the state in the shared memory */
 };
 
 static void event_dump( struct object *obj, int verbose );
@@ -49,14 +51,17 @@ static int event_signaled( struct object *obj, struct thread *thread );
 static int event_satisfied( struct object *obj, struct thread *thread );
 static unsigned int event_map_access( struct object *obj, unsigned int access );
 static int event_signal( struct object *obj, unsigned int access);
+static int event_add_queue( struct object *obj, struct wait_queue_entry *entry );
+static void event_remove_queue( struct object *obj, struct wait_queue_entry *entry );
+static void event_destroy( struct object *obj );
 
 static const struct object_ops event_ops =
 {
     sizeof(struct event),      /* size */
     event_dump,                /* dump */
     event_get_type,            /* get_type */
-    add_queue,                 /* add_queue */
-    remove_queue,              /* remove_queue */
+    event_add_queue,           /* add_queue */
+    event_remove_queue,        /* remove_queue */
     event_signaled,            /* signaled */
     event_satisfied,           /* satisfied */
     event_signal,              /* signal */
@@ -67,10 +72,24 @@ static const struct object_ops event_ops =
     no_lookup_name,            /* lookup_name */
     no_open_file,              /* open_file */
     no_close_handle,           /* close_handle */
-    no_destroy                 /* destroy */
+    event_destroy              /* destroy */
 };
 
 
+/* retrieve the signaled state, which lives in the shared memory if there is one */
+static inline int get_event_state( struct event *event )
+{
+    if (!event->shm) return event->signaled;
+    return SYNC_SHM_COUNT( get_sync_shm_entry( event->shm, event->shm_index )->state ) != 0;
+}
+
+static inline void set_event_state( struct event *event, int signaled )
+{
+    if (!event->shm) event->signaled = signaled;
+    else sync_shm_set_count( get_sync_shm_entry( event->shm, event->shm_index ), signaled );
+}
+
+
 struct event *create_event( struct directory *root, const struct unicode_str *name,
                             unsigned int attr, int manual_reset, int initial_state,
                             const struct security_descriptor *sd )
@@ -84,6 +103,7 @@ struct event *create_event( struct directory *root, const struct unicode_str *na
             /* initialize it if it didn't already exist */
             event->manual_reset = manual_reset;
             event->signaled     = initial_state;
+            event->shm          = NULL;
             if (sd) default_set_sd( &event->obj, sd, OWNER_SECURITY_INFORMATION|
                                                      GROUP_SECURITY_INFORMATION|
                                                      DACL_SECURITY_INFORMATION|
@@ -98,24 +118,37 @@ struct event *get_event_obj( struct process *process, obj_handle_t handle, unsig
     return (struct event *)get_handle_obj( process, handle, access, &event_ops );
 }
 
+/* move the state of a newly created event to the shared memory of the process */
+static void event_use_sync_shm( struct event *event, struct process *process )
+{
+    int index = alloc_sync_shm_entry( process, event->manual_reset ? SYNC_SHM_MANUAL_EVENT : SYNC_SHM_AUTO_EVENT,
+                                      event->signaled, 1, &event->shm );
+    if (index != -1) event->shm_index = index;
+}
+
 void pulse_event( struct event *event )
 {
-    event->signaled = 1;
+    struct sync_shm_entry *entry = event->shm ? get_sync_shm_entry( event->shm, event->shm_index ) : NULL;
+
+    /* count ourselves as a waiter so that the client doesn't see the transient signaled state */
+    if (entry) sync_shm_add_waiter( entry, 1 );
+    set_event_state( event, 1 );
     /* wake up all waiters if manual reset, a single one otherwise */
     wake_up( &event->obj, !event->manual_reset );
-    event->signaled = 0;
+    set_event_state( event, 0 );
+    if (entry) sync_shm_add_waiter( entry, -1 );
 }
 
 void set_event( struct event *event )
 {
-    event->signaled = 1;
+    set_event_state( event, 1 );
     /* wake up all waiters if manual reset, a single one otherwise */
     wake_up( &event->obj, !event->manual_reset );
 }
 
 void reset_event( struct event *event )
 {
-    event->signaled = 0;
+    set_event_state( event, 0 );
 }
 
 static void event_dump( struct object *obj, int verbose )
@@ -123,7 +156,7 @@ static void event_dump( struct object *obj, int verbose )
     struct event *event = (struct event *)obj;
     assert( obj->ops == &event_ops );
     fprintf( stderr, "Event manual=%d signaled=%d ",
-             event->manual_reset, event->signaled );
+             event->manual_reset, get_event_state( event ));
     dump_object_name( &event->obj );
     fputc( '\n', stderr );
 }
@@ -139,7 +172,7 @@ static int event_signaled( struct object *obj, struct thread *thread )
 {
     struct event *event = (struct event *)obj;
     assert( obj->ops == &event_ops );
-    return event->signaled;
+    return get_event_state( event );
 }
 
 static int event_satisfied( struct object *obj, struct thread *thread )
@@ -147,10 +180,34 @@ static int event_satisfied( struct object *obj, struct thread *thread )
     struct event *event = (struct event *)obj;
     assert( obj->ops == &event_ops );
     /* Reset if it's an auto-reset event */
-    if (!event->manual_reset) event->signaled = 0;
+    if (!event->manual_reset) set_event_state( event, 0 );
     return 0;  /* Not abandoned */
 }
 
+/* keep track of the server waiters so that the client leaves the shared state alone */
+static int event_add_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct event *event = (struct event *)obj;
+    assert( obj->ops == &event_ops );
+    if (event->shm) sync_shm_add_waiter( get_sync_shm_entry( event->shm, event->shm_index ), 1 );
+    return add_queue( obj, entry );
+}
+
+static void event_remove_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct event *event = (struct event *)obj;
+    assert( obj->ops == &event_ops );
+    remove_queue( obj, entry );
+    if (event->shm) sync_shm_add_waiter( get_sync_shm_entry( event->shm, event->shm_index ), -1 );
+}
+
+static void event_destroy( struct object *obj )
+{
+    struct event *event = (struct event *)obj;
+    assert( obj->ops == &event_ops );
+    if (event->shm) free_sync_shm_entry( event->shm, event->shm_index );
+}
+
 static unsigned int event_map_access( struct object *obj, unsigned int access )
 {
     if (access & GENERIC_READ)    access |= STANDARD_RIGHTS_READ | SYNCHRONIZE | EVENT_QUERY_STATE;
@@ -199,7 +256,19 @@ DECL_HANDLER(create_event)
         if (get_error() == STATUS_OBJECT_NAME_EXISTS)
             reply->handle = alloc_handle( current->process, event, req->access, req->attributes );
         else
+        {
             reply->handle = alloc_handle_no_access_check( current->process, event, req->access, req->attributes );
+            /* the client fast path needs to both signal and wait on the handle */
+            if (reply->handle &&
+                (get_handle_access( current->process, reply->handle ) & (EVENT_MODIFY_STATE | SYNCHRONIZE)) ==
+                (EVENT_MODIFY_STATE | SYNCHRONIZE))
+                event_use_sync_shm( event, current->process );
+            if (event->shm)
+            {
+                reply->shm_index  = event->shm_index;
+                reply->shm_serial = get_sync_shm_entry( event->shm, event->shm_index )->serial;
+            }
+        }
         release_object( event );
     }
 
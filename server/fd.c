@@ -277,7 +277,7 @@ struct inode
     struct device      *device;     /* device containing this inode */
     ino_t               ino;        /* inode number */
     struct list         open;       /* list of open file descriptors */
-    struct list         locks;      /* list of file locks */
+    struct file_lock   *locks;      /* tree of file locks */
     struct list         closed;     /* list of file descriptors to close at destroy time */
 };
 
@@ -311,7 +311,10 @@ struct file_lock
     struct object       obj;         /* object header */
     struct fd          *fd;          /* fd owning this lock */
     struct list         fd_entry;    /* entry in list of locks on a given fd */
-    struct list         inode_entry; /* entry in inode list of locks */
+    struct file_lock   *left;        /* children in the inode tree of locks */
+    struct file_lock   *right;
+    file_pos_t          max_end;     /* highest end offset in this subtree */
+    unsigned int        priority;    /* random priority used to balance the tree */
     int                 shared;      /* shared lock? */
     file_pos_t          start;       /* locked region is interval [start;end) */
     file_pos_t          end;
@@ -362,13 +365,17 @@ static file_pos_t max_unix_offset = OFF_T_MAX;
 
 struct timeout_user
 {
-    struct list           entry;      /* entry in sorted timeout list */
+    struct list           entry;      /* entry in expired list while its callback is pending */
+    int                   index;      /* index in the timeout heap, -1 if expired */
     timeout_t             when;       /* timeout expiry (absolute time) */
     timeout_callback      callback;   /* callback function */
     void                 *private;    /* callback private data */
 };
 
-static struct list timeout_list = LIST_INIT(timeout_list);   /* sorted timeouts list */
+static struct timeout_user **timeout_heap;   /* binary min-heap of pending timeouts */
+static int timeout_count;                    /* number of entries in the heap */
+static int timeout_size;                     /* allocated size of the heap */
+static struct list expired_list = LIST_INIT(expired_list);   /* expired timeouts being processed */
 timeout_t current_time;
 
 static inline void set_current_time(void)
@@ -379,32 +386,95 @@ static inline void set_current_time(void)
     current_time = (timeout_t)now.tv_sec * TICKS_PER_SEC + now.tv_usec * 10 + ticks_1601_to_1970;
 }
 
+/* store a timeout at a given position in the heap */
+static inline void set_heap_entry( int index, struct timeout_user *user )
+{
+    timeout_heap[index] = user;
+    user->index = index;
+}
+
+/* move a heap entry towards the root until the heap order is restored */
+static void timeout_heap_up( int index )
+{
+    struct timeout_user *user = timeout_heap[index];
+
+    while (index > 0)
+    {
+        int parent = (index - 1) / 2;
+        if (timeout_heap[parent]->when <= user->when) break;
+        set_heap_entry( index, timeout_heap[parent] );
+        index = parent;
+    }
+    set_heap_entry( index, user );
+}
+
+/* move a heap entry towards the leaves until the heap order is restored */
+static void timeout_heap_down( int index )
+{
+    struct timeout_user *user = timeout_heap[index];
+
+    for (;;)
+    {
+        int child = 2 * index + 1;
+        if (child >= timeout_count) break;
+        if (child + 1 < timeout_count && timeout_heap[child + 1]->when < timeout_heap[child]->when)
+            child++;
+        if (user->when <= timeout_heap[child]->when) break;
+        set_heap_entry( index, timeout_heap[child] );
+        index = child;
+    }
+    set_heap_entry( index, user );
+}
+
+/* remove an entry from the timeout heap */
+static void timeout_heap_remove( struct timeout_user *user )
+{
+    int index = user->index;
+    struct timeout_user *last = timeout_heap[--timeout_count];
+
+    user->index = -1;
+    if (last == user) return;
+    set_heap_entry( index, last );
+    if (index > 0 && timeout_heap[(index - 1) / 2]->when > last->when) timeout_heap_up( index );
+    else timeout_heap_down( index );
+}
+
 /* add a timeout user */
 struct timeout_user *add_timeout_user( timeout_t when, timeout_callback func, void *private )
 {
     struct timeout_user *user;
-    struct list *ptr;
+
+    if (timeout_count == timeout_size)
+    {
+        int new_size = max( timeout_size * 2, 64 );
+        struct timeout_user **new_heap;
+
+        if (!(new_heap = realloc( timeout_heap, new_size * sizeof(*new_heap) )))
+        {
+            set_error( STATUS_NO_MEMORY );
+            return NULL;
+        }
+        timeout_heap = new_heap;
+        timeout_size = new_size;
+    }
 
     if (!(user = mem_alloc( sizeof(*user) ))) return NULL;
     user->when     = (when > 0) ? when : current_time - when;
     user->callback = func;
     user->private  = private;
 
-    /* Now insert it in the linked list */
+    /* Now insert it in the heap */
 
-    LIST_FOR_EACH( ptr, &timeout_list )
-    {
-        struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-        if (timeout->when >= user->when) break;
-    }
-    list_add_before( ptr, &user->entry );
+    set_heap_entry( timeout_count++, user );
+    timeout_heap_up( user->index );
     return user;
 }
 
 /* remove a timeout user */
 void remove_timeout_user( struct timeout_user *user )
 {
-    list_remove( &user->entry );
+    if (user->index == -1) list_remove( &user->entry );
+    else timeout_heap_remove( user );
     free( user );
 }
 
@@ -850,44 +920,33 @@ static void remove_poll_user( struct fd *fd, int user )
 /* process pending timeouts and return the time until the next timeout, in milliseconds */
 static int get_next_timeout(void)
 {
-    if (!list_empty( &timeout_list ))
-    {
-        struct list expired_list, *ptr;
+    struct list *ptr;
+    int diff;
 
-        /* first remove all expired timers from the list */
+    /* first remove all expired timers from the heap, in expiration order */
 
-        list_init( &expired_list );
-        while ((ptr = list_head( &timeout_list )) != NULL)
-        {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
+    while (timeout_count && timeout_heap[0]->when <= current_time)
+    {
+        struct timeout_user *timeout = timeout_heap[0];
+        timeout_heap_remove( timeout );
+        list_add_tail( &expired_list, &timeout->entry );
+    }
 
-            if (timeout->when <= current_time)
-            {
-                list_remove( &timeout->entry );
-                list_add_tail( &expired_list, &timeout->entry );
-            }
-            else break;
-        }
+    /* now call the callback for all the removed timers */
 
-        /* now call the callback for all the removed timers */
+    while ((ptr = list_head( &expired_list )) != NULL)
+    {
+        struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
+        list_remove( &timeout->entry );
+        timeout->callback( timeout->private );
+        free( timeout );
+    }
 
-        while ((ptr = list_head( &expired_list )) != NULL)
-        {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-            list_remove( &timeout->entry );
-            timeout->callback( timeout->private );
-            free( timeout );
-        }
+    if (!timeout_count) return -1;  /* no pending timeouts */
 
-        if ((ptr = list_head( &timeout_list )) != NULL)
-        {
-            struct timeout_user *timeout = LIST_ENTRY( ptr, struct timeout_user, entry );
-            int diff = (timeout->when - current_time + 9999) / 10000;
-            if (diff < 0) diff = 0;
-            return diff;
-        }
-    }
-    return -1;  /* no pending timeouts */
+    diff = (timeout_heap[0]->when - current_time + 9999) / 10000;
+    if (diff < 0) diff = 0;
+    return diff;
 }
 
 /* server main poll() loop */
@@ -1054,7 +1113,7 @@ static void inode_destroy( struct object *obj )
     struct list *ptr;
 
     assert( list_empty(&inode->open) );
-    assert( list_empty(&inode->locks) );
+    assert( !inode->locks );
 
     list_remove( &inode->entry );
 
@@ -1102,7 +1161,7 @@ static struct inode *get_inode( dev_t dev, ino_t ino, int unix_fd )
         inode->device = device;
         inode->ino    = ino;
         list_init( &inode->open );
-        list_init( &inode->locks );
+        inode->locks  = NULL;
         list_init( &inode->closed );
         list_add_head( &device->inode_hash[hash], &inode->entry );
     }
@@ -1114,7 +1173,7 @@ static struct inode *get_inode( dev_t dev, ino_t ino, int unix_fd )
 /* add fd to the inode list of file descriptors to close */
 static void inode_add_closed_fd( struct inode *inode, struct closed_fd *fd )
 {
-    if (!list_empty( &inode->locks ))
+    if (inode->locks)
     {
         list_add_head( &inode->closed, &fd->entry );
     }
@@ -1221,104 +1280,171 @@ static inline int lock_overlaps( struct file_lock *lock, file_pos_t start, file_
     return 1;
 }
 
-/* remove Unix locks for all bytes in the specified area that are no longer locked */
-static void remove_unix_locks( struct fd *fd, file_pos_t start, file_pos_t end )
+/* The locks of an inode are kept in a treap ordered by start offset, where each
+ * node also stores the highest end offset of its subtree. This allows finding the
+ * locks overlapping a range in O(log n + k) without looking at the other ones. */
+
+static unsigned int lock_priority_seed = 0x2545f491;
+
+/* end offset of a lock, an end of 0 meaning the lock extends to infinity */
+static inline file_pos_t lock_end( const struct file_lock *lock )
 {
-    struct hole
-    {
-        struct hole *next;
-        struct hole *prev;
-        file_pos_t   start;
-        file_pos_t   end;
-    } *first, *cur, *next, *buffer;
+    return lock->end ? lock->end : FILE_POS_T_MAX;
+}
 
-    struct list *ptr;
-    int count = 0;
+/* ordering of the locks in the tree, by start offset and then by address */
+static inline int lock_before( const struct file_lock *lock1, const struct file_lock *lock2 )
+{
+    if (lock1->start != lock2->start) return lock1->start < lock2->start;
+    return lock1 < lock2;
+}
 
-    if (!fd->inode) return;
-    if (!fd->fs_locks) return;
-    if (start == end || start > max_unix_offset) return;
-    if (!end || end > max_unix_offset) end = max_unix_offset + 1;
+/* check if a subtree can contain a lock extending beyond the given offset */
+static inline int lock_tree_reaches( const struct file_lock *root, file_pos_t pos )
+{
+    return root && (root->max_end > pos || root->max_end == FILE_POS_T_MAX);
+}
+
+static void update_lock_max_end( struct file_lock *lock )
+{
+    lock->max_end = lock_end( lock );
+    if (lock->left && lock->left->max_end > lock->max_end) lock->max_end = lock->left->max_end;
+    if (lock->right && lock->right->max_end > lock->max_end) lock->max_end = lock->right->max_end;
+}
+
+/* insert a lock in the tree, returns the new root */
+static struct file_lock *insert_lock_tree( struct file_lock *root, struct file_lock *lock )
+{
+    struct file_lock *child;
 
-    /* count the number of locks overlapping the specified area */
+    if (!root) return lock;
 
-    LIST_FOR_EACH( ptr, &fd->inode->locks )
+    if (lock_before( lock, root ))
     {
-        struct file_lock *lock = LIST_ENTRY( ptr, struct file_lock, inode_entry );
-        if (lock->start == lock->end) continue;
-        if (lock_overlaps( lock, start, end )) count++;
+        root->left = insert_lock_tree( root->left, lock );
+        if (root->left->priority > root->priority)  /* rotate right */
+        {
+            child = root->left;
+            root->left = child->right;
+            child->right = root;
+            update_lock_max_end( root );
+            root = child;
+        }
     }
+    else
+    {
+        root->right = insert_lock_tree( root->right, lock );
+        if (root->right->priority > root->priority)  /* rotate left */
+        {
+            child = root->right;
+            root->right = child->left;
+            child->left = root;
+            update_lock_max_end( root );
+            root = child;
+        }
+    }
+    update_lock_max_end( root );
+    return root;
+}
 
-    if (!count)  /* no locks at all, we can unlock everything */
+/* merge two subtrees where all the locks of the left one come first */
+static struct file_lock *merge_lock_trees( struct file_lock *left, struct file_lock *right )
+{
+    if (!left) return right;
+    if (!right) return left;
+
+    if (left->priority > right->priority)
     {
-        set_unix_lock( fd, start, end, F_UNLCK );
-        return;
+        left->right = merge_lock_trees( left->right, right );
+        update_lock_max_end( left );
+        return left;
     }
+    right->left = merge_lock_trees( left, right->left );
+    update_lock_max_end( right );
+    return right;
+}
 
-    /* allocate space for the list of holes */
-    /* max. number of holes is number of locks + 1 */
+/* remove a lock from the tree, returns the new root */
+static struct file_lock *remove_lock_tree( struct file_lock *root, struct file_lock *lock )
+{
+    assert( root );
 
-    if (!(buffer = malloc( sizeof(*buffer) * (count+1) ))) return;
-    first = buffer;
-    first->next  = NULL;
-    first->prev  = NULL;
-    first->start = start;
-    first->end   = end;
-    next = first + 1;
+    if (root == lock) return merge_lock_trees( lock->left, lock->right );
+    if (lock_before( lock, root )) root->left = remove_lock_tree( root->left, lock );
+    else root->right = remove_lock_tree( root->right, lock );
+    update_lock_max_end( root );
+    return root;
+}
 
-    /* build a sorted list of unlocked holes in the specified area */
+/* find a lock overlapping the interval [start;end) that conflicts with a new lock */
+static struct file_lock *find_conflicting_lock( struct file_lock *root, file_pos_t start,
+                                                file_pos_t end, int shared )
+{
+    struct file_lock *lock;
 
-    LIST_FOR_EACH( ptr, &fd->inode->locks )
+    while (lock_tree_reaches( root, start ))
     {
-        struct file_lock *lock = LIST_ENTRY( ptr, struct file_lock, inode_entry );
-        if (lock->start == lock->end) continue;
-        if (!lock_overlaps( lock, start, end )) continue;
+        if ((lock = find_conflicting_lock( root->left, start, end, shared ))) return lock;
+        if (end && root->start >= end) break;  /* all remaining locks start after the interval */
+        if (lock_overlaps( root, start, end ) && !(root->shared && shared)) return root;
+        root = root->right;
+    }
+    return NULL;
+}
 
-        /* go through all the holes touched by this lock */
-        for (cur = first; cur; cur = cur->next)
-        {
-            if (cur->end <= lock->start) continue; /* hole is before start of lock */
-            if (lock->end && cur->start >= lock->end) break;  /* hole is after end of lock */
+/* find a lock of the fd with the exact same range */
+static struct file_lock *find_fd_lock( struct file_lock *root, struct fd *fd,
+                                       file_pos_t start, file_pos_t end )
+{
+    struct file_lock *lock;
 
-            /* now we know that lock is overlapping hole */
+    while (root && root->start != start) root = (start < root->start) ? root->left : root->right;
+    if (!root) return NULL;
+    if (root->fd == fd && root->end == end) return root;
+    /* there can be other locks with the same start on both sides */
+    if ((lock = find_fd_lock( root->left, fd, start, end ))) return lock;
+    return find_fd_lock( root->right, fd, start, end );
+}
 
-            if (cur->start >= lock->start)  /* lock starts before hole, shrink from start */
-            {
-                cur->start = lock->end;
-                if (cur->start && cur->start < cur->end) break;  /* done with this lock */
-                /* now hole is empty, remove it */
-                if (cur->next) cur->next->prev = cur->prev;
-                if (cur->prev) cur->prev->next = cur->next;
-                else if (!(first = cur->next)) goto done;  /* no more holes at all */
-            }
-            else if (!lock->end || cur->end <= lock->end)  /* lock larger than hole, shrink from end */
-            {
-                cur->end = lock->start;
-                assert( cur->start < cur->end );
-            }
-            else  /* lock is in the middle of hole, split hole in two */
-            {
-                next->prev = cur;
-                next->next = cur->next;
-                cur->next = next;
-                next->start = lock->end;
-                next->end = cur->end;
-                cur->end = lock->start;
-                assert( next->start < next->end );
-                assert( cur->end < next->start );
-                next++;
-                break;  /* done with this lock */
-            }
+struct unlock_range
+{
+    struct fd   *fd;     /* fd to use for the Unix locks */
+    file_pos_t   pos;    /* start of the area not covered yet by the locks */
+    file_pos_t   end;    /* end of the area to unlock */
+};
+
+/* remove the Unix locks for the holes left by the locks of the tree, in start order */
+static void unlock_holes( struct file_lock *root, struct unlock_range *range )
+{
+    while (range->pos < range->end && lock_tree_reaches( root, range->pos ))
+    {
+        unlock_holes( root->left, range );
+        if (range->pos >= range->end || root->start >= range->end) return;
+        if (root->start != root->end)
+        {
+            /* each hole is unlocked with a single call, however many locks were removed in it */
+            if (root->start > range->pos) set_unix_lock( range->fd, range->pos, root->start, F_UNLCK );
+            if (lock_end( root ) > range->pos) range->pos = min( lock_end( root ), range->end );
         }
+        root = root->right;
     }
+}
 
-    /* clear Unix locks for all the holes */
+/* remove Unix locks for all bytes in the specified area that are no longer locked */
+static void remove_unix_locks( struct fd *fd, file_pos_t start, file_pos_t end )
+{
+    struct unlock_range range;
 
-    for (cur = first; cur; cur = cur->next)
-        set_unix_lock( fd, cur->start, cur->end, F_UNLCK );
+    if (!fd->inode) return;
+    if (!fd->fs_locks) return;
+    if (start == end || start > max_unix_offset) return;
+    if (!end || end > max_unix_offset) end = max_unix_offset + 1;
 
- done:
-    free( buffer );
+    range.fd  = fd;
+    range.pos = start;
+    range.end = end;
+    unlock_holes( fd->inode->locks, &range );
+    if (range.pos < range.end) set_unix_lock( fd, range.pos, range.end, F_UNLCK );
 }
 
 /* create a new lock on a fd */
@@ -1339,8 +1465,15 @@ static struct file_lock *add_lock( struct fd *fd, int shared, file_pos_t start,
         release_object( lock );
         return NULL;
     }
+    lock_priority_seed ^= lock_priority_seed << 13;
+    lock_priority_seed ^= lock_priority_seed >> 17;
+    lock_priority_seed ^= lock_priority_seed << 5;
+    lock->left     = NULL;
+    lock->right    = NULL;
+    lock->max_end  = lock_end( lock );
+    lock->priority = lock_priority_seed;
     list_add_head( &fd->locks, &lock->fd_entry );
-    list_add_head( &fd->inode->locks, &lock->inode_entry );
+    fd->inode->locks = insert_lock_tree( fd->inode->locks, lock );
     list_add_head( &lock->process->locks, &lock->proc_entry );
     return lock;
 }
@@ -1351,10 +1484,10 @@ static void remove_lock( struct file_lock *lock, int remove_unix )
     struct inode *inode = lock->fd->inode;
 
     list_remove( &lock->fd_entry );
-    list_remove( &lock->inode_entry );
+    inode->locks = remove_lock_tree( inode->locks, lock );
     list_remove( &lock->proc_entry );
     if (remove_unix) remove_unix_locks( lock->fd, lock->start, lock->end );
-    if (list_empty( &inode->locks )) inode_close_pending( inode, 1 );
+    if (!inode->locks) inode_close_pending( inode, 1 );
     lock->process = NULL;
     wake_up( &lock->obj, 0 );
     release_object( lock );
@@ -1363,12 +1496,37 @@ static void remove_lock( struct file_lock *lock, int remove_unix )
 /* remove all locks owned by a given process */
 void remove_process_locks( struct process *process )
 {
+    struct fd *fd = NULL;
+    file_pos_t start = 0, end = 0;
     struct list *ptr;
 
+    /* locks are removed from the Unix fd once for each run of locks on the same fd */
     while ((ptr = list_head( &process->locks )))
     {
         struct file_lock *lock = LIST_ENTRY( ptr, struct file_lock, proc_entry );
-        remove_lock( lock, 1 );  /* this removes it from the list */
+
+        if (lock->fd != fd)
+        {
+            if (fd)
+            {
+                remove_unix_locks( fd, start, end );
+                release_object( fd );
+            }
+            fd    = (struct fd *)grab_object( lock->fd );
+            start = lock->start;
+            end   = lock->end;
+        }
+        else
+        {
+            if (lock->start < start) start = lock->start;
+            if (end && (!lock->end || lock->end > end)) end = lock->end;
+        }
+        remove_lock( lock, 0 );  /* this removes it from the list */
+    }
+    if (fd)
+    {
+        remove_unix_locks( fd, start, end );
+        release_object( fd );
     }
 }
 
@@ -1392,7 +1550,7 @@ static void remove_fd_locks( struct fd *fd )
 /* returns handle to wait on */
 obj_handle_t lock_fd( struct fd *fd, file_pos_t start, file_pos_t count, int shared, int wait )
 {
-    struct list *ptr;
+    struct file_lock *lock;
     file_pos_t end = start + count;
 
     if (!fd->inode)  /* not a regular file */
@@ -1409,12 +1567,8 @@ obj_handle_t lock_fd( struct fd *fd, file_pos_t start, file_pos_t count, int sha
     }
 
     /* check if another lock on that file overlaps the area */
-    LIST_FOR_EACH( ptr, &fd->inode->locks )
+    if ((lock = find_conflicting_lock( fd->inode->locks, start, end, shared )))
     {
-        struct file_lock *lock = LIST_ENTRY( ptr, struct file_lock, inode_entry );
-        if (!lock_overlaps( lock, start, end )) continue;
-        if (lock->shared && shared) continue;
-        /* found one */
         if (!wait)
         {
             set_error( STATUS_FILE_LOCK_CONFLICT );
@@ -1437,20 +1591,14 @@ obj_handle_t lock_fd( struct fd *fd, file_pos_t start, file_pos_t count, int sha
 /* remove a lock on an fd */
 void unlock_fd( struct fd *fd, file_pos_t start, file_pos_t count )
 {
-    struct list *ptr;
+    struct file_lock *lock;
     file_pos_t end = start + count;
 
     /* find an existing lock with the exact same parameters */
-    LIST_FOR_EACH( ptr, &fd->locks )
-    {
-        struct file_lock *lock = LIST_ENTRY( ptr, struct file_lock, fd_entry );
-        if ((lock->start == start) && (lock->end == end))
-        {
-            remove_lock( lock, 1 );
-            return;
-        }
-    }
-    set_error( STATUS_FILE_LOCK_CONFLICT );
+    if (fd->inode && (lock = find_fd_lock( fd->inode->locks, fd, start, end )))
+        remove_lock( lock, 1 );
+    else
+        set_error( STATUS_FILE_LOCK_CONFLICT );
 }
 
 
@@ -41,18 +41,31 @@
 
 struct handle_entry
 {
-    struct object *ptr;       /* object */
-    unsigned int   access;    /* access rights */
+    struct object *ptr;       /* object, NULL if the entry is free */
+    unsigned int   access;    /* access rights, or index of the next free entry if free */
+};
+
+/* index of the handles of a given object type, kept sorted by table index */
+struct handle_type_index
+{
+    const struct object_ops *ops;      /* object type */
+    int                      count;    /* number of handles in the index */
+    int                      size;     /* allocated size of the indices array */
+    int                     *indices;  /* table indices of the handles */
 };
 
 struct handle_table
 {
-    struct object        obj;         /* object header */
-    struct process      *process;     /* process owning this table */
-    int                  count;       /* number of allocated entries */
-    int                  last;        /* last used entry */
-    int                  free;        /* first entry that may be free */
-    struct handle_entry *entries;     /* handle entries */
+    struct object             obj;         /* object header */
+    struct process           *process;     /* process owning this table */
+    int                       count;       /* number of initialized entries */
+    int                       last;        /* last used entry */
+    int                       free;        /* first entry of the free list, -1 if empty */
+    int                       nb_chunks;   /* number of allocated chunks */
+    int                       max_chunks;  /* allocated size of the chunks array */
+    struct handle_entry     **chunks;      /* handle entries, in chunks that never move */
+    int                       nb_types;    /* number of type indexes */
+    struct handle_type_index *types;       /* indexes of the handles of some object types */
 };
 
 static struct handle_table *global_table;
@@ -63,9 +76,12 @@ static struct handle_table *global_table;
 #define RESERVED_CLOSE_PROTECT (HANDLE_FLAG_PROTECT_FROM_CLOSE << RESERVED_SHIFT)
 #define RESERVED_ALL           (RESERVED_INHERIT | RESERVED_CLOSE_PROTECT)
 
-#define MIN_HANDLE_ENTRIES  32
 #define MAX_HANDLE_ENTRIES  0x00ffffff
 
+/* the entries are allocated in chunks so that growing the table doesn't move them */
+#define HANDLE_CHUNK_SHIFT  8
+#define HANDLE_CHUNK_SIZE   (1 << HANDLE_CHUNK_SHIFT)
+
 
 /* handle to table index conversion */
 
@@ -121,21 +137,27 @@ static const struct object_ops handle_table_ops =
     handle_table_destroy             /* destroy */
 };
 
+/* return the entry at a given index of the table */
+static inline struct handle_entry *get_entry( struct handle_table *table, int index )
+{
+    return &table->chunks[index >> HANDLE_CHUNK_SHIFT][index & (HANDLE_CHUNK_SIZE - 1)];
+}
+
 /* dump a handle table */
 static void handle_table_dump( struct object *obj, int verbose )
 {
     int i;
     struct handle_table *table = (struct handle_table *)obj;
-    struct handle_entry *entry = table->entries;
+    struct handle_entry *entry;
 
     assert( obj->ops == &handle_table_ops );
 
     fprintf( stderr, "Handle table last=%d count=%d process=%p\n",
              table->last, table->count, table->process );
     if (!verbose) return;
-    entry = table->entries;
-    for (i = 0; i <= table->last; i++, entry++)
+    for (i = 0; i <= table->last; i++)
     {
+        entry = get_entry( table, i );
         if (!entry->ptr) continue;
         fprintf( stderr, "    %04x: %p %08x ",
                  index_to_handle(i), entry->ptr, entry->access );
@@ -155,20 +177,25 @@ static void handle_table_destroy( struct object *obj )
     /* first notify all objects that handles are being closed */
     if (table->process)
     {
-        for (i = 0, entry = table->entries; i <= table->last; i++, entry++)
+        for (i = 0; i <= table->last; i++)
         {
-            struct object *obj = entry->ptr;
+            struct object *obj = get_entry( table, i )->ptr;
             if (obj) obj->ops->close_handle( obj, table->process, index_to_handle(i) );
         }
     }
 
-    for (i = 0, entry = table->entries; i <= table->last; i++, entry++)
+    for (i = 0; i <= table->last; i++)
     {
-        struct object *obj = entry->ptr;
+        struct object *obj;
+        entry = get_entry( table, i );
+        obj = entry->ptr;
         entry->ptr = NULL;
         if (obj) release_object( obj );
     }
-    free( table->entries );
+    for (i = 0; i < table->nb_chunks; i++) free( table->chunks[i] );
+    free( table->chunks );
+    for (i = 0; i < table->nb_types; i++) free( table->types[i].indices );
+    free( table->types );
 }
 
 /* close all the process handles and free the handle table */
@@ -180,60 +207,182 @@ void close_process_handles( struct process *process )
     if (table) release_object( table );
 }
 
+/* make sure the table has room for at least count entries */
+static int reserve_handle_entries( struct handle_table *table, int count )
+{
+    int nb_chunks = (count + HANDLE_CHUNK_SIZE - 1) >> HANDLE_CHUNK_SHIFT;
+
+    if (count > MAX_HANDLE_ENTRIES) goto error;
+    if (nb_chunks > table->max_chunks)
+    {
+        int max_chunks = max( nb_chunks, table->max_chunks * 2 );
+        struct handle_entry **new_chunks;
+
+        if (!(new_chunks = realloc( table->chunks, max_chunks * sizeof(*new_chunks) ))) goto error;
+        table->chunks = new_chunks;
+        table->max_chunks = max_chunks;
+    }
+    while (table->nb_chunks < nb_chunks)
+    {
+        if (!(table->chunks[table->nb_chunks] = malloc( HANDLE_CHUNK_SIZE * sizeof(struct handle_entry) )))
+            goto error;
+        table->nb_chunks++;
+    }
+    return 1;
+
+error:
+    set_error( STATUS_INSUFFICIENT_RESOURCES );
+    return 0;
+}
+
 /* allocate a new handle table */
 struct handle_table *alloc_handle_table( struct process *process, int count )
 {
     struct handle_table *table;
 
-    if (count < MIN_HANDLE_ENTRIES) count = MIN_HANDLE_ENTRIES;
     if (!(table = alloc_object( &handle_table_ops )))
         return NULL;
-    table->process = process;
-    table->count   = count;
-    table->last    = -1;
-    table->free    = 0;
-    if ((table->entries = mem_alloc( count * sizeof(*table->entries) ))) return table;
+    table->process    = process;
+    table->count      = 0;
+    table->last       = -1;
+    table->free       = -1;
+    table->nb_chunks  = 0;
+    table->max_chunks = 0;
+    table->chunks     = NULL;
+    table->nb_types   = 0;
+    table->types      = NULL;
+    if (reserve_handle_entries( table, max( count, 1 ))) return table;
     release_object( table );
     return NULL;
 }
 
-/* grow a handle table */
-static int grow_handle_table( struct handle_table *table )
+/* return the index of the given object type in the table, or NULL if it isn't indexed */
+static struct handle_type_index *get_type_index( struct handle_table *table, const struct object_ops *ops )
 {
-    struct handle_entry *new_entries;
-    int count = min( table->count * 2, MAX_HANDLE_ENTRIES );
+    int i;
 
-    if (count == table->count ||
-        !(new_entries = realloc( table->entries, count * sizeof(struct handle_entry) )))
+    for (i = 0; i < table->nb_types; i++) if (table->types[i].ops == ops) return &table->types[i];
+    return NULL;
+}
+
+/* return the position of the first index entry not below the given table index */
+static int find_type_index_pos( const struct handle_type_index *type, int index )
+{
+    int min = 0, max = type->count;
+
+    while (min < max)
     {
-        set_error( STATUS_INSUFFICIENT_RESOURCES );
-        return 0;
+        int pos = (min + max) / 2;
+        if (type->indices[pos] < index) min = pos + 1;
+        else max = pos;
     }
-    table->entries = new_entries;
-    table->count   = count;
-    return 1;
+    return min;
 }
 
-/* allocate the first free entry in the handle table */
+/* add a handle to the index of its object type, if there is one */
+/* on failure the index is dropped, the queries then fall back to scanning the table */
+static void add_to_type_index( struct handle_table *table, int index, const struct object_ops *ops )
+{
+    struct handle_type_index *type = get_type_index( table, ops );
+    int pos;
+
+    if (!type) return;
+    if (type->count == type->size)
+    {
+        int size = max( type->size * 2, 16 );
+        int *new_indices;
+
+        if (!(new_indices = realloc( type->indices, size * sizeof(*new_indices) )))
+        {
+            free( type->indices );
+            *type = table->types[--table->nb_types];
+            return;
+        }
+        type->indices = new_indices;
+        type->size = size;
+    }
+    pos = find_type_index_pos( type, index );
+    memmove( type->indices + pos + 1, type->indices + pos, (type->count - pos) * sizeof(int) );
+    type->indices[pos] = index;
+    type->count++;
+}
+
+/* remove a handle from the index of its object type, if there is one */
+static void remove_from_type_index( struct handle_table *table, int index, const struct object_ops *ops )
+{
+    struct handle_type_index *type = get_type_index( table, ops );
+    int pos;
+
+    if (!type) return;
+    pos = find_type_index_pos( type, index );
+    if (pos == type->count || type->indices[pos] != index) return;
+    type->count--;
+    memmove( type->indices + pos, type->indices + pos + 1, (type->count - pos) * sizeof(int) );
+}
+
+/* build the index of the handles of the given object type */
+/* the indexes are only built for the types that are queried, and then kept up to date */
+static struct handle_type_index *build_type_index( struct handle_table *table, const struct object_ops *ops )
+{
+    struct handle_type_index *type, *new_types;
+    int i;
+
+    if ((type = get_type_index( table, ops ))) return type;
+
+    if (!(new_types = realloc( table->types, (table->nb_types + 1) * sizeof(*new_types) ))) return NULL;
+    table->types = new_types;
+    type = &table->types[table->nb_types++];
+    type->ops     = ops;
+    type->count   = 0;
+    type->size    = 0;
+    type->indices = NULL;
+
+    for (i = 0; i <= table->last; i++)
+    {
+        struct handle_entry *entry = get_entry( table, i );
+        if (!entry->ptr || entry->ptr->ops != ops) continue;
+        add_to_type_index( table, i, ops );
+        if (!(type = get_type_index( table, ops ))) return NULL;  /* out of memory */
+    }
+    return type;
+}
+
+/* allocate a free entry in the handle table */
 static obj_handle_t alloc_entry( struct handle_table *table, void *obj, unsigned int access )
 {
-    struct handle_entry *entry = table->entries + table->free;
+    struct handle_entry *entry;
     int i;
 
-    for (i = table->free; i <= table->last; i++, entry++) if (!entry->ptr) goto found;
-    if (i >= table->count)
+    if ((i = table->free) != -1)
     {
-        if (!grow_handle_table( table )) return 0;
-        entry = table->entries + i;  /* the entries may have moved */
+        entry = get_entry( table, i );
+        table->free = entry->access;
     }
-    table->last = i;
- found:
-    table->free = i + 1;
+    else
+    {
+        if (!reserve_handle_entries( table, table->count + 1 )) return 0;
+        i = table->count++;
+        entry = get_entry( table, i );
+    }
+    if (i > table->last) table->last = i;
     entry->ptr    = grab_object( obj );
     entry->access = access;
+    if (table->nb_types) add_to_type_index( table, i, entry->ptr->ops );
     return index_to_handle(i);
 }
 
+/* put an entry back on the free list */
+static void free_entry( struct handle_table *table, int index )
+{
+    struct handle_entry *entry = get_entry( table, index );
+
+    if (table->nb_types) remove_from_type_index( table, index, entry->ptr->ops );
+    entry->ptr = NULL;
+    entry->access = table->free;
+    table->free = index;
+    while (table->last >= 0 && !get_entry( table, table->last )->ptr) table->last--;
+}
+
 /* allocate a handle for an object, incrementing its refcount */
 /* return the handle, or 0 on error */
 obj_handle_t alloc_handle_no_access_check( struct process *process, void *ptr, unsigned int access, unsigned int attr )
@@ -299,32 +448,11 @@ static struct handle_entry *get_handle( struct process *process, obj_handle_t ha
     index = handle_to_index( handle );
     if (index < 0) return NULL;
     if (index > table->last) return NULL;
-    entry = table->entries + index;
+    entry = get_entry( table, index );
     if (!entry->ptr) return NULL;
     return entry;
 }
 
-/* attempt to shrink a table */
-static void shrink_handle_table( struct handle_table *table )
-{
-    struct handle_entry *entry = table->entries + table->last;
-    struct handle_entry *new_entries;
-    int count = table->count;
-
-    while (table->last >= 0)
-    {
-        if (entry->ptr) break;
-        table->last--;
-        entry--;
-    }
-    if (table->last >= count / 4) return;  /* no need to shrink */
-    if (count < MIN_HANDLE_ENTRIES * 2) return;  /* too small to shrink */
-    count /= 2;
-    if (!(new_entries = realloc( table->entries, count * sizeof(*new_entries) ))) return;
-    table->count   = count;
-    table->entries = new_entries;
-}
-
 /* copy the handle table of the parent process */
 /* return 1 if OK, 0 on error */
 struct handle_table *copy_handle_table( struct process *process, struct process *parent )
@@ -336,22 +464,32 @@ struct handle_table *copy_handle_table( struct process *process, struct process
     assert( parent_table );
     assert( parent_table->obj.ops == &handle_table_ops );
 
-    if (!(table = (struct handle_table *)alloc_handle_table( process, parent_table->count )))
+    if (!(table = (struct handle_table *)alloc_handle_table( process, parent_table->last + 1 )))
         return NULL;
 
-    if ((table->last = parent_table->last) >= 0)
+    /* the handle values must be preserved, so keep the inherited entries at the same index */
+    for (i = 0; i <= parent_table->last; i++)
     {
-        struct handle_entry *ptr = table->entries;
-        memcpy( ptr, parent_table->entries, (table->last + 1) * sizeof(struct handle_entry) );
-        for (i = 0; i <= table->last; i++, ptr++)
+        struct handle_entry *ptr = get_entry( table, i );
+
+        *ptr = *get_entry( parent_table, i );
+        if (ptr->ptr && (ptr->access & RESERVED_INHERIT))
         {
-            if (!ptr->ptr) continue;
-            if (ptr->access & RESERVED_INHERIT) grab_object( ptr->ptr );
-            else ptr->ptr = NULL; /* don't inherit this entry */
+            grab_object( ptr->ptr );
+            table->last = i;
         }
+        else ptr->ptr = NULL; /* don't inherit this entry */
+    }
+    table->count = table->last + 1;
+
+    /* chain the holes in increasing order, so that they are reused first */
+    for (i = table->last; i >= 0; i--)
+    {
+        struct handle_entry *ptr = get_entry( table, i );
+        if (ptr->ptr) continue;
+        ptr->access = table->free;
+        table->free = i;
     }
-    /* attempt to shrink the table */
-    shrink_handle_table( table );
     return table;
 }
 
@@ -366,10 +504,15 @@ unsigned int close_handle( struct process *process, obj_handle_t handle )
     if (entry->access & RESERVED_CLOSE_PROTECT) return STATUS_HANDLE_NOT_CLOSABLE;
     obj = entry->ptr;
     if (!obj->ops->close_handle( obj, process, handle )) return STATUS_HANDLE_NOT_CLOSABLE;
-    entry->ptr = NULL;
-    table = handle_is_global(handle) ? global_table : process->handles;
-    if (entry < table->entries + table->free) table->free = entry - table->entries;
-    if (entry == table->entries + table->last) shrink_handle_table( table );
+    /* the client can't know that the handle value is no longer valid */
+    if (!current || process != current->process) sync_shm_handle_closed( process );
+    if (handle_is_global(handle))
+    {
+        table = global_table;
+        handle = handle_global_to_local(handle);
+    }
+    else table = process->handles;
+    free_entry( table, handle_to_index(handle) );
     release_object( obj );
     return STATUS_SUCCESS;
 }
@@ -433,13 +576,23 @@ unsigned int get_handle_access( struct process *process, obj_handle_t handle )
 obj_handle_t find_inherited_handle( struct process *process, const struct object_ops *ops )
 {
     struct handle_table *table = process->handles;
+    struct handle_type_index *type;
     struct handle_entry *ptr;
     int i;
 
     if (!table) return 0;
 
-    for (i = 0, ptr = table->entries; i <= table->last; i++, ptr++)
+    if ((type = build_type_index( table, ops )))
+    {
+        for (i = 0; i < type->count; i++)
+            if (get_entry( table, type->indices[i] )->access & RESERVED_INHERIT)
+                return index_to_handle( type->indices[i] );
+        return 0;
+    }
+
+    for (i = 0; i <= table->last; i++)
     {
+        ptr = get_entry( table, i );
         if (!ptr->ptr) continue;
         if (ptr->ptr->ops != ops) continue;
         if (ptr->access & RESERVED_INHERIT) return index_to_handle(i);
@@ -453,13 +606,24 @@ obj_handle_t enumerate_handles( struct process *process, const struct object_ops
                                 unsigned int *index )
 {
     struct handle_table *table = process->handles;
-    unsigned int i;
+    struct handle_type_index *type;
     struct handle_entry *entry;
+    int i;
 
     if (!table) return 0;
 
-    for (i = *index, entry = &table->entries[i]; i <= table->last; i++, entry++)
+    if ((type = build_type_index( table, ops )))
+    {
+        int pos = find_type_index_pos( type, *index );
+
+        if (pos == type->count) return 0;
+        *index = type->indices[pos] + 1;
+        return index_to_handle( type->indices[pos] );
+    }
+
+    for (i = *index; i <= table->last; i++)
     {
+        entry = get_entry( table, i );
         if (!entry->ptr) continue;
         if (entry->ptr->ops != ops) continue;
         *index = i + 1;
@@ -26,6 +26,7 @@
 #include <signal.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
 #include <unistd.h>
 #ifdef HAVE_GETOPT_H
@@ -42,7 +43,9 @@
 int debug_level = 0;
 int foreground = 0;
 timeout_t master_socket_timeout = 3 * -TICKS_PER_SEC;  /* master socket timeout, default is 3 seconds */
+timeout_t notify_delay = 0;  /* delay for coalescing directory change notifications, default is none */
 const char *server_argv0;
+static int convert_format = -1;  /* registry format to convert to, or -1 */
 
 /* parse-line args */
 
@@ -50,10 +53,12 @@ static void usage(void)
 {
     fprintf(stderr, "Usage: %s [options]\n\n", server_argv0);
     fprintf(stderr, "Options:\n");
+    fprintf(stderr, "   -c f,  --convert-registry=f  convert the registry to format f (text or binary)\n");
     fprintf(stderr, "   -d[n], --debug[=n]       set debug level to n or +1 if n not specified\n");
     fprintf(stderr, "   -f,    --foreground      remain in the foreground for debugging\n");
     fprintf(stderr, "   -h,    --help            display this help message\n");
     fprintf(stderr, "   -k[n], --kill[=n]        kill the current wineserver, optionally with signal n\n");
+    fprintf(stderr, "   -n n,  --notify-delay=n  delay directory change notifications by n milliseconds\n");
     fprintf(stderr, "   -p[n], --persistent[=n]  make server persistent, optionally for n seconds\n");
     fprintf(stderr, "   -v,    --version         display version information and exit\n");
     fprintf(stderr, "   -w,    --wait            wait until the current wineserver terminates\n");
@@ -66,10 +71,12 @@ static void parse_args( int argc, char *argv[] )
 
     static struct option long_options[] =
     {
+        {"convert-registry", 1, NULL, 'c'},
         {"debug",       2, NULL, 'd'},
         {"foreground",  0, NULL, 'f'},
         {"help",        0, NULL, 'h'},
         {"kill",        2, NULL, 'k'},
+        {"notify-delay",1, NULL, 'n'},
         {"persistent",  2, NULL, 'p'},
         {"version",     0, NULL, 'v'},
         {"wait",        0, NULL, 'w'},
@@ -78,10 +85,20 @@ static void parse_args( int argc, char *argv[] )
 
     server_argv0 = argv[0];
 
-    while ((optc = getopt_long( argc, argv, "d::fhk::p::vw", long_options, NULL )) != -1)
+    while ((optc = getopt_long( argc, argv, "c:d::fhk::n:p::vw", long_options, NULL )) != -1)
     {
         switch(optc)
         {
+            case 'c':
+                if (!strcmp( optarg, "text" )) convert_format = 0;
+                else if (!strcmp( optarg, "binary" )) convert_format = 1;
+                else
+                {
+                    usage();
+                    exit(1);
+                }
+                foreground = 1;
+                break;
             case 'd':
                 if (optarg && isdigit(*optarg))
                     debug_level = atoi( optarg );
@@ -101,6 +118,9 @@ static void parse_args( int argc, char *argv[] )
                 else
                     ret = kill_lock_owner(-1);
                 exit( !ret );
+            case 'n':
+                notify_delay = (timeout_t)atoi( optarg ) * -(TICKS_PER_SEC / 1000);
+                break;
             case 'p':
                 if (optarg && isdigit(*optarg))
                     master_socket_timeout = (timeout_t)atoi( optarg ) * -TICKS_PER_SEC;
@@ -125,9 +145,19 @@ static void sigterm_handler( int signum )
     exit(1);  /* make sure atexit functions get called */
 }
 
+/* the server is usually started automatically, so also allow setting the delay from the environment */
+static void get_notify_delay_from_env(void)
+{
+    const char *delay = getenv( "WINESERVER_NOTIFY_DELAY" );
+
+    if (delay && isdigit(*delay))
+        notify_delay = (timeout_t)atoi( delay ) * -(TICKS_PER_SEC / 1000);
+}
+
 int main( int argc, char *argv[] )
 {
     setvbuf( stderr, NULL, _IOLBF, 0 );
+    get_notify_delay_from_env();
     parse_args( argc, argv );
 
     /* setup temporary handlers before the real signal initialization is done */
@@ -145,6 +175,7 @@ int main( int argc, char *argv[] )
     init_signals();
     init_directories();
     init_registry();
+    if (convert_format != -1) exit( !convert_registry( convert_format ));
     main_loop();
     return 0;
 }
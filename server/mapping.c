@@ -26,6 +26,9 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
 #include <unistd.h>
 
 #include "ntstatus.h"
@@ -162,7 +165,7 @@ static int grow_file( int unix_fd, file_pos_t new_size )
 }
 
 /* create a temp file for anonymous mappings */
-static int create_temp_file( file_pos_t size )
+int create_temp_file( file_pos_t size )
 {
     char tmpfn[16];
     int fd;
@@ -526,6 +529,40 @@ static struct object *create_mapping( struct directory *root, const struct unico
     return NULL;
 }
 
+/* create an anonymous mapping that is also mapped read-write in the server */
+struct object *create_server_mapping( mem_size_t size, void **ptr )
+{
+    static const struct unicode_str empty_name;
+    struct mapping *mapping;
+    int unix_fd;
+
+    if (!(mapping = (struct mapping *)create_mapping( NULL, &empty_name, 0, size,
+                                                      VPROT_READ | VPROT_WRITE | VPROT_COMMITTED, 0, NULL )))
+        return NULL;
+
+    if ((unix_fd = get_unix_fd( mapping->fd )) == -1) goto error;
+    if ((*ptr = mmap( NULL, mapping->size, PROT_READ | PROT_WRITE, MAP_SHARED, unix_fd, 0 )) == MAP_FAILED)
+    {
+        file_set_error();
+        goto error;
+    }
+    return &mapping->obj;
+
+ error:
+    release_object( mapping );
+    return NULL;
+}
+
+/* release a mapping created by create_server_mapping */
+void release_server_mapping( struct object *obj, void *ptr )
+{
+    struct mapping *mapping = (struct mapping *)obj;
+
+    assert( obj->ops == &mapping_ops );
+    munmap( ptr, mapping->size );
+    release_object( mapping );
+}
+
 static void mapping_dump( struct object *obj, int verbose )
 {
     struct mapping *mapping = (struct mapping *)obj;
@@ -480,7 +480,7 @@ static void named_pipe_device_destroy( struct object *obj )
     struct named_pipe_device *device = (struct named_pipe_device*)obj;
     assert( obj->ops == &named_pipe_device_ops );
     if (device->fd) release_object( device->fd );
-    free( device->pipes );
+    free_namespace( device->pipes );
 }
 
 static enum server_fd_type named_pipe_device_get_fd_type( struct fd *fd )
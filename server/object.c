@@ -43,18 +43,30 @@
 struct object_name
 {
     struct list         entry;           /* entry in the hash list */
+    struct namespace   *namespace;       /* namespace containing this name */
     struct object      *obj;             /* object owning this name */
     struct object      *parent;          /* parent object */
+    unsigned int        hash;            /* hash of the case-folded name */
     data_size_t         len;             /* name length in bytes */
     WCHAR               name[1];
 };
 
+/* The hash table is doubled when the average chain length reaches 2. To avoid
+ * stalling the server on large namespaces, the entries of the old table are
+ * moved a few buckets at a time on each insertion or removal, and lookups
+ * search both tables until the move is complete. */
 struct namespace
 {
-    unsigned int        hash_size;       /* size of hash table */
-    struct list         names[1];        /* array of hash entry lists */
+    unsigned int        hash_size;       /* size of hash table, a power of 2 */
+    unsigned int        count;           /* number of names in the namespace */
+    struct list        *names;           /* array of hash entry lists */
+    unsigned int        old_size;        /* size of the table being moved, 0 if none */
+    unsigned int        old_pos;         /* next bucket of the old table to move */
+    struct list        *old_names;       /* old array of hash entry lists */
 };
 
+#define NAMESPACE_REHASH_STEP 8  /* number of old buckets moved on each insertion or removal */
+
 
 #ifdef DEBUG_OBJECTS
 static struct list object_list = LIST_INIT(object_list);
@@ -120,12 +132,60 @@ void *memdup( const void *data, size_t len )
 
 /*****************************************************************/
 
-static int get_name_hash( const struct namespace *namespace, const WCHAR *name, data_size_t len )
+/* compute the hash of a name, case-insensitively */
+static unsigned int get_name_hash( const WCHAR *name, data_size_t len )
 {
-    WCHAR hash = 0;
+    unsigned int hash = 2166136261u;
+
     len /= sizeof(WCHAR);
-    while (len--) hash ^= tolowerW(*name++);
-    return hash % namespace->hash_size;
+    while (len--)
+    {
+        hash ^= tolowerW(*name++);
+        hash *= 16777619;
+    }
+    return hash;
+}
+
+/* move some of the entries of the old hash table to the new one */
+static void rehash_namespace( struct namespace *namespace, unsigned int count )
+{
+    struct list *ptr;
+
+    while (namespace->old_size && count--)
+    {
+        struct list *bucket = &namespace->old_names[namespace->old_pos];
+
+        while ((ptr = list_head( bucket )))
+        {
+            struct object_name *name = LIST_ENTRY( ptr, struct object_name, entry );
+            list_remove( &name->entry );
+            list_add_tail( &namespace->names[name->hash & (namespace->hash_size - 1)], &name->entry );
+        }
+        if (++namespace->old_pos == namespace->old_size)
+        {
+            free( namespace->old_names );
+            namespace->old_names = NULL;
+            namespace->old_size = 0;
+        }
+    }
+}
+
+/* double the size of the hash table once it gets too full */
+static void grow_namespace( struct namespace *namespace )
+{
+    struct list *names;
+    unsigned int i, size;
+
+    if (namespace->old_size) return;  /* still moving the previous table */
+    if (namespace->count < 2 * namespace->hash_size) return;
+    size = namespace->hash_size * 2;
+    if (!(names = malloc( size * sizeof(*names) ))) return;  /* keep the current table */
+    for (i = 0; i < size; i++) list_init( &names[i] );
+    namespace->old_names = namespace->names;
+    namespace->old_size  = namespace->hash_size;
+    namespace->old_pos   = 0;
+    namespace->names     = names;
+    namespace->hash_size = size;
 }
 
 /* allocate a name for an object */
@@ -136,7 +196,9 @@ static struct object_name *alloc_name( const struct unicode_str *name )
     if ((ptr = mem_alloc( sizeof(*ptr) + name->len - sizeof(ptr->name) )))
     {
         ptr->len = name->len;
+        ptr->hash = get_name_hash( name->str, name->len );
         ptr->parent = NULL;
+        ptr->namespace = NULL;
         memcpy( ptr->name, name->str, name->len );
     }
     return ptr;
@@ -147,6 +209,11 @@ static void free_name( struct object *obj )
 {
     struct object_name *ptr = obj->name;
     list_remove( &ptr->entry );
+    if (ptr->namespace)
+    {
+        ptr->namespace->count--;
+        rehash_namespace( ptr->namespace, NAMESPACE_REHASH_STEP );
+    }
     if (ptr->parent) release_object( ptr->parent );
     free( ptr );
 }
@@ -155,11 +222,13 @@ static void free_name( struct object *obj )
 static void set_object_name( struct namespace *namespace,
                              struct object *obj, struct object_name *ptr )
 {
-    int hash = get_name_hash( namespace, ptr->name, ptr->len );
-
-    list_add_head( &namespace->names[hash], &ptr->entry );
+    rehash_namespace( namespace, NAMESPACE_REHASH_STEP );
+    list_add_head( &namespace->names[ptr->hash & (namespace->hash_size - 1)], &ptr->entry );
+    ptr->namespace = namespace;
     ptr->obj = obj;
     obj->name = ptr;
+    namespace->count++;
+    grow_namespace( namespace );
 }
 
 /* get the name of an existing object */
@@ -319,19 +388,15 @@ void release_object( void *ptr )
     }
 }
 
-/* find an object by its name; the refcount is incremented */
-struct object *find_object( const struct namespace *namespace, const struct unicode_str *name,
-                            unsigned int attributes )
+/* find a name in a hash bucket */
+static struct object *find_object_in_list( const struct list *list, const struct unicode_str *name,
+                                           unsigned int hash, unsigned int attributes )
 {
-    const struct list *list;
-    struct list *p;
+    const struct object_name *ptr;
 
-    if (!name || !name->len) return NULL;
-
-    list = &namespace->names[ get_name_hash( namespace, name->str, name->len ) ];
-    LIST_FOR_EACH( p, list )
+    LIST_FOR_EACH_ENTRY( ptr, list, const struct object_name, entry )
     {
-        const struct object_name *ptr = LIST_ENTRY( p, struct object_name, entry );
+        if (ptr->hash != hash) continue;
         if (ptr->len != name->len) continue;
         if (attributes & OBJ_CASE_INSENSITIVE)
         {
@@ -347,15 +412,45 @@ struct object *find_object( const struct namespace *namespace, const struct unic
     return NULL;
 }
 
+/* find an object by its name; the refcount is incremented */
+struct object *find_object( const struct namespace *namespace, const struct unicode_str *name,
+                            unsigned int attributes )
+{
+    struct object *obj;
+    unsigned int hash;
+
+    if (!name || !name->len) return NULL;
+
+    hash = get_name_hash( name->str, name->len );
+    if ((obj = find_object_in_list( &namespace->names[hash & (namespace->hash_size - 1)],
+                                    name, hash, attributes )))
+        return obj;
+    if (namespace->old_size)
+        return find_object_in_list( &namespace->old_names[hash & (namespace->old_size - 1)],
+                                    name, hash, attributes );
+    return NULL;
+}
+
 /* find an object by its index; the refcount is incremented */
 struct object *find_object_index( const struct namespace *namespace, unsigned int index )
 {
+    const struct object_name *ptr;
     unsigned int i;
 
-    /* FIXME: not efficient at all */
+    if (index >= namespace->count)
+    {
+        set_error( STATUS_NO_MORE_ENTRIES );
+        return NULL;
+    }
+    for (i = namespace->old_pos; i < namespace->old_size; i++)
+    {
+        LIST_FOR_EACH_ENTRY( ptr, &namespace->old_names[i], const struct object_name, entry )
+        {
+            if (!index--) return grab_object( ptr->obj );
+        }
+    }
     for (i = 0; i < namespace->hash_size; i++)
     {
-        const struct object_name *ptr;
         LIST_FOR_EACH_ENTRY( ptr, &namespace->names[i], const struct object_name, entry )
         {
             if (!index--) return grab_object( ptr->obj );
@@ -369,17 +464,51 @@ struct object *find_object_index( const struct namespace *namespace, unsigned in
 struct namespace *create_namespace( unsigned int hash_size )
 {
     struct namespace *namespace;
-    unsigned int i;
+    unsigned int i, size = 8;
 
-    namespace = mem_alloc( sizeof(*namespace) + (hash_size - 1) * sizeof(namespace->names[0]) );
-    if (namespace)
+    while (size < hash_size) size *= 2;
+    if (!(namespace = mem_alloc( sizeof(*namespace) ))) return NULL;
+    if (!(namespace->names = mem_alloc( size * sizeof(*namespace->names) )))
     {
-        namespace->hash_size      = hash_size;
-        for (i = 0; i < hash_size; i++) list_init( &namespace->names[i] );
+        free( namespace );
+        return NULL;
     }
+    namespace->hash_size = size;
+    namespace->count     = 0;
+    namespace->old_size  = 0;
+    namespace->old_pos   = 0;
+    namespace->old_names = NULL;
+    for (i = 0; i < size; i++) list_init( &namespace->names[i] );
     return namespace;
 }
 
+/* detach the remaining names of a hash bucket from their namespace */
+static void detach_names( struct list *list )
+{
+    struct list *ptr;
+
+    while ((ptr = list_head( list )))
+    {
+        struct object_name *name = LIST_ENTRY( ptr, struct object_name, entry );
+        list_remove( &name->entry );
+        list_init( &name->entry );
+        name->namespace = NULL;
+    }
+}
+
+/* free a namespace */
+void free_namespace( struct namespace *namespace )
+{
+    unsigned int i;
+
+    if (!namespace) return;
+    for (i = namespace->old_pos; i < namespace->old_size; i++) detach_names( &namespace->old_names[i] );
+    for (i = 0; i < namespace->hash_size; i++) detach_names( &namespace->names[i] );
+    free( namespace->old_names );
+    free( namespace->names );
+    free( namespace );
+}
+
 /* functions for unimplemented/default object operations */
 
 struct object_type *no_get_type( struct object *obj )
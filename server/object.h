@@ -124,6 +124,7 @@ extern void *create_named_object( struct namespace *namespace, const struct obje
 extern void unlink_named_object( struct object *obj );
 extern void make_object_static( struct object *obj );
 extern struct namespace *create_namespace( unsigned int hash_size );
+extern void free_namespace( struct namespace *namespace );
 /* grab/release_object can take any pointer, but you better make sure */
 /* that the thing pointed to starts with a struct object... */
 extern struct object *grab_object( void *obj );
@@ -183,12 +184,29 @@ extern void debug_exit_thread( struct thread *thread );
 /* mapping functions */
 
 extern int get_page_size(void);
+extern int create_temp_file( file_pos_t size );
+extern struct object *create_server_mapping( mem_size_t size, void **ptr );
+extern void release_server_mapping( struct object *obj, void *ptr );
+
+/* synchronization shared memory functions */
+
+struct sync_shm;
+extern int alloc_sync_shm_entry( struct process *process, enum sync_shm_type type,
+                                 unsigned int count, unsigned int max, struct sync_shm **ret );
+extern void free_sync_shm_entry( struct sync_shm *shm, unsigned int index );
+extern struct sync_shm_entry *get_sync_shm_entry( struct sync_shm *shm, unsigned int index );
+extern unsigned int sync_shm_set_count( struct sync_shm_entry *entry, unsigned int count );
+extern unsigned int sync_shm_add_count( struct sync_shm_entry *entry, unsigned int incr, unsigned int max,
+                                        int *overflow );
+extern void sync_shm_add_waiter( struct sync_shm_entry *entry, int incr );
+extern void sync_shm_handle_closed( struct process *process );
 
 /* registry functions */
 
 extern unsigned int get_prefix_cpu_mask(void);
 extern void init_registry(void);
 extern void flush_registry(void);
+extern int convert_registry( int binary );
 
 /* signal functions */
 
@@ -231,6 +249,7 @@ extern void create_mailslot_device( struct directory *root, const struct unicode
 extern int debug_level;
 extern int foreground;
 extern timeout_t master_socket_timeout;
+extern timeout_t notify_delay;
 extern const char *server_argv0;
 
   /* server start time used for GetTickCount() */
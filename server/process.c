@@ -328,6 +328,8 @@ struct thread *create_process( int fd, struct thread *parent_thread, int inherit
     process->startup_state   = STARTUP_IN_PROGRESS;
     process->startup_info    = NULL;
     process->idle_event      = NULL;
+    process->sync_shm        = NULL;
+    process->req_stats       = NULL;
     process->peb             = 0;
     process->ldt_copy        = 0;
     process->winstation      = 0;
@@ -423,6 +425,8 @@ static void process_destroy( struct object *obj )
     if (process->msg_fd) release_object( process->msg_fd );
     list_remove( &process->entry );
     if (process->idle_event) release_object( process->idle_event );
+    if (process->sync_shm) release_object( process->sync_shm );
+    free_process_request_stats( process );
     if (process->id) free_ptid( process->id );
     if (process->token) release_object( process->token );
 }
@@ -629,6 +633,11 @@ static void process_killed( struct process *process )
         release_object( process->idle_event );
         process->idle_event = NULL;
     }
+    if (process->sync_shm)
+    {
+        release_object( process->sync_shm );
+        process->sync_shm = NULL;
+    }
 
     /* close the console attached to this process, if any */
     free_console( process );
@@ -132,6 +132,8 @@ struct msg_queue
     struct thread_input   *input;           /* thread input descriptor */
     struct hook_table     *hooks;           /* hook table */
     timeout_t              last_get_msg;    /* time of last get message call */
+    struct object         *ring_mapping;    /* mapping of the posted message ring */
+    struct queue_ring     *ring;            /* server view of the posted message ring */
 };
 
 static void msg_queue_dump( struct object *obj, int verbose );
@@ -275,6 +277,8 @@ static struct msg_queue *create_msg_queue( struct thread *thread, struct thread_
         queue->input           = (struct thread_input *)grab_object( input );
         queue->hooks           = NULL;
         queue->last_get_msg    = current_time;
+        queue->ring_mapping    = NULL;
+        queue->ring            = NULL;
         list_init( &queue->send_result );
         list_init( &queue->callback_result );
         list_init( &queue->pending_timers );
@@ -338,11 +342,28 @@ static inline int is_signaled( struct msg_queue *queue )
     return ((queue->wake_bits & queue->wake_mask) || (queue->changed_bits & queue->changed_mask));
 }
 
+/* publish the queue state the client needs to use the posted message ring */
+static inline void update_queue_ring( struct msg_queue *queue )
+{
+    if (!queue->ring) return;
+    queue->ring->wake_bits = queue->wake_bits;
+    queue->ring->server_posted = !list_empty( &queue->msg_list[POST_MESSAGE] );
+    queue->ring->cursor_x = queue->input->desktop->cursor_x;
+    queue->ring->cursor_y = queue->input->desktop->cursor_y;
+}
+
+/* check whether the client has retrieved all the messages of the ring */
+static inline int is_queue_ring_empty( struct msg_queue *queue )
+{
+    return !queue->ring || !queue->ring->count;
+}
+
 /* set some queue bits */
 static inline void set_queue_bits( struct msg_queue *queue, unsigned int bits )
 {
     queue->wake_bits |= bits;
     queue->changed_bits |= bits;
+    update_queue_ring( queue );
     if (is_signaled( queue )) wake_up( &queue->obj, 0 );
 }
 
@@ -351,6 +372,36 @@ static inline void clear_queue_bits( struct msg_queue *queue, unsigned int bits
 {
     queue->wake_bits &= ~bits;
     queue->changed_bits &= ~bits;
+    update_queue_ring( queue );
+}
+
+/* account for the messages the client stored in or retrieved from the ring since the last request */
+static void sync_queue_ring( struct msg_queue *queue )
+{
+    struct queue_ring *ring = queue->ring;
+
+    if (!ring) return;
+    if (ring->get_posted != ring->get_seen)
+    {
+        /* the client retrieved messages from the ring, which resets the changed bits like get_message */
+        queue->changed_bits &= ~(QS_POSTMESSAGE|QS_ALLPOSTMESSAGE);
+        ring->get_seen = ring->get_posted;
+    }
+    if (ring->count)
+    {
+        /* only the messages stored after both the last sync and the last retrieval are new */
+        if (min( ring->posted - ring->seen, ring->posted - ring->get_posted ))
+            set_queue_bits( queue, QS_POSTMESSAGE|QS_ALLPOSTMESSAGE );
+        else if (!(queue->wake_bits & QS_POSTMESSAGE))
+        {
+            queue->wake_bits |= QS_POSTMESSAGE|QS_ALLPOSTMESSAGE;
+            update_queue_ring( queue );
+            if (is_signaled( queue )) wake_up( &queue->obj, 0 );
+        }
+    }
+    else if (list_empty( &queue->msg_list[POST_MESSAGE] ) && !queue->quit_message)
+        clear_queue_bits( queue, QS_POSTMESSAGE|QS_ALLPOSTMESSAGE );
+    ring->seen = ring->posted;
 }
 
 /* check whether msg is a keyboard message */
@@ -512,8 +563,9 @@ static void remove_queue_message( struct msg_queue *queue, struct message *msg,
         if (list_empty( &queue->msg_list[kind] )) clear_queue_bits( queue, QS_SENDMESSAGE );
         break;
     case POST_MESSAGE:
-        if (list_empty( &queue->msg_list[kind] ) && !queue->quit_message)
+        if (list_empty( &queue->msg_list[kind] ) && !queue->quit_message && is_queue_ring_empty( queue ))
             clear_queue_bits( queue, QS_POSTMESSAGE|QS_ALLPOSTMESSAGE );
+        update_queue_ring( queue );
         break;
     }
     free_message( msg );
@@ -725,7 +777,7 @@ static int get_quit_message( struct msg_queue *queue, unsigned int flags,
         if (flags & PM_REMOVE)
         {
             queue->quit_message = 0;
-            if (list_empty( &queue->msg_list[POST_MESSAGE] ))
+            if (list_empty( &queue->msg_list[POST_MESSAGE] ) && is_queue_ring_empty( queue ))
                 clear_queue_bits( queue, QS_POSTMESSAGE|QS_ALLPOSTMESSAGE );
         }
         return 1;
@@ -773,6 +825,8 @@ static int is_queue_hung( struct msg_queue *queue )
 
     if (current_time - queue->last_get_msg <= 5 * TICKS_PER_SEC)
         return 0;  /* less than 5 seconds since last get message -> not hung */
+    if (queue->ring && get_tick_count() - queue->ring->last_get <= 5000)
+        return 0;  /* the thread retrieved a message from the ring recently */
 
     LIST_FOR_EACH_ENTRY( entry, &queue->obj.wait_queue, struct wait_queue_entry, entry )
     {
@@ -871,6 +925,7 @@ static void msg_queue_destroy( struct object *obj )
     }
     if (queue->hooks) release_object( queue->hooks );
     if (queue->fd) release_object( queue->fd );
+    if (queue->ring_mapping) release_server_mapping( queue->ring_mapping, queue->ring );
 }
 
 static void msg_queue_poll_event( struct fd *fd, int event )
@@ -1270,6 +1325,11 @@ static void queue_hardware_message( struct thread_input *input, struct message *
     unsigned int msg_code;
 
     last_input_time = get_tick_count();
+    if (input && msg->msg >= WM_MOUSEFIRST && msg->msg <= WM_MOUSELAST)
+    {
+        input->desktop->cursor_x = data->x;
+        input->desktop->cursor_y = data->y;
+    }
     win = find_hardware_message_window( input, msg, data, &msg_code );
     if (!win || !(thread = get_window_thread(win)))
     {
@@ -1566,6 +1626,24 @@ DECL_HANDLER(get_msg_queue)
 }
 
 
+/* retrieve the posted message ring of the current thread queue */
+DECL_HANDLER(get_queue_ring)
+{
+    struct msg_queue *queue = get_current_queue();
+    void *ptr;
+
+    if (!queue) return;
+    if (!queue->ring_mapping)
+    {
+        if (!(queue->ring_mapping = create_server_mapping( sizeof(*queue->ring), &ptr ))) return;
+        queue->ring = ptr;
+        update_queue_ring( queue );
+    }
+    reply->handle = alloc_handle( current->process, queue->ring_mapping,
+                                  SECTION_MAP_READ | SECTION_MAP_WRITE | SECTION_QUERY, 0 );
+}
+
+
 /* set the file descriptor associated to the current thread queue */
 DECL_HANDLER(set_queue_fd)
 {
@@ -1598,6 +1676,7 @@ DECL_HANDLER(set_queue_mask)
 
     if (queue)
     {
+        sync_queue_ring( queue );
         queue->wake_mask    = req->wake_mask;
         queue->changed_mask = req->changed_mask;
         reply->wake_bits    = queue->wake_bits;
@@ -1618,6 +1697,7 @@ DECL_HANDLER(get_queue_status)
     struct msg_queue *queue = current->queue;
     if (queue)
     {
+        sync_queue_ring( queue );
         reply->wake_bits    = queue->wake_bits;
         reply->changed_bits = queue->changed_bits;
         if (req->clear) queue->changed_bits = 0;
@@ -1776,6 +1856,7 @@ DECL_HANDLER(get_message)
     if (!queue) return;
     queue->last_get_msg = current_time;
     if (!filter) filter = QS_ALLINPUT;
+    sync_queue_ring( queue );
 
     /* first check for sent messages */
     if ((ptr = list_head( &queue->msg_list[SEND_MESSAGE] )))
@@ -34,6 +34,7 @@
 #include <stdarg.h>
 #include <string.h>
 #include <stdlib.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 
@@ -78,6 +79,8 @@ struct key
     unsigned int      flags;       /* flags */
     timeout_t         modif;       /* last modification time */
     struct list       notify_list; /* list of notifications */
+    struct hive      *hive;        /* hive file the key contents come from */
+    unsigned int      hive_pos;    /* position of the key record in the hive file */
 };
 
 /* key flags */
@@ -87,6 +90,12 @@ struct key
 #define KEY_SYMLINK  0x0008  /* key is a symbolic link */
 #define KEY_WOW64    0x0010  /* key contains a Wow6432Node subkey */
 #define KEY_WOWSHARE 0x0020  /* key is a Wow64 shared key (used for Software\Classes) */
+#define KEY_PAGED_OUT 0x0040 /* key subkeys and values have not been loaded from the hive yet */
+#define KEY_CHANGED  0x0080  /* key contents have been modified since the last save */
+#define KEY_REPLAYED 0x0100  /* key is listed in the journal entry being replayed */
+
+/* key flags stored in the hive files */
+#define KEY_HIVE_FLAGS (KEY_SYMLINK | KEY_WOW64)
 
 /* a key value */
 struct key_value
@@ -103,6 +112,7 @@ struct key_value
 
 #define MAX_NAME_LEN  255    /* max. length of a key name */
 #define MAX_VALUE_LEN 16383  /* max. length of a value name */
+#define MAX_KEY_DEPTH 512    /* max. depth of the saved key tree */
 
 /* the root of the registry tree */
 static struct key *root_key;
@@ -118,13 +128,103 @@ static const WCHAR symlink_value[] = {'S','y','m','b','o','l','i','c','L','i','n
 static const struct unicode_str symlink_str = { symlink_value, sizeof(symlink_value) };
 
 static void set_periodic_save_timer(void);
-static struct key_value *find_value( const struct key *key, const struct unicode_str *name, int *index );
+static struct key_value *find_value( struct key *key, const struct unicode_str *name, int *index );
+
+/*
+ * The binary hive format stores a registry branch as a tree of key records
+ * that is mapped in memory and loaded on demand, one key at a time. The
+ * records of a key contain the positions of its subkey records, its values,
+ * and its name, class and value data. Saving appends the modified keys to a
+ * journal file, and the hive is only rewritten once the journal has grown
+ * too large.
+ */
+
+#define HIVE_MAGIC     "WINEHIVE"
+#define HIVE_VERSION   1
+#define JOURNAL_MAGIC  0x4c4e524a  /* "JRNL" */
+
+struct hive_header
+{
+    char           magic[8];   /* HIVE_MAGIC */
+    unsigned int   version;    /* HIVE_VERSION */
+    unsigned int   arch;       /* prefix type */
+    unsigned int   size;       /* size of the file */
+    unsigned int   root;       /* position of the root key record */
+    unsigned int   sequence;   /* sequence number of the last journal batch merged in the file */
+    unsigned int   reserved;
+};
+
+/* key record, followed by the positions of the subkey records, the value */
+/* descriptors, the key name and class, and the value names and data */
+struct hive_key
+{
+    timeout_t      modif;      /* last modification time */
+    unsigned int   size;       /* total size of the record */
+    unsigned int   flags;      /* key flags (KEY_HIVE_FLAGS) */
+    unsigned int   nb_subkeys; /* number of subkeys */
+    unsigned int   nb_values;  /* number of values */
+    unsigned short namelen;    /* length of key name */
+    unsigned short classlen;   /* length of class name */
+    unsigned int   reserved;
+};
+
+struct hive_value
+{
+    unsigned short namelen;    /* length of value name */
+    unsigned short type;       /* value type */
+    data_size_t    len;        /* value data length in bytes */
+    unsigned int   name;       /* offset of the value name in the key record */
+    unsigned int   data;       /* offset of the value data in the key record */
+};
+
+/* batch of journal entries written by a single save */
+struct journal_header
+{
+    unsigned int   magic;      /* JOURNAL_MAGIC */
+    unsigned int   sequence;   /* sequence number of the batch */
+    unsigned int   size;       /* size of the entries */
+    unsigned int   checksum;   /* checksum of the entries */
+};
+
+/* journal entry holding the full state of a modified key, followed by the key path */
+/* relative to the branch, the class, the subkey names and the values */
+struct journal_key
+{
+    timeout_t      modif;      /* last modification time */
+    unsigned int   flags;      /* key flags (KEY_HIVE_FLAGS) */
+    unsigned int   pathlen;    /* length of the key path */
+    unsigned int   classlen;   /* length of class name */
+    unsigned int   nb_subkeys; /* number of subkeys, each stored as a length and a name */
+    unsigned int   nb_values;  /* number of values, each stored as a journal_value, a name and data */
+    unsigned int   reserved;
+};
+
+struct journal_value
+{
+    unsigned short namelen;    /* length of value name */
+    unsigned short type;       /* value type */
+    data_size_t    len;        /* value data length in bytes */
+};
+
+/* a mapped binary hive */
+struct hive
+{
+    const char    *path;          /* hive file name */
+    char          *journal_path;  /* journal file name */
+    const char    *base;          /* mapping of the hive file */
+    unsigned int   size;          /* size of the mapping */
+    int            journal_fd;    /* journal file, opened on first use */
+    unsigned int   journal_size;  /* size of the valid journal data */
+    unsigned int   sequence;      /* sequence number of the last journal batch */
+};
 
 /* information about where to save a registry branch */
 struct save_branch_info
 {
     struct key  *key;
-    const char  *path;
+    const char  *path;    /* text file name */
+    struct hive  hive;    /* binary hive */
+    int          binary;  /* whether the branch is saved in the binary format */
 };
 
 #define MAX_SAVE_BRANCH_INFO 3
@@ -145,6 +245,7 @@ struct file_load_info
 };
 
 
+static int page_in_key( struct key *key );
 static void key_dump( struct object *obj, int verbose );
 static unsigned int key_map_access( struct object *obj, unsigned int access );
 static int key_close_handle( struct object *obj, struct process *process, obj_handle_t handle );
@@ -252,11 +353,20 @@ static void dump_value( const struct key_value *value, FILE *f )
 }
 
 /* save a registry and all its subkeys to a text file */
-static void save_subkeys( const struct key *key, const struct key *base, FILE *f )
+/* returns 0 if a key could not be loaded from its hive */
+static int save_subkeys( struct key *key, const struct key *base, FILE *f, int depth )
 {
     int i;
 
-    if (key->flags & KEY_VOLATILE) return;
+    if (key->flags & KEY_VOLATILE) return 1;
+    if (depth > MAX_KEY_DEPTH)
+    {
+        fprintf( stderr, "wineserver: registry tree too deep, not saving " );
+        dump_path( key, NULL, stderr );
+        fprintf( stderr, "\n" );
+        return 1;
+    }
+    if (!page_in_key( key )) return 0;
     /* save key if it has either some values or no subkeys, or needs special options */
     /* keys with no values but subkeys are saved implicitly by saving the subkeys */
     if ((key->last_value >= 0) || (key->last_subkey == -1) || key->class || (key->flags & KEY_SYMLINK))
@@ -273,7 +383,9 @@ static void save_subkeys( const struct key *key, const struct key *base, FILE *f
         if (key->flags & KEY_SYMLINK) fputs( "#link\n", f );
         for (i = 0; i <= key->last_value; i++) dump_value( &key->values[i], f );
     }
-    for (i = 0; i <= key->last_subkey; i++) save_subkeys( key->subkeys[i], base, f );
+    for (i = 0; i <= key->last_subkey; i++)
+        if (!save_subkeys( key->subkeys[i], base, f, depth + 1 )) return 0;
+    return 1;
 }
 
 static void dump_operation( const struct key *key, const struct key_value *value, const char *op )
@@ -432,6 +544,8 @@ static struct key *alloc_key( const struct unicode_str *name, timeout_t modif )
         key->values      = NULL;
         key->modif       = modif;
         key->parent      = NULL;
+        key->hive        = NULL;
+        key->hive_pos    = 0;
         list_init( &key->notify_list );
         if (name->len && !(key->name = memdup( name->str, name->len )))
         {
@@ -442,6 +556,166 @@ static struct key *alloc_key( const struct unicode_str *name, timeout_t modif )
     return key;
 }
 
+/* check that a range of a hive key record lies within the record */
+static inline int is_valid_hive_range( unsigned int offset, unsigned int len, unsigned int size )
+{
+    return offset <= size && len <= size - offset;
+}
+
+/* return the key record at the given position of a hive, or NULL if it is invalid */
+static const struct hive_key *get_hive_key( const struct hive *hive, unsigned int pos )
+{
+    const struct hive_key *rec;
+    const struct hive_value *values;
+    unsigned int i, size, avail;
+
+    if ((pos % 8) || pos < sizeof(struct hive_header) || pos > hive->size - sizeof(*rec)) return NULL;
+    rec = (const struct hive_key *)(hive->base + pos);
+    size = rec->size;
+    if (size < sizeof(*rec) || size > hive->size - pos) return NULL;
+    avail = size - sizeof(*rec);
+    if (rec->nb_subkeys > avail / sizeof(unsigned int)) return NULL;
+    avail -= rec->nb_subkeys * sizeof(unsigned int);
+    if (rec->nb_values > avail / sizeof(*values)) return NULL;
+    avail -= rec->nb_values * sizeof(*values);
+    if ((rec->namelen | rec->classlen) % sizeof(WCHAR)) return NULL;
+    if (rec->namelen > MAX_NAME_LEN * sizeof(WCHAR)) return NULL;
+    if (rec->namelen + rec->classlen > avail) return NULL;
+
+    values = (const struct hive_value *)((const unsigned int *)(rec + 1) + rec->nb_subkeys);
+    for (i = 0; i < rec->nb_values; i++)
+    {
+        if ((values[i].name | values[i].namelen) % sizeof(WCHAR)) return NULL;
+        if (!is_valid_hive_range( values[i].name, values[i].namelen, size )) return NULL;
+        if (!is_valid_hive_range( values[i].data, values[i].len, size )) return NULL;
+    }
+    return rec;
+}
+
+static inline const unsigned int *get_hive_subkeys( const struct hive_key *rec )
+{
+    return (const unsigned int *)(rec + 1);
+}
+
+static inline const struct hive_value *get_hive_values( const struct hive_key *rec )
+{
+    return (const struct hive_value *)(get_hive_subkeys( rec ) + rec->nb_subkeys);
+}
+
+static inline const WCHAR *get_hive_key_name( const struct hive_key *rec )
+{
+    return (const WCHAR *)(get_hive_values( rec ) + rec->nb_values);
+}
+
+/* set the key information from its hive record, the contents are loaded later by page_in_key */
+static int init_key_from_hive( struct key *key, struct hive *hive, unsigned int pos,
+                               const struct hive_key *rec )
+{
+    if (rec->classlen)
+    {
+        WCHAR *class;
+        if (!(class = memdup( get_hive_key_name( rec ) + rec->namelen / sizeof(WCHAR), rec->classlen )))
+            return 0;
+        free( key->class );
+        key->class    = class;
+        key->classlen = rec->classlen;
+    }
+    key->modif    = rec->modif;
+    key->flags    = (key->flags & ~KEY_HIVE_FLAGS) | (rec->flags & KEY_HIVE_FLAGS) | KEY_PAGED_OUT;
+    key->hive     = hive;
+    key->hive_pos = pos;
+    return 1;
+}
+
+/* free the contents of a key that failed to be paged in */
+static void unload_key( struct key *key )
+{
+    int i;
+
+    for (i = 0; i <= key->last_value; i++)
+    {
+        free( key->values[i].name );
+        free( key->values[i].data );
+    }
+    for (i = 0; i <= key->last_subkey; i++)
+    {
+        key->subkeys[i]->parent = NULL;
+        release_object( key->subkeys[i] );
+    }
+    free( key->values );
+    free( key->subkeys );
+    key->values      = NULL;
+    key->subkeys     = NULL;
+    key->last_value  = -1;
+    key->last_subkey = -1;
+    key->nb_values   = 0;
+    key->nb_subkeys  = 0;
+}
+
+/* load the subkeys and values of a key from its hive file */
+static int page_in_key( struct key *key )
+{
+    const struct hive_key *rec, *subrec;
+    const struct hive_value *values;
+    const unsigned int *subkeys;
+    struct unicode_str name;
+    struct key *subkey;
+    unsigned int i;
+
+    if (!(key->flags & KEY_PAGED_OUT)) return 1;
+
+    rec = get_hive_key( key->hive, key->hive_pos );
+    assert( rec );  /* it has been checked when creating the key */
+    subkeys = get_hive_subkeys( rec );
+    values  = get_hive_values( rec );
+
+    if (rec->nb_subkeys)
+    {
+        key->nb_subkeys = max( rec->nb_subkeys, MIN_SUBKEYS );
+        if (!(key->subkeys = mem_alloc( key->nb_subkeys * sizeof(*key->subkeys) ))) goto failed;
+    }
+    for (i = 0; i < rec->nb_subkeys; i++)
+    {
+        if (subkeys[i] >= key->hive_pos || !(subrec = get_hive_key( key->hive, subkeys[i] ))) goto corrupted;
+        name.str = get_hive_key_name( subrec );
+        name.len = subrec->namelen;
+        if (!(subkey = alloc_key( &name, subrec->modif ))) goto failed;
+        subkey->parent = key;
+        key->subkeys[++key->last_subkey] = subkey;
+        if (!init_key_from_hive( subkey, key->hive, subkeys[i], subrec )) goto failed;
+    }
+
+    if (rec->nb_values)
+    {
+        key->nb_values = max( rec->nb_values, MIN_VALUES );
+        if (!(key->values = mem_alloc( key->nb_values * sizeof(*key->values) ))) goto failed;
+    }
+    for (i = 0; i < rec->nb_values; i++)
+    {
+        struct key_value *value = &key->values[++key->last_value];
+
+        value->name    = NULL;
+        value->namelen = values[i].namelen;
+        value->type    = values[i].type;
+        value->len     = values[i].len;
+        value->data    = NULL;
+        if (value->namelen && !(value->name = memdup( (const char *)rec + values[i].name, value->namelen )))
+            goto failed;
+        if (value->len && !(value->data = memdup( (const char *)rec + values[i].data, value->len )))
+            goto failed;
+    }
+
+    key->flags &= ~KEY_PAGED_OUT;
+    return 1;
+
+corrupted:
+    fprintf( stderr, "%s: corrupted key record at %x\n", key->hive->path, subkeys[i] );
+    set_error( STATUS_REGISTRY_CORRUPT );
+failed:
+    unload_key( key );
+    return 0;
+}
+
 /* mark a key and all its parents as dirty (modified) */
 static void make_dirty( struct key *key )
 {
@@ -459,8 +733,8 @@ static void make_clean( struct key *key )
     int i;
 
     if (key->flags & KEY_VOLATILE) return;
-    if (!(key->flags & KEY_DIRTY)) return;
-    key->flags &= ~KEY_DIRTY;
+    if (!(key->flags & (KEY_DIRTY|KEY_CHANGED))) return;
+    key->flags &= ~(KEY_DIRTY|KEY_CHANGED);
     for (i = 0; i <= key->last_subkey; i++) make_clean( key->subkeys[i] );
 }
 
@@ -483,6 +757,7 @@ static void touch_key( struct key *key, unsigned int change )
     struct key *k;
 
     key->modif = current_time;
+    key->flags |= KEY_CHANGED;
     make_dirty( key );
 
     /* do notifications */
@@ -528,6 +803,11 @@ static struct key *alloc_subkey( struct key *parent, const struct unicode_str *n
         set_error( STATUS_NAME_TOO_LONG );
         return NULL;
     }
+    if (parent->flags & KEY_PAGED_OUT)
+    {
+        set_error( STATUS_REGISTRY_CORRUPT );
+        return NULL;
+    }
     if (parent->last_subkey + 1 == parent->nb_subkeys)
     {
         /* need to grow the array */
@@ -536,6 +816,8 @@ static struct key *alloc_subkey( struct key *parent, const struct unicode_str *n
     if ((key = alloc_key( name, modif )) != NULL)
     {
         key->parent = parent;
+        key->flags |= KEY_CHANGED;
+        parent->flags |= KEY_CHANGED;
         for (i = ++parent->last_subkey; i > index; i--)
             parent->subkeys[i] = parent->subkeys[i-1];
         parent->subkeys[index] = key;
@@ -557,6 +839,7 @@ static void free_subkey( struct key *parent, int index )
     key = parent->subkeys[index];
     for (i = index; i < parent->last_subkey; i++) parent->subkeys[i] = parent->subkeys[i + 1];
     parent->last_subkey--;
+    parent->flags |= KEY_CHANGED;
     key->flags |= KEY_DELETED;
     key->parent = NULL;
     if (is_wow6432node( key->name, key->namelen )) parent->flags &= ~KEY_WOW64;
@@ -576,11 +859,14 @@ static void free_subkey( struct key *parent, int index )
 }
 
 /* find the named child of a given key and return its index */
-static struct key *find_subkey( const struct key *key, const struct unicode_str *name, int *index )
+static struct key *find_subkey( struct key *key, const struct unicode_str *name, int *index )
 {
     int i, min, max, res;
     data_size_t len;
 
+    *index = 0;
+    if (!page_in_key( key )) return NULL;
+
     min = 0;
     max = key->last_subkey;
     while (min <= max)
@@ -805,6 +1091,7 @@ static struct key *create_key_recursive( struct key *key, const struct unicode_s
                 return NULL;
             }
         }
+        make_dirty( base );
     }
 
     grab_object( key );
@@ -812,7 +1099,7 @@ static struct key *create_key_recursive( struct key *key, const struct unicode_s
 }
 
 /* query information about a key or a subkey */
-static void enum_key( const struct key *key, int index, int info_class,
+static void enum_key( struct key *key, int index, int info_class,
                       struct enum_key_reply *reply )
 {
     int i;
@@ -821,6 +1108,7 @@ static void enum_key( const struct key *key, int index, int info_class,
     data_size_t max_value = 0, max_data = 0;
     char *data;
 
+    if (!page_in_key( key )) return;
     if (index != -1)  /* -1 means use the specified key directly */
     {
         if ((index < 0) || (index > key->last_subkey))
@@ -829,6 +1117,7 @@ static void enum_key( const struct key *key, int index, int info_class,
             return;
         }
         key = key->subkeys[index];
+        if (!page_in_key( key )) return;
     }
 
     namelen = key->namelen;
@@ -907,6 +1196,7 @@ static int delete_key( struct key *key, int recurse )
         return -1;
     }
     assert( parent );
+    if (!page_in_key( key )) return -1;
 
     while (recurse && (key->last_subkey>=0))
         if (0 > delete_key(key->subkeys[key->last_subkey], 1))
@@ -955,11 +1245,14 @@ static int grow_values( struct key *key )
 }
 
 /* find the named value of a given key and return its index in the array */
-static struct key_value *find_value( const struct key *key, const struct unicode_str *name, int *index )
+static struct key_value *find_value( struct key *key, const struct unicode_str *name, int *index )
 {
     int i, min, max, res;
     data_size_t len;
 
+    *index = 0;
+    if (!page_in_key( key )) return NULL;
+
     min = 0;
     max = key->last_value;
     while (min <= max)
@@ -992,6 +1285,11 @@ static struct key_value *insert_value( struct key *key, const struct unicode_str
         set_error( STATUS_NAME_TOO_LONG );
         return NULL;
     }
+    if (key->flags & KEY_PAGED_OUT)
+    {
+        set_error( STATUS_REGISTRY_CORRUPT );
+        return NULL;
+    }
     if (key->last_value + 1 == key->nb_values)
     {
         if (!grow_values( key )) return NULL;
@@ -1079,6 +1377,7 @@ static void enum_value( struct key *key, int i, int info_class, struct enum_key_
 {
     struct key_value *value;
 
+    if (!page_in_key( key )) return;
     if (i < 0 || i > key->last_value) set_error( STATUS_NO_MORE_ENTRIES );
     else
     {
@@ -1307,6 +1606,13 @@ static struct key *load_key( struct key *base, const char *buffer,
     return create_key_recursive( base, &name, modif );
 }
 
+/* set the prefix architecture, and check that it matches the previously loaded files */
+static int check_prefix_type( enum prefix_type type )
+{
+    if (prefix_type == PREFIX_UNKNOWN) prefix_type = type;
+    return (type == prefix_type);
+}
+
 /* load a global option from the input file */
 static int load_global_option( const char *buffer, struct file_load_info *info )
 {
@@ -1324,8 +1630,7 @@ static int load_global_option( const char *buffer, struct file_load_info *info )
             set_error( STATUS_NOT_REGISTRY_FILE );
             return 0;
         }
-        if (prefix_type == PREFIX_UNKNOWN) prefix_type = type;
-        else if (type != prefix_type)
+        if (!check_prefix_type( type ))
         {
             file_read_error( "Mismatched architecture", info );
             set_error( STATUS_NOT_REGISTRY_FILE );
@@ -1352,8 +1657,9 @@ static int load_key_option( struct key *key, const char *buffer, struct file_loa
         free( key->class );
         if (!(key->class = memdup( info->tmp, len ))) len = 0;
         key->classlen = len;
+        key->flags |= KEY_CHANGED;
     }
-    if (!strncmp( buffer, "#link", 5 )) key->flags |= KEY_SYMLINK;
+    if (!strncmp( buffer, "#link", 5 )) key->flags |= KEY_SYMLINK | KEY_CHANGED;
     /* ignore unknown options */
     return 1;
 }
@@ -1472,6 +1778,7 @@ static int load_value( struct key *key, const char *buffer, struct file_load_inf
     value->data = newptr;
     value->len  = len;
     value->type = type;
+    key->flags |= KEY_CHANGED;
     return 1;
 
  error:
@@ -1548,6 +1855,8 @@ static void load_keys( struct key *key, const char *filename, FILE *f, int prefi
             if (prefix_len == -1) prefix_len = get_prefix_len( key, p + 1, &info );
             if (!(subkey = load_key( key, p + 1, prefix_len, &info )))
                 file_read_error( "Error creating key", &info );
+            else
+                make_dirty( subkey );
             break;
         case '@':   /* default value */
         case '\"':  /* value */
@@ -1594,28 +1903,345 @@ static void load_registry( struct key *key, obj_handle_t handle )
     }
 }
 
-/* load one of the initial registry files */
-static int load_init_registry_from_file( const char *filename, struct key *key )
+/* read the next item of a journal batch */
+static const void *read_journal_data( const char **ptr, const char *end, size_t size )
 {
-    FILE *f;
+    const char *data = *ptr;
+    size_t padded = (size + 3) & ~3;
+
+    if (padded < size || padded > (size_t)(end - data)) return NULL;
+    *ptr += padded;
+    return data;
+}
 
-    if ((f = fopen( filename, "r" )))
+/* page in a key and all its subkeys, so that deleting them cannot fail */
+static int page_in_tree( struct key *key, int depth )
+{
+    int i;
+
+    if (depth > MAX_KEY_DEPTH)
     {
-        load_keys( key, filename, f, 0 );
-        fclose( f );
-        if (get_error() == STATUS_NOT_REGISTRY_FILE)
+        set_error( STATUS_REGISTRY_CORRUPT );
+        return 0;
+    }
+    if (!page_in_key( key )) return 0;
+    for (i = 0; i <= key->last_subkey; i++)
+        if (!page_in_tree( key->subkeys[i], depth + 1 )) return 0;
+    return 1;
+}
+
+/* check that a journal entry is well-formed and that the keys it touches can be loaded */
+static int check_journal_key( struct key *branch, const char **ptr, const char *end )
+{
+    struct journal_key entry;
+    struct journal_value jvalue;
+    struct unicode_str path, token, name;
+    struct key *key = branch, *subkey;
+    const unsigned int *len;
+    const void *data;
+    unsigned int i;
+    int index, depth = 0, ret = 1;
+
+    clear_error();
+    if (!(data = read_journal_data( ptr, end, sizeof(entry) ))) return 0;
+    memcpy( &entry, data, sizeof(entry) );
+    if (entry.pathlen % sizeof(WCHAR) || entry.classlen > 0xffff || entry.classlen % sizeof(WCHAR))
+        return 0;
+    if (!(path.str = read_journal_data( ptr, end, entry.pathlen ))) return 0;
+    path.len = entry.pathlen;
+
+    token.str = NULL;
+    if (!get_path_token( &path, &token )) return 0;
+    while (token.len)
+    {
+        if (token.len > MAX_NAME_LEN * sizeof(WCHAR) || ++depth > MAX_KEY_DEPTH) return 0;
+        if (key && !(key = find_subkey( key, &token, &index )) && get_error()) return 0;
+        get_path_token( &path, &token );
+    }
+    if (key && !page_in_key( key )) return 0;
+    if (!read_journal_data( ptr, end, entry.classlen )) return 0;
+
+    for (i = 0; i < entry.nb_subkeys; i++)
+    {
+        if (!(len = read_journal_data( ptr, end, sizeof(*len) ))) return 0;
+        name.len = *len;
+        if (!name.len || name.len > MAX_NAME_LEN * sizeof(WCHAR) || name.len % sizeof(WCHAR)) return 0;
+        if (!(name.str = read_journal_data( ptr, end, name.len ))) return 0;
+        if (key && (subkey = find_subkey( key, &name, &index ))) subkey->flags |= KEY_REPLAYED;
+    }
+    /* the subkeys that are not listed get deleted */
+    for (index = 0; key && index <= key->last_subkey; index++)
+    {
+        subkey = key->subkeys[index];
+        if (subkey->flags & KEY_REPLAYED) subkey->flags &= ~KEY_REPLAYED;
+        else if (ret && !(subkey->flags & KEY_VOLATILE)) ret = page_in_tree( subkey, depth + 1 );
+    }
+    if (!ret) return 0;
+
+    for (i = 0; i < entry.nb_values; i++)
+    {
+        if (!(data = read_journal_data( ptr, end, sizeof(jvalue) ))) return 0;
+        memcpy( &jvalue, data, sizeof(jvalue) );
+        if (jvalue.namelen > MAX_VALUE_LEN * sizeof(WCHAR) || jvalue.namelen % sizeof(WCHAR)) return 0;
+        if (!read_journal_data( ptr, end, jvalue.namelen )) return 0;
+        if (!read_journal_data( ptr, end, jvalue.len )) return 0;
+    }
+    return 1;
+}
+
+/* replay a journal entry, restoring the saved state of a key */
+static int replay_journal_key( struct key *branch, const char **ptr, const char *end )
+{
+    struct journal_key entry;
+    struct journal_value jvalue;
+    struct unicode_str path, token, name;
+    struct key *key = branch, *subkey;
+    struct key_value *value;
+    const unsigned int *len;
+    const void *data;
+    unsigned int i;
+    int index;
+
+    if (!(data = read_journal_data( ptr, end, sizeof(entry) ))) return 0;
+    memcpy( &entry, data, sizeof(entry) );
+    if (!(path.str = read_journal_data( ptr, end, entry.pathlen ))) return 0;
+    path.len = entry.pathlen;
+
+    /* create the key and its parents if needed, without following symlinks */
+    token.str = NULL;
+    if (!get_path_token( &path, &token )) return 0;
+    while (token.len)
+    {
+        if (!(subkey = find_subkey( key, &token, &index )) &&
+            !(subkey = alloc_subkey( key, &token, index, entry.modif )))
+            return 0;
+        key = subkey;
+        get_path_token( &path, &token );
+    }
+    if (!page_in_key( key )) return 0;
+
+    if (entry.classlen > 0xffff || !(data = read_journal_data( ptr, end, entry.classlen ))) return 0;
+    free( key->class );
+    key->class = NULL;
+    key->classlen = 0;
+    if (entry.classlen && (key->class = memdup( data, entry.classlen ))) key->classlen = entry.classlen;
+
+    /* create the listed subkeys, and delete the other ones */
+    for (i = 0; i < entry.nb_subkeys; i++)
+    {
+        if (!(len = read_journal_data( ptr, end, sizeof(*len) ))) return 0;
+        name.len = *len;
+        if (!(name.str = read_journal_data( ptr, end, name.len ))) return 0;
+        if (!(subkey = find_subkey( key, &name, &index )) &&
+            !(subkey = alloc_subkey( key, &name, index, entry.modif )))
+            return 0;
+        subkey->flags |= KEY_REPLAYED;
+    }
+    for (index = key->last_subkey; index >= 0; index--)
+    {
+        subkey = key->subkeys[index];
+        if (subkey->flags & KEY_REPLAYED) subkey->flags &= ~KEY_REPLAYED;
+        else if (!(subkey->flags & KEY_VOLATILE)) delete_key( subkey, 1 );
+    }
+
+    /* replace all the values */
+    for (index = 0; index <= key->last_value; index++)
+    {
+        free( key->values[index].name );
+        free( key->values[index].data );
+    }
+    key->last_value = -1;
+    for (i = 0; i < entry.nb_values; i++)
+    {
+        if (!(data = read_journal_data( ptr, end, sizeof(jvalue) ))) return 0;
+        memcpy( &jvalue, data, sizeof(jvalue) );
+        name.len = jvalue.namelen;
+        if (!(name.str = read_journal_data( ptr, end, name.len ))) return 0;
+        if (!(data = read_journal_data( ptr, end, jvalue.len ))) return 0;
+        if (!(value = find_value( key, &name, &index )) && !(value = insert_value( key, &name, index )))
+            return 0;
+        free( value->data );
+        value->type = jvalue.type;
+        value->len  = 0;
+        value->data = NULL;
+        if (jvalue.len && !(value->data = memdup( data, jvalue.len ))) return 0;
+        value->len  = jvalue.len;
+    }
+
+    key->modif = entry.modif;
+    key->flags = (key->flags & ~KEY_HIVE_FLAGS) | (entry.flags & KEY_HIVE_FLAGS);
+    return 1;
+}
+
+/* compute the checksum of a journal batch */
+static unsigned int get_journal_checksum( const void *data, unsigned int size )
+{
+    const unsigned char *ptr = data;
+    unsigned int sum = 0;
+
+    while (size--) sum = (sum << 5) + sum + *ptr++;
+    return sum;
+}
+
+/* replay the journal batches that were written after the hive file */
+static void replay_journal( struct hive *hive, struct key *branch )
+{
+    struct journal_header header;
+    struct stat st;
+    const char *ptr, *end, *batch_end;
+    char *data;
+    unsigned int pos = 0;
+    int fd, valid = 1;
+    ssize_t ret = 0;
+
+    hive->journal_size = 0;
+    if ((fd = open( hive->journal_path, O_RDONLY )) == -1) return;
+    if (fstat( fd, &st ) == -1 || st.st_size > UINT_MAX || !(data = mem_alloc( st.st_size + 1 )))
+    {
+        close( fd );
+        return;
+    }
+    while (pos < st.st_size && (ret = read( fd, data + pos, st.st_size - pos )) > 0) pos += ret;
+    close( fd );
+    if (ret < 0)
+    {
+        free( data );
+        return;
+    }
+
+    end = data + pos;
+    for (pos = 0; pos + sizeof(header) <= end - data; pos += sizeof(header) + header.size)
+    {
+        memcpy( &header, data + pos, sizeof(header) );
+        if (header.magic != JOURNAL_MAGIC || header.size > end - data - pos - sizeof(header) ||
+            header.checksum != get_journal_checksum( data + pos + sizeof(header), header.size ))
         {
-            fprintf( stderr, "%s is not a valid registry file\n", filename );
-            return 1;
+            valid = 0;
+            break;
         }
+        if (header.sequence <= hive->sequence) continue;  /* already merged in the hive file */
+
+        /* a batch is replayed entirely or not at all, so check all its entries first */
+        batch_end = data + pos + sizeof(header) + header.size;
+        for (ptr = data + pos + sizeof(header); ptr < batch_end; )
+            if (!check_journal_key( branch, &ptr, batch_end )) break;
+        if (ptr != batch_end)
+        {
+            fprintf( stderr, "%s: invalid journal batch %u\n", hive->journal_path, header.sequence );
+            valid = 0;
+            break;
+        }
+        for (ptr = data + pos + sizeof(header); ptr < batch_end; )
+            if (!replay_journal_key( branch, &ptr, batch_end )) fatal_error( "out of memory\n" );
+        hive->sequence = header.sequence;
+    }
+    if (!valid || pos < end - data)
+    {
+        /* discard the incomplete or invalid batch and everything after it */
+        fprintf( stderr, "%s: discarding %u bytes of incomplete journal data\n",
+                 hive->journal_path, (unsigned int)(end - data) - pos );
+        truncate( hive->journal_path, pos );
+    }
+    hive->journal_size = pos;
+    free( data );
+}
+
+/* map a binary hive file and attach it to the branch key; return 0 if there is no hive file */
+static int load_hive( struct hive *hive, struct key *key )
+{
+    const struct hive_header *header;
+    const struct hive_key *rec;
+    struct stat st;
+    void *base;
+    int fd;
+
+    if ((fd = open( hive->path, O_RDONLY )) == -1) return 0;
+    if (fstat( fd, &st ) == -1 || st.st_size < sizeof(*header) || st.st_size > UINT_MAX)
+    {
+        close( fd );
+        goto invalid;
     }
+    base = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    close( fd );
+    if (base == MAP_FAILED)
+    {
+        fprintf( stderr, "%s: ", hive->path );
+        perror( "mmap" );
+        goto invalid;
+    }
+
+    header = base;
+    hive->base = base;
+    hive->size = st.st_size;
+    if (memcmp( header->magic, HIVE_MAGIC, sizeof(header->magic) ) ||
+        header->version != HIVE_VERSION || header->size != hive->size ||
+        !(rec = get_hive_key( hive, header->root )))
+        goto unmap;
+    if (header->arch != PREFIX_UNKNOWN && !check_prefix_type( header->arch ))
+    {
+        fprintf( stderr, "%s: mismatched architecture\n", hive->path );
+        goto unmap;
+    }
+    if (!init_key_from_hive( key, hive, header->root, rec )) goto unmap;
+
+    hive->sequence = header->sequence;
+    replay_journal( hive, key );
+    return 1;
+
+unmap:
+    munmap( base, st.st_size );
+    hive->base = NULL;
+    hive->size = 0;
+invalid:
+    set_error( STATUS_NOT_REGISTRY_FILE );
+    return 1;
+}
+
+/* load one of the initial registry files, in binary or text format */
+static int load_init_registry_from_file( const char *filename, const char *hive_name, struct key *key )
+{
+    struct save_branch_info *info;
+    FILE *f;
+    int ret;
 
     assert( save_branch_count < MAX_SAVE_BRANCH_INFO );
 
-    save_branch_info[save_branch_count].path = filename;
-    save_branch_info[save_branch_count++].key = (struct key *)grab_object( key );
+    info = &save_branch_info[save_branch_count];
+    info->path = filename;
+    info->hive.path = hive_name;
+    info->hive.journal_path = malloc( strlen(hive_name) + sizeof(".log") );
+    if (!info->hive.journal_path) fatal_error( "out of memory\n" );
+    sprintf( info->hive.journal_path, "%s.log", hive_name );
+    info->hive.base = NULL;
+    info->hive.size = 0;
+    info->hive.journal_fd = -1;
+    info->hive.journal_size = 0;
+    info->hive.sequence = 0;
+
+    if ((ret = load_hive( &info->hive, key )))
+    {
+        info->binary = 1;
+        filename = hive_name;
+    }
+    else if ((f = fopen( filename, "r" )))
+    {
+        load_keys( key, filename, f, 0 );
+        fclose( f );
+        info->binary = 0;
+        ret = 1;
+    }
+    if (get_error() == STATUS_NOT_REGISTRY_FILE)
+    {
+        fprintf( stderr, "%s is not a valid registry file\n", filename );
+        free( info->hive.journal_path );
+        return 1;
+    }
+    make_clean( key );
+
+    info->key = (struct key *)grab_object( key );
+    save_branch_count++;
     make_object_static( &key->obj );
-    return (f != NULL);
+    return ret;
 }
 
 static WCHAR *format_user_registry_path( const SID *sid, struct unicode_str *path )
@@ -1700,7 +2326,7 @@ void init_registry(void)
     if (!(hklm = create_key_recursive( root_key, &HKLM_name, current_time )))
         fatal_error( "could not create Machine registry key\n" );
 
-    if (!load_init_registry_from_file( "system.reg", hklm ))
+    if (!load_init_registry_from_file( "system.reg", "system.hiv", hklm ))
         prefix_type = sizeof(void *) > sizeof(int) ? PREFIX_64BIT : PREFIX_32BIT;
     else if (prefix_type == PREFIX_UNKNOWN)
         prefix_type = PREFIX_32BIT;
@@ -1710,7 +2336,7 @@ void init_registry(void)
     if (!(key = create_key_recursive( root_key, &HKU_name, current_time )))
         fatal_error( "could not create User\\.Default registry key\n" );
 
-    load_init_registry_from_file( "userdef.reg", key );
+    load_init_registry_from_file( "userdef.reg", "userdef.hiv", key );
     release_object( key );
 
     /* load user.reg into HKEY_CURRENT_USER */
@@ -1721,7 +2347,7 @@ void init_registry(void)
         !(hkcu = create_key_recursive( root_key, &current_user_str, current_time )))
         fatal_error( "could not create HKEY_CURRENT_USER registry key\n" );
     free( current_user_path );
-    load_init_registry_from_file( "user.reg", hkcu );
+    load_init_registry_from_file( "user.reg", "user.hiv", hkcu );
 
     /* set the shared flag on Software\Classes\Wow6432Node */
     if (prefix_type == PREFIX_64BIT)
@@ -1745,7 +2371,7 @@ void init_registry(void)
 }
 
 /* save a registry branch to a file */
-static void save_all_subkeys( struct key *key, FILE *f )
+static int save_all_subkeys( struct key *key, FILE *f )
 {
     fprintf( f, "WINE REGISTRY Version 2\n" );
     fprintf( f, ";; All keys relative to " );
@@ -1762,7 +2388,7 @@ static void save_all_subkeys( struct key *key, FILE *f )
     default:
         break;
     }
-    save_subkeys( key, key, f );
+    return save_subkeys( key, key, f, 0 );
 }
 
 /* save a registry branch to a file handle */
@@ -1779,8 +2405,9 @@ static void save_registry( struct key *key, obj_handle_t handle )
         FILE *f = fdopen( fd, "w" );
         if (f)
         {
-            save_all_subkeys( key, f );
-            if (fclose( f )) file_set_error();
+            /* page_in_key has set the error if a key could not be loaded */
+            if (!save_all_subkeys( key, f )) fclose( f );
+            else if (fclose( f )) file_set_error();
         }
         else
         {
@@ -1790,19 +2417,456 @@ static void save_registry( struct key *key, obj_handle_t handle )
     }
 }
 
-/* save a registry branch to a file */
-static int save_branch( struct key *key, const char *path )
+/* create a temp file in the same directory as the given file */
+static int create_save_file( const char *path, char **tmp )
+{
+    char *p;
+    int fd, count = 0;
+
+    if (!(*tmp = malloc( strlen(path) + 20 ))) return -1;
+    strcpy( *tmp, path );
+    if ((p = strrchr( *tmp, '/' ))) p++;
+    else p = *tmp;
+    for (;;)
+    {
+        sprintf( p, "reg%lx%04x.tmp", (long) getpid(), count++ );
+        if ((fd = open( *tmp, O_CREAT | O_EXCL | O_WRONLY, 0666 )) != -1) return fd;
+        if (errno != EEXIST) break;
+    }
+    free( *tmp );
+    *tmp = NULL;
+    return -1;
+}
+
+/* buffer holding a batch of journal entries */
+struct journal_buffer
+{
+    char          *data;    /* entries data */
+    unsigned int   size;    /* allocated size */
+    unsigned int   pos;     /* current position */
+};
+
+/* allocate space for an item at the end of a journal buffer */
+static void *journal_alloc( struct journal_buffer *buf, unsigned int size )
+{
+    unsigned int padded = (size + 3) & ~3;
+    char *ptr;
+
+    if (padded > buf->size - buf->pos)
+    {
+        unsigned int new_size = max( buf->size * 2, 4096 );
+        char *new_data;
+
+        while (padded > new_size - buf->pos) new_size *= 2;
+        if (!(new_data = realloc( buf->data, new_size )))
+        {
+            set_error( STATUS_NO_MEMORY );
+            return NULL;
+        }
+        buf->data = new_data;
+        buf->size = new_size;
+    }
+    ptr = buf->data + buf->pos;
+    memset( ptr + size, 0, padded - size );
+    buf->pos += padded;
+    return ptr;
+}
+
+/* append an item to a journal buffer */
+static int journal_write( struct journal_buffer *buf, const void *data, unsigned int size )
+{
+    void *ptr;
+
+    if (!(ptr = journal_alloc( buf, size ))) return 0;
+    if (size) memcpy( ptr, data, size );
+    return 1;
+}
+
+/* append the full state of a key to the journal */
+static int journal_key( struct journal_buffer *buf, struct key *key, const struct key *branch )
+{
+    struct journal_key entry;
+    struct journal_value jvalue;
+    struct key *k;
+    WCHAR *path;
+    unsigned int len;
+    int i;
+
+    entry.modif      = key->modif;
+    entry.flags      = key->flags & KEY_HIVE_FLAGS;
+    entry.pathlen    = 0;
+    entry.classlen   = key->classlen;
+    entry.nb_subkeys = 0;
+    entry.nb_values  = key->last_value + 1;
+    entry.reserved   = 0;
+    for (k = key; k != branch; k = k->parent)
+        entry.pathlen += k->namelen + (k->parent != branch ? sizeof(WCHAR) : 0);
+    for (i = 0; i <= key->last_subkey; i++)
+        if (!(key->subkeys[i]->flags & KEY_VOLATILE)) entry.nb_subkeys++;
+
+    if (!journal_write( buf, &entry, sizeof(entry) )) return 0;
+    if (!(path = journal_alloc( buf, entry.pathlen ))) return 0;
+    len = entry.pathlen / sizeof(WCHAR);
+    for (k = key; k != branch; k = k->parent)
+    {
+        len -= k->namelen / sizeof(WCHAR);
+        memcpy( path + len, k->name, k->namelen );
+        if (len) path[--len] = '\\';
+    }
+    if (!journal_write( buf, key->class, key->classlen )) return 0;
+
+    for (i = 0; i <= key->last_subkey; i++)
+    {
+        struct key *subkey = key->subkeys[i];
+
+        if (subkey->flags & KEY_VOLATILE) continue;
+        len = subkey->namelen;
+        if (!journal_write( buf, &len, sizeof(len) )) return 0;
+        if (!journal_write( buf, subkey->name, subkey->namelen )) return 0;
+    }
+    for (i = 0; i <= key->last_value; i++)
+    {
+        jvalue.namelen = key->values[i].namelen;
+        jvalue.type    = key->values[i].type;
+        jvalue.len     = key->values[i].len;
+        if (!journal_write( buf, &jvalue, sizeof(jvalue) )) return 0;
+        if (!journal_write( buf, key->values[i].name, jvalue.namelen )) return 0;
+        if (!journal_write( buf, key->values[i].data, jvalue.len )) return 0;
+    }
+    return 1;
+}
+
+/* append the keys that changed since the last save to the journal, parents first */
+static int journal_changed_keys( struct journal_buffer *buf, struct key *key, const struct key *branch,
+                                 int depth )
+{
+    int i;
+
+    if (key->flags & KEY_VOLATILE) return 1;
+    if ((key->flags & KEY_CHANGED) && !journal_key( buf, key, branch )) return 0;
+    for (i = 0; i <= key->last_subkey; i++)
+    {
+        if (!(key->subkeys[i]->flags & (KEY_DIRTY | KEY_CHANGED))) continue;
+        if (depth >= MAX_KEY_DEPTH)
+        {
+            fprintf( stderr, "wineserver: registry tree too deep, not saving " );
+            dump_path( key->subkeys[i], NULL, stderr );
+            fprintf( stderr, "\n" );
+            continue;
+        }
+        if (!journal_changed_keys( buf, key->subkeys[i], branch, depth + 1 )) return 0;
+    }
+    return 1;
+}
+
+/* save the changes of a branch as a new journal batch */
+static int append_journal( struct hive *hive, struct key *branch )
+{
+    struct journal_buffer buf = { NULL, 0, 0 };
+    struct journal_header *header;
+    ssize_t ret;
+    int res = 0;
+
+    if (!journal_alloc( &buf, sizeof(*header) )) return 0;
+    if (!journal_changed_keys( &buf, branch, branch, 0 )) goto done;
+
+    header = (struct journal_header *)buf.data;
+    header->magic    = JOURNAL_MAGIC;
+    header->sequence = hive->sequence + 1;
+    header->size     = buf.pos - sizeof(*header);
+    header->checksum = get_journal_checksum( header + 1, header->size );
+
+    if (hive->journal_fd == -1 &&
+        (hive->journal_fd = open( hive->journal_path, O_WRONLY | O_CREAT | O_APPEND, 0666 )) == -1)
+        goto done;
+
+    /* the whole batch is written at once, a partial write is discarded on the next load */
+    if ((ret = write( hive->journal_fd, buf.data, buf.pos )) != buf.pos)
+    {
+        if (ret > 0) ftruncate( hive->journal_fd, hive->journal_size );
+        goto done;
+    }
+    /* make sure the batch is on disk before the keys are marked clean */
+    if (fsync( hive->journal_fd ) == -1)
+    {
+        ftruncate( hive->journal_fd, hive->journal_size );
+        goto done;
+    }
+    hive->journal_size += buf.pos;
+    hive->sequence++;
+    res = 1;
+
+done:
+    free( buf.data );
+    return res;
+}
+
+/* a hive file being written */
+struct hive_writer
 {
+    FILE          *file;        /* output file */
+    unsigned int   pos;         /* current position in the file */
+    struct key   **moved;       /* paged out keys whose record has been copied */
+    unsigned int  *moved_pos;   /* new position of the moved keys */
+    unsigned int   nb_moved;    /* number of moved keys */
+    unsigned int   size_moved;  /* allocated size of the moved arrays */
+};
+
+/* write a key record and return its position */
+static int write_hive_record( struct hive_writer *writer, const struct key *key,
+                              const unsigned int *subkeys, unsigned int nb_subkeys,
+                              const struct key_value *values, unsigned int nb_values,
+                              unsigned int *pos )
+{
+    static const char padding[8];
+    struct hive_key rec;
+    struct hive_value hvalue;
+    unsigned int i, name_offset, data_offset;
+
+    name_offset = sizeof(rec) + nb_subkeys * sizeof(*subkeys) + nb_values * sizeof(hvalue) +
+                  key->namelen + key->classlen;
+    data_offset = name_offset;
+    for (i = 0; i < nb_values; i++) data_offset += values[i].namelen;
+
+    rec.modif      = key->modif;
+    rec.size       = data_offset;
+    rec.flags      = key->flags & KEY_HIVE_FLAGS;
+    rec.nb_subkeys = nb_subkeys;
+    rec.nb_values  = nb_values;
+    rec.namelen    = key->namelen;
+    rec.classlen   = key->classlen;
+    rec.reserved   = 0;
+    for (i = 0; i < nb_values; i++) rec.size += values[i].len;
+    if (rec.size > UINT_MAX - writer->pos - 8)
+    {
+        set_error( STATUS_NO_MEMORY );
+        return 0;
+    }
+
+    fwrite( &rec, sizeof(rec), 1, writer->file );
+    fwrite( subkeys, sizeof(*subkeys), nb_subkeys, writer->file );
+    for (i = 0; i < nb_values; i++)
+    {
+        hvalue.namelen = values[i].namelen;
+        hvalue.type    = values[i].type;
+        hvalue.len     = values[i].len;
+        hvalue.name    = name_offset;
+        hvalue.data    = data_offset;
+        fwrite( &hvalue, sizeof(hvalue), 1, writer->file );
+        name_offset += values[i].namelen;
+        data_offset += values[i].len;
+    }
+    fwrite( key->name, key->namelen, 1, writer->file );
+    fwrite( key->class, key->classlen, 1, writer->file );
+    for (i = 0; i < nb_values; i++) fwrite( values[i].name, values[i].namelen, 1, writer->file );
+    for (i = 0; i < nb_values; i++) fwrite( values[i].data, values[i].len, 1, writer->file );
+    fwrite( padding, (8 - rec.size % 8) % 8, 1, writer->file );
+
+    *pos = writer->pos;
+    writer->pos += (rec.size + 7) & ~7;
+    return !ferror( writer->file );
+}
+
+/* copy a record and all its subkeys from the previous hive file */
+static int copy_hive_key( struct hive_writer *writer, const struct hive *hive, unsigned int old_pos,
+                          unsigned int *pos, int depth )
+{
+    const struct hive_key *rec;
+    const struct hive_value *hvalues;
+    const unsigned int *old_subkeys;
+    struct key_value *values = NULL;
+    unsigned int *subkeys = NULL;
+    struct key key;
+    unsigned int i;
+    int ret = 0;
+
+    if (depth > MAX_KEY_DEPTH || !(rec = get_hive_key( hive, old_pos )))
+    {
+        fprintf( stderr, "%s: corrupted key record at %x\n", hive->path, old_pos );
+        set_error( STATUS_REGISTRY_CORRUPT );
+        return 0;
+    }
+    old_subkeys = get_hive_subkeys( rec );
+    /* subkey records are always written before their parent, which also rules out cycles */
+    for (i = 0; i < rec->nb_subkeys; i++)
+    {
+        if (old_subkeys[i] < old_pos) continue;
+        fprintf( stderr, "%s: corrupted key record at %x\n", hive->path, old_subkeys[i] );
+        set_error( STATUS_REGISTRY_CORRUPT );
+        return 0;
+    }
+    hvalues = get_hive_values( rec );
+    if (rec->nb_subkeys && !(subkeys = mem_alloc( rec->nb_subkeys * sizeof(*subkeys) ))) goto done;
+    if (rec->nb_values && !(values = mem_alloc( rec->nb_values * sizeof(*values) ))) goto done;
+
+    for (i = 0; i < rec->nb_subkeys; i++)
+        if (!copy_hive_key( writer, hive, old_subkeys[i], &subkeys[i], depth + 1 )) goto done;
+    for (i = 0; i < rec->nb_values; i++)
+    {
+        values[i].name    = (WCHAR *)((const char *)rec + hvalues[i].name);
+        values[i].namelen = hvalues[i].namelen;
+        values[i].type    = hvalues[i].type;
+        values[i].len     = hvalues[i].len;
+        values[i].data    = (char *)rec + hvalues[i].data;
+    }
+
+    key.modif    = rec->modif;
+    key.flags    = rec->flags;
+    key.name     = (WCHAR *)get_hive_key_name( rec );
+    key.namelen  = rec->namelen;
+    key.class    = key.name + rec->namelen / sizeof(WCHAR);
+    key.classlen = rec->classlen;
+    ret = write_hive_record( writer, &key, subkeys, rec->nb_subkeys, values, rec->nb_values, pos );
+
+done:
+    free( subkeys );
+    free( values );
+    return ret;
+}
+
+/* remember the new record position of a paged out key */
+static int add_moved_key( struct hive_writer *writer, struct key *key, unsigned int pos )
+{
+    if (writer->nb_moved == writer->size_moved)
+    {
+        unsigned int new_size = max( writer->size_moved * 2, 64 );
+        struct key **new_moved;
+        unsigned int *new_pos;
+
+        if (!(new_moved = realloc( writer->moved, new_size * sizeof(*new_moved) ))) goto nomem;
+        writer->moved = new_moved;
+        if (!(new_pos = realloc( writer->moved_pos, new_size * sizeof(*new_pos) ))) goto nomem;
+        writer->moved_pos = new_pos;
+        writer->size_moved = new_size;
+    }
+    writer->moved[writer->nb_moved] = key;
+    writer->moved_pos[writer->nb_moved++] = pos;
+    return 1;
+
+nomem:
+    set_error( STATUS_NO_MEMORY );
+    return 0;
+}
+
+/* write the records of a key and its subkeys, children first */
+static int write_key_record( struct hive_writer *writer, struct key *key, unsigned int *pos, int depth )
+{
+    unsigned int *subkeys = NULL, count = 0;
+    int i, ret = 0;
+
+    if (key->flags & KEY_PAGED_OUT)
+        return copy_hive_key( writer, key->hive, key->hive_pos, pos, depth ) &&
+               add_moved_key( writer, key, *pos );
+
+    if (key->last_subkey >= 0 && !(subkeys = mem_alloc( (key->last_subkey + 1) * sizeof(*subkeys) )))
+        return 0;
+    for (i = 0; i <= key->last_subkey; i++)
+    {
+        if (key->subkeys[i]->flags & KEY_VOLATILE) continue;
+        if (depth >= MAX_KEY_DEPTH)
+        {
+            fprintf( stderr, "wineserver: registry tree too deep, not saving " );
+            dump_path( key->subkeys[i], NULL, stderr );
+            fprintf( stderr, "\n" );
+            continue;
+        }
+        if (!write_key_record( writer, key->subkeys[i], &subkeys[count++], depth + 1 )) goto done;
+    }
+    ret = write_hive_record( writer, key, subkeys, count, key->values, key->last_value + 1, pos );
+
+done:
+    free( subkeys );
+    return ret;
+}
+
+/* write the whole branch to a new hive file, and map it in place of the previous one */
+static int write_hive_file( struct hive *hive, struct key *branch )
+{
+    struct hive_writer writer;
+    struct hive_header header;
     struct stat st;
-    char *p, *tmp = NULL;
-    int fd, count = 0, ret = 0;
-    FILE *f;
+    char *tmp;
+    void *base;
+    unsigned int i;
+    int fd, ret = 0;
 
-    if (!(key->flags & KEY_DIRTY))
+    if ((fd = create_save_file( hive->path, &tmp )) == -1) return 0;
+    if (!(writer.file = fdopen( fd, "wb" )))
     {
-        if (debug_level > 1) dump_operation( key, NULL, "Not saving clean" );
-        return 1;
+        close( fd );
+        unlink( tmp );
+        free( tmp );
+        return 0;
     }
+    writer.pos = sizeof(header);
+    writer.moved = NULL;
+    writer.moved_pos = NULL;
+    writer.nb_moved = writer.size_moved = 0;
+
+    if (debug_level > 1)
+    {
+        fprintf( stderr, "%s: ", hive->path );
+        dump_operation( branch, NULL, "writing hive" );
+    }
+
+    /* the header is written last, once the file contents are known */
+    memset( &header, 0, sizeof(header) );
+    fwrite( &header, sizeof(header), 1, writer.file );
+    if (write_key_record( &writer, branch, &header.root, 0 ))
+    {
+        memcpy( header.magic, HIVE_MAGIC, sizeof(header.magic) );
+        header.version  = HIVE_VERSION;
+        header.arch     = prefix_type;
+        header.size     = writer.pos;
+        header.sequence = hive->sequence;
+        ret = !fseek( writer.file, 0, SEEK_SET ) && fwrite( &header, sizeof(header), 1, writer.file );
+    }
+    /* the new file must be on disk before it replaces the old one */
+    if (ret && (fflush( writer.file ) || fsync( fileno( writer.file ) ) == -1)) ret = 0;
+    if (fclose( writer.file )) ret = 0;
+    if (ret) ret = !rename( tmp, hive->path );
+    if (!ret) unlink( tmp );
+    free( tmp );
+    if (!ret) goto done;
+
+    /* the journal has been merged in the hive file */
+    if (hive->journal_fd != -1) ftruncate( hive->journal_fd, 0 );
+    else unlink( hive->journal_path );
+    hive->journal_size = 0;
+
+    /* switch to the new file; if it can't be mapped, the old mapping stays valid */
+    if ((fd = open( hive->path, O_RDONLY )) == -1) goto done;
+    if (fstat( fd, &st ) != -1 && st.st_size == header.size &&
+        (base = mmap( NULL, header.size, PROT_READ, MAP_PRIVATE, fd, 0 )) != MAP_FAILED)
+    {
+        if (hive->base) munmap( (void *)hive->base, hive->size );
+        hive->base = base;
+        hive->size = header.size;
+        for (i = 0; i < writer.nb_moved; i++) writer.moved[i]->hive_pos = writer.moved_pos[i];
+    }
+    close( fd );
+
+done:
+    free( writer.moved );
+    free( writer.moved_pos );
+    return ret;
+}
+
+/* save a registry branch to its binary hive */
+static int save_hive_branch( struct hive *hive, struct key *branch )
+{
+    /* rewrite the hive once the journal gets too large compared to it */
+    if (!hive->base || hive->journal_size > hive->size / 2) return write_hive_file( hive, branch );
+    return append_journal( hive, branch );
+}
+
+/* save a registry branch to a text file */
+static int save_text_branch( struct key *key, const char *path )
+{
+    struct stat st;
+    char *tmp = NULL;
+    int fd, ret = 0;
+    FILE *f;
 
     /* test the file type */
 
@@ -1820,17 +2884,7 @@ static int save_branch( struct key *key, const char *path )
 
     /* create a temp file in the same directory */
 
-    if (!(tmp = malloc( strlen(path) + 20 ))) goto done;
-    strcpy( tmp, path );
-    if ((p = strrchr( tmp, '/' ))) p++;
-    else p = tmp;
-    for (;;)
-    {
-        sprintf( p, "reg%lx%04x.tmp", (long) getpid(), count++ );
-        if ((fd = open( tmp, O_CREAT | O_EXCL | O_WRONLY, 0666 )) != -1) break;
-        if (errno != EEXIST) goto done;
-        close( fd );
-    }
+    if ((fd = create_save_file( path, &tmp )) == -1) goto done;
 
     /* now save to it */
 
@@ -1842,14 +2896,8 @@ static int save_branch( struct key *key, const char *path )
         goto done;
     }
 
-    if (debug_level > 1)
-    {
-        fprintf( stderr, "%s: ", path );
-        dump_operation( key, NULL, "saving" );
-    }
-
-    save_all_subkeys( key, f );
-    ret = !fclose(f);
+    ret = save_all_subkeys( key, f );
+    if (fclose(f)) ret = 0;
 
     if (tmp)
     {
@@ -1860,6 +2908,29 @@ static int save_branch( struct key *key, const char *path )
 
 done:
     free( tmp );
+    return ret;
+}
+
+/* save a registry branch to its file */
+static int save_branch( struct save_branch_info *info )
+{
+    struct key *key = info->key;
+    int ret;
+
+    if (!(key->flags & KEY_DIRTY))
+    {
+        if (debug_level > 1) dump_operation( key, NULL, "Not saving clean" );
+        return 1;
+    }
+
+    if (debug_level > 1)
+    {
+        fprintf( stderr, "%s: ", info->binary ? info->hive.path : info->path );
+        dump_operation( key, NULL, "saving" );
+    }
+
+    if (info->binary) ret = save_hive_branch( &info->hive, key );
+    else ret = save_text_branch( key, info->path );
     if (ret) make_clean( key );
     return ret;
 }
@@ -1872,7 +2943,7 @@ static void periodic_save( void *arg )
     if (fchdir( config_dir_fd ) == -1) return;
     save_timeout_user = NULL;
     for (i = 0; i < save_branch_count; i++)
-        save_branch( save_branch_info[i].key, save_branch_info[i].path );
+        save_branch( &save_branch_info[i] );
     if (fchdir( server_dir_fd ) == -1) fatal_perror( "chdir to server dir" );
     set_periodic_save_timer();
 }
@@ -1887,21 +2958,62 @@ static void set_periodic_save_timer(void)
 /* save the modified registry branches to disk */
 void flush_registry(void)
 {
-    int i;
+    struct save_branch_info *info;
 
     if (fchdir( config_dir_fd ) == -1) return;
-    for (i = 0; i < save_branch_count; i++)
+    for (info = save_branch_info; info < save_branch_info + save_branch_count; info++)
     {
-        if (!save_branch( save_branch_info[i].key, save_branch_info[i].path ))
+        if (!save_branch( info ))
         {
             fprintf( stderr, "wineserver: could not save registry branch to %s",
-                     save_branch_info[i].path );
+                     info->binary ? info->hive.path : info->path );
             perror( " " );
         }
     }
     if (fchdir( server_dir_fd ) == -1) fatal_perror( "chdir to server dir" );
 }
 
+/* rewrite all the registry branches in the text or binary format, and remove the other files */
+int convert_registry( int binary )
+{
+    struct save_branch_info *info;
+    int ret = 1;
+
+    if (fchdir( config_dir_fd ) == -1) return 0;
+    for (info = save_branch_info; info < save_branch_info + save_branch_count; info++)
+    {
+        if (binary)
+        {
+            if (!write_hive_file( &info->hive, info->key ))
+            {
+                fprintf( stderr, "wineserver: could not save registry branch to %s", info->hive.path );
+                perror( " " );
+                ret = 0;
+                continue;
+            }
+            unlink( info->path );
+        }
+        else
+        {
+            if (!save_text_branch( info->key, info->path ))
+            {
+                fprintf( stderr, "wineserver: could not save registry branch to %s", info->path );
+                perror( " " );
+                ret = 0;
+                continue;
+            }
+            if (info->hive.journal_fd != -1) close( info->hive.journal_fd );
+            info->hive.journal_fd = -1;
+            unlink( info->hive.path );
+            unlink( info->hive.journal_path );
+        }
+        info->binary = binary;
+        make_clean( info->key );
+    }
+    if (fchdir( server_dir_fd ) == -1) fatal_perror( "chdir to server dir" );
+    return ret;
+}
+
 /* determine if the thread is wow64 (32-bit client running on 64-bit prefix) */
 static int is_wow64_thread( struct thread *thread )
 {
@@ -47,6 +47,12 @@
 #ifdef HAVE_SYS_UN_H
 #include <sys/un.h>
 #endif
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+#ifdef HAVE_SYS_SYSCALL_H
+#include <sys/syscall.h>
+#endif
 #include <unistd.h>
 #ifdef HAVE_POLL_H
 #include <poll.h>
@@ -70,6 +76,9 @@
 #define SCM_RIGHTS 1
 #endif
 
+/* size of the request data buffer allocated for each thread, most requests fit in it */
+#define INITIAL_REQ_DATA_SIZE 512
+
 /* path names for server master Unix socket */
 static const char * const server_socket_name = "socket";   /* name of the socket file */
 static const char * const server_lock_name = "lock";       /* name of the server lock file */
@@ -212,6 +221,73 @@ void write_reply( struct thread *thread )
         fatal_protocol_perror( thread, "reply write" );
 }
 
+#if defined(__linux__) && defined(HAVE_SYS_MMAN_H) && defined(__NR_futex)
+
+/* wake up a client sleeping on the reply sequence number */
+static inline void futex_wake( int *addr )
+{
+    syscall( __NR_futex, addr, 1 /* FUTEX_WAKE */, 1, NULL, 0, 0 );
+}
+
+/* create a shared memory area used to return replies to a thread */
+struct request_shm *create_request_shm( int *fd )
+{
+    struct request_shm *shm;
+
+    if ((*fd = create_temp_file( REQUEST_SHM_SIZE )) == -1) return NULL;
+    shm = mmap( NULL, REQUEST_SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, *fd, 0 );
+    if (shm == MAP_FAILED)
+    {
+        file_set_error();
+        close( *fd );
+        return NULL;
+    }
+    return shm;
+}
+
+/* free the shared memory area of a thread */
+void free_request_shm( struct thread *thread )
+{
+    if (!thread->request_shm) return;
+    munmap( thread->request_shm, REQUEST_SHM_SIZE );
+    thread->request_shm = NULL;
+}
+
+/* store the reply in the shared memory area and wake up the client if necessary */
+static void send_reply_shm( struct request_shm *shm, union generic_reply *reply )
+{
+    char *ptr = (char *)(shm + 1);
+
+    memcpy( ptr, reply, sizeof(*reply) );
+    if (current->reply_size) memcpy( ptr + sizeof(*reply), current->reply_data, current->reply_size );
+    free( current->reply_data );
+    current->reply_data = NULL;
+
+    /* the client sets the waiting flag before checking the sequence number, */
+    /* so one of us is guaranteed to see the other's update */
+    interlocked_xchg_add( &shm->seq, 1 );
+    if (interlocked_xchg( &shm->waiting, 0 )) futex_wake( &shm->seq );
+}
+
+#else  /* __linux__ */
+
+struct request_shm *create_request_shm( int *fd )
+{
+    set_error( STATUS_NOT_SUPPORTED );
+    return NULL;
+}
+
+void free_request_shm( struct thread *thread )
+{
+}
+
+static void send_reply_shm( struct request_shm *shm, union generic_reply *reply )
+{
+    assert( 0 );
+}
+
+#endif  /* __linux__ */
+
 /* send a reply to the current thread */
 static void send_reply( union generic_reply *reply )
 {
@@ -254,11 +330,274 @@ static void send_reply( union generic_reply *reply )
         fatal_protocol_perror( current, "reply write" );
 }
 
+/* per-process request statistics, kept without a histogram to save memory */
+struct process_request_stats
+{
+    unsigned __int64 total_time;   /* total time spent in the handler, in microseconds */
+    unsigned __int64 reply_bytes;  /* total size of the replies */
+    unsigned int     count;        /* number of calls */
+    unsigned int     max_time;     /* longest time spent in the handler, in microseconds */
+};
+
+static struct request_stats req_stats[REQ_NB_REQUESTS];  /* server-wide request statistics */
+
+/* return the time in microseconds, for measuring the handler times */
+static inline unsigned __int64 get_stats_time(void)
+{
+    struct timeval now;
+    gettimeofday( &now, NULL );
+    return (unsigned __int64)now.tv_sec * 1000000 + now.tv_usec;
+}
+
+/* account a request call in the server-wide and per-process statistics */
+static void update_request_stats( struct process *process, enum request req,
+                                  unsigned int time, data_size_t reply_size )
+{
+    struct request_stats *stats = &req_stats[req];
+    unsigned int bucket = 0;
+
+    while (bucket < REQUEST_STATS_BUCKETS - 1 && (time >> bucket)) bucket++;
+    stats->count++;
+    stats->total_time += time;
+    stats->reply_bytes += reply_size;
+    if (time > stats->max_time) stats->max_time = time;
+    stats->histogram[bucket]++;
+
+    if (!process->req_stats &&
+        !(process->req_stats = calloc( REQ_NB_REQUESTS, sizeof(*process->req_stats) )))
+        return;
+    process->req_stats[req].count++;
+    process->req_stats[req].total_time += time;
+    process->req_stats[req].reply_bytes += reply_size;
+    if (time > process->req_stats[req].max_time) process->req_stats[req].max_time = time;
+}
+
+/* free the request statistics of a process */
+void free_process_request_stats( struct process *process )
+{
+    free( process->req_stats );
+    process->req_stats = NULL;
+}
+
+/* compare two request types by total handler time, for sorting the statistics dump */
+static int compare_request_stats( const void *p1, const void *p2 )
+{
+    const struct request_stats *stats1 = &req_stats[*(const enum request *)p1];
+    const struct request_stats *stats2 = &req_stats[*(const enum request *)p2];
+
+    if (stats1->total_time > stats2->total_time) return -1;
+    if (stats1->total_time < stats2->total_time) return 1;
+    if (stats1->count > stats2->count) return -1;
+    if (stats1->count < stats2->count) return 1;
+    return 0;
+}
+
+/* dump the server-wide request statistics to stderr, busiest requests first */
+void dump_request_stats(void)
+{
+    enum request order[REQ_NB_REQUESTS];
+    unsigned int i, j, count = 0;
+
+    for (i = 0; i < REQ_NB_REQUESTS; i++) if (req_stats[i].count) order[count++] = i;
+    qsort( order, count, sizeof(order[0]), compare_request_stats );
+
+    fprintf( stderr, "%-30s %10s %12s %10s %10s %12s  histogram (log2 usec)\n",
+             "request", "count", "total usec", "avg usec", "max usec", "reply bytes" );
+    for (i = 0; i < count; i++)
+    {
+        const struct request_stats *stats = &req_stats[order[i]];
+
+        fprintf( stderr, "%-30s %10u %12.0f %10u %10u %12.0f ", req_names[order[i]], stats->count,
+                 (double)stats->total_time, (unsigned int)(stats->total_time / stats->count),
+                 stats->max_time, (double)stats->reply_bytes );
+        for (j = 0; j < REQUEST_STATS_BUCKETS; j++)
+            if (stats->histogram[j]) fprintf( stderr, " %u:%u", j, stats->histogram[j] );
+        fputc( '\n', stderr );
+    }
+}
+
+/* retrieve the request statistics of the server or of a process */
+DECL_HANDLER(get_server_stats)
+{
+    struct process *process = NULL;
+    struct request_stats *stats;
+    unsigned int i, count = 0;
+    data_size_t size;
+
+    if (req->pid && !(process = get_process_from_id( req->pid ))) return;
+
+    for (i = 0; i < REQ_NB_REQUESTS; i++) if (req_stats[i].count) count++;
+    reply->total = count;
+
+    size = min( count, get_reply_max_size() / sizeof(*stats) );
+    if (size && (stats = set_reply_data_size( size * sizeof(*stats) )))
+    {
+        memset( stats, 0, size * sizeof(*stats) );
+        for (i = 0; i < REQ_NB_REQUESTS && size; i++)
+        {
+            if (!req_stats[i].count) continue;
+            if (process)
+            {
+                /* only the totals are kept per process */
+                if (process->req_stats)
+                {
+                    stats->total_time  = process->req_stats[i].total_time;
+                    stats->reply_bytes = process->req_stats[i].reply_bytes;
+                    stats->count       = process->req_stats[i].count;
+                    stats->max_time    = process->req_stats[i].max_time;
+                }
+            }
+            else *stats = req_stats[i];
+            strcpy( stats->name, req_names[i] );
+            stats++;
+            size--;
+        }
+    }
+    if (process) release_object( process );
+}
+
+/* check if a request can be executed as part of a batch */
+/* only requests that can't block, don't transfer file descriptors and */
+/* don't require the client to update its own state are allowed */
+static int is_batchable_request( enum request req )
+{
+    switch (req)
+    {
+    /* handles and objects */
+    case REQ_set_handle_info:
+    case REQ_get_object_info:
+    case REQ_open_symlink:
+    case REQ_query_symlink:
+    case REQ_get_token_statistics:
+    /* synchronization objects */
+    case REQ_open_event:
+    case REQ_event_op:
+    case REQ_open_mutex:
+    case REQ_release_mutex:
+    case REQ_open_semaphore:
+    case REQ_release_semaphore:
+    /* registry */
+    case REQ_open_key:
+    case REQ_enum_key:
+    case REQ_set_key_value:
+    case REQ_get_key_value:
+    case REQ_enum_key_value:
+    case REQ_delete_key_value:
+    /* windows */
+    case REQ_get_window_info:
+    case REQ_set_window_info:
+    case REQ_get_window_parents:
+    case REQ_get_window_children:
+    case REQ_get_window_tree:
+    case REQ_get_window_rectangles:
+    case REQ_get_window_text:
+    case REQ_get_window_property:
+    case REQ_get_window_properties:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/* execute the requests of a batch on behalf of the current thread */
+DECL_HANDLER(call_batch)
+{
+    struct thread *thread = current;
+    const char *ptr = get_req_data();
+    const char *end = ptr + get_req_data_size();
+    union generic_request batch_req = current->req;
+    data_size_t reply_max = get_reply_max_size(), reply_pos = 0;
+    unsigned int count = 0, error = STATUS_SUCCESS;
+    char *replies = NULL;
+
+    if (reply_max && !(replies = mem_alloc( reply_max ))) return;
+
+    while (ptr < end)
+    {
+        const union generic_request *request = (const union generic_request *)ptr;
+        union generic_reply request_reply;
+        enum request req_code;
+        data_size_t size;
+        unsigned __int64 start_time;
+
+        if (end - ptr < sizeof(*request) ||
+            (size = request->request_header.request_size) > end - ptr - sizeof(*request) ||
+            !is_batchable_request( (req_code = request->request_header.req) ))
+        {
+            error = STATUS_INVALID_PARAMETER;
+            break;
+        }
+        if (reply_max - reply_pos < sizeof(request_reply) ||
+            BATCH_DATA_ALIGN( request->request_header.reply_size ) >
+            reply_max - reply_pos - sizeof(request_reply))
+        {
+            error = STATUS_BUFFER_TOO_SMALL;
+            break;
+        }
+
+        /* make the request look like it was received on its own; the request data */
+        /* buffer is left alone, it is still owned by the thread if the handler kills it */
+        memcpy( &thread->req, request, sizeof(*request) );
+        thread->batch_data = request + 1;
+        thread->reply_data = NULL;
+        thread->reply_size = 0;
+        clear_error();
+        memset( &request_reply, 0, sizeof(request_reply) );
+
+        start_time = get_stats_time();
+        req_handlers[req_code]( &thread->req, &request_reply );
+        thread->batch_data = NULL;
+        /* the time is also accounted to the call_batch request itself */
+        update_request_stats( thread->process, req_code, get_stats_time() - start_time,
+                              current ? sizeof(request_reply) + current->reply_size : 0 );
+        if (!current) break;  /* the thread has been killed */
+
+        request_reply.reply_header.error = current->error;
+        request_reply.reply_header.reply_size = current->reply_size;
+        memcpy( replies + reply_pos, &request_reply, sizeof(request_reply) );
+        reply_pos += sizeof(request_reply);
+        if (current->reply_size)
+        {
+            memcpy( replies + reply_pos, current->reply_data, current->reply_size );
+            memset( replies + reply_pos + current->reply_size, 0,
+                    BATCH_DATA_ALIGN( current->reply_size ) - current->reply_size );
+            reply_pos += BATCH_DATA_ALIGN( current->reply_size );
+        }
+        free( current->reply_data );
+        current->reply_data = NULL;
+        current->reply_size = 0;
+        count++;
+        if (current->error) break;
+        ptr += sizeof(*request) + BATCH_DATA_ALIGN( size );
+    }
+
+    if (!current)
+    {
+        free( replies );
+        return;
+    }
+    memcpy( &thread->req, &batch_req, sizeof(batch_req) );
+
+    /* the replies of the requests executed before an error are returned too */
+    clear_error();
+    set_error( error );
+    reply->count = count;
+    if (reply_pos) set_reply_data_ptr( replies, reply_pos );
+    else free( replies );
+}
+
 /* call a request handler */
 static void call_req_handler( struct thread *thread )
 {
     union generic_reply reply;
     enum request req = thread->req.request_header.req;
+    struct request_shm *shm = NULL;
+    unsigned __int64 start_time = get_stats_time();
+    data_size_t reply_size = 0;
+
+    /* the client expects the reply in the shared area if it has one and the reply can fit */
+    if (thread->request_shm && thread->req.request_header.reply_size <= REQUEST_SHM_MAX_REPLY_SIZE)
+        shm = thread->request_shm;
 
     current = thread;
     current->reply_size = 0;
@@ -276,10 +615,12 @@ static void call_req_handler( struct thread *thread )
     {
         if (current->reply_fd)
         {
+            reply_size = sizeof(reply) + current->reply_size;
             reply.reply_header.error = current->error;
             reply.reply_header.reply_size = current->reply_size;
             if (debug_level) trace_reply( req, &reply );
-            send_reply( &reply );
+            if (shm) send_reply_shm( shm, &reply );
+            else send_reply( &reply );
         }
         else
         {
@@ -288,6 +629,39 @@ static void call_req_handler( struct thread *thread )
         }
     }
     current = NULL;
+
+    if (req < REQ_NB_REQUESTS)
+        update_request_stats( thread->process, req, get_stats_time() - start_time, reply_size );
+}
+
+/* make sure the request data buffer of a thread can hold at least size bytes */
+static int grow_req_data( struct thread *thread, unsigned int size )
+{
+    void *data;
+
+    if (size <= thread->req_data_size) return 1;
+    if (!(data = realloc( thread->req_data, size ))) return 0;
+    thread->req_data = data;
+    thread->req_data_size = size;
+    return 1;
+}
+
+/* handle a request once it has been read entirely */
+static void handle_request( struct thread *thread )
+{
+    call_req_handler( thread );
+
+    /* don't keep the buffer of a large request around, most requests fit in the initial size */
+    if (thread->req_data_size > INITIAL_REQ_DATA_SIZE)
+    {
+        void *data = realloc( thread->req_data, INITIAL_REQ_DATA_SIZE );
+
+        if (data)
+        {
+            thread->req_data = data;
+            thread->req_data_size = INITIAL_REQ_DATA_SIZE;
+        }
+    }
 }
 
 /* read a request from a thread */
@@ -297,23 +671,37 @@ void read_request( struct thread *thread )
 
     if (!thread->req_toread)  /* no pending request */
     {
-        if ((ret = read( get_unix_fd( thread->request_fd ), &thread->req,
-                         sizeof(thread->req) )) != sizeof(thread->req)) goto error;
-        if (!(thread->req_toread = thread->req.request_header.request_size))
+        struct iovec vec[2];
+        unsigned int size;
+
+        /* The client doesn't send anything else until it gets the reply, so we can read
+         * the fixed part and whatever fits of the variable data in a single call. The
+         * buffer is kept across requests to avoid a malloc/free pair for each of them. */
+        if (!grow_req_data( thread, INITIAL_REQ_DATA_SIZE )) goto nomem;
+        vec[0].iov_base = &thread->req;
+        vec[0].iov_len  = sizeof(thread->req);
+        vec[1].iov_base = thread->req_data;
+        vec[1].iov_len  = thread->req_data_size;
+        if ((ret = readv( get_unix_fd( thread->request_fd ), vec, 2 )) < (int)sizeof(thread->req))
+            goto error;
+        size = thread->req.request_header.request_size;
+        ret -= sizeof(thread->req);
+        if ((unsigned int)ret > size)
         {
-            /* no data, handle request at once */
-            call_req_handler( thread );
+            fatal_protocol_error( thread, "request %d too long (%d > %u)\n",
+                                  thread->req.request_header.req, ret, size );
             return;
         }
-        if (!(thread->req_data = malloc( thread->req_toread )))
+        if (!(thread->req_toread = size - ret))
         {
-            fatal_protocol_error( thread, "no memory for %u bytes request %d\n",
-                                  thread->req_toread, thread->req.request_header.req );
+            /* got everything, handle request at once */
+            handle_request( thread );
             return;
         }
+        if (!grow_req_data( thread, size )) goto nomem;
     }
 
-    /* read the variable sized data */
+    /* read the rest of the variable sized data */
     for (;;)
     {
         ret = read( get_unix_fd( thread->request_fd ),
@@ -323,9 +711,7 @@ void read_request( struct thread *thread )
         if (ret <= 0) break;
         if (!(thread->req_toread -= ret))
         {
-            call_req_handler( thread );
-            free( thread->req_data );
-            thread->req_data = NULL;
+            handle_request( thread );
             return;
         }
     }
@@ -337,6 +723,11 @@ error:
         fatal_protocol_error( thread, "partial read %d\n", ret );
     else if (errno != EWOULDBLOCK && errno != EAGAIN)
         fatal_protocol_perror( thread, "read" );
+    return;
+
+nomem:
+    fatal_protocol_error( thread, "no memory for %u bytes request %d\n",
+                          thread->req.request_header.request_size, thread->req.request_header.req );
 }
 
 /* receive a file descriptor on the process socket */
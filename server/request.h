@@ -55,6 +55,8 @@ extern int receive_fd( struct process *process );
 extern int send_client_fd( struct process *process, int fd, obj_handle_t handle );
 extern void read_request( struct thread *thread );
 extern void write_reply( struct thread *thread );
+extern struct request_shm *create_request_shm( int *fd );
+extern void free_request_shm( struct thread *thread );
 extern unsigned int get_tick_count(void);
 extern void open_master_socket(void);
 extern void close_master_socket( timeout_t timeout );
@@ -63,12 +65,17 @@ extern int wait_for_lock(void);
 extern int kill_lock_owner( int sig );
 extern int server_dir_fd, config_dir_fd;
 
+extern void dump_request_stats(void);
+extern void free_process_request_stats( struct process *process );
+
+extern const char * const req_names[REQ_NB_REQUESTS];
 extern void trace_request(void);
 extern void trace_reply( enum request req, const union generic_reply *reply );
 
 /* get the request vararg data */
 static inline const void *get_req_data(void)
 {
+    if (current->batch_data) return current->batch_data;
     return current->req_data;
 }
 
@@ -117,6 +124,10 @@ DECL_HANDLER(new_thread);
 DECL_HANDLER(get_startup_info);
 DECL_HANDLER(init_process_done);
 DECL_HANDLER(init_thread);
+DECL_HANDLER(create_request_shm);
+DECL_HANDLER(get_sync_shm);
+DECL_HANDLER(get_server_stats);
+DECL_HANDLER(call_batch);
 DECL_HANDLER(terminate_process);
 DECL_HANDLER(terminate_thread);
 DECL_HANDLER(get_process_info);
@@ -230,6 +241,7 @@ DECL_HANDLER(set_atom_information);
 DECL_HANDLER(empty_atom_table);
 DECL_HANDLER(init_atom_table);
 DECL_HANDLER(get_msg_queue);
+DECL_HANDLER(get_queue_ring);
 DECL_HANDLER(set_queue_fd);
 DECL_HANDLER(set_queue_mask);
 DECL_HANDLER(get_queue_status);
@@ -255,6 +267,7 @@ DECL_HANDLER(get_named_pipe_info);
 DECL_HANDLER(create_window);
 DECL_HANDLER(destroy_window);
 DECL_HANDLER(get_desktop_window);
+DECL_HANDLER(get_desktop_shm);
 DECL_HANDLER(set_window_owner);
 DECL_HANDLER(get_window_info);
 DECL_HANDLER(set_window_info);
@@ -366,6 +379,10 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_get_startup_info,
     (req_handler)req_init_process_done,
     (req_handler)req_init_thread,
+    (req_handler)req_create_request_shm,
+    (req_handler)req_get_sync_shm,
+    (req_handler)req_get_server_stats,
+    (req_handler)req_call_batch,
     (req_handler)req_terminate_process,
     (req_handler)req_terminate_thread,
     (req_handler)req_get_process_info,
@@ -479,6 +496,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_empty_atom_table,
     (req_handler)req_init_atom_table,
     (req_handler)req_get_msg_queue,
+    (req_handler)req_get_queue_ring,
     (req_handler)req_set_queue_fd,
     (req_handler)req_set_queue_mask,
     (req_handler)req_get_queue_status,
@@ -504,6 +522,7 @@ static const req_handler req_handlers[REQ_NB_REQUESTS] =
     (req_handler)req_create_window,
     (req_handler)req_destroy_window,
     (req_handler)req_get_desktop_window,
+    (req_handler)req_get_desktop_shm,
     (req_handler)req_set_window_owner,
     (req_handler)req_get_window_info,
     (req_handler)req_set_window_info,
@@ -687,6 +706,19 @@ C_ASSERT( FIELD_OFFSET(struct init_thread_reply, info_size) == 24 );
 C_ASSERT( FIELD_OFFSET(struct init_thread_reply, version) == 28 );
 C_ASSERT( FIELD_OFFSET(struct init_thread_reply, all_cpus) == 32 );
 C_ASSERT( sizeof(struct init_thread_reply) == 40 );
+C_ASSERT( sizeof(struct create_request_shm_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct create_request_shm_reply, size) == 8 );
+C_ASSERT( sizeof(struct create_request_shm_reply) == 16 );
+C_ASSERT( sizeof(struct get_sync_shm_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_sync_shm_reply, size) == 8 );
+C_ASSERT( sizeof(struct get_sync_shm_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_server_stats_request, pid) == 12 );
+C_ASSERT( sizeof(struct get_server_stats_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_server_stats_reply, total) == 8 );
+C_ASSERT( sizeof(struct get_server_stats_reply) == 16 );
+C_ASSERT( sizeof(struct call_batch_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct call_batch_reply, count) == 8 );
+C_ASSERT( sizeof(struct call_batch_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct terminate_process_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct terminate_process_request, exit_code) == 16 );
 C_ASSERT( sizeof(struct terminate_process_request) == 24 );
@@ -816,7 +848,9 @@ C_ASSERT( FIELD_OFFSET(struct create_event_request, manual_reset) == 20 );
 C_ASSERT( FIELD_OFFSET(struct create_event_request, initial_state) == 24 );
 C_ASSERT( sizeof(struct create_event_request) == 32 );
 C_ASSERT( FIELD_OFFSET(struct create_event_reply, handle) == 8 );
-C_ASSERT( sizeof(struct create_event_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct create_event_reply, shm_index) == 12 );
+C_ASSERT( FIELD_OFFSET(struct create_event_reply, shm_serial) == 16 );
+C_ASSERT( sizeof(struct create_event_reply) == 24 );
 C_ASSERT( FIELD_OFFSET(struct event_op_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct event_op_request, op) == 16 );
 C_ASSERT( sizeof(struct event_op_request) == 24 );
@@ -848,7 +882,9 @@ C_ASSERT( FIELD_OFFSET(struct create_semaphore_request, initial) == 20 );
 C_ASSERT( FIELD_OFFSET(struct create_semaphore_request, max) == 24 );
 C_ASSERT( sizeof(struct create_semaphore_request) == 32 );
 C_ASSERT( FIELD_OFFSET(struct create_semaphore_reply, handle) == 8 );
-C_ASSERT( sizeof(struct create_semaphore_reply) == 16 );
+C_ASSERT( FIELD_OFFSET(struct create_semaphore_reply, shm_index) == 12 );
+C_ASSERT( FIELD_OFFSET(struct create_semaphore_reply, shm_serial) == 16 );
+C_ASSERT( sizeof(struct create_semaphore_reply) == 24 );
 C_ASSERT( FIELD_OFFSET(struct release_semaphore_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct release_semaphore_request, count) == 16 );
 C_ASSERT( sizeof(struct release_semaphore_request) == 24 );
@@ -1103,8 +1139,7 @@ C_ASSERT( FIELD_OFFSET(struct read_directory_changes_request, async) == 24 );
 C_ASSERT( sizeof(struct read_directory_changes_request) == 64 );
 C_ASSERT( FIELD_OFFSET(struct read_change_request, handle) == 12 );
 C_ASSERT( sizeof(struct read_change_request) == 16 );
-C_ASSERT( FIELD_OFFSET(struct read_change_reply, action) == 8 );
-C_ASSERT( sizeof(struct read_change_reply) == 16 );
+C_ASSERT( sizeof(struct read_change_reply) == 8 );
 C_ASSERT( FIELD_OFFSET(struct create_mapping_request, access) == 12 );
 C_ASSERT( FIELD_OFFSET(struct create_mapping_request, attributes) == 16 );
 C_ASSERT( FIELD_OFFSET(struct create_mapping_request, protect) == 20 );
@@ -1349,6 +1384,9 @@ C_ASSERT( sizeof(struct init_atom_table_reply) == 16 );
 C_ASSERT( sizeof(struct get_msg_queue_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_msg_queue_reply, handle) == 8 );
 C_ASSERT( sizeof(struct get_msg_queue_reply) == 16 );
+C_ASSERT( sizeof(struct get_queue_ring_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_queue_ring_reply, handle) == 8 );
+C_ASSERT( sizeof(struct get_queue_ring_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_queue_fd_request, handle) == 12 );
 C_ASSERT( sizeof(struct set_queue_fd_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_queue_mask_request, wake_mask) == 12 );
@@ -1510,6 +1548,9 @@ C_ASSERT( sizeof(struct get_desktop_window_request) == 16 );
 C_ASSERT( FIELD_OFFSET(struct get_desktop_window_reply, top_window) == 8 );
 C_ASSERT( FIELD_OFFSET(struct get_desktop_window_reply, msg_window) == 12 );
 C_ASSERT( sizeof(struct get_desktop_window_reply) == 16 );
+C_ASSERT( sizeof(struct get_desktop_shm_request) == 16 );
+C_ASSERT( FIELD_OFFSET(struct get_desktop_shm_reply, handle) == 8 );
+C_ASSERT( sizeof(struct get_desktop_shm_reply) == 16 );
 C_ASSERT( FIELD_OFFSET(struct set_window_owner_request, handle) == 12 );
 C_ASSERT( FIELD_OFFSET(struct set_window_owner_request, owner) == 16 );
 C_ASSERT( sizeof(struct set_window_owner_request) == 24 );
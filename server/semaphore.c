@@ -38,9 +38,11 @@
 
 struct semaphore
 {
-    struct object  obj;    /* object header */
-    unsigned int   count;  /* current count */
-    unsigned int   max;    /* maximum possible count */
+    struct object    obj;       /* object header */
+    unsigned int     count;     /* current count */
+    unsigned int     max;       /* maximum possible count */
+    struct sync_shm *shm;       /* shared memory holding the count, if any */
+    unsigned int     shm_index; /* index of the count in the shared memory */
 };
 
 static void semaphore_dump( struct object *obj, int verbose );
@@ -49,14 +51,17 @@ static int semaphore_signaled( struct object *obj, struct thread *thread );
 static int semaphore_satisfied( struct object *obj, struct thread *thread );
 static unsigned int semaphore_map_access( struct object *obj, unsigned int access );
 static int semaphore_signal( struct object *obj, unsigned int access );
+static int semaphore_add_queue( struct object *obj, struct wait_queue_entry *entry );
+static void semaphore_remove_queue( struct object *obj, struct wait_queue_entry *entry );
+static void semaphore_destroy( struct object *obj );
 
 static const struct object_ops semaphore_ops =
 {
     sizeof(struct semaphore),      /* size */
     semaphore_dump,                /* dump */
     semaphore_get_type,            /* get_type */
-    add_queue,                     /* add_queue */
-    remove_queue,                  /* remove_queue */
+    semaphore_add_queue,           /* add_queue */
+    semaphore_remove_queue,        /* remove_queue */
     semaphore_signaled,            /* signaled */
     semaphore_satisfied,           /* satisfied */
     semaphore_signal,              /* signal */
@@ -67,10 +72,18 @@ static const struct object_ops semaphore_ops =
     no_lookup_name,                /* lookup_name */
     no_open_file,                  /* open_file */
     no_close_handle,               /* close_handle */
-    no_destroy                     /* destroy */
+    semaphore_destroy              /* destroy */
 };
 
 
+/* retrieve the current count, which lives in the shared memory if there is one */
+static inline unsigned int get_semaphore_count( struct semaphore *sem )
+{
+    if (!sem->shm) return sem->count;
+    return SYNC_SHM_COUNT( get_sync_shm_entry( sem->shm, sem->shm_index )->state );
+}
+
+
 static struct semaphore *create_semaphore( struct directory *root, const struct unicode_str *name,
                                            unsigned int attr, unsigned int initial, unsigned int max,
                                            const struct security_descriptor *sd )
@@ -89,6 +102,7 @@ static struct semaphore *create_semaphore( struct directory *root, const struct
             /* initialize it if it didn't already exist */
             sem->count = initial;
             sem->max   = max;
+            sem->shm   = NULL;
             if (sd) default_set_sd( &sem->obj, sd, OWNER_SECURITY_INFORMATION|
                                                    GROUP_SECURITY_INFORMATION|
                                                    DACL_SECURITY_INFORMATION|
@@ -98,9 +112,32 @@ static struct semaphore *create_semaphore( struct directory *root, const struct
     return sem;
 }
 
+/* move the count of a newly created semaphore to the shared memory of the process */
+static void semaphore_use_sync_shm( struct semaphore *sem, struct process *process )
+{
+    int index = alloc_sync_shm_entry( process, SYNC_SHM_SEMAPHORE, sem->count, sem->max, &sem->shm );
+    if (index != -1) sem->shm_index = index;
+}
+
 static int release_semaphore( struct semaphore *sem, unsigned int count,
                               unsigned int *prev )
 {
+    if (sem->shm)
+    {
+        int overflow;
+        unsigned int old = sync_shm_add_count( get_sync_shm_entry( sem->shm, sem->shm_index ),
+                                               count, sem->max, &overflow );
+        if (prev) *prev = old;
+        if (overflow)
+        {
+            set_error( STATUS_SEMAPHORE_LIMIT_EXCEEDED );
+            return 0;
+        }
+        /* there cannot be any thread to wake up if the count was != 0 */
+        if (!old) wake_up( &sem->obj, count );
+        return 1;
+    }
+
     if (prev) *prev = sem->count;
     if (sem->count + count < sem->count || sem->count + count > sem->max)
     {
@@ -124,7 +161,7 @@ static void semaphore_dump( struct object *obj, int verbose )
 {
     struct semaphore *sem = (struct semaphore *)obj;
     assert( obj->ops == &semaphore_ops );
-    fprintf( stderr, "Semaphore count=%d max=%d ", sem->count, sem->max );
+    fprintf( stderr, "Semaphore count=%d max=%d ", get_semaphore_count( sem ), sem->max );
     dump_object_name( &sem->obj );
     fputc( '\n', stderr );
 }
@@ -140,18 +177,50 @@ static int semaphore_signaled( struct object *obj, struct thread *thread )
 {
     struct semaphore *sem = (struct semaphore *)obj;
     assert( obj->ops == &semaphore_ops );
-    return (sem->count > 0);
+    return (get_semaphore_count( sem ) > 0);
 }
 
 static int semaphore_satisfied( struct object *obj, struct thread *thread )
 {
     struct semaphore *sem = (struct semaphore *)obj;
     assert( obj->ops == &semaphore_ops );
+    if (sem->shm)
+    {
+        /* we have a waiter queued, so the client won't touch the count */
+        struct sync_shm_entry *entry = get_sync_shm_entry( sem->shm, sem->shm_index );
+        assert( SYNC_SHM_COUNT( entry->state ));
+        sync_shm_set_count( entry, SYNC_SHM_COUNT( entry->state ) - 1 );
+        return 0;
+    }
     assert( sem->count );
     sem->count--;
     return 0;  /* not abandoned */
 }
 
+/* keep track of the server waiters so that the client leaves the shared count alone */
+static int semaphore_add_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+    if (sem->shm) sync_shm_add_waiter( get_sync_shm_entry( sem->shm, sem->shm_index ), 1 );
+    return add_queue( obj, entry );
+}
+
+static void semaphore_remove_queue( struct object *obj, struct wait_queue_entry *entry )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+    remove_queue( obj, entry );
+    if (sem->shm) sync_shm_add_waiter( get_sync_shm_entry( sem->shm, sem->shm_index ), -1 );
+}
+
+static void semaphore_destroy( struct object *obj )
+{
+    struct semaphore *sem = (struct semaphore *)obj;
+    assert( obj->ops == &semaphore_ops );
+    if (sem->shm) free_sync_shm_entry( sem->shm, sem->shm_index );
+}
+
 static unsigned int semaphore_map_access( struct object *obj, unsigned int access )
 {
     if (access & GENERIC_READ)    access |= STANDARD_RIGHTS_READ | SYNCHRONIZE;
@@ -199,7 +268,19 @@ DECL_HANDLER(create_semaphore)
         if (get_error() == STATUS_OBJECT_NAME_EXISTS)
             reply->handle = alloc_handle( current->process, sem, req->access, req->attributes );
         else
+        {
             reply->handle = alloc_handle_no_access_check( current->process, sem, req->access, req->attributes );
+            /* the client fast path needs to both release and wait on the handle */
+            if (reply->handle &&
+                (get_handle_access( current->process, reply->handle ) & (SEMAPHORE_MODIFY_STATE | SYNCHRONIZE)) ==
+                (SEMAPHORE_MODIFY_STATE | SYNCHRONIZE))
+                semaphore_use_sync_shm( sem, current->process );
+            if (sem->shm)
+            {
+                reply->shm_index  = sem->shm_index;
+                reply->shm_serial = get_sync_shm_entry( sem->shm, sem->shm_index )->serial;
+            }
+        }
         release_object( sem );
     }
 
@@ -301,7 +301,10 @@ static int sock_dispatch_asyncs( struct sock *sock, int event, int error )
         if ( event & (POLLIN|POLLPRI) && async_waiting( sock->read_q ) )
         {
             if (debug_level) fprintf( stderr, "activating read queue for socket %p\n", sock );
-            async_wake_up( sock->read_q, STATUS_ALERTED );
+            /* each pending receive gets its own datagram, so skip the ones already woken up; */
+            /* the socket stays readable while datagrams are left, waking the next one */
+            if (sock->type == SOCK_DGRAM) async_wake_up_waiting( sock->read_q, STATUS_ALERTED );
+            else async_wake_up( sock->read_q, STATUS_ALERTED );
             event &= ~(POLLIN|POLLPRI);
         }
         if ( event & POLLOUT && async_waiting( sock->write_q ) )
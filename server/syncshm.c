@@ -0,0 +1,231 @@
+/*
+ * Server-side shared memory for synchronization objects
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301, USA
+ */
+
+/*
+ * The state of events and semaphores created by a process that requested it
+ * is kept in an area shared with that process, so that the client can signal,
+ * reset and acquire them with atomic operations as long as no thread is
+ * blocked on them in the server. Each entry state holds the object count in
+ * its low half and the number of server waiters in its high half; the client
+ * only ever modifies a state whose waiter count is zero, so while a thread is
+ * waiting the server is the only one changing it.
+ */
+
+#include "config.h"
+#include "wine/port.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <unistd.h>
+#ifdef HAVE_SYS_MMAN_H
+#include <sys/mman.h>
+#endif
+
+#include "ntstatus.h"
+#define WIN32_NO_STATUS
+#include "windef.h"
+#include "winternl.h"
+
+#include "file.h"
+#include "process.h"
+#include "thread.h"
+#include "request.h"
+
+struct sync_shm
+{
+    struct object          obj;                           /* object header */
+    struct sync_shm_entry *entries;                       /* mapped shared memory */
+    unsigned int           next;                          /* next entry to try to allocate */
+    unsigned int           used;                          /* number of allocated entries */
+    int                    fd;                            /* file descriptor of the area */
+};
+
+C_ASSERT( sizeof(struct sync_shm_header) == sizeof(struct sync_shm_entry) );
+
+static void sync_shm_dump( struct object *obj, int verbose );
+static void sync_shm_destroy( struct object *obj );
+
+static const struct object_ops sync_shm_ops =
+{
+    sizeof(struct sync_shm),   /* size */
+    sync_shm_dump,             /* dump */
+    no_get_type,               /* get_type */
+    no_add_queue,              /* add_queue */
+    NULL,                      /* remove_queue */
+    NULL,                      /* signaled */
+    NULL,                      /* satisfied */
+    no_signal,                 /* signal */
+    no_get_fd,                 /* get_fd */
+    no_map_access,             /* map_access */
+    default_get_sd,            /* get_sd */
+    default_set_sd,            /* set_sd */
+    no_lookup_name,            /* lookup_name */
+    no_open_file,              /* open_file */
+    no_close_handle,           /* close_handle */
+    sync_shm_destroy           /* destroy */
+};
+
+static unsigned int last_serial;  /* last serial number handed out, shared by all areas */
+
+static void sync_shm_dump( struct object *obj, int verbose )
+{
+    struct sync_shm *shm = (struct sync_shm *)obj;
+    assert( obj->ops == &sync_shm_ops );
+    fprintf( stderr, "Sync shared memory used=%u\n", shm->used );
+}
+
+static void sync_shm_destroy( struct object *obj )
+{
+    struct sync_shm *shm = (struct sync_shm *)obj;
+    assert( obj->ops == &sync_shm_ops );
+    munmap( shm->entries, SYNC_SHM_SIZE );
+    close( shm->fd );
+}
+
+/* create the shared memory area of a process */
+static struct sync_shm *create_sync_shm(void)
+{
+    struct sync_shm *shm;
+    void *ptr;
+    int fd;
+
+    if ((fd = create_temp_file( SYNC_SHM_SIZE )) == -1) return NULL;
+    if ((ptr = mmap( NULL, SYNC_SHM_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0 )) == MAP_FAILED)
+    {
+        file_set_error();
+        close( fd );
+        return NULL;
+    }
+    if (!(shm = alloc_object( &sync_shm_ops )))
+    {
+        munmap( ptr, SYNC_SHM_SIZE );
+        close( fd );
+        return NULL;
+    }
+    shm->entries = ptr;
+    shm->next    = 0;
+    shm->used    = 0;
+    shm->fd      = fd;
+    return shm;
+}
+
+/* allocate an entry in the shared memory area of a process; return its index or -1 if none */
+int alloc_sync_shm_entry( struct process *process, enum sync_shm_type type,
+                          unsigned int count, unsigned int max, struct sync_shm **ret )
+{
+    struct sync_shm *shm = process->sync_shm;
+    unsigned int i, index;
+
+    if (!shm || shm->used == SYNC_SHM_ENTRIES - 1) return -1;
+
+    /* the first entry is the header */
+    for (i = 0; i < SYNC_SHM_ENTRIES - 1; i++)
+    {
+        index = 1 + (shm->next + i) % (SYNC_SHM_ENTRIES - 1);
+        if (!shm->entries[index].serial) break;
+    }
+    assert( i < SYNC_SHM_ENTRIES - 1 );
+
+    if (!++last_serial) last_serial++;  /* skip 0, it marks free entries */
+    shm->entries[index].state  = SYNC_SHM_STATE( count, 0 );
+    shm->entries[index].type   = type;
+    shm->entries[index].max    = max;
+    shm->entries[index].serial = last_serial;
+    shm->next = index;
+    shm->used++;
+    *ret = (struct sync_shm *)grab_object( shm );
+    return index;
+}
+
+/* free an entry and release the reference held on its area */
+void free_sync_shm_entry( struct sync_shm *shm, unsigned int index )
+{
+    assert( shm->entries[index].serial );
+    assert( !SYNC_SHM_WAITERS( shm->entries[index].state ));
+    shm->entries[index].type   = SYNC_SHM_FREE;
+    shm->entries[index].serial = 0;
+    shm->used--;
+    release_object( shm );
+}
+
+struct sync_shm_entry *get_sync_shm_entry( struct sync_shm *shm, unsigned int index )
+{
+    return &shm->entries[index];
+}
+
+/* atomically replace the count of an entry, returning the previous one */
+unsigned int sync_shm_set_count( struct sync_shm_entry *entry, unsigned int count )
+{
+    __int64 state;
+
+    do state = entry->state;
+    while (interlocked_cmpxchg64( &entry->state, SYNC_SHM_STATE( count, SYNC_SHM_WAITERS( state )),
+                                  state ) != state);
+    return SYNC_SHM_COUNT( state );
+}
+
+/* atomically add to the count of an entry without exceeding max, returning the previous one */
+/* on overflow the count is left unchanged and the previous count is still returned */
+unsigned int sync_shm_add_count( struct sync_shm_entry *entry, unsigned int incr, unsigned int max,
+                                 int *overflow )
+{
+    __int64 state;
+    unsigned int count;
+
+    do
+    {
+        state = entry->state;
+        count = SYNC_SHM_COUNT( state );
+        if ((*overflow = (count + incr < count || count + incr > max))) break;
+    }
+    while (interlocked_cmpxchg64( &entry->state, SYNC_SHM_STATE( count + incr, SYNC_SHM_WAITERS( state )),
+                                  state ) != state);
+    return count;
+}
+
+/* add or remove a server waiter on an entry */
+void sync_shm_add_waiter( struct sync_shm_entry *entry, int incr )
+{
+    __int64 state;
+
+    do state = entry->state;
+    while (interlocked_cmpxchg64( &entry->state,
+                                  SYNC_SHM_STATE( SYNC_SHM_COUNT( state ), SYNC_SHM_WAITERS( state ) + incr ),
+                                  state ) != state);
+}
+
+/* a handle of the process was closed by another process, so the cached states can't be trusted */
+void sync_shm_handle_closed( struct process *process )
+{
+    struct sync_shm_header *header;
+
+    if (!process->sync_shm) return;
+    header = (struct sync_shm_header *)process->sync_shm->entries;
+    interlocked_xchg_add( (int *)&header->close_count, 1 );
+}
+
+/* retrieve the shared memory area of the current process */
+DECL_HANDLER(get_sync_shm)
+{
+    struct process *process = current->process;
+
+    if (!process->sync_shm && !(process->sync_shm = create_sync_shm())) return;
+    reply->size = SYNC_SHM_SIZE;
+    send_client_fd( process, process->sync_shm->fd, 0 );
+}
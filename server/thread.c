@@ -181,12 +181,15 @@ static inline void init_thread_structure( struct thread *thread )
     thread->wait            = NULL;
     thread->error           = 0;
     thread->req_data        = NULL;
+    thread->batch_data      = NULL;
     thread->req_toread      = 0;
+    thread->req_data_size   = 0;
     thread->reply_data      = NULL;
     thread->reply_towrite   = 0;
     thread->request_fd      = NULL;
     thread->reply_fd        = NULL;
     thread->wait_fd         = NULL;
+    thread->request_shm     = NULL;
     thread->state           = RUNNING;
     thread->exit_code       = 0;
     thread->priority        = 0;
@@ -270,6 +273,7 @@ static void cleanup_thread( struct thread *thread )
     if (thread->request_fd) release_object( thread->request_fd );
     if (thread->reply_fd) release_object( thread->reply_fd );
     if (thread->wait_fd) release_object( thread->wait_fd );
+    free_request_shm( thread );
     free( thread->suspend_context );
     cleanup_clipboard_thread(thread);
     destroy_thread_windows( thread );
@@ -284,6 +288,8 @@ static void cleanup_thread( struct thread *thread )
         }
     }
     thread->req_data = NULL;
+    thread->batch_data = NULL;
+    thread->req_data_size = 0;
     thread->reply_data = NULL;
     thread->request_fd = NULL;
     thread->reply_fd = NULL;
@@ -1185,6 +1191,26 @@ DECL_HANDLER(init_thread)
     if (wait_fd != -1) close( wait_fd );
 }
 
+/* create the shared memory area used to return replies to the current thread */
+DECL_HANDLER(create_request_shm)
+{
+    struct request_shm *shm;
+    int fd;
+
+    if (current->request_shm)  /* already created */
+    {
+        set_error( STATUS_INVALID_PARAMETER );
+        return;
+    }
+    if (!(shm = create_request_shm( &fd ))) return;
+
+    /* the area is only used starting with the next request, see call_req_handler */
+    current->request_shm = shm;
+    reply->size = REQUEST_SHM_SIZE;
+    send_client_fd( current->process, fd, 0 );
+    close( fd );
+}
+
 /* terminate a thread */
 DECL_HANDLER(terminate_thread)
 {
@@ -65,13 +65,16 @@ struct thread
     unsigned int           error;         /* current error code */
     union generic_request  req;           /* current request */
     void                  *req_data;      /* variable-size data for request */
+    const void            *batch_data;    /* variable-size data of the batched request being executed */
     unsigned int           req_toread;    /* amount of data still to read in request */
+    unsigned int           req_data_size; /* allocated size of the request data buffer */
     void                  *reply_data;    /* variable-size data for reply */
     unsigned int           reply_size;    /* size of reply data */
     unsigned int           reply_towrite; /* amount of data still to write in reply */
     struct fd             *request_fd;    /* fd for receiving client requests */
     struct fd             *reply_fd;      /* fd to send a reply to a client */
     struct fd             *wait_fd;       /* fd to use to wake a sleeping client */
+    struct request_shm    *request_shm;   /* shared memory area for replies, if any */
     enum run_state         state;         /* running state */
     int                    exit_code;     /* thread exit code */
     int                    unix_pid;      /* Unix pid of client */
@@ -313,6 +313,59 @@ static void dump_varargs_ints( const char *prefix, data_size_t size )
     remove_data( size );
 }
 
+static void dump_varargs_request_stats( const char *prefix, data_size_t size )
+{
+    const struct request_stats *stats = cur_data;
+    data_size_t len = size / sizeof(*stats);
+
+    fprintf( stderr,"%s{", prefix );
+    while (len > 0)
+    {
+        fprintf( stderr, "{name=%s,count=%u,max_time=%u", stats->name, stats->count, stats->max_time );
+        dump_uint64( ",total_time=", &stats->total_time );
+        dump_uint64( ",reply_bytes=", &stats->reply_bytes );
+        fputc( '}', stderr );
+        stats++;
+        if (--len) fputc( ',', stderr );
+    }
+    fputc( '}', stderr );
+    remove_data( size );
+}
+
+static void dump_varargs_filesystem_events( const char *prefix, data_size_t size )
+{
+    static const char * const actions[] = {
+        NULL,
+        "ADDED",
+        "REMOVED",
+        "MODIFIED",
+        "RENAMED_OLD_NAME",
+        "RENAMED_NEW_NAME",
+        "ADDED_STREAM",
+        "REMOVED_STREAM",
+        "MODIFIED_STREAM"
+    };
+
+    fprintf( stderr,"%s{", prefix );
+    while (size)
+    {
+        const struct filesystem_event *event = cur_data;
+        data_size_t len = (offsetof( struct filesystem_event, name[event->len] ) + sizeof(int) - 1)
+                           & ~(sizeof(int) - 1);
+
+        if (size < len) break;
+        if (event->action < sizeof(actions) / sizeof(actions[0]) && actions[event->action])
+            fprintf( stderr, "{action=%s", actions[event->action] );
+        else
+            fprintf( stderr, "{action=%u", event->action );
+        fprintf( stderr, ",name=\"%.*s\"}", event->len, event->name );
+        remove_data( len );
+        size -= len;
+        if (size) fputc( ',', stderr );
+    }
+    fputc( '}', stderr );
+}
+
 static void dump_varargs_uints64( const char *prefix, data_size_t size )
 {
     const unsigned __int64 *data = cur_data;
@@ -1087,6 +1140,46 @@ static void dump_init_thread_reply( const struct init_thread_reply *req )
     fprintf( stderr, ", all_cpus=%08x", req->all_cpus );
 }
 
+static void dump_create_request_shm_request( const struct create_request_shm_request *req )
+{
+}
+
+static void dump_create_request_shm_reply( const struct create_request_shm_reply *req )
+{
+    fprintf( stderr, " size=%u", req->size );
+}
+
+static void dump_get_sync_shm_request( const struct get_sync_shm_request *req )
+{
+}
+
+static void dump_get_sync_shm_reply( const struct get_sync_shm_reply *req )
+{
+    fprintf( stderr, " size=%u", req->size );
+}
+
+static void dump_get_server_stats_request( const struct get_server_stats_request *req )
+{
+    fprintf( stderr, " pid=%04x", req->pid );
+}
+
+static void dump_get_server_stats_reply( const struct get_server_stats_reply *req )
+{
+    fprintf( stderr, " total=%08x", req->total );
+    dump_varargs_request_stats( ", stats=", cur_size );
+}
+
+static void dump_call_batch_request( const struct call_batch_request *req )
+{
+    dump_varargs_bytes( " requests=", cur_size );
+}
+
+static void dump_call_batch_reply( const struct call_batch_reply *req )
+{
+    fprintf( stderr, " count=%08x", req->count );
+    dump_varargs_bytes( ", replies=", cur_size );
+}
+
 static void dump_terminate_process_request( const struct terminate_process_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -1325,6 +1418,8 @@ static void dump_create_event_request( const struct create_event_request *req )
 static void dump_create_event_reply( const struct create_event_reply *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", shm_index=%08x", req->shm_index );
+    fprintf( stderr, ", shm_serial=%08x", req->shm_serial );
 }
 
 static void dump_event_op_request( const struct event_op_request *req )
@@ -1394,6 +1489,8 @@ static void dump_create_semaphore_request( const struct create_semaphore_request
 static void dump_create_semaphore_reply( const struct create_semaphore_reply *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
+    fprintf( stderr, ", shm_index=%08x", req->shm_index );
+    fprintf( stderr, ", shm_serial=%08x", req->shm_serial );
 }
 
 static void dump_release_semaphore_request( const struct release_semaphore_request *req )
@@ -1865,8 +1962,7 @@ static void dump_read_change_request( const struct read_change_request *req )
 
 static void dump_read_change_reply( const struct read_change_reply *req )
 {
-    fprintf( stderr, " action=%d", req->action );
-    dump_varargs_string( ", name=", cur_size );
+    dump_varargs_filesystem_events( " events=", cur_size );
 }
 
 static void dump_create_mapping_request( const struct create_mapping_request *req )
@@ -2373,6 +2469,15 @@ static void dump_get_msg_queue_reply( const struct get_msg_queue_reply *req )
     fprintf( stderr, " handle=%04x", req->handle );
 }
 
+static void dump_get_queue_ring_request( const struct get_queue_ring_request *req )
+{
+}
+
+static void dump_get_queue_ring_reply( const struct get_queue_ring_reply *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
 static void dump_set_queue_fd_request( const struct set_queue_fd_request *req )
 {
     fprintf( stderr, " handle=%04x", req->handle );
@@ -2663,6 +2768,15 @@ static void dump_get_desktop_window_reply( const struct get_desktop_window_reply
     fprintf( stderr, ", msg_window=%08x", req->msg_window );
 }
 
+static void dump_get_desktop_shm_request( const struct get_desktop_shm_request *req )
+{
+}
+
+static void dump_get_desktop_shm_reply( const struct get_desktop_shm_reply *req )
+{
+    fprintf( stderr, " handle=%04x", req->handle );
+}
+
 static void dump_set_window_owner_request( const struct set_window_owner_request *req )
 {
     fprintf( stderr, " handle=%08x", req->handle );
@@ -3854,6 +3968,10 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_startup_info_request,
     (dump_func)dump_init_process_done_request,
     (dump_func)dump_init_thread_request,
+    (dump_func)dump_create_request_shm_request,
+    (dump_func)dump_get_sync_shm_request,
+    (dump_func)dump_get_server_stats_request,
+    (dump_func)dump_call_batch_request,
     (dump_func)dump_terminate_process_request,
     (dump_func)dump_terminate_thread_request,
     (dump_func)dump_get_process_info_request,
@@ -3967,6 +4085,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_empty_atom_table_request,
     (dump_func)dump_init_atom_table_request,
     (dump_func)dump_get_msg_queue_request,
+    (dump_func)dump_get_queue_ring_request,
     (dump_func)dump_set_queue_fd_request,
     (dump_func)dump_set_queue_mask_request,
     (dump_func)dump_get_queue_status_request,
@@ -3992,6 +4111,7 @@ static const dump_func req_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_create_window_request,
     (dump_func)dump_destroy_window_request,
     (dump_func)dump_get_desktop_window_request,
+    (dump_func)dump_get_desktop_shm_request,
     (dump_func)dump_set_window_owner_request,
     (dump_func)dump_get_window_info_request,
     (dump_func)dump_set_window_info_request,
@@ -4100,6 +4220,10 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_get_startup_info_reply,
     NULL,
     (dump_func)dump_init_thread_reply,
+    (dump_func)dump_create_request_shm_reply,
+    (dump_func)dump_get_sync_shm_reply,
+    (dump_func)dump_get_server_stats_reply,
+    (dump_func)dump_call_batch_reply,
     (dump_func)dump_terminate_process_reply,
     (dump_func)dump_terminate_thread_reply,
     (dump_func)dump_get_process_info_reply,
@@ -4213,6 +4337,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     NULL,
     (dump_func)dump_init_atom_table_reply,
     (dump_func)dump_get_msg_queue_reply,
+    (dump_func)dump_get_queue_ring_reply,
     NULL,
     (dump_func)dump_set_queue_mask_reply,
     (dump_func)dump_get_queue_status_reply,
@@ -4238,6 +4363,7 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_create_window_reply,
     NULL,
     (dump_func)dump_get_desktop_window_reply,
+    (dump_func)dump_get_desktop_shm_reply,
     (dump_func)dump_set_window_owner_reply,
     (dump_func)dump_get_window_info_reply,
     (dump_func)dump_set_window_info_reply,
@@ -4339,13 +4465,17 @@ static const dump_func reply_dumpers[REQ_NB_REQUESTS] = {
     (dump_func)dump_set_cursor_reply,
 };
 
-static const char * const req_names[REQ_NB_REQUESTS] = {
+const char * const req_names[REQ_NB_REQUESTS] = {
     "new_process",
     "get_new_process_info",
     "new_thread",
     "get_startup_info",
     "init_process_done",
     "init_thread",
+    "create_request_shm",
+    "get_sync_shm",
+    "get_server_stats",
+    "call_batch",
     "terminate_process",
     "terminate_thread",
     "get_process_info",
@@ -4459,6 +4589,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "empty_atom_table",
     "init_atom_table",
     "get_msg_queue",
+    "get_queue_ring",
     "set_queue_fd",
     "set_queue_mask",
     "get_queue_status",
@@ -4484,6 +4615,7 @@ static const char * const req_names[REQ_NB_REQUESTS] = {
     "create_window",
     "destroy_window",
     "get_desktop_window",
+    "get_desktop_shm",
     "set_window_owner",
     "get_window_info",
     "set_window_info",
@@ -4677,6 +4809,7 @@ static const struct
     { "PIPE_NOT_AVAILABLE",          STATUS_PIPE_NOT_AVAILABLE },
     { "PRIVILEGE_NOT_HELD",          STATUS_PRIVILEGE_NOT_HELD },
     { "PROCESS_IS_TERMINATING",      STATUS_PROCESS_IS_TERMINATING },
+    { "REGISTRY_CORRUPT",            STATUS_REGISTRY_CORRUPT },
     { "SECTION_TOO_BIG",             STATUS_SECTION_TOO_BIG },
     { "SEMAPHORE_LIMIT_EXCEEDED",    STATUS_SEMAPHORE_LIMIT_EXCEEDED },
     { "SHARING_VIOLATION",           STATUS_SHARING_VIOLATION },
@@ -62,6 +62,10 @@ struct desktop
     struct hook_table   *global_hooks;   /* table of global hooks on this desktop */
     struct timeout_user *close_timeout;  /* timeout before closing the desktop */
     unsigned int         users;          /* processes and threads using this desktop */
+    struct object       *shm_mapping;    /* mapping of the shared window state */
+    struct window_shm   *shm;            /* server view of the shared window state */
+    int                  cursor_x;       /* cursor position of the last mouse input */
+    int                  cursor_y;
 };
 
 /* user handles functions */
@@ -142,6 +146,7 @@ extern struct thread *get_window_thread( user_handle_t handle );
 extern user_handle_t window_from_point( struct desktop *desktop, int x, int y );
 extern user_handle_t find_window_to_repaint( user_handle_t parent, struct thread *thread );
 extern struct window_class *get_window_class( user_handle_t window );
+extern void free_desktop_shm( struct desktop *desktop );
 
 /* window class functions */
 
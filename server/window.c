@@ -32,6 +32,7 @@
 #include "winuser.h"
 #include "winternl.h"
 
+#include "handle.h"
 #include "object.h"
 #include "request.h"
 #include "thread.h"
@@ -215,6 +216,44 @@ static void link_window( struct window *win, struct window *previous )
     win->is_linked = 1;
 }
 
+/* publish the state of a window in the shared memory of its desktop */
+static void update_window_shm( struct window *win )
+{
+    struct window_shm *entry;
+
+    if (!win->desktop->shm) return;
+    entry = &win->desktop->shm[((win->handle & 0xffff) - FIRST_USER_HANDLE) >> 1];
+    interlocked_xchg_add( (int *)&entry->seq, 1 );  /* odd while the entry is being written */
+    entry->handle   = win->handle;
+    entry->parent   = win->parent ? win->parent->handle : 0;
+    entry->owner    = win->owner;
+    entry->style    = win->style;
+    entry->ex_style = win->ex_style;
+    entry->window   = win->window_rect;
+    entry->client   = win->client_rect;
+    interlocked_xchg_add( (int *)&entry->seq, 1 );
+}
+
+/* remove a destroyed window from the shared memory of its desktop */
+static void clear_window_shm( struct window *win )
+{
+    struct window_shm *entry;
+
+    if (!win->desktop->shm) return;
+    entry = &win->desktop->shm[((win->handle & 0xffff) - FIRST_USER_HANDLE) >> 1];
+    interlocked_xchg_add( (int *)&entry->seq, 1 );
+    entry->handle = 0;
+    interlocked_xchg_add( (int *)&entry->seq, 1 );
+}
+
+/* free the shared window state of a desktop */
+void free_desktop_shm( struct desktop *desktop )
+{
+    release_server_mapping( desktop->shm_mapping, desktop->shm );
+    desktop->shm_mapping = NULL;
+    desktop->shm = NULL;
+}
+
 /* change the parent of a window (or unlink the window if the new parent is NULL) */
 static int set_parent_window( struct window *win, struct window *parent )
 {
@@ -246,6 +285,7 @@ static int set_parent_window( struct window *win, struct window *parent )
         list_add_head( &win->parent->unlinked, &win->entry );
         win->is_linked = 0;
     }
+    update_window_shm( win );
     return 1;
 }
 
@@ -501,6 +541,7 @@ static struct window *create_window( struct window *parent, struct window *owner
     }
 
     current->desktop_users++;
+    update_window_shm( win );
     return win;
 
 failed:
@@ -1552,8 +1593,10 @@ static void set_window_pos( struct window *win, struct window *previous,
             offset_rect( &child->window_rect, new_size - old_size, 0 );
             offset_rect( &child->visible_rect, new_size - old_size, 0 );
             offset_rect( &child->client_rect, new_size - old_size, 0 );
+            update_window_shm( child );
         }
     }
+    update_window_shm( win );
 
     /* if the window is not visible, everything is easy */
     if (!visible) return;
@@ -1726,6 +1769,7 @@ void destroy_window( struct window *win )
     if (win == shell_listview) shell_listview = NULL;
     if (win == progman_window) progman_window = NULL;
     if (win == taskman_window) taskman_window = NULL;
+    clear_window_shm( win );
     free_user_handle( win->handle );
     destroy_properties( win );
     list_remove( &win->entry );
@@ -1828,6 +1872,7 @@ DECL_HANDLER(get_desktop_window)
         {
             detach_window_thread( desktop->top_window );
             desktop->top_window->style  = WS_POPUP | WS_VISIBLE | WS_CLIPSIBLINGS | WS_CLIPCHILDREN;
+            update_window_shm( desktop->top_window );
         }
     }
 
@@ -1840,6 +1885,7 @@ DECL_HANDLER(get_desktop_window)
         {
             detach_window_thread( desktop->msg_window );
             desktop->msg_window->style = WS_POPUP | WS_CLIPSIBLINGS | WS_CLIPCHILDREN;
+            update_window_shm( desktop->msg_window );
         }
     }
 
@@ -1849,6 +1895,32 @@ DECL_HANDLER(get_desktop_window)
 }
 
 
+/* retrieve the shared window state of the current thread desktop */
+DECL_HANDLER(get_desktop_shm)
+{
+    struct desktop *desktop = get_thread_desktop( current, 0 );
+    struct window *win;
+    user_handle_t handle = 0;
+    void *ptr;
+
+    if (!desktop) return;
+
+    if (!desktop->shm_mapping)  /* create it and publish the existing windows */
+    {
+        if (!(desktop->shm_mapping = create_server_mapping( DESKTOP_SHM_SIZE, &ptr )))
+        {
+            release_object( desktop );
+            return;
+        }
+        desktop->shm = ptr;
+        while ((win = next_user_handle( &handle, USER_WINDOW )))
+            if (win->desktop == desktop) update_window_shm( win );
+    }
+    reply->handle = alloc_handle( current->process, desktop->shm_mapping,
+                                  SECTION_MAP_READ | SECTION_QUERY, 0 );
+    release_object( desktop );
+}
+
 /* set a window owner */
 DECL_HANDLER(set_window_owner)
 {
@@ -1875,6 +1947,7 @@ DECL_HANDLER(set_window_owner)
 
     reply->prev_owner = win->owner;
     reply->full_owner = win->owner = owner ? owner->handle : 0;
+    update_window_shm( win );
 }
 
 
@@ -1950,6 +2023,7 @@ DECL_HANDLER(set_window_info)
 
     /* changing window style triggers a non-client paint */
     if (req->flags & SET_WIN_STYLE) win->paint_flags |= PAINT_NONCLIENT;
+    if (req->flags & (SET_WIN_STYLE | SET_WIN_EXSTYLE)) update_window_shm( win );
 }
 
 
@@ -231,6 +231,10 @@ static struct desktop *create_desktop( const struct unicode_str *name, unsigned
             desktop->global_hooks = NULL;
             desktop->close_timeout = NULL;
             desktop->users = 0;
+            desktop->shm_mapping = NULL;
+            desktop->shm = NULL;
+            desktop->cursor_x = 0;
+            desktop->cursor_y = 0;
             list_add_tail( &winstation->desktops, &desktop->entry );
         }
     }
@@ -274,6 +278,7 @@ static void desktop_destroy( struct object *obj )
     if (desktop->msg_window) destroy_window( desktop->msg_window );
     if (desktop->global_hooks) release_object( desktop->global_hooks );
     if (desktop->close_timeout) remove_timeout_user( desktop->close_timeout );
+    if (desktop->shm_mapping) free_desktop_shm( desktop );
     list_remove( &desktop->entry );
     release_object( desktop->winstation );
 }